@@ -0,0 +1,86 @@
+/**
+ * ensemble_bench.c
+ *
+ * Parameter-sweep workload: thousands of universes with MAX_OBJECTS-sized
+ * populations. Compares one UniverseCreate per world stepped in a loop with
+ * an Ensemble stepped by EnsembleUpdate at increasing thread counts.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "../src/core/engine.h"
+
+#define WORLDS 4096
+#define PER_WORLD 100
+#define STEPS 100
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void populate(Universe *universe, uint32_t world) {
+  UniverseSetBoundaries(universe, 800, 600, 10.0f, true);
+  srand(world + 1);
+  for (int i = 0; i < PER_WORLD; i++) {
+    KVector2 p = {20 + rand() % 700, 20 + rand() % 500};
+    KVector2 v = {rand() % 80 - 40.0, rand() % 80 - 40.0};
+    ParticleCreate(universe, p, v, 1.0);
+  }
+}
+
+int main(int argc, char **argv) {
+  uint32_t maxThreads = argc > 1 ? (uint32_t)atoi(argv[1]) : 8;
+  static Universe *separate[WORLDS];
+
+  double start = now();
+  for (uint32_t w = 0; w < WORLDS; w++) {
+    separate[w] = UniverseCreate(PER_WORLD);
+    if (!separate[w]) {
+      fprintf(stderr, "allocation failed\n");
+      return 1;
+    }
+    populate(separate[w], w);
+  }
+  double createTime = now() - start;
+
+  start = now();
+  for (int s = 0; s < STEPS; s++)
+    for (uint32_t w = 0; w < WORLDS; w++)
+      UniverseUpdate(separate[w], 1.0 / 60.0);
+  double baseline = now() - start;
+
+  for (uint32_t w = 0; w < WORLDS; w++)
+    UniverseDestroy(separate[w]);
+
+  printf("ensemble_bench: %d worlds x %d particles, %d steps\n", WORLDS,
+         PER_WORLD, STEPS);
+  printf("  separate universes  : %8.2f ms (create %.2f ms)\n", baseline * 1e3,
+         createTime * 1e3);
+
+  for (uint32_t threads = 1; threads <= maxThreads; threads *= 2) {
+    start = now();
+    Ensemble *ensemble = EnsembleCreate(WORLDS, PER_WORLD, threads);
+    if (!ensemble) {
+      fprintf(stderr, "allocation failed\n");
+      return 1;
+    }
+    for (uint32_t w = 0; w < WORLDS; w++)
+      populate(EnsembleWorld(ensemble, w), w);
+    createTime = now() - start;
+
+    start = now();
+    for (int s = 0; s < STEPS; s++)
+      EnsembleUpdate(ensemble, 1.0 / 60.0);
+    double elapsed = now() - start;
+
+    printf("  ensemble, %2u threads: %8.2f ms (create %.2f ms), %5.2fx\n",
+           threads, elapsed * 1e3, createTime * 1e3, baseline / elapsed);
+    EnsembleDestroy(ensemble);
+  }
+
+  return 0;
+}
@@ -0,0 +1,85 @@
+/**
+ * fluid_bench.c
+ *
+ * Dam break with 100k+ SPH particles. Reports the cost of the fluid pass and
+ * of whole steps per thread count, against the 60 Hz frame budget.
+ *
+ * Usage: fluid_bench [particles] [steps] [maxThreads]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "../src/core/engine.h"
+
+#define FRAME_BUDGET_MS (1000.0 / 60.0)
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* A block 2/5 of the world wide in the bottom-left corner */
+static Universe *damBreak(uint32_t particles) {
+  Universe *universe = UniverseCreate(particles);
+  if (!universe || !FluidEnable(universe, NULL))
+    return NULL;
+
+  const double spacing = universe->fluid->settings.spacing;
+  const uint32_t columns = 500;
+  const uint32_t rows = (particles + columns - 1) / columns;
+  UniverseSetBoundaries(universe, (int)(columns * spacing * 2.5),
+                        (int)(rows * spacing * 1.5), 10.0f, true);
+
+  const UniverseBoundary walls = universe->boundary;
+  for (uint32_t i = 0; i < particles; i++) {
+    KVector2 p = {walls.left + spacing * (1 + i % columns),
+                  walls.bottom - spacing * (1 + i / columns)};
+    FluidParticleCreate(universe, p, (KVector2){0, 0});
+  }
+  return universe;
+}
+
+int main(int argc, char **argv) {
+  uint32_t particles = argc > 1 ? (uint32_t)atoi(argv[1]) : 100000;
+  int steps = argc > 2 ? atoi(argv[2]) : 50;
+  uint32_t maxThreads = argc > 3 ? (uint32_t)atoi(argv[3]) : 8;
+
+  printf("fluid_bench: %u particles, %d steps, %s backend\n", particles, steps,
+         ParallelBackendName(ParallelGetBackend()));
+
+  for (uint32_t threads = 1; threads <= maxThreads; threads *= 2) {
+    ParallelSetThreads(threads);
+    Universe *universe = damBreak(particles);
+    if (!universe) {
+      fprintf(stderr, "allocation failed\n");
+      return 1;
+    }
+    double dt = FluidMaxTimestep(universe);
+
+    double start = now();
+    for (int s = 0; s < steps; s++)
+      UniverseUpdate(universe, dt);
+    double elapsed = now() - start;
+
+    // The fluid share alone, on the state the steps left behind
+    start = now();
+    for (int s = 0; s < steps; s++) {
+      PhysicsFluidUpdate(universe);
+      PhysicsClearForces(universe);
+    }
+    double fluidTime = now() - start;
+
+    double fluidMs = fluidTime * 1e3 / steps;
+    double stepMs = elapsed * 1e3 / steps;
+    printf("  %2u threads: fluid pass %6.2f ms, step %6.2f ms, %6.1f steps/s%s\n",
+           threads, fluidMs, stepMs, 1e3 / stepMs,
+           stepMs <= FRAME_BUDGET_MS ? "" : " (over the 60 Hz budget)");
+    UniverseDestroy(universe);
+  }
+
+  ParallelShutdown();
+  return 0;
+}
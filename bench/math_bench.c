@@ -0,0 +1,186 @@
+/**
+ * math_bench.c
+ *
+ * Batch math kernels against a loop of the scalar functions they replace.
+ * Each operation runs over a cache-resident batch many times. It is timed
+ * three ways: scalar calls on an array of structs, the batch function on
+ * the same array of structs, and the batch function on SoA arrays.
+ *
+ * Usage: math_bench [elements] [repeats]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "../src/core/engine.h"
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+typedef struct {
+  size_t count;
+  KVector3 *a, *b, *out;
+  double *ax, *ay, *az, *bx, *by, *bz, *ox, *oy, *oz, *dots;
+  KQuaternion *q1, *q2, *products;
+  Matrix3x3 *matrices;
+} Data;
+
+typedef void (*Kernel)(Data *data);
+
+/* Scalar loops, one call per element as callers wrote them before */
+static void scalarUnit(Data *d) {
+  for (size_t i = 0; i < d->count; i++)
+    d->out[i] = KVector3Unit(d->a[i]);
+}
+static void scalarDot(Data *d) {
+  for (size_t i = 0; i < d->count; i++)
+    d->dots[i] = KVector3DotProduct(d->a[i], d->b[i]);
+}
+static void scalarCross(Data *d) {
+  for (size_t i = 0; i < d->count; i++)
+    d->out[i] = KVector3CrossProduct(d->a[i], d->b[i]);
+}
+static void scalarRotate(Data *d) {
+  for (size_t i = 0; i < d->count; i++)
+    d->out[i] = KQuaternionRotate(d->q1[0], d->a[i]);
+}
+static void scalarMultiply(Data *d) {
+  for (size_t i = 0; i < d->count; i++)
+    d->products[i] = KQuaternionMultiply(d->q1[i], d->q2[i]);
+}
+static void scalarMatrix(Data *d) {
+  for (size_t i = 0; i < d->count; i++)
+    d->matrices[i] = KQuaternionToMatrix3(d->q1[i]);
+}
+
+/* Batches over the same arrays of structs */
+static void aosUnit(Data *d) {
+  KVector3UnitBatch(KVector3ArrayOf(d->a), KVector3ArrayOf(d->out), d->count);
+}
+static void aosDot(Data *d) {
+  KVector3DotProductBatch(KVector3ArrayOf(d->a), KVector3ArrayOf(d->b),
+                          d->dots, d->count);
+}
+static void aosCross(Data *d) {
+  KVector3CrossProductBatch(KVector3ArrayOf(d->a), KVector3ArrayOf(d->b),
+                            KVector3ArrayOf(d->out), d->count);
+}
+static void aosRotate(Data *d) {
+  KQuaternionRotateBatch(d->q1[0], KVector3ArrayOf(d->a),
+                         KVector3ArrayOf(d->out), d->count);
+}
+static void batchMultiply(Data *d) {
+  KQuaternionMultiplyBatch(d->q1, d->q2, d->products, d->count);
+}
+static void batchMatrix(Data *d) {
+  KQuaternionToMatrix3Batch(d->q1, d->matrices, d->count);
+}
+
+/* Batches over SoA arrays */
+static void soaUnit(Data *d) {
+  KVector3UnitBatch(KVector3ArraySoA(d->ax, d->ay, d->az),
+                    KVector3ArraySoA(d->ox, d->oy, d->oz), d->count);
+}
+static void soaDot(Data *d) {
+  KVector3DotProductBatch(KVector3ArraySoA(d->ax, d->ay, d->az),
+                          KVector3ArraySoA(d->bx, d->by, d->bz), d->dots,
+                          d->count);
+}
+static void soaCross(Data *d) {
+  KVector3CrossProductBatch(KVector3ArraySoA(d->ax, d->ay, d->az),
+                            KVector3ArraySoA(d->bx, d->by, d->bz),
+                            KVector3ArraySoA(d->ox, d->oy, d->oz), d->count);
+}
+static void soaRotate(Data *d) {
+  KQuaternionRotateBatch(d->q1[0], KVector3ArraySoA(d->ax, d->ay, d->az),
+                         KVector3ArraySoA(d->ox, d->oy, d->oz), d->count);
+}
+
+static double nanosecondsPerElement(Kernel kernel, Data *data, int repeats) {
+  kernel(data);
+  double begin = now();
+  for (int r = 0; r < repeats; r++)
+    kernel(data);
+  return (now() - begin) * 1e9 / ((double)repeats * data->count);
+}
+
+static double randomValue(void) {
+  return (double)rand() / RAND_MAX * 2.0 - 1.0;
+}
+
+int main(int argc, char **argv) {
+  size_t count = argc > 1 ? (size_t)atol(argv[1]) : 4096;
+  int repeats = argc > 2 ? atoi(argv[2]) : 20000;
+
+  Data d = {.count = count};
+  d.a = malloc(count * sizeof(KVector3));
+  d.b = malloc(count * sizeof(KVector3));
+  d.out = malloc(count * sizeof(KVector3));
+  double *scalars = malloc(10 * count * sizeof(double));
+  d.q1 = malloc(count * sizeof(KQuaternion));
+  d.q2 = malloc(count * sizeof(KQuaternion));
+  d.products = malloc(count * sizeof(KQuaternion));
+  d.matrices = malloc(count * sizeof(Matrix3x3));
+  if (!d.a || !d.b || !d.out || !scalars || !d.q1 || !d.q2 || !d.products ||
+      !d.matrices) {
+    fprintf(stderr, "allocation failed\n");
+    return 1;
+  }
+  double **columns[10] = {&d.ax, &d.ay, &d.az, &d.bx, &d.by,
+                          &d.bz, &d.ox, &d.oy, &d.oz, &d.dots};
+  for (int c = 0; c < 10; c++)
+    *columns[c] = scalars + c * count;
+
+  for (size_t i = 0; i < count; i++) {
+    d.a[i] = (KVector3){randomValue(), randomValue(), randomValue()};
+    d.b[i] = (KVector3){randomValue(), randomValue(), randomValue()};
+    d.ax[i] = d.a[i].x, d.ay[i] = d.a[i].y, d.az[i] = d.a[i].z;
+    d.bx[i] = d.b[i].x, d.by[i] = d.b[i].y, d.bz[i] = d.b[i].z;
+    d.q1[i] = KQuaternionFromAxisAngle(d.a[i], 3.0 * randomValue());
+    d.q2[i] = KQuaternionFromAxisAngle(d.b[i], 3.0 * randomValue());
+  }
+
+  const struct {
+    const char *name;
+    Kernel scalar, aos, soa;
+  } cases[] = {
+      {"vector3 unit", scalarUnit, aosUnit, soaUnit},
+      {"vector3 dot", scalarDot, aosDot, soaDot},
+      {"vector3 cross", scalarCross, aosCross, soaCross},
+      {"quaternion rotate", scalarRotate, aosRotate, soaRotate},
+      {"quaternion multiply", scalarMultiply, batchMultiply, NULL},
+      {"quaternion to matrix3", scalarMatrix, batchMatrix, NULL},
+  };
+
+  printf("math_bench: %zu elements x %d repeats, ns per element\n", count,
+         repeats);
+  printf("  %-22s %8s %8s %8s %8s\n", "", "scalar", "batch", "soa", "speedup");
+  for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+    double scalar = nanosecondsPerElement(cases[c].scalar, &d, repeats);
+    double aos = nanosecondsPerElement(cases[c].aos, &d, repeats);
+    double soa = cases[c].soa
+                     ? nanosecondsPerElement(cases[c].soa, &d, repeats)
+                     : aos;
+    double best = soa < aos ? soa : aos;
+    if (cases[c].soa)
+      printf("  %-22s %8.3f %8.3f %8.3f %7.1fx\n", cases[c].name, scalar, aos,
+             soa, scalar / best);
+    else
+      printf("  %-22s %8.3f %8.3f %8s %7.1fx\n", cases[c].name, scalar, aos,
+             "-", scalar / best);
+  }
+
+  free(d.a);
+  free(d.b);
+  free(d.out);
+  free(scalars);
+  free(d.q1);
+  free(d.q2);
+  free(d.products);
+  free(d.matrices);
+  return 0;
+}
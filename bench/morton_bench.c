@@ -0,0 +1,130 @@
+/**
+ * morton_bench.c
+ *
+ * Neighbour-heavy workload before and after a Morton reorder. Every particle
+ * counts the neighbours within CELL_SIZE through a uniform grid, so each
+ * step reads the positions of ~9 cells worth of other particles. With storage
+ * in random order those reads miss cache; after UniverseReorderByMorton they
+ * mostly hit lines already loaded for the previous particle.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../src/core/engine.h"
+
+#define PARTICLES 400000
+#define WORLD_SIZE 4000.0
+#define CELL_SIZE 8.0
+#define GRID (int)(WORLD_SIZE / CELL_SIZE)
+#define REPEATS 5
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int cellOf(double v) {
+  int c = (int)(v / CELL_SIZE);
+  return c < 0 ? 0 : (c >= GRID ? GRID - 1 : c);
+}
+
+// Counting sort of slots into cells, then a 3x3 cell neighbour count
+static uint64_t countNeighbours(const Universe *universe, uint32_t *cellStart,
+                                uint32_t *cellSlots) {
+  const uint32_t n = universe->maxEntities;
+  const KineticBodyComponent *bodies = universe->kineticBodies;
+
+  memset(cellStart, 0, (GRID * GRID + 1) * sizeof(uint32_t));
+  for (uint32_t i = 0; i < n; i++)
+    cellStart[cellOf(bodies[i].position.y) * GRID +
+              cellOf(bodies[i].position.x) + 1]++;
+  for (int c = 0; c < GRID * GRID; c++)
+    cellStart[c + 1] += cellStart[c];
+  for (uint32_t i = 0; i < n; i++) {
+    int cell = cellOf(bodies[i].position.y) * GRID + cellOf(bodies[i].position.x);
+    cellSlots[cellStart[cell]++] = i;
+  }
+  for (int c = GRID * GRID; c > 0; c--)
+    cellStart[c] = cellStart[c - 1];
+  cellStart[0] = 0;
+
+  uint64_t pairs = 0;
+  for (uint32_t i = 0; i < n; i++) {
+    KVector2 p = bodies[i].position;
+    int cx = cellOf(p.x), cy = cellOf(p.y);
+
+    for (int y = cy - 1; y <= cy + 1; y++) {
+      for (int x = cx - 1; x <= cx + 1; x++) {
+        if (x < 0 || y < 0 || x >= GRID || y >= GRID)
+          continue;
+        int cell = y * GRID + x;
+        for (uint32_t k = cellStart[cell]; k < cellStart[cell + 1]; k++) {
+          KVector2 q = bodies[cellSlots[k]].position;
+          double dx = q.x - p.x, dy = q.y - p.y;
+          pairs += dx * dx + dy * dy < CELL_SIZE * CELL_SIZE;
+        }
+      }
+    }
+  }
+  return pairs;
+}
+
+static double timeWorkload(const Universe *universe, uint32_t *cellStart,
+                           uint32_t *cellSlots, uint64_t *pairs) {
+  double best = 1e30;
+  for (int r = 0; r < REPEATS; r++) {
+    double start = now();
+    *pairs = countNeighbours(universe, cellStart, cellSlots);
+    double elapsed = now() - start;
+    best = elapsed < best ? elapsed : best;
+  }
+  return best;
+}
+
+int main(int argc, char **argv) {
+  uint32_t threads = argc > 1 ? (uint32_t)atoi(argv[1]) : 1;
+  ParallelSetThreads(threads);
+  UniverseOptions options = {0};
+  options.touchThreads = threads;
+
+  Universe *universe = UniverseCreateWithOptions(PARTICLES, &options);
+  uint32_t *cellStart = malloc((GRID * GRID + 1) * sizeof(uint32_t));
+  uint32_t *cellSlots = malloc(PARTICLES * sizeof(uint32_t));
+  if (!universe || !cellStart || !cellSlots) {
+    fprintf(stderr, "allocation failed\n");
+    return 1;
+  }
+
+  srand(1234);
+  for (uint32_t i = 0; i < PARTICLES; i++) {
+    KVector2 p = {WORLD_SIZE * rand() / (double)RAND_MAX,
+                  WORLD_SIZE * rand() / (double)RAND_MAX};
+    ParticleCreate(universe, p, (KVector2){0, 0}, 1.0);
+  }
+
+  uint64_t before = 0, after = 0;
+  double scattered = timeWorkload(universe, cellStart, cellSlots, &before);
+
+  double start = now();
+  UniverseReorderByMorton(universe);
+  double sortTime = now() - start;
+
+  double sorted = timeWorkload(universe, cellStart, cellSlots, &after);
+
+  printf("morton_bench: %d particles, %u sort thread(s)\n", PARTICLES, threads);
+  printf("  neighbour pass, scattered : %8.2f ms (%llu pairs)\n",
+         scattered * 1e3, (unsigned long long)before);
+  printf("  neighbour pass, Z-ordered : %8.2f ms (%llu pairs)\n", sorted * 1e3,
+         (unsigned long long)after);
+  printf("  reorder cost              : %8.2f ms\n", sortTime * 1e3);
+  printf("  speedup                   : %8.2fx\n", scattered / sorted);
+
+  free(cellStart);
+  free(cellSlots);
+  UniverseDestroy(universe);
+  return before == after ? 0 : 1;
+}
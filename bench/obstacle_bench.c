@@ -0,0 +1,108 @@
+/**
+ * obstacle_bench.c
+ *
+ * Particles raining through a field of thousands of static segments, circles
+ * and boxes. Times the obstacle pass against the wall pass it runs next to,
+ * PhysicsResolveBoundaryCollisions, over the same particles.
+ *
+ * Usage: obstacle_bench [particles] [obstacles] [steps]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "../src/core/engine.h"
+
+#define WORLD 4000.0
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static double randomIn(double lo, double hi) {
+  return lo + (hi - lo) * rand() / (double)RAND_MAX;
+}
+
+/* Short tilted segments, pegs and small boxes scattered over the world */
+static uint32_t scatter(Universe *universe, uint32_t count) {
+  uint32_t added = 0;
+  for (uint32_t i = 0; i < count; i++) {
+    KVector2 c = {randomIn(50.0, WORLD - 50.0), randomIn(200.0, WORLD - 50.0)};
+    bool ok;
+    if (i % 4 < 2) {
+      KVector2 half = {randomIn(5.0, 20.0), randomIn(-8.0, 8.0)};
+      ok = ObstacleAddSegment(universe, KVector2Subtraction(c, half),
+                              KVector2Addition(c, half));
+    } else if (i % 4 == 2) {
+      ok = ObstacleAddCircle(universe, c, randomIn(2.0, 6.0));
+    } else {
+      const KVector2 box[4] = {{c.x - 4, c.y - 3},
+                               {c.x + 4, c.y - 3},
+                               {c.x + 4, c.y + 3},
+                               {c.x - 4, c.y + 3}};
+      ok = ObstacleAddPolygon(universe, box, 4);
+    }
+    added += ok;
+  }
+  return added;
+}
+
+int main(int argc, char **argv) {
+  uint32_t particles = argc > 1 ? (uint32_t)atoi(argv[1]) : 100000;
+  uint32_t obstacles = argc > 2 ? (uint32_t)atoi(argv[2]) : 5000;
+  int steps = argc > 3 ? atoi(argv[3]) : 200;
+  const double dt = 1.0 / 60.0;
+
+  Universe *universe = UniverseCreate(particles);
+  if (!universe || !ObstaclesEnable(universe, obstacles, 4 * obstacles)) {
+    fprintf(stderr, "allocation failed\n");
+    return 1;
+  }
+  UniverseSetBoundaries(universe, (int)WORLD, (int)WORLD, 0.0f, true);
+  srand(1);
+  uint32_t added = scatter(universe, obstacles);
+  for (uint32_t i = 0; i < particles; i++) {
+    KVector2 position = {randomIn(10.0, WORLD - 10.0), randomIn(10.0, WORLD)};
+    KVector2 velocity = {randomIn(-50.0, 50.0), randomIn(-50.0, 50.0)};
+    EntityID e = ParticleCreate(universe, position, velocity, 1.0);
+    UniverseAddRadiusComponent(universe, e, 1.5);
+    UniverseGetMechanicsComponent(universe, e)->acceleration =
+        (KVector2){0.0, 400.0};
+  }
+
+  double begin = now();
+  ObstaclesBuild(universe);
+  double buildMs = (now() - begin) * 1e3;
+
+  double wallSeconds = 0.0, obstacleSeconds = 0.0;
+  uint64_t contacts = 0;
+  for (int s = 0; s < steps; s++) {
+    PhysicsMechanicsUpdate(universe, dt);
+    PhysicsPositionUpdate(universe, dt);
+    double t0 = now();
+    PhysicsResolveBoundaryCollisions(universe);
+    double t1 = now();
+    PhysicsResolveObstacleCollisions(universe);
+    double t2 = now();
+    wallSeconds += t1 - t0;
+    obstacleSeconds += t2 - t1;
+    contacts += universe->obstacles->contacts;
+  }
+
+  const ObstacleSet *set = universe->obstacles;
+  printf("obstacle_bench: %u particles, %u obstacles, %d steps, %s backend\n",
+         particles, added, steps, ParallelBackendName(ParallelGetBackend()));
+  printf("  build %.2f ms: %u nodes, depth %u\n", buildMs, set->nodeCount,
+         set->depth);
+  printf("  walls %.3f ms/step, obstacles %.3f ms/step (%.1fx), "
+         "%.0f contacts/step\n",
+         wallSeconds * 1e3 / steps, obstacleSeconds * 1e3 / steps,
+         obstacleSeconds / wallSeconds, (double)contacts / steps);
+
+  UniverseDestroy(universe);
+  ParallelShutdown();
+  return 0;
+}
@@ -0,0 +1,92 @@
+/**
+ * rigid_bench.c
+ *
+ * A pyramid of thousands of stacked boxes on the floor. Reports the cost of
+ * a step per thread count against the 60 Hz frame budget, and how far the
+ * apex sank, which shows whether the stack held. A pyramid ninety rows tall
+ * needs more iterations than the default to carry its weight down, so the
+ * count is a parameter.
+ *
+ * Usage: rigid_bench [boxes] [steps] [maxThreads] [iterations]
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "../src/core/engine.h"
+
+#define FRAME_BUDGET_MS (1000.0 / 60.0)
+#define HALF 10.0
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* Rows of boxes, each half a box in from the one below; returns the apex */
+static EntityID pyramid(Universe *universe, uint32_t boxes) {
+  uint32_t base = 1;
+  while (base * (base + 1) / 2 < boxes)
+    base++;
+
+  UniverseSetBoundaries(universe, (int)(2.0 * HALF * (base + 4)),
+                        (int)(2.0 * HALF * (base + 4)), 10.0f, true);
+  const UniverseBoundary walls = universe->boundary;
+
+  EntityID apex = INVALID_ENTITY;
+  uint32_t placed = 0;
+  for (uint32_t row = 0; row < base && placed < boxes; row++) {
+    for (uint32_t i = 0; i < base - row && placed < boxes; i++, placed++) {
+      KVector2 p = {walls.left + 2.0 * HALF * (2 + i) + HALF * row,
+                    walls.bottom - HALF - 2.0 * HALF * row};
+      apex = RigidBoxCreate(universe, p, (KVector2){HALF, HALF}, 0.0, 1.0);
+    }
+  }
+  return apex;
+}
+
+int main(int argc, char **argv) {
+  uint32_t boxes = argc > 1 ? (uint32_t)atoi(argv[1]) : 4000;
+  int steps = argc > 2 ? atoi(argv[2]) : 300;
+  uint32_t maxThreads = argc > 3 ? (uint32_t)atoi(argv[3]) : 8;
+  uint32_t iterations = argc > 4 ? (uint32_t)atoi(argv[4]) : 30;
+  const double dt = 1.0 / 60.0;
+
+  printf("rigid_bench: %u boxes, %d steps, %u iterations, %s backend\n",
+         boxes, steps, iterations, ParallelBackendName(ParallelGetBackend()));
+
+  for (uint32_t threads = 1; threads <= maxThreads; threads *= 2) {
+    ParallelSetThreads(threads);
+    Universe *universe = UniverseCreate(boxes);
+    RigidSettings settings = RigidDefaultSettings();
+    settings.maxBodies = boxes;
+    settings.iterations = iterations;
+    if (!universe || !RigidEnable(universe, &settings)) {
+      fprintf(stderr, "allocation failed\n");
+      return 1;
+    }
+    EntityID apex = pyramid(universe, boxes);
+    double start = RigidGetBody(universe, apex)->position.y;
+
+    double begin = now();
+    for (int s = 0; s < steps; s++)
+      UniverseUpdate(universe, dt);
+    double elapsed = now() - begin;
+
+    const RigidSolver *rigid = universe->rigid;
+    double stepMs = elapsed * 1e3 / steps;
+    printf("  %2u threads: step %6.2f ms, %6.1f steps/s%s; %u contacts, "
+           "%u warm started, apex sank %.2f\n",
+           threads, stepMs, 1e3 / stepMs,
+           stepMs <= FRAME_BUDGET_MS ? "" : " (over the 60 Hz budget)",
+           rigid->manifoldCount, rigid->warmStarted,
+           RigidGetBody(universe, apex)->position.y - start);
+    UniverseDestroy(universe);
+  }
+
+  ParallelShutdown();
+  return 0;
+}
@@ -0,0 +1,132 @@
+/**
+ * spatial_bench.c
+ *
+ * Index upkeep and query throughput over a moving particle cloud: the
+ * incremental update UniverseUpdate runs each step, then batches of radius
+ * and nearest queries, against the full scan they replace.
+ *
+ * Usage: spatial_bench [particles] [queries] [steps]
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "../src/core/engine.h"
+
+#define WORLD 4000.0
+#define QUERY_RADIUS 12.0
+#define PER_QUERY 64
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static double randomIn(double lo, double hi) {
+  return lo + (hi - lo) * rand() / (double)RAND_MAX;
+}
+
+/* What a radius query costs without the index */
+static uint32_t scanRadius(const Universe *universe, KVector2 centre,
+                           double radius) {
+  uint32_t found = 0;
+  for (uint32_t w = 0; w < BITSET_WORDS(universe->maxEntities); w++) {
+    uint64_t bits =
+        UniverseMatchWord(universe, w, COMPONENT_PARTICLE, COMPONENT_NONE);
+    while (bits) {
+      uint32_t i = w * 64 + (uint32_t)__builtin_ctzll(bits);
+      bits &= bits - 1;
+      KVector2 p = universe->kineticBodies[i].position;
+      double dx = p.x - centre.x, dy = p.y - centre.y;
+      found += dx * dx + dy * dy <= radius * radius;
+    }
+  }
+  return found;
+}
+
+int main(int argc, char **argv) {
+  uint32_t particles = argc > 1 ? (uint32_t)atoi(argv[1]) : 100000;
+  uint32_t queries = argc > 2 ? (uint32_t)atoi(argv[2]) : 10000;
+  int steps = argc > 3 ? atoi(argv[3]) : 50;
+  const double dt = 1.0 / 60.0;
+
+  Universe *universe = UniverseCreate(particles);
+  KVector2 *centres = malloc(queries * sizeof(KVector2));
+  double *radii = malloc(queries * sizeof(double));
+  EntityID *out = malloc((size_t)queries * PER_QUERY * sizeof(EntityID));
+  uint32_t *counts = malloc(queries * sizeof(uint32_t));
+  if (!universe || !centres || !radii || !out || !counts) {
+    fprintf(stderr, "allocation failed\n");
+    return 1;
+  }
+  UniverseSetBoundaries(universe, (int)WORLD, (int)WORLD, 0.0f, true);
+  srand(1);
+  for (uint32_t i = 0; i < particles; i++) {
+    KVector2 position = {randomIn(0.0, WORLD), randomIn(0.0, WORLD)};
+    KVector2 velocity = {randomIn(-60.0, 60.0), randomIn(-60.0, 60.0)};
+    ParticleCreate(universe, position, velocity, 1.0);
+  }
+
+  double begin = now();
+  UniverseSpatialIndexEnable(universe, 2.0 * QUERY_RADIUS);
+  double enableMs = (now() - begin) * 1e3;
+
+  double updateSeconds = 0.0, radiusSeconds = 0.0, nearestSeconds = 0.0;
+  uint64_t relinked = 0, found = 0;
+  for (int s = 0; s < steps; s++) {
+    PhysicsMechanicsUpdate(universe, dt);
+    PhysicsPositionUpdate(universe, dt);
+    PhysicsResolveBoundaryCollisions(universe);
+    for (uint32_t q = 0; q < queries; q++) {
+      centres[q] = (KVector2){randomIn(0.0, WORLD), randomIn(0.0, WORLD)};
+      radii[q] = QUERY_RADIUS;
+    }
+
+    double t0 = now();
+    UniverseSpatialIndexUpdate(universe);
+    double t1 = now();
+    UniverseQueryRadiusBatch(universe, centres, radii, queries, out, PER_QUERY,
+                             counts);
+    double t2 = now();
+    UniverseQueryNearestBatch(universe, centres, queries, INFINITY, out);
+    double t3 = now();
+    updateSeconds += t1 - t0;
+    radiusSeconds += t2 - t1;
+    nearestSeconds += t3 - t2;
+    relinked += universe->spatial->relinked;
+    for (uint32_t q = 0; q < queries; q++)
+      found += counts[q];
+  }
+
+  // A handful of scans is enough to price one
+  const int scans = 20;
+  uint64_t scanned = 0;
+  double t0 = now();
+  for (int q = 0; q < scans; q++)
+    scanned += scanRadius(universe, centres[q], QUERY_RADIUS);
+  double scanUs = (now() - t0) * 1e6 / scans;
+
+  const double perStep = 1e3 / steps;
+  printf("spatial_bench: %u particles, %u queries/step, %d steps, %s backend\n",
+         particles, queries, steps, ParallelBackendName(ParallelGetBackend()));
+  printf("  enable %.2f ms, update %.3f ms/step (%.0f relinked)\n", enableMs,
+         updateSeconds * perStep, (double)relinked / steps);
+  printf("  radius %.3f ms/step (%.2f us/query, %.1f found), "
+         "nearest %.3f ms/step (%.2f us/query)\n",
+         radiusSeconds * perStep, radiusSeconds * 1e6 / steps / queries,
+         (double)found / steps / queries, nearestSeconds * perStep,
+         nearestSeconds * 1e6 / steps / queries);
+  printf("  full scan %.2f us/query (%.0f found)\n", scanUs,
+         (double)scanned / scans);
+
+  UniverseDestroy(universe);
+  free(centres);
+  free(radii);
+  free(out);
+  free(counts);
+  ParallelShutdown();
+  return 0;
+}
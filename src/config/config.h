@@ -9,7 +9,24 @@
 
 /* Entity/Simulation limits */
 #define MAX_OBJECTS 100
-#define OBJECT_RADIUS 5
+#define OBJECT_RADIUS 5 /* default collision radius of ParticleCreate */
+
+/* Maximum number of distinct cached entity queries per universe */
+#define MAX_QUERIES 16
+
+/* Number of deferred command buffers per universe (one per worker thread) */
+#define MAX_COMMAND_BUFFERS 16
+
+/* Systems a universe schedules, built-in ones included (see scheduler.h) */
+#define MAX_SYSTEMS 32
+/* Words of 64 slots a fused sweep runs through every kernel at a time */
+#define SCHEDULER_FUSE_WORDS 16
+
+/* Smallest slice of slots a system hands to one parallel worker */
+#define PARALLEL_GRAIN_SLOTS 16384
+
+/* Minimum alignment of component columns, one cache line */
+#define COLUMN_ALIGNMENT 64
 
 /* Physics parameters */
 #define GRAVITY_X 0.0
@@ -17,9 +34,65 @@
 #define RESTITUTION 0.8
 #define DEFAULT_MASS 1.0
 
+/* Adaptive substepping: class k takes 2^k substeps, k < TIMESTEP_CLASSES */
+#define TIMESTEP_CLASSES 8
+/* Least fraction of maxDisplacement an approached wall lowers the limit to */
+#define TIMESTEP_WALL_FLOOR 0.25
+
+/* Diagnostics: relative drift beyond these flags a step as unstable */
+#define DIAGNOSTICS_ENERGY_TOLERANCE 0.05   /* gain since the reference */
+#define DIAGNOSTICS_STEP_TOLERANCE 0.01     /* gain in a single step */
+#define DIAGNOSTICS_MOMENTUM_TOLERANCE 0.05 /* only checked without walls */
+
+/* Fluid defaults (see physics/fluid.h), in world units and seconds */
+#define FLUID_SMOOTHING_RADIUS 8.0
+#define FLUID_SPACING 4.0
+#define FLUID_PARTICLE_MASS 1.0
+#define FLUID_STIFFNESS 4.0e5 /* speed of sound ~630, steps up to ~5 ms */
+#define FLUID_VISCOSITY 100.0
+#define FLUID_GRAVITY_X 0.0
+#define FLUID_GRAVITY_Y 400.0
+
+/* Rigid bodies (see physics/rigid.h), in world units and seconds */
+#define RIGID_MAX_BODIES 4096
+#define RIGID_MAX_VERTICES 8  /* per polygon; fixes the shape component size */
+#define RIGID_PAIRS_PER_BODY 8 /* candidate pairs the scratch holds per body */
+#define RIGID_ITERATIONS 10
+#define RIGID_GRAVITY_X 0.0
+#define RIGID_GRAVITY_Y 400.0
+#define RIGID_FRICTION 0.6
+#define RIGID_RESTITUTION 0.0
+#define RIGID_BOUNCE_THRESHOLD 20.0 /* slower impacts do not bounce */
+#define RIGID_BAUMGARTE 0.2 /* share of the overlap removed per step */
+#define RIGID_SLOP 0.5      /* overlap left alone so contacts persist */
+#define RIGID_MAX_CONDITION 1000.0 /* blocks worse than this solve per point */
+
+/* Static obstacles (see physics/obstacles.h) */
+#define OBSTACLE_NODE_WIDTH 4   /* children per hierarchy node */
+#define OBSTACLE_LEAF_SIZE 4    /* obstacles per leaf at most */
+#define OBSTACLE_STACK_DEPTH 64 /* traversal stack, ~3 entries per level */
+
+/* World streaming (see chunks.h) */
+#define CHUNK_MAX_FOCI 4  /* viewports and other regions kept resident */
+#define CHUNK_SIZE 256.0  /* world units per chunk side */
+#define CHUNK_CAPACITY 4096 /* particles a frozen chunk holds */
+
 /* Boundary handling */
 #define BOUNDARY_PADDING 10.0f
 
+/* Simulated world, independent of the window; the camera frames it */
+#define WORLD_WIDTH 1600
+#define WORLD_HEIGHT 900
+
+/* Rendering: screen tiles used for culling and density aggregation */
+#define RENDER_TILE_PIXELS 4
+/* Tiles holding more particles than this are drawn as density */
+#define RENDER_TILE_DETAIL_LIMIT 4
+/* Particles smaller than this on screen are drawn as density */
+#define RENDER_MIN_RADIUS_PIXELS 0.75f
+#define RENDER_MIN_ZOOM 0.01f
+#define RENDER_MAX_ZOOM 64.0f
+
 /* Window defaults (used when the renderer cannot query current size) */
 #define WINDOW_DEFAULT_WIDTH 800
 #define WINDOW_DEFAULT_HEIGHT 600
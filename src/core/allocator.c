@@ -0,0 +1,313 @@
+#include "allocator.h"
+
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "parallel.h"
+
+#define HUGE_PAGE_SIZE ((size_t)2 * 1024 * 1024)
+/* First overflow block of an arena; each later one is twice the last */
+#define ARENA_MIN_GROWTH ((size_t)64 * 1024)
+
+static size_t roundUp(size_t value, size_t alignment) {
+  return (value + alignment - 1) & ~(alignment - 1);
+}
+
+typedef struct {
+  _Atomic uint64_t allocations;
+  _Atomic uint64_t bytes;
+  _Atomic uint64_t liveBytes;
+  _Atomic uint64_t peakBytes;
+} AccountCounters;
+
+static AccountCounters accounts[K_MEMORY_OWNERS];
+static _Atomic(KAllocationHook) allocationHook;
+static void *_Atomic allocationHookContext;
+
+static const char *const ownerNames[K_MEMORY_OWNERS] = {
+    "arena",   "universe", "columns",   "queries", "commands",
+    "reorder", "timestep", "scheduler", "spatial", "fluid",
+    "rigid",   "obstacles", "chunks",   "publish", "ensemble"};
+
+void KAccountAllocation(KMemoryOwner owner, size_t bytes) {
+  if ((unsigned)owner >= K_MEMORY_OWNERS)
+    return;
+
+  AccountCounters *account = &accounts[owner];
+  atomic_fetch_add_explicit(&account->allocations, 1, memory_order_relaxed);
+  atomic_fetch_add_explicit(&account->bytes, bytes, memory_order_relaxed);
+  uint64_t live = atomic_fetch_add_explicit(&account->liveBytes, bytes,
+                                            memory_order_relaxed) +
+                  bytes;
+  uint64_t peak = atomic_load_explicit(&account->peakBytes,
+                                       memory_order_relaxed);
+  // A failed exchange reloads peak; stop once it is at least live
+  while (live > peak)
+    if (atomic_compare_exchange_weak_explicit(&account->peakBytes, &peak, live,
+                                              memory_order_relaxed,
+                                              memory_order_relaxed))
+      break;
+
+  KAllocationHook hook =
+      atomic_load_explicit(&allocationHook, memory_order_acquire);
+  if (hook)
+    hook(atomic_load_explicit(&allocationHookContext, memory_order_relaxed),
+         owner, bytes);
+}
+
+void KAccountRelease(KMemoryOwner owner, size_t bytes) {
+  if ((unsigned)owner >= K_MEMORY_OWNERS)
+    return;
+
+  atomic_fetch_sub_explicit(&accounts[owner].liveBytes, bytes,
+                            memory_order_relaxed);
+}
+
+void KAllocationSnapshot(KAllocationStats *stats) {
+  if (!stats)
+    return;
+
+  for (uint32_t o = 0; o < K_MEMORY_OWNERS; o++) {
+    AccountCounters *account = &accounts[o];
+    stats[o].allocations =
+        atomic_load_explicit(&account->allocations, memory_order_relaxed);
+    stats[o].bytes =
+        atomic_load_explicit(&account->bytes, memory_order_relaxed);
+    stats[o].liveBytes =
+        atomic_load_explicit(&account->liveBytes, memory_order_relaxed);
+    stats[o].peakBytes =
+        atomic_load_explicit(&account->peakBytes, memory_order_relaxed);
+  }
+}
+
+uint64_t KAllocationCount(void) {
+  uint64_t count = 0;
+  for (uint32_t o = 0; o < K_MEMORY_OWNERS; o++)
+    count += atomic_load_explicit(&accounts[o].allocations,
+                                  memory_order_relaxed);
+  return count;
+}
+
+void KSetAllocationHook(KAllocationHook hook, void *context) {
+  // The context goes first, so a caller that sees the hook sees it too
+  atomic_store_explicit(&allocationHookContext, context, memory_order_relaxed);
+  atomic_store_explicit(&allocationHook, hook, memory_order_release);
+}
+
+const char *KMemoryOwnerName(KMemoryOwner owner) {
+  return (unsigned)owner < K_MEMORY_OWNERS ? ownerNames[owner] : "unknown";
+}
+
+static KArenaBlock *mapBlock(size_t size, bool hugePages) {
+  size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+  void *memory = MAP_FAILED;
+
+  size = roundUp(size, hugePages ? HUGE_PAGE_SIZE : pageSize);
+
+#ifdef MAP_HUGETLB
+  // Explicit huge pages need a reserved pool; fall back silently without one
+  if (hugePages)
+    memory = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                  MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+#endif
+
+  if (memory == MAP_FAILED) {
+    memory = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                  MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED)
+      return NULL;
+#ifdef MADV_HUGEPAGE
+    if (hugePages)
+      madvise(memory, size, MADV_HUGEPAGE);
+#endif
+  }
+
+  KAccountAllocation(K_MEMORY_ARENA, size);
+  KArenaBlock *block = (KArenaBlock *)memory;
+  block->next = NULL;
+  block->size = size;
+  block->used = sizeof(KArenaBlock);
+  return block;
+}
+
+static void *blockAllocate(KArenaBlock *block, size_t size, size_t alignment) {
+  uintptr_t base = (uintptr_t)block;
+  size_t offset = roundUp(base + block->used, alignment) - base;
+
+  if (offset + size > block->size)
+    return NULL;
+
+  block->used = offset + size;
+  return (void *)(base + offset);
+}
+
+KArena *KArenaCreate(size_t capacity, bool hugePages) {
+  KArenaBlock *block =
+      mapBlock(capacity + sizeof(KArenaBlock) + sizeof(KArena), hugePages);
+  if (!block)
+    return NULL;
+
+  KArena *arena =
+      (KArena *)blockAllocate(block, sizeof(KArena), _Alignof(KArena));
+  arena->head = block;
+  arena->growth = ARENA_MIN_GROWTH;
+  arena->hugePages = hugePages;
+  return arena;
+}
+
+void *KArenaAllocate(KArena *arena, size_t size, size_t alignment) {
+  if (!arena || alignment == 0 || (alignment & (alignment - 1)) != 0)
+    return NULL;
+
+  void *memory = blockAllocate(arena->head, size, alignment);
+  if (memory)
+    return memory;
+
+  // Sized from the request, not the first block, and doubling each time
+  size_t needed = sizeof(KArenaBlock) + size + alignment;
+  KArenaBlock *block = mapBlock(
+      needed > arena->growth ? needed : arena->growth, arena->hugePages);
+  if (!block)
+    return NULL;
+  arena->growth = 2 * block->size;
+
+  block->next = arena->head;
+  arena->head = block;
+  return blockAllocate(block, size, alignment);
+}
+
+void KArenaDestroy(KArena *arena) {
+  if (!arena)
+    return;
+
+  // The arena header sits in the oldest block, so unmap that one last
+  KArenaBlock *block = arena->head;
+  while (block) {
+    KArenaBlock *next = block->next;
+    KAccountRelease(K_MEMORY_ARENA, block->size);
+    munmap(block, block->size);
+    block = next;
+  }
+}
+
+static void *arenaAllocate(void *context, size_t size, size_t alignment) {
+  return KArenaAllocate((KArena *)context, size, alignment);
+}
+
+static void arenaRelease(void *context, void *pointer) {
+  (void)context;
+  (void)pointer;
+}
+
+KAllocator KArenaAllocator(KArena *arena) {
+  KAllocator allocator = {arenaAllocate, arenaRelease, arena,
+                          K_ALLOCATOR_ARENA};
+  return allocator;
+}
+
+static void *heapAllocate(void *context, size_t size, size_t alignment) {
+  (void)context;
+  if (alignment < sizeof(void *))
+    alignment = sizeof(void *);
+
+  void *memory = aligned_alloc(alignment, roundUp(size ? size : 1, alignment));
+  if (memory)
+    memset(memory, 0, size);
+  return memory;
+}
+
+static void heapRelease(void *context, void *pointer) {
+  (void)context;
+  free(pointer);
+}
+
+KAllocator KHeapAllocator(void) {
+  KAllocator allocator = {heapAllocate, heapRelease, NULL, K_ALLOCATOR_HEAP};
+  return allocator;
+}
+
+KAllocator KAllocatorRebind(KAllocator allocator) {
+  switch (allocator.kind) {
+  case K_ALLOCATOR_ARENA:
+    return KArenaAllocator((KArena *)allocator.context);
+  case K_ALLOCATOR_HEAP:
+    return KHeapAllocator();
+  default:
+    return allocator; // the caller's code, not reloaded with us
+  }
+}
+
+typedef struct {
+  unsigned char *data;
+  size_t bytes;
+  uint32_t slices;
+} TouchJob;
+
+static void touchSlices(void *context, uint32_t begin, uint32_t end,
+                        uint32_t chunk) {
+  (void)chunk;
+  const TouchJob *job = (const TouchJob *)context;
+  size_t first = job->bytes * begin / job->slices;
+  size_t last = job->bytes * end / job->slices;
+  memset(job->data + first, 0, last - first);
+}
+
+static void swapBytes(unsigned char *a, unsigned char *b, size_t size) {
+  unsigned char held[64];
+  while (size) {
+    size_t n = size < sizeof(held) ? size : sizeof(held);
+    memcpy(held, a, n);
+    memcpy(a, b, n);
+    memcpy(b, held, n);
+    a += n;
+    b += n;
+    size -= n;
+  }
+}
+
+static void siftDown(unsigned char *base, size_t root, size_t count,
+                     size_t size, int (*compare)(const void *, const void *)) {
+  for (size_t child = 2 * root + 1; child < count; child = 2 * root + 1) {
+    if (child + 1 < count &&
+        compare(base + child * size, base + (child + 1) * size) < 0)
+      child++;
+    if (compare(base + root * size, base + child * size) >= 0)
+      return;
+    swapBytes(base + root * size, base + child * size, size);
+    root = child;
+  }
+}
+
+void KSort(void *base, size_t count, size_t size,
+           int (*compare)(const void *, const void *)) {
+  unsigned char *bytes = (unsigned char *)base;
+  if (count < 2)
+    return;
+
+  for (size_t root = count / 2; root-- > 0;)
+    siftDown(bytes, root, count, size, compare);
+  for (size_t end = count - 1; end > 0; end--) {
+    swapBytes(bytes, bytes + end * size, size);
+    siftDown(bytes, 0, end, size, compare);
+  }
+}
+
+void KFirstTouch(void *data, size_t bytes, uint32_t threads) {
+  if (!data || bytes == 0)
+    return;
+
+  if (threads > PARALLEL_MAX_THREADS)
+    threads = PARALLEL_MAX_THREADS;
+
+  if (threads <= 1) {
+    memset(data, 0, bytes);
+    return;
+  }
+
+  // Slice t goes to chunk t, the worker that runs chunk t of every system
+  TouchJob job = {(unsigned char *)data, bytes, threads};
+  ParallelForChunks(threads, threads, touchSlices, &job);
+}
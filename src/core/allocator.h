@@ -0,0 +1,128 @@
+/**
+ * allocator.h
+ *
+ * Pluggable allocation for universe storage. The default backing is a linear
+ * arena of anonymous mappings: every column of a universe is carved from one
+ * cache-aligned block, nothing is freed individually and teardown unmaps the
+ * whole block at once.
+ */
+#ifndef ECS_ALLOCATOR_H
+#define ECS_ALLOCATOR_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Which callbacks an allocator holds; custom ones are zero-initialised */
+typedef enum {
+  K_ALLOCATOR_CUSTOM = 0,
+  K_ALLOCATOR_ARENA, /* KArenaAllocator, context is the arena */
+  K_ALLOCATOR_HEAP,  /* KHeapAllocator */
+} KAllocatorKind;
+
+/**
+ * Allocation callbacks. `allocate` must return zero-filled memory aligned to
+ * `alignment` (a power of two) or NULL; `release` may be a no-op. The kind
+ * lets a reloaded copy of the library point built-in allocators at its own
+ * callbacks (see UniverseRebind).
+ */
+typedef struct {
+  void *(*allocate)(void *context, size_t size, size_t alignment);
+  void (*release)(void *context, void *pointer);
+  void *context;
+  KAllocatorKind kind;
+} KAllocator;
+
+typedef struct KArenaBlock {
+  struct KArenaBlock *next;
+  size_t size;
+  size_t used;
+} KArenaBlock;
+
+/**
+ * Linear arena. The arena header lives inside its own first block. When a
+ * request does not fit, a new block of at least `growth` bytes is mapped
+ * and chained, so allocations never fail because the estimate was short.
+ * `growth` starts at 64 KiB and doubles with every block, so a big first
+ * block does not make every overflow block as big.
+ */
+typedef struct {
+  KArenaBlock *head;
+  size_t growth;
+  bool hugePages;
+} KArena;
+
+KArena *KArenaCreate(size_t capacity, bool hugePages);
+void *KArenaAllocate(KArena *arena, size_t size, size_t alignment);
+void KArenaDestroy(KArena *arena);
+KAllocator KArenaAllocator(KArena *arena);
+
+KAllocator KHeapAllocator(void);
+/* The built-in allocators rebuilt from this copy of the library */
+KAllocator KAllocatorRebind(KAllocator allocator);
+
+/**
+ * Allocation accounting. Every place the engine takes memory reports it
+ * under its owner: arena blocks when they are mapped, universe storage when
+ * it is carved, and the few heap buffers (command buffers, publishers,
+ * ensembles) when they grow. Counters are process-wide and atomic. Worker
+ * threads and libc internals are not counted.
+ */
+typedef enum {
+  K_MEMORY_ARENA, /* blocks mapped for arenas; the owners below carve them */
+  K_MEMORY_UNIVERSE,
+  K_MEMORY_COLUMNS,
+  K_MEMORY_QUERIES,
+  K_MEMORY_COMMANDS,
+  K_MEMORY_REORDER,
+  K_MEMORY_TIMESTEP,
+  K_MEMORY_SCHEDULER,
+  K_MEMORY_SPATIAL,
+  K_MEMORY_FLUID,
+  K_MEMORY_RIGID,
+  K_MEMORY_OBSTACLES,
+  K_MEMORY_CHUNKS,
+  K_MEMORY_PUBLISH,
+  K_MEMORY_ENSEMBLE,
+  K_MEMORY_OWNERS
+} KMemoryOwner;
+
+typedef struct {
+  uint64_t allocations;
+  uint64_t bytes; /* allocated in total */
+  uint64_t liveBytes;
+  uint64_t peakBytes; /* highest liveBytes */
+} KAllocationStats;
+
+/* Called on every counted allocation, from the allocating thread */
+typedef void (*KAllocationHook)(void *context, KMemoryOwner owner,
+                                size_t bytes);
+
+void KAccountAllocation(KMemoryOwner owner, size_t bytes);
+void KAccountRelease(KMemoryOwner owner, size_t bytes);
+/* Copies the counters of all K_MEMORY_OWNERS owners */
+void KAllocationSnapshot(KAllocationStats *stats);
+/* Allocations so far, all owners together */
+uint64_t KAllocationCount(void);
+/* NULL removes the hook */
+void KSetAllocationHook(KAllocationHook hook, void *context);
+const char *KMemoryOwnerName(KMemoryOwner owner);
+
+/**
+ * In-place heapsort with qsort's interface. glibc's qsort takes a merge
+ * buffer from malloc for all but small arrays, so code that runs every step
+ * sorts with this instead. Not stable: `compare` must be a total order for
+ * the result to be deterministic.
+ */
+void KSort(void *base, size_t count, size_t size,
+           int (*compare)(const void *, const void *));
+
+/**
+ * Writes `bytes` of zeroes from `threads` worker threads, each taking one
+ * contiguous slice. On NUMA machines the first write places a page on the
+ * writer's node, so slicing the same way systems partition entities keeps
+ * each worker's columns local. `threads <= 1` touches from the caller.
+ */
+void KFirstTouch(void *data, size_t bytes, uint32_t threads);
+
+#endif /* ECS_ALLOCATOR_H */
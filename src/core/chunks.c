@@ -0,0 +1,409 @@
+#include "chunks.h"
+
+#include <fcntl.h>
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+static size_t alignUp(size_t bytes, size_t alignment) {
+  return (bytes + alignment - 1) & ~(alignment - 1);
+}
+
+static bool testBit(const uint64_t *bits, uint32_t index) {
+  return bits[index >> 6] >> (index & 63) & 1;
+}
+
+static void setBit(uint64_t *bits, uint32_t index) {
+  bits[index >> 6] |= (uint64_t)1 << (index & 63);
+}
+
+ChunkSettings ChunkDefaultSettings(void) {
+  ChunkSettings settings = {0};
+  settings.chunkSize = CHUNK_SIZE;
+  settings.chunksX = (uint32_t)ceil(WORLD_WIDTH / CHUNK_SIZE);
+  settings.chunksY = (uint32_t)ceil(WORLD_HEIGHT / CHUNK_SIZE);
+  settings.capacity = CHUNK_CAPACITY;
+  settings.halo = 1;
+  settings.interval = 1;
+  settings.streamed = COMPONENT_PARTICLE | COMPONENT_MECHANICS |
+                      COMPONENT_RADIUS;
+  return settings;
+}
+
+static bool validSettings(const Universe *universe,
+                          const ChunkSettings *settings) {
+  const ComponentMask registered =
+      universe->componentCount >= 64
+          ? ~COMPONENT_NONE
+          : COMPONENT_BIT(universe->componentCount) - 1;
+  return settings->chunkSize > 0.0 && isfinite(settings->chunkSize) &&
+         isfinite(settings->origin.x) && isfinite(settings->origin.y) &&
+         settings->chunksX > 0 && settings->chunksY > 0 &&
+         (uint64_t)settings->chunksX * settings->chunksY <= UINT32_MAX &&
+         settings->capacity > 0 && settings->interval > 0 &&
+         settings->wakeSpeed >= 0.0 &&
+         (settings->streamed & COMPONENT_PARTICLE) &&
+         !(settings->streamed & ~registered);
+}
+
+/* A scratch file nobody else can open; it goes away with the descriptor */
+static int openPageFile(const char *path) {
+  if (path)
+    return open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+
+  const char *directory = getenv("TMPDIR");
+  char name[PATH_MAX];
+  if (snprintf(name, sizeof(name), "%s/kurage-chunks-XXXXXX",
+               directory && directory[0] ? directory : "/tmp") >=
+      (int)sizeof(name))
+    return -1;
+  int fd = mkstemp(name);
+  if (fd >= 0)
+    unlink(name);
+  return fd;
+}
+
+bool UniverseChunksEnable(Universe *universe, const ChunkSettings *settings) {
+  if (!universe)
+    return false;
+  if (universe->chunks)
+    return true;
+
+  ChunkSettings chosen = settings ? *settings : ChunkDefaultSettings();
+  if (!validSettings(universe, &chosen))
+    return false;
+
+  // Records pack the streamed components after the mask, 8-byte aligned
+  size_t offsets[MAX_COMPONENTS] = {0};
+  size_t recordBytes = sizeof(ComponentMask);
+  for (ComponentMask m = chosen.streamed; m; m &= m - 1) {
+    const uint32_t c = (uint32_t)__builtin_ctzll(m);
+    offsets[c] = recordBytes;
+    recordBytes = alignUp(recordBytes + universe->columns[c].size, 8);
+  }
+
+  const size_t pageBytes = (size_t)sysconf(_SC_PAGESIZE);
+  const uint32_t chunkCount = chosen.chunksX * chosen.chunksY;
+  const size_t slotBytes = alignUp(chosen.capacity * recordBytes, pageBytes);
+  const size_t fileBytes = slotBytes * chunkCount;
+  if (fileBytes / chunkCount != slotBytes)
+    return false;
+
+  // The file stays sparse: only slots that ever held a particle use disk
+  int fd = openPageFile(chosen.path);
+  if (fd < 0)
+    return false;
+  void *pages = MAP_FAILED;
+  if (ftruncate(fd, (off_t)fileBytes) == 0)
+    pages = mmap(NULL, fileBytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (pages == MAP_FAILED) {
+    close(fd);
+    return false;
+  }
+
+  const size_t header = alignUp(sizeof(ChunkWorld), COLUMN_ALIGNMENT);
+  const size_t counts =
+      alignUp((size_t)chunkCount * sizeof(uint32_t), COLUMN_ALIGNMENT);
+  const size_t bits = alignUp(
+      (size_t)BITSET_WORDS(chunkCount) * sizeof(uint64_t), COLUMN_ALIGNMENT);
+  unsigned char *block = (unsigned char *)UniverseAllocate(
+      universe, K_MEMORY_CHUNKS, header + counts + 2 * bits, COLUMN_ALIGNMENT);
+  if (!block) {
+    munmap(pages, fileBytes);
+    close(fd);
+    return false;
+  }
+  memset(block, 0, header + counts + 2 * bits);
+
+  ChunkWorld *world = (ChunkWorld *)block;
+  world->settings = chosen;
+  world->settings.path = NULL; // the caller's string may not outlive us
+  world->inverseChunkSize = 1.0 / chosen.chunkSize;
+  world->chunkCount = chunkCount;
+  world->counts = (uint32_t *)(block + header);
+  world->wanted = (uint64_t *)(block + header + counts);
+  world->written = (uint64_t *)(block + header + counts + bits);
+  memcpy(world->offsets, offsets, sizeof(offsets));
+  world->recordBytes = recordBytes;
+  world->slotBytes = slotBytes;
+  world->pageBytes = pageBytes;
+  world->pages = (unsigned char *)pages;
+  world->fileBytes = fileBytes;
+  world->fd = fd;
+  universe->chunks = world;
+  return true;
+}
+
+void UniverseChunksDisable(Universe *universe) {
+  ChunkWorld *world = universe ? universe->chunks : NULL;
+  if (!world)
+    return;
+
+  munmap(world->pages, world->fileBytes);
+  close(world->fd);
+  const size_t bits = alignUp(
+      (size_t)BITSET_WORDS(world->chunkCount) * sizeof(uint64_t),
+      COLUMN_ALIGNMENT);
+  const size_t bytes =
+      alignUp(sizeof(ChunkWorld), COLUMN_ALIGNMENT) +
+      alignUp((size_t)world->chunkCount * sizeof(uint32_t), COLUMN_ALIGNMENT) +
+      2 * bits;
+  universe->chunks = NULL;
+  UniverseRelease(universe, K_MEMORY_CHUNKS, world, bytes);
+}
+
+bool ChunkSetFocus(Universe *universe, uint32_t focus, KVector2 min,
+                   KVector2 max) {
+  ChunkWorld *world = universe ? universe->chunks : NULL;
+  if (!world || focus >= CHUNK_MAX_FOCI)
+    return false;
+
+  world->focusMin[focus] = min;
+  world->focusMax[focus] = max;
+  world->focused[focus] = min.x <= max.x && min.y <= max.y;
+  return true;
+}
+
+/* NaN lands in chunk 0 */
+static uint32_t chunkCoordinate(double value, double origin, double inverse,
+                                uint32_t chunks) {
+  const double c = (value - origin) * inverse;
+  if (!(c >= 0.0))
+    return 0;
+  return c >= chunks ? chunks - 1 : (uint32_t)c;
+}
+
+static uint32_t chunkOf(const ChunkWorld *world, KVector2 position) {
+  const ChunkSettings *s = &world->settings;
+  return chunkCoordinate(position.y, s->origin.y, world->inverseChunkSize,
+                         s->chunksY) *
+             s->chunksX +
+         chunkCoordinate(position.x, s->origin.x, world->inverseChunkSize,
+                         s->chunksX);
+}
+
+uint32_t ChunkIndex(const Universe *universe, KVector2 position) {
+  const ChunkWorld *world = universe ? universe->chunks : NULL;
+  return world ? chunkOf(world, position) : 0;
+}
+
+bool ChunkIsWanted(const Universe *universe, KVector2 position) {
+  const ChunkWorld *world = universe ? universe->chunks : NULL;
+  return world && testBit(world->wanted, chunkOf(world, position));
+}
+
+const ChunkStats *ChunkGetStats(const Universe *universe) {
+  return universe && universe->chunks ? &universe->chunks->stats : NULL;
+}
+
+static unsigned char *record(const ChunkWorld *world, uint32_t chunk,
+                             uint32_t index) {
+  return world->pages + (size_t)chunk * world->slotBytes +
+         (size_t)index * world->recordBytes;
+}
+
+/* Wants the chunks [x0, x1] x [y0, y1], widened by the halo */
+static void want(ChunkWorld *world, uint32_t x0, uint32_t y0, uint32_t x1,
+                 uint32_t y1) {
+  const ChunkSettings *s = &world->settings;
+  x0 = x0 > s->halo ? x0 - s->halo : 0;
+  y0 = y0 > s->halo ? y0 - s->halo : 0;
+  x1 = s->chunksX - 1 - x1 > s->halo ? x1 + s->halo : s->chunksX - 1;
+  y1 = s->chunksY - 1 - y1 > s->halo ? y1 + s->halo : s->chunksY - 1;
+  for (uint32_t y = y0; y <= y1; y++)
+    for (uint32_t x = x0; x <= x1; x++)
+      setBit(world->wanted, y * s->chunksX + x);
+}
+
+static void wantAround(ChunkWorld *world, KVector2 position) {
+  const uint32_t chunk = chunkOf(world, position);
+  const uint32_t x = chunk % world->settings.chunksX;
+  const uint32_t y = chunk / world->settings.chunksX;
+  want(world, x, y, x, y);
+}
+
+/* Packs the particle in `slot` into `chunk` and destroys it */
+static bool freezeSlot(Universe *universe, ChunkWorld *world, uint32_t slot,
+                       uint32_t chunk) {
+  if (world->counts[chunk] == world->settings.capacity) {
+    world->stats.overflowed++;
+    return false;
+  }
+
+  unsigned char *packed = record(world, chunk, world->counts[chunk]++);
+  const ComponentMask mask = universe->entityMasks[slot];
+  memcpy(packed, &mask, sizeof(mask));
+  for (ComponentMask m = mask; m; m &= m - 1) {
+    const uint32_t c = (uint32_t)__builtin_ctzll(m);
+    const ComponentColumn *column = &universe->columns[c];
+    memcpy(packed + world->offsets[c],
+           (const char *)column->data + (size_t)slot * column->stride,
+           column->size);
+  }
+  setBit(world->written, chunk);
+  UniverseDestroyEntity(universe, universe->slotEntities[slot]);
+  world->stats.frozen++;
+  world->stats.frozenParticles++;
+  return true;
+}
+
+/* Recreates the chunk's particles in recording order */
+static void thawChunk(Universe *universe, ChunkWorld *world, uint32_t chunk) {
+  const uint32_t count = world->counts[chunk];
+  uint32_t thawed = 0;
+  for (; thawed < count; thawed++) {
+    EntityID entity = UniverseCreateEntity(universe);
+    if (entity == INVALID_ENTITY)
+      break;
+
+    const unsigned char *packed = record(world, chunk, thawed);
+    ComponentMask mask;
+    memcpy(&mask, packed, sizeof(mask));
+    for (ComponentMask m = mask; m; m &= m - 1) {
+      const uint32_t c = (uint32_t)__builtin_ctzll(m);
+      UniverseAddComponent(universe, entity, c, packed + world->offsets[c]);
+    }
+  }
+
+  world->stats.thawed += thawed;
+  world->stats.frozenParticles -= thawed;
+  world->counts[chunk] = count - thawed;
+  if (thawed < count) {
+    // The universe is full; the rest waits for the next pass
+    world->stats.starved += count - thawed;
+    memmove(record(world, chunk, 0), record(world, chunk, thawed),
+            (size_t)(count - thawed) * world->recordBytes);
+    return;
+  }
+  // Consumed: the pages need not be written back or kept
+  madvise(record(world, chunk, 0),
+          alignUp((size_t)count * world->recordBytes, world->pageBytes),
+          MADV_DONTNEED);
+}
+
+/* Writes freshly frozen chunks back and drops them from memory */
+static void pageOut(ChunkWorld *world) {
+#ifdef MADV_PAGEOUT
+  const int advice = MADV_PAGEOUT;
+#else
+  const int advice = MADV_DONTNEED;
+#endif
+  for (uint32_t w = 0; w < BITSET_WORDS(world->chunkCount); w++) {
+    uint64_t bits = world->written[w];
+    world->written[w] = 0;
+    while (bits) {
+      const uint32_t chunk = w * 64 + (uint32_t)__builtin_ctzll(bits);
+      bits &= bits - 1;
+      madvise(record(world, chunk, 0),
+              alignUp((size_t)world->counts[chunk] * world->recordBytes,
+                      world->pageBytes),
+              advice);
+    }
+  }
+}
+
+void UniverseChunksStream(Universe *universe) {
+  ChunkWorld *world = universe ? universe->chunks : NULL;
+  if (!world)
+    return;
+
+  const ChunkSettings *s = &world->settings;
+  const uint32_t words = BITSET_WORDS(universe->maxEntities);
+  const double wake = s->wakeSpeed * s->wakeSpeed;
+  world->stats.frozen = world->stats.thawed = 0;
+  world->stats.overflowed = world->stats.starved = 0;
+  memset(world->wanted, 0,
+         (size_t)BITSET_WORDS(world->chunkCount) * sizeof(uint64_t));
+
+  for (uint32_t f = 0; f < CHUNK_MAX_FOCI; f++) {
+    if (!world->focused[f])
+      continue;
+    const uint32_t low = chunkOf(world, world->focusMin[f]);
+    const uint32_t high = chunkOf(world, world->focusMax[f]);
+    want(world, low % s->chunksX, low / s->chunksX, high % s->chunksX,
+         high / s->chunksX);
+  }
+
+  // Pinned entities and fast particles are activity
+  for (uint32_t w = 0; w < words; w++) {
+    uint64_t bits =
+        UniverseMatchWord(universe, w, COMPONENT_PARTICLE, COMPONENT_NONE);
+    while (bits) {
+      const uint32_t slot = w * 64 + (uint32_t)__builtin_ctzll(bits);
+      bits &= bits - 1;
+
+      const ComponentMask mask = universe->entityMasks[slot];
+      bool active = (mask & ~s->streamed) != 0;
+      if (!active && wake > 0.0 && (mask & COMPONENT_MECHANICS)) {
+        const KVector2 v = universe->mechanics[slot].velocity;
+        active = v.x * v.x + v.y * v.y > wake;
+      }
+      if (active)
+        wantAround(world, universe->kineticBodies[slot].position);
+    }
+  }
+
+  uint32_t wanted = 0;
+  for (uint32_t w = 0; w < BITSET_WORDS(world->chunkCount); w++) {
+    uint64_t bits = world->wanted[w];
+    wanted += (uint32_t)__builtin_popcountll(bits);
+    while (bits) {
+      const uint32_t chunk = w * 64 + (uint32_t)__builtin_ctzll(bits);
+      bits &= bits - 1;
+      if (world->counts[chunk])
+        thawChunk(universe, world, chunk);
+    }
+  }
+  world->stats.wantedChunks = wanted;
+
+  // Thawed particles sit in wanted chunks, so this pass leaves them be
+  for (uint32_t w = 0; w < words; w++) {
+    uint64_t bits =
+        UniverseMatchWord(universe, w, COMPONENT_PARTICLE, COMPONENT_NONE);
+    while (bits) {
+      const uint32_t slot = w * 64 + (uint32_t)__builtin_ctzll(bits);
+      bits &= bits - 1;
+
+      if (universe->entityMasks[slot] & ~s->streamed)
+        continue;
+      const uint32_t chunk =
+          chunkOf(world, universe->kineticBodies[slot].position);
+      if (!testBit(world->wanted, chunk))
+        freezeSlot(universe, world, slot, chunk);
+    }
+  }
+
+  pageOut(world);
+}
+
+void UniverseChunksUpdate(Universe *universe) {
+  ChunkWorld *world = universe ? universe->chunks : NULL;
+  if (world && (universe->stepCount + 1) % world->settings.interval == 0)
+    UniverseChunksStream(universe);
+}
+
+bool ChunkParticleCreate(Universe *universe, KVector2 position,
+                         KVector2 velocity, double mass) {
+  ChunkWorld *world = universe ? universe->chunks : NULL;
+  if (!world)
+    return false;
+
+  EntityID entity = ParticleCreate(universe, position, velocity, mass);
+  if (entity == INVALID_ENTITY)
+    return false;
+
+  const uint32_t slot = universe->entitySlots[entity];
+  const uint32_t chunk = chunkOf(world, position);
+  if (testBit(world->wanted, chunk) ||
+      (universe->entityMasks[slot] & ~world->settings.streamed))
+    return true;
+  if (freezeSlot(universe, world, slot, chunk))
+    return true;
+
+  UniverseDestroyEntity(universe, entity);
+  return false;
+}
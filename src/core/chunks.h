@@ -0,0 +1,128 @@
+/**
+ * chunks.h
+ *
+ * Out-of-core worlds. The world is cut into a grid of square chunks, and
+ * only the chunks near a focus (the viewport, say) or near activity are
+ * resident: their particles live in the universe and are simulated as
+ * usual. Every other chunk is frozen. Its particles leave the universe and
+ * are packed into the chunk's own slot of a page file mapped with mmap,
+ * then paged out. When a chunk becomes wanted again its slot faults back in
+ * and the particles are recreated, with new EntityIDs, exactly as they
+ * were frozen. The universe only needs room for the resident region, so
+ * memory and step time follow that region rather than the world.
+ *
+ * A streaming pass runs after the commands flush every `interval` steps:
+ *
+ * 1. A chunk is wanted when it overlaps a focus box, holds a pinned entity
+ *    or holds a resident particle faster than `wakeSpeed`, or lies within
+ *    `halo` chunks of one of those. Pinned entities are those with a
+ *    position and a component outside `streamed`, such as emitters, rigid
+ *    bodies and emitted particles; they are never frozen.
+ * 2. Wanted chunks with frozen particles are thawed.
+ * 3. Resident particles whose chunk is not wanted are frozen into it. A
+ *    particle that would overflow the chunk's capacity stays resident.
+ *
+ * Positions outside the grid belong to the nearest edge chunk. A frozen
+ * record holds the component mask and the bytes of every streamed
+ * component, so streamed components must not refer to other entities.
+ * The page file is scratch space; it is not kept across runs.
+ */
+#ifndef ECS_CHUNKS_H
+#define ECS_CHUNKS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "universe.h"
+
+typedef struct {
+  KVector2 origin;   /* corner of chunk (0, 0) */
+  double chunkSize;  /* world units per side */
+  uint32_t chunksX;  /* grid size, in chunks */
+  uint32_t chunksY;
+  uint32_t capacity; /* particles a frozen chunk holds */
+  uint32_t halo;     /* chunks kept around every wanted one */
+  uint32_t interval; /* steps between streaming passes */
+  double wakeSpeed;  /* resident particles this fast are activity; 0 never */
+  /* Components frozen particles keep; COMPONENT_PARTICLE is required */
+  ComponentMask streamed;
+  const char *path; /* page file; NULL makes an unlinked temporary one */
+} ChunkSettings;
+
+typedef struct {
+  uint32_t wantedChunks;    /* in the last pass */
+  uint64_t frozenParticles; /* in the page file now */
+  uint32_t frozen;          /* particles frozen by the last pass */
+  uint32_t thawed;          /* particles thawed by the last pass */
+  uint32_t overflowed;      /* left resident by the last pass, chunk full */
+  uint32_t starved;         /* left frozen by the last pass, universe full */
+} ChunkStats;
+
+/**
+ * Streaming state, carved from the universe allocator in one block by
+ * UniverseChunksEnable. Chunk arrays are indexed by y * chunksX + x.
+ */
+typedef struct ChunkWorld {
+  ChunkSettings settings;
+  ChunkStats stats;
+  double inverseChunkSize;
+  KVector2 focusMin[CHUNK_MAX_FOCI];
+  KVector2 focusMax[CHUNK_MAX_FOCI];
+  bool focused[CHUNK_MAX_FOCI];
+  uint32_t chunkCount;
+  uint32_t *counts;  /* frozen particles per chunk */
+  uint64_t *wanted;  /* bitset of chunks wanted by the last pass */
+  uint64_t *written; /* bitset of chunks frozen into by the last pass */
+  /* Record layout: the mask, then each streamed component at its offset */
+  size_t offsets[MAX_COMPONENTS];
+  size_t recordBytes;
+  size_t slotBytes; /* per chunk in the page file, whole pages */
+  size_t pageBytes;
+  unsigned char *pages; /* the mapped page file */
+  size_t fileBytes;
+  int fd;
+} ChunkWorld;
+
+ChunkSettings ChunkDefaultSettings(void);
+
+/**
+ * Maps the page file and carves the chunk tables. The streamed components
+ * must be registered already. Calling it again does nothing.
+ *
+ * @param settings NULL selects ChunkDefaultSettings
+ */
+bool UniverseChunksEnable(Universe *universe, const ChunkSettings *settings);
+
+/**
+ * Unmaps and closes the page file; frozen particles are dropped. Called by
+ * UniverseDestroy.
+ */
+void UniverseChunksDisable(Universe *universe);
+
+/**
+ * Sets focus `focus` (< CHUNK_MAX_FOCI) to the box [min, max]. Chunks it
+ * overlaps are wanted from the next pass on. An empty box removes it.
+ */
+bool ChunkSetFocus(Universe *universe, uint32_t focus, KVector2 min,
+                   KVector2 max);
+
+/**
+ * A particle like ParticleCreate's, created resident if its chunk is
+ * wanted and frozen straight into the page file otherwise. Before the first
+ * pass no chunk is wanted. Fails when the universe or the chunk is full.
+ */
+bool ChunkParticleCreate(Universe *universe, KVector2 position,
+                         KVector2 velocity, double mass);
+
+/* Chunk of a position, clamped to the grid */
+uint32_t ChunkIndex(const Universe *universe, KVector2 position);
+/* Whether the last pass wanted the chunk at `position` */
+bool ChunkIsWanted(const Universe *universe, KVector2 position);
+const ChunkStats *ChunkGetStats(const Universe *universe);
+
+/* Runs a streaming pass, every settings.interval steps; see above */
+void UniverseChunksUpdate(Universe *universe);
+/* Runs a streaming pass now */
+void UniverseChunksStream(Universe *universe);
+
+#endif /* ECS_CHUNKS_H */
@@ -0,0 +1,256 @@
+#include "commands.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "physics/systems.h"
+#include "universe.h"
+
+#define PAYLOAD_ALIGNMENT 16
+
+/* A buffer grew from `before` to `after` bytes */
+static void accountGrowth(size_t before, size_t after) {
+  KAccountRelease(K_MEMORY_COMMANDS, before);
+  KAccountAllocation(K_MEMORY_COMMANDS, after);
+}
+
+static Command *pushCommand(CommandBuffer *buffer, CommandType type,
+                            uint32_t entity) {
+  if (buffer->count == buffer->capacity) {
+    uint32_t capacity = buffer->capacity ? buffer->capacity * 2 : 64;
+    Command *commands =
+        (Command *)realloc(buffer->commands, capacity * sizeof(Command));
+    if (!commands)
+      return NULL;
+    accountGrowth(buffer->capacity * sizeof(Command),
+                  capacity * sizeof(Command));
+    buffer->commands = commands;
+    buffer->capacity = capacity;
+  }
+
+  Command *command = &buffer->commands[buffer->count];
+  command->type = type;
+  command->entity = entity;
+  command->sequence = buffer->count++;
+  command->component = INVALID_COMPONENT;
+  command->dataOffset = 0;
+  command->dataSize = 0;
+  command->force = (KVector2){0, 0};
+  return command;
+}
+
+uint32_t CommandBufferCreateEntity(CommandBuffer *buffer) {
+  if (!buffer)
+    return INVALID_ENTITY;
+
+  if (buffer->createdCount == buffer->createdCapacity) {
+    uint32_t capacity =
+        buffer->createdCapacity ? buffer->createdCapacity * 2 : 32;
+    uint32_t *created =
+        (uint32_t *)realloc(buffer->created, capacity * sizeof(uint32_t));
+    if (!created)
+      return INVALID_ENTITY;
+    accountGrowth(buffer->createdCapacity * sizeof(uint32_t),
+                  capacity * sizeof(uint32_t));
+    buffer->created = created;
+    buffer->createdCapacity = capacity;
+  }
+
+  uint32_t placeholder = COMMAND_PENDING_BIT | buffer->createdCount;
+  if (!pushCommand(buffer, COMMAND_CREATE, placeholder))
+    return INVALID_ENTITY;
+
+  buffer->created[buffer->createdCount++] = INVALID_ENTITY;
+  return placeholder;
+}
+
+bool CommandBufferDestroyEntity(CommandBuffer *buffer, uint32_t entity) {
+  return buffer && pushCommand(buffer, COMMAND_DESTROY, entity) != NULL;
+}
+
+bool CommandBufferAddComponent(CommandBuffer *buffer, uint32_t entity,
+                               ComponentID component, const void *data,
+                               size_t size) {
+  if (!buffer)
+    return false;
+
+  size_t offset = (buffer->dataSize + PAYLOAD_ALIGNMENT - 1) &
+                  ~(size_t)(PAYLOAD_ALIGNMENT - 1);
+  if (data && offset + size > buffer->dataCapacity) {
+    size_t capacity = buffer->dataCapacity ? buffer->dataCapacity : 1024;
+    while (capacity < offset + size)
+      capacity *= 2;
+    unsigned char *bytes = (unsigned char *)realloc(buffer->data, capacity);
+    if (!bytes)
+      return false;
+    accountGrowth(buffer->dataCapacity, capacity);
+    buffer->data = bytes;
+    buffer->dataCapacity = capacity;
+  }
+
+  Command *command = pushCommand(buffer, COMMAND_ADD_COMPONENT, entity);
+  if (!command)
+    return false;
+
+  command->component = component;
+  if (data) {
+    memcpy(buffer->data + offset, data, size);
+    command->dataOffset = offset;
+    command->dataSize = size;
+    buffer->dataSize = offset + size;
+  } else {
+    command->dataOffset = SIZE_MAX;
+  }
+  return true;
+}
+
+bool CommandBufferApplyForce(CommandBuffer *buffer, uint32_t entity,
+                             KVector2 force) {
+  if (!buffer)
+    return false;
+
+  Command *command = pushCommand(buffer, COMMAND_APPLY_FORCE, entity);
+  if (!command)
+    return false;
+
+  command->force = force;
+  return true;
+}
+
+void CommandBufferReset(CommandBuffer *buffer) {
+  if (!buffer)
+    return;
+
+  buffer->count = 0;
+  buffer->dataSize = 0;
+  buffer->createdCount = 0;
+}
+
+void CommandBufferFree(CommandBuffer *buffer) {
+  if (!buffer)
+    return;
+
+  KAccountRelease(K_MEMORY_COMMANDS,
+                  buffer->capacity * sizeof(Command) + buffer->dataCapacity +
+                      buffer->createdCapacity * sizeof(uint32_t));
+  free(buffer->commands);
+  free(buffer->data);
+  free(buffer->created);
+  memset(buffer, 0, sizeof(*buffer));
+}
+
+static int compareCommands(const void *a, const void *b) {
+  const Command *lhs = (const Command *)a;
+  const Command *rhs = (const Command *)b;
+
+  if (lhs->type != rhs->type)
+    return lhs->type < rhs->type ? -1 : 1;
+  if (lhs->entity != rhs->entity)
+    return lhs->entity < rhs->entity ? -1 : 1;
+  if (lhs->sequence != rhs->sequence)
+    return lhs->sequence < rhs->sequence ? -1 : 1;
+  return 0;
+}
+
+CommandBuffer *UniverseGetCommandBuffer(Universe *universe, uint32_t thread) {
+  if (!universe || thread >= MAX_COMMAND_BUFFERS)
+    return NULL;
+
+  return &universe->commandBuffers[thread];
+}
+
+/* Creates the buffer's pending entities and resolves its placeholders */
+static void createPending(Universe *universe, CommandBuffer *buffer) {
+  // Creations run in recording order so placeholders can be resolved
+  // before sorting the remaining commands by entity
+  for (uint32_t c = 0; c < buffer->count; c++) {
+    Command *command = &buffer->commands[c];
+    if (command->type == COMMAND_CREATE)
+      buffer->created[command->entity & ~COMMAND_PENDING_BIT] =
+          UniverseCreateEntity(universe);
+  }
+
+  for (uint32_t c = 0; c < buffer->count; c++) {
+    Command *command = &buffer->commands[c];
+    if (!COMMAND_IS_PENDING(command->entity) ||
+        command->entity == INVALID_ENTITY)
+      continue;
+
+    uint32_t index = command->entity & ~COMMAND_PENDING_BIT;
+    command->entity =
+        index < buffer->createdCount ? buffer->created[index] : INVALID_ENTITY;
+  }
+}
+
+static void playCommand(Universe *universe, const CommandBuffer *buffer,
+                        const Command *command) {
+  switch (command->type) {
+  case COMMAND_CREATE:
+    break;
+  case COMMAND_ADD_COMPONENT: {
+    const void *data = NULL;
+    if (command->dataOffset != SIZE_MAX) {
+      if (command->component >= universe->componentCount ||
+          command->dataSize != universe->columns[command->component].size)
+        break;
+      data = buffer->data + command->dataOffset;
+    }
+    UniverseAddComponent(universe, command->entity, command->component, data);
+    break;
+  }
+  case COMMAND_APPLY_FORCE:
+    PhysicsApplyForce(universe, command->entity, command->force);
+    break;
+  case COMMAND_DESTROY:
+    UniverseDestroyEntity(universe, command->entity);
+    break;
+  }
+}
+
+void UniverseFlushCommands(Universe *universe) {
+  if (!universe)
+    return;
+
+  // Every creation lands before any destroy frees an ID
+  uint32_t next[MAX_COMMAND_BUFFERS];
+  for (uint32_t b = 0; b < MAX_COMMAND_BUFFERS; b++) {
+    CommandBuffer *buffer = &universe->commandBuffers[b];
+    createPending(universe, buffer);
+    KSort(buffer->commands, buffer->count, sizeof(Command), compareCommands);
+    next[b] = 0;
+  }
+
+  // Merge the sorted buffers into one order: type, entity, buffer, sequence
+  const Command *last = NULL;
+  for (;;) {
+    int32_t from = -1;
+    const Command *best = NULL;
+    for (uint32_t b = 0; b < MAX_COMMAND_BUFFERS; b++) {
+      const CommandBuffer *buffer = &universe->commandBuffers[b];
+      if (next[b] == buffer->count)
+        continue;
+      const Command *head = &buffer->commands[next[b]];
+      // Ties go to the lower buffer, which was seen first
+      if (!best || head->type < best->type ||
+          (head->type == best->type && head->entity < best->entity)) {
+        from = (int32_t)b;
+        best = head;
+      }
+    }
+    if (from < 0)
+      break;
+
+    const CommandBuffer *buffer = &universe->commandBuffers[from];
+    const Command *command = &buffer->commands[next[from]++];
+    // Repeated destroys of one entity are adjacent once merged
+    bool repeated = command->type == COMMAND_DESTROY && last &&
+                    last->type == COMMAND_DESTROY &&
+                    last->entity == command->entity;
+    if (!repeated)
+      playCommand(universe, buffer, command);
+    last = command;
+  }
+
+  for (uint32_t b = 0; b < MAX_COMMAND_BUFFERS; b++)
+    CommandBufferReset(&universe->commandBuffers[b]);
+}
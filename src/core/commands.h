@@ -0,0 +1,70 @@
+/**
+ * Deferred structural changes.
+ *
+ * A CommandBuffer records entity creation, destruction, component additions
+ * and forces without touching the universe, so systems may record from inside
+ * their loops or from worker threads (one buffer per thread). The universe
+ * plays every buffer back at a sync point with UniverseFlushCommands.
+ *
+ * The flush first creates every pending entity, buffer by buffer in
+ * recording order. The other commands of all buffers then run as one list
+ * sorted by type, entity, buffer and recording order, so destroys come last
+ * and an ID freed by the flush is never handed out again within it. Repeated
+ * destroys of an entity, from any buffers, destroy it once. A component
+ * payload whose size is not the component's is dropped.
+ */
+#ifndef ECS_COMMANDS_H
+#define ECS_COMMANDS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "components.h"
+
+/* Entities created through a buffer get a placeholder ID until the flush */
+#define COMMAND_PENDING_BIT 0x80000000u
+#define COMMAND_IS_PENDING(entity) (((entity) & COMMAND_PENDING_BIT) != 0)
+
+typedef enum {
+  /* Declared in playback order */
+  COMMAND_CREATE = 0,
+  COMMAND_ADD_COMPONENT,
+  COMMAND_APPLY_FORCE,
+  COMMAND_DESTROY,
+} CommandType;
+
+typedef struct {
+  CommandType type;
+  uint32_t entity;
+  uint32_t sequence;
+  ComponentID component;
+  size_t dataOffset;
+  size_t dataSize;
+  KVector2 force;
+} Command;
+
+typedef struct {
+  Command *commands;
+  uint32_t count;
+  uint32_t capacity;
+  unsigned char *data;
+  size_t dataSize;
+  size_t dataCapacity;
+  /* Placeholder index -> real entity, filled during the flush */
+  uint32_t *created;
+  uint32_t createdCount;
+  uint32_t createdCapacity;
+} CommandBuffer;
+
+uint32_t CommandBufferCreateEntity(CommandBuffer *buffer);
+bool CommandBufferDestroyEntity(CommandBuffer *buffer, uint32_t entity);
+bool CommandBufferAddComponent(CommandBuffer *buffer, uint32_t entity,
+                               ComponentID component, const void *data,
+                               size_t size);
+bool CommandBufferApplyForce(CommandBuffer *buffer, uint32_t entity,
+                             KVector2 force);
+void CommandBufferReset(CommandBuffer *buffer);
+void CommandBufferFree(CommandBuffer *buffer);
+
+#endif /* ECS_COMMANDS_H */
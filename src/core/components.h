@@ -6,11 +6,26 @@
 
 #include "math/kurage_math.h"
 
-typedef enum {
-	COMPONENT_NONE = 0,
-	COMPONENT_PARTICLE = 1 << 0,
-	COMPONENT_MECHANICS = 1 << 1,
-} ComponentMask;
+/* One bit per registered component; at most 64 components per universe */
+typedef uint64_t ComponentMask;
+typedef uint32_t ComponentID;
+
+#define MAX_COMPONENTS 64
+#define INVALID_COMPONENT UINT32_MAX
+#define COMPONENT_BIT(id) ((ComponentMask)1 << (id))
+
+/* Built-in components, registered by UniverseCreate in this order */
+enum {
+	COMPONENT_ID_KINETIC_BODY = 0,
+	COMPONENT_ID_MECHANICS,
+	COMPONENT_ID_RADIUS,
+	COMPONENT_BUILTIN_COUNT
+};
+
+#define COMPONENT_NONE ((ComponentMask)0)
+#define COMPONENT_PARTICLE COMPONENT_BIT(COMPONENT_ID_KINETIC_BODY)
+#define COMPONENT_MECHANICS COMPONENT_BIT(COMPONENT_ID_MECHANICS)
+#define COMPONENT_RADIUS COMPONENT_BIT(COMPONENT_ID_RADIUS)
 
 typedef struct {
 	KVector2 position;
@@ -24,4 +39,9 @@ typedef struct {
 	KVector2 forceAccum;
 } MechanicsComponent;
 
+/* Collision radius, kept out of the kinetic body so integration stays lean */
+typedef struct {
+	double radius;
+} RadiusComponent;
+
 #endif /* ECS_COMPONENTS_H */
@@ -4,11 +4,7 @@ void UniverseUpdate(Universe *universe, double deltaTime) {
   if (!universe)
     return;
 
-  PhysicsForcesUpdate(universe);
-  PhysicsMechanicsUpdate(universe, deltaTime);
-  PhysicsPositionUpdate(universe, deltaTime);
-  PhysicsClearForces(universe);
-
-  if (universe->boundary.enabled)
-    PhysicsResolveBoundaryCollisions(universe);
+  // The systems and their order are declared in scheduler.h
+  UniverseRunSystems(universe, deltaTime);
+  universe->stepCount++;
 }
@@ -4,7 +4,20 @@
 #ifndef ENGINE_H
 #define ENGINE_H
 
+#include "chunks.h"
+#include "ensemble.h"
+#include "parallel.h"
+#include "publish.h"
+#include "reorder.h"
+#include "scheduler.h"
+#include "spatial.h"
 #include "universe.h"
+#include "physics/diagnostics.h"
+#include "physics/emitters.h"
+#include "physics/fixed.h"
+#include "physics/fluid.h"
+#include "physics/obstacles.h"
+#include "physics/rigid.h"
 #include "physics/systems.h"
 
 void UniverseUpdate(Universe *universe, double deltaTime);
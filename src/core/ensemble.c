@@ -0,0 +1,131 @@
+#include "ensemble.h"
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "engine.h"
+#include "parallel.h"
+
+typedef struct {
+  Ensemble *ensemble;
+  double deltaTime;
+  bool failed;
+} EnsembleJob;
+
+static void createBlock(void *context, uint32_t begin, uint32_t end,
+                        uint32_t block) {
+  EnsembleJob *job = (EnsembleJob *)context;
+  Ensemble *ensemble = job->ensemble;
+
+  // Mapped and first written here, so the block is local to this worker
+  size_t bytes = UniverseEstimateBytes(ensemble->worldCapacity, NULL);
+  ensemble->arenas[block] = KArenaCreate(bytes * (end - begin), false);
+  if (!ensemble->arenas[block]) {
+    job->failed = true;
+    return;
+  }
+
+  ensemble->allocators[block] = KArenaAllocator(ensemble->arenas[block]);
+  UniverseOptions options = {0};
+  options.allocator = &ensemble->allocators[block];
+
+  for (uint32_t w = begin; w < end; w++) {
+    ensemble->worlds[w] =
+        UniverseCreateWithOptions(ensemble->worldCapacity, &options);
+    if (!ensemble->worlds[w]) {
+      job->failed = true;
+      return;
+    }
+  }
+}
+
+/* Each world only allocates from its block's arena, so blocks never contend */
+static void updateBlock(void *context, uint32_t begin, uint32_t end,
+                        uint32_t block) {
+  (void)block;
+  EnsembleJob *job = (EnsembleJob *)context;
+
+  for (uint32_t w = begin; w < end; w++)
+    UniverseUpdate(job->ensemble->worlds[w], job->deltaTime);
+}
+
+Ensemble *EnsembleCreate(uint32_t worldCount, uint32_t worldCapacity,
+                         uint32_t threads) {
+  if (worldCount == 0)
+    return NULL;
+
+  Ensemble *ensemble = (Ensemble *)calloc(1, sizeof(Ensemble));
+  if (!ensemble)
+    return NULL;
+
+  ensemble->worlds = (Universe **)calloc(worldCount, sizeof(Universe *));
+  if (!ensemble->worlds) {
+    free(ensemble);
+    return NULL;
+  }
+  KAccountAllocation(K_MEMORY_ENSEMBLE,
+                     sizeof(Ensemble) + worldCount * sizeof(Universe *));
+
+  if (threads < 1)
+    threads = 1;
+  if (threads > PARALLEL_MAX_THREADS)
+    threads = PARALLEL_MAX_THREADS;
+  if (threads > worldCount)
+    threads = worldCount;
+
+  ensemble->worldCount = worldCount;
+  ensemble->worldCapacity = worldCapacity;
+  ensemble->threads = threads;
+
+  EnsembleJob job = {ensemble, 0.0, false};
+  ParallelForChunks(worldCount, threads, createBlock, &job);
+  if (job.failed) {
+    EnsembleDestroy(ensemble);
+    return NULL;
+  }
+
+  return ensemble;
+}
+
+void EnsembleDestroy(Ensemble *ensemble) {
+  if (!ensemble)
+    return;
+
+  // Arena releases are no-ops; this frees what lives outside the arenas
+  for (uint32_t w = 0; w < ensemble->worldCount; w++)
+    UniverseDestroy(ensemble->worlds[w]);
+
+  for (uint32_t t = 0; t < ensemble->threads; t++)
+    KArenaDestroy(ensemble->arenas[t]);
+
+  KAccountRelease(K_MEMORY_ENSEMBLE,
+                  sizeof(Ensemble) + ensemble->worldCount * sizeof(Universe *));
+  free(ensemble->worlds);
+  free(ensemble);
+}
+
+Universe *EnsembleWorld(const Ensemble *ensemble, uint32_t world) {
+  if (!ensemble || world >= ensemble->worldCount)
+    return NULL;
+
+  return ensemble->worlds[world];
+}
+
+void EnsembleUpdate(Ensemble *ensemble, double deltaTime) {
+  if (!ensemble)
+    return;
+
+  // Nested loops in the systems run serially inside each block
+  EnsembleJob job = {ensemble, deltaTime, false};
+  ParallelForChunks(ensemble->worldCount, ensemble->threads, updateBlock, &job);
+}
+
+uint32_t EnsembleCountActive(const Ensemble *ensemble) {
+  if (!ensemble)
+    return 0;
+
+  uint32_t total = 0;
+  for (uint32_t w = 0; w < ensemble->worldCount; w++)
+    total += UniverseCountActive(ensemble->worlds[w]);
+  return total;
+}
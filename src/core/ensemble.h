@@ -0,0 +1,47 @@
+/**
+ * ensemble.h
+ *
+ * Many small, independent universes stepped together, e.g. for parameter
+ * sweeps. Worlds are split into one contiguous block per worker thread. Each
+ * worker creates its block from its own arena, so the worlds of a block sit
+ * back to back in memory on the worker's NUMA node. EnsembleUpdate steps all
+ * blocks in one parallel sweep, with no per-world allocation or thread start.
+ *
+ * A world is an ordinary Universe: populate and inspect it through
+ * EnsembleWorld with the regular API, but not while EnsembleUpdate runs.
+ */
+#ifndef ECS_ENSEMBLE_H
+#define ECS_ENSEMBLE_H
+
+#include <stdint.h>
+
+#include "allocator.h"
+#include "parallel.h"
+#include "universe.h"
+
+typedef struct {
+  uint32_t worldCount;
+  uint32_t worldCapacity; /* maxEntities of every world */
+  uint32_t threads;
+  Universe **worlds;      /* world index -> universe */
+  /* Block t of ParallelForChunks(worldCount, threads) owns arenas[t] */
+  KArena *arenas[PARALLEL_MAX_THREADS];
+  KAllocator allocators[PARALLEL_MAX_THREADS];
+} Ensemble;
+
+/**
+ * @param threads number of blocks, one per worker of the parallel backend
+ *                (see parallel.h); clamped to [1, PARALLEL_MAX_THREADS] and
+ *                to the world count
+ * @return NULL if any world could not be created
+ */
+Ensemble *EnsembleCreate(uint32_t worldCount, uint32_t worldCapacity,
+                         uint32_t threads);
+void EnsembleDestroy(Ensemble *ensemble);
+Universe *EnsembleWorld(const Ensemble *ensemble, uint32_t world);
+
+/* UniverseUpdate on every world, one block of worlds per worker */
+void EnsembleUpdate(Ensemble *ensemble, double deltaTime);
+uint32_t EnsembleCountActive(const Ensemble *ensemble);
+
+#endif /* ECS_ENSEMBLE_H */
@@ -0,0 +1,11 @@
+#include "kurage.h"
+
+#define KURAGE_STRINGIFY_(x) #x
+#define KURAGE_STRINGIFY(x) KURAGE_STRINGIFY_(x)
+
+uint32_t KurageVersion(void) { return KURAGE_VERSION; }
+
+const char *KurageVersionString(void) {
+  return KURAGE_STRINGIFY(KURAGE_VERSION_MAJOR) "." KURAGE_STRINGIFY(
+      KURAGE_VERSION_MINOR) "." KURAGE_STRINGIFY(KURAGE_VERSION_PATCH);
+}
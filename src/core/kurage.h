@@ -0,0 +1,33 @@
+/**
+ * kurage.h
+ *
+ * Public header of the embeddable physics core (libkurage). It pulls in the
+ * whole engine API and carries the library version. The core has no
+ * dependency on raylib, so it can be linked into headless processes.
+ */
+#ifndef KURAGE_LIB_H
+#define KURAGE_LIB_H
+
+#include <stdint.h>
+
+#include "engine.h"
+
+/* Bump MAJOR on ABI breaks; it is also the shared object's soname suffix */
+#define KURAGE_VERSION_MAJOR 1
+#define KURAGE_VERSION_MINOR 0
+#define KURAGE_VERSION_PATCH 0
+
+#define KURAGE_VERSION_ENCODE(major, minor, patch)                             \
+  (((uint32_t)(major) << 16) | ((uint32_t)(minor) << 8) | (uint32_t)(patch))
+#define KURAGE_VERSION                                                         \
+  KURAGE_VERSION_ENCODE(KURAGE_VERSION_MAJOR, KURAGE_VERSION_MINOR,            \
+                        KURAGE_VERSION_PATCH)
+
+/**
+ * Version of the library actually linked, encoded like KURAGE_VERSION.
+ * Embedders compare its major part with KURAGE_VERSION_MAJOR at startup.
+ */
+uint32_t KurageVersion(void);
+const char *KurageVersionString(void);
+
+#endif /* KURAGE_LIB_H */
@@ -0,0 +1,241 @@
+/**
+ * kurage_batch.c
+ *
+ * Batch variants of the Kurage math library functions (see "Batch
+ * operations" in kurage_math.h).
+ *
+ * Every vector kernel is a static inline loop taking its strides as
+ * arguments. The public function calls it once with literal unit strides
+ * when every view is SoA, so that copy compiles to contiguous vector loads,
+ * and once with the views' strides otherwise.
+ */
+
+#include "kurage_math.h"
+#include <math.h>
+#include <stddef.h>
+
+#define UNIT_EPSILON 0.000001 /* as in KVector2Unit and KVector3Unit */
+
+KVector2Array KVector2ArraySoA(double *x, double *y) {
+  return (KVector2Array){x, y, 1};
+}
+
+KVector2Array KVector2ArrayOf(KVector2 *vectors) {
+  return (KVector2Array){&vectors->x, &vectors->y,
+                         sizeof(KVector2) / sizeof(double)};
+}
+
+KVector3Array KVector3ArraySoA(double *x, double *y, double *z) {
+  return (KVector3Array){x, y, z, 1};
+}
+
+KVector3Array KVector3ArrayOf(KVector3 *vectors) {
+  return (KVector3Array){&vectors->x, &vectors->y, &vectors->z,
+                         sizeof(KVector3) / sizeof(double)};
+}
+
+/**
+ * KVector2 batches
+ */
+static inline void unit2(const double *restrict x, const double *restrict y,
+                         double *restrict ox, double *restrict oy, size_t si,
+                         size_t so, size_t count) {
+#pragma omp simd
+  for (size_t i = 0; i < count; i++) {
+    double vx = x[i * si], vy = y[i * si];
+    double magnitude = sqrt(vx * vx + vy * vy);
+    double inverse = magnitude < UNIT_EPSILON ? 0.0 : 1.0 / magnitude;
+    ox[i * so] = vx * inverse;
+    oy[i * so] = vy * inverse;
+  }
+}
+
+void KVector2UnitBatch(KVector2Array in, KVector2Array out, size_t count) {
+  if (in.stride == 1 && out.stride == 1)
+    unit2(in.x, in.y, out.x, out.y, 1, 1, count);
+  else
+    unit2(in.x, in.y, out.x, out.y, in.stride, out.stride, count);
+}
+
+static inline void dot2(const double *restrict ax, const double *restrict ay,
+                        const double *restrict bx, const double *restrict by,
+                        double *restrict out, size_t sa, size_t sb,
+                        size_t count) {
+#pragma omp simd
+  for (size_t i = 0; i < count; i++)
+    out[i] = ax[i * sa] * bx[i * sb] + ay[i * sa] * by[i * sb];
+}
+
+void KVector2DotProductBatch(KVector2Array a, KVector2Array b,
+                             double *restrict out, size_t count) {
+  if (a.stride == 1 && b.stride == 1)
+    dot2(a.x, a.y, b.x, b.y, out, 1, 1, count);
+  else
+    dot2(a.x, a.y, b.x, b.y, out, a.stride, b.stride, count);
+}
+
+/**
+ * KVector3 batches
+ */
+static inline void unit3(const double *restrict x, const double *restrict y,
+                         const double *restrict z, double *restrict ox,
+                         double *restrict oy, double *restrict oz, size_t si,
+                         size_t so, size_t count) {
+#pragma omp simd
+  for (size_t i = 0; i < count; i++) {
+    double vx = x[i * si], vy = y[i * si], vz = z[i * si];
+    double magnitude = sqrt(vx * vx + vy * vy + vz * vz);
+    double inverse = magnitude < UNIT_EPSILON ? 0.0 : 1.0 / magnitude;
+    ox[i * so] = vx * inverse;
+    oy[i * so] = vy * inverse;
+    oz[i * so] = vz * inverse;
+  }
+}
+
+void KVector3UnitBatch(KVector3Array in, KVector3Array out, size_t count) {
+  if (in.stride == 1 && out.stride == 1)
+    unit3(in.x, in.y, in.z, out.x, out.y, out.z, 1, 1, count);
+  else
+    unit3(in.x, in.y, in.z, out.x, out.y, out.z, in.stride, out.stride,
+          count);
+}
+
+static inline void dot3(const double *restrict ax, const double *restrict ay,
+                        const double *restrict az, const double *restrict bx,
+                        const double *restrict by, const double *restrict bz,
+                        double *restrict out, size_t sa, size_t sb,
+                        size_t count) {
+#pragma omp simd
+  for (size_t i = 0; i < count; i++)
+    out[i] = ax[i * sa] * bx[i * sb] + ay[i * sa] * by[i * sb] +
+             az[i * sa] * bz[i * sb];
+}
+
+void KVector3DotProductBatch(KVector3Array a, KVector3Array b,
+                             double *restrict out, size_t count) {
+  if (a.stride == 1 && b.stride == 1)
+    dot3(a.x, a.y, a.z, b.x, b.y, b.z, out, 1, 1, count);
+  else
+    dot3(a.x, a.y, a.z, b.x, b.y, b.z, out, a.stride, b.stride, count);
+}
+
+static inline void cross3(const double *restrict ax, const double *restrict ay,
+                          const double *restrict az, const double *restrict bx,
+                          const double *restrict by, const double *restrict bz,
+                          double *restrict ox, double *restrict oy,
+                          double *restrict oz, size_t sa, size_t sb, size_t so,
+                          size_t count) {
+#pragma omp simd
+  for (size_t i = 0; i < count; i++) {
+    double x1 = ax[i * sa], y1 = ay[i * sa], z1 = az[i * sa];
+    double x2 = bx[i * sb], y2 = by[i * sb], z2 = bz[i * sb];
+    ox[i * so] = y1 * z2 - z1 * y2;
+    oy[i * so] = z1 * x2 - x1 * z2;
+    oz[i * so] = x1 * y2 - y1 * x2;
+  }
+}
+
+void KVector3CrossProductBatch(KVector3Array a, KVector3Array b,
+                               KVector3Array out, size_t count) {
+  if (a.stride == 1 && b.stride == 1 && out.stride == 1)
+    cross3(a.x, a.y, a.z, b.x, b.y, b.z, out.x, out.y, out.z, 1, 1, 1, count);
+  else
+    cross3(a.x, a.y, a.z, b.x, b.y, b.z, out.x, out.y, out.z, a.stride,
+           b.stride, out.stride, count);
+}
+
+/**
+ * KQuaternion batches
+ */
+
+// One matrix for the whole batch, then nine products per point
+static inline void rotate3(const Matrix3x3 *r, const double *restrict x,
+                           const double *restrict y, const double *restrict z,
+                           double *restrict ox, double *restrict oy,
+                           double *restrict oz, size_t si, size_t so,
+                           size_t count) {
+  const double m00 = r->m[0][0], m01 = r->m[0][1], m02 = r->m[0][2];
+  const double m10 = r->m[1][0], m11 = r->m[1][1], m12 = r->m[1][2];
+  const double m20 = r->m[2][0], m21 = r->m[2][1], m22 = r->m[2][2];
+#pragma omp simd
+  for (size_t i = 0; i < count; i++) {
+    double vx = x[i * si], vy = y[i * si], vz = z[i * si];
+    ox[i * so] = m00 * vx + m01 * vy + m02 * vz;
+    oy[i * so] = m10 * vx + m11 * vy + m12 * vz;
+    oz[i * so] = m20 * vx + m21 * vy + m22 * vz;
+  }
+}
+
+void KQuaternionRotateBatch(KQuaternion q, KVector3Array in,
+                            KVector3Array out, size_t count) {
+  const Matrix3x3 r = KQuaternionToMatrix3(q);
+  if (in.stride == 1 && out.stride == 1)
+    rotate3(&r, in.x, in.y, in.z, out.x, out.y, out.z, 1, 1, count);
+  else
+    rotate3(&r, in.x, in.y, in.z, out.x, out.y, out.z, in.stride, out.stride,
+            count);
+}
+
+void KQuaternionMultiplyBatch(const KQuaternion *restrict q1,
+                              const KQuaternion *restrict q2,
+                              KQuaternion *restrict out, size_t count) {
+#pragma omp simd
+  for (size_t i = 0; i < count; i++) {
+    const KQuaternion a = q1[i], b = q2[i];
+    out[i].w = a.w * b.w - a.x * b.x - a.y * b.y - a.z * b.z;
+    out[i].x = a.w * b.x + a.x * b.w + a.y * b.z - a.z * b.y;
+    out[i].y = a.w * b.y - a.x * b.z + a.y * b.w + a.z * b.x;
+    out[i].z = a.w * b.z + a.x * b.y - a.y * b.x + a.z * b.w;
+  }
+}
+
+void KQuaternionToMatrix3Batch(const KQuaternion *restrict q,
+                               Matrix3x3 *restrict out, size_t count) {
+#pragma omp simd
+  for (size_t i = 0; i < count; i++) {
+    const double xx = q[i].x * q[i].x, yy = q[i].y * q[i].y;
+    const double zz = q[i].z * q[i].z, xy = q[i].x * q[i].y;
+    const double xz = q[i].x * q[i].z, yz = q[i].y * q[i].z;
+    const double wx = q[i].w * q[i].x, wy = q[i].w * q[i].y;
+    const double wz = q[i].w * q[i].z;
+
+    out[i].m[0][0] = 1.0 - 2.0 * (yy + zz);
+    out[i].m[0][1] = 2.0 * (xy - wz);
+    out[i].m[0][2] = 2.0 * (xz + wy);
+    out[i].m[1][0] = 2.0 * (xy + wz);
+    out[i].m[1][1] = 1.0 - 2.0 * (xx + zz);
+    out[i].m[1][2] = 2.0 * (yz - wx);
+    out[i].m[2][0] = 2.0 * (xz - wy);
+    out[i].m[2][1] = 2.0 * (yz + wx);
+    out[i].m[2][2] = 1.0 - 2.0 * (xx + yy);
+  }
+}
+
+void KQuaternionToMatrix4Batch(const KQuaternion *restrict q,
+                               Matrix4x4 *restrict out, size_t count) {
+#pragma omp simd
+  for (size_t i = 0; i < count; i++) {
+    const double xx = q[i].x * q[i].x, yy = q[i].y * q[i].y;
+    const double zz = q[i].z * q[i].z, xy = q[i].x * q[i].y;
+    const double xz = q[i].x * q[i].z, yz = q[i].y * q[i].z;
+    const double wx = q[i].w * q[i].x, wy = q[i].w * q[i].y;
+    const double wz = q[i].w * q[i].z;
+
+    out[i].m[0][0] = 1.0 - 2.0 * (yy + zz);
+    out[i].m[0][1] = 2.0 * (xy - wz);
+    out[i].m[0][2] = 2.0 * (xz + wy);
+    out[i].m[0][3] = 0.0;
+    out[i].m[1][0] = 2.0 * (xy + wz);
+    out[i].m[1][1] = 1.0 - 2.0 * (xx + zz);
+    out[i].m[1][2] = 2.0 * (yz - wx);
+    out[i].m[1][3] = 0.0;
+    out[i].m[2][0] = 2.0 * (xz - wy);
+    out[i].m[2][1] = 2.0 * (yz + wx);
+    out[i].m[2][2] = 1.0 - 2.0 * (xx + yy);
+    out[i].m[2][3] = 0.0;
+    out[i].m[3][0] = 0.0;
+    out[i].m[3][1] = 0.0;
+    out[i].m[3][2] = 0.0;
+    out[i].m[3][3] = 1.0;
+  }
+}
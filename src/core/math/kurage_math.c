@@ -229,7 +229,7 @@ Matrix4x4 KQuaternionToMatrix4(KQuaternion q) {
   return result;
 }
 
-KQuaternion KQuaternionUnit(KQuaternion q) {
+KQuaternion KQuaternionNormalize(KQuaternion q) {
   KQuaternion result = {0, 0, 0, 1}; // Default to identity quaternion
 
   double magnitude =
@@ -246,6 +246,16 @@ KQuaternion KQuaternionUnit(KQuaternion q) {
   return result;
 }
 
+// v + 2w (u x v) + 2u x (u x v), with u the vector part of a unit q
+KVector3 KQuaternionRotate(KQuaternion q, KVector3 v) {
+  KVector3 u = {q.x, q.y, q.z};
+  KVector3 t = KVector3ScalarProduct(2.0, KVector3CrossProduct(u, v));
+
+  return KVector3Addition(
+      KVector3Addition(v, KVector3ScalarProduct(q.w, t)),
+      KVector3CrossProduct(u, t));
+}
+
 /**
  * Utility Functions Implementation
  */
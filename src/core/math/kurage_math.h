@@ -80,6 +80,59 @@ KQuaternion KQuaternionMultiply(KQuaternion q1, KQuaternion q2);
 Matrix3x3 KQuaternionToMatrix3(KQuaternion q);
 Matrix4x4 KQuaternionToMatrix4(KQuaternion q);
 KQuaternion KQuaternionNormalize(KQuaternion q);
+KVector3 KQuaternionRotate(KQuaternion q, KVector3 v);
+
+/**
+ * Batch operations
+ *
+ * Vector batches are read and written through KVector2Array and
+ * KVector3Array views: one pointer per coordinate plus a stride in doubles
+ * between consecutive elements. A stride of 1 views separate x, y and z
+ * arrays (SoA); KVector2ArrayOf and KVector3ArrayOf view an array of
+ * KVector2 or KVector3 structs in place. Element i of the view is
+ * (x[i * stride], y[i * stride], z[i * stride]).
+ *
+ * The loops are `omp simd` over the elements, and SoA views take a
+ * contiguous path that vectorises without gathers. Each result matches the
+ * scalar function to within rounding. Outputs must not overlap inputs.
+ */
+typedef struct {
+  double *restrict x;
+  double *restrict y;
+  size_t stride;
+} KVector2Array;
+
+typedef struct {
+  double *restrict x;
+  double *restrict y;
+  double *restrict z;
+  size_t stride;
+} KVector3Array;
+
+KVector2Array KVector2ArraySoA(double *x, double *y);
+KVector2Array KVector2ArrayOf(KVector2 *vectors);
+KVector3Array KVector3ArraySoA(double *x, double *y, double *z);
+KVector3Array KVector3ArrayOf(KVector3 *vectors);
+
+void KVector2UnitBatch(KVector2Array in, KVector2Array out, size_t count);
+void KVector2DotProductBatch(KVector2Array a, KVector2Array b,
+                             double *restrict out, size_t count);
+void KVector3UnitBatch(KVector3Array in, KVector3Array out, size_t count);
+void KVector3DotProductBatch(KVector3Array a, KVector3Array b,
+                             double *restrict out, size_t count);
+void KVector3CrossProductBatch(KVector3Array a, KVector3Array b,
+                               KVector3Array out, size_t count);
+
+/* Rotates `count` points by one unit quaternion */
+void KQuaternionRotateBatch(KQuaternion q, KVector3Array in,
+                            KVector3Array out, size_t count);
+void KQuaternionMultiplyBatch(const KQuaternion *restrict q1,
+                              const KQuaternion *restrict q2,
+                              KQuaternion *restrict out, size_t count);
+void KQuaternionToMatrix3Batch(const KQuaternion *restrict q,
+                               Matrix3x3 *restrict out, size_t count);
+void KQuaternionToMatrix4Batch(const KQuaternion *restrict q,
+                               Matrix4x4 *restrict out, size_t count);
 
 /**
  * Utility functions
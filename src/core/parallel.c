@@ -0,0 +1,272 @@
+#include "parallel.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#ifndef KURAGE_PARALLEL_DEFAULT
+#define KURAGE_PARALLEL_DEFAULT PARALLEL_PTHREADS
+#endif
+
+static const char *BACKEND_NAMES[PARALLEL_BACKEND_COUNT] = {
+    "serial", "pthreads", "openmp"};
+
+typedef struct {
+  uint32_t index;
+  uint64_t generation; /* last job this worker has seen */
+} PoolWorker;
+
+/*
+ * Persistent workers. Worker w runs chunks w, w + stride, ... of each job,
+ * the submitting thread being worker 0. Everything is guarded by `lock`.
+ */
+typedef struct {
+  pthread_mutex_t lock;
+  pthread_cond_t start;
+  pthread_cond_t done;
+  pthread_t threads[PARALLEL_MAX_THREADS];
+  PoolWorker workers[PARALLEL_MAX_THREADS];
+  uint32_t workerCount; /* excluding the submitting thread */
+  uint64_t generation;
+  uint32_t pending;
+  bool stopping;
+  ParallelBody body;
+  void *context;
+  uint32_t count;
+  uint32_t chunks;
+} ParallelPool;
+
+static ParallelPool pool = {.lock = PTHREAD_MUTEX_INITIALIZER,
+                            .start = PTHREAD_COND_INITIALIZER,
+                            .done = PTHREAD_COND_INITIALIZER};
+/* One pthread job at a time; others fall back to serial */
+static pthread_mutex_t submitLock = PTHREAD_MUTEX_INITIALIZER;
+
+static pthread_once_t configured = PTHREAD_ONCE_INIT;
+static ParallelBackend backend = KURAGE_PARALLEL_DEFAULT;
+static uint32_t threadCount = 1;
+
+static __thread bool insideParallel = false;
+
+static uint32_t clampThreads(long threads) {
+  if (threads < 1)
+    return 1;
+  if (threads > PARALLEL_MAX_THREADS)
+    return PARALLEL_MAX_THREADS;
+  return (uint32_t)threads;
+}
+
+static void configure(void) {
+  threadCount = clampThreads(sysconf(_SC_NPROCESSORS_ONLN));
+
+  const char *threads = getenv("KURAGE_THREADS");
+  if (threads && *threads)
+    threadCount = clampThreads(strtol(threads, NULL, 10));
+
+  const char *name = getenv("KURAGE_PARALLEL");
+  for (int b = 0; name && b < PARALLEL_BACKEND_COUNT; b++) {
+    if (strcmp(name, BACKEND_NAMES[b]) == 0 &&
+        ParallelBackendAvailable((ParallelBackend)b))
+      backend = (ParallelBackend)b;
+  }
+
+  if (!ParallelBackendAvailable(backend))
+    backend = PARALLEL_PTHREADS;
+}
+
+static inline void runChunk(ParallelBody body, void *context, uint32_t count,
+                            uint32_t chunks, uint32_t chunk) {
+  uint32_t begin = (uint32_t)((uint64_t)count * chunk / chunks);
+  uint32_t end = (uint32_t)((uint64_t)count * (chunk + 1) / chunks);
+  body(context, begin, end, chunk);
+}
+
+static void runSerial(uint32_t count, uint32_t chunks, ParallelBody body,
+                      void *context) {
+  for (uint32_t c = 0; c < chunks; c++)
+    runChunk(body, context, count, chunks, c);
+}
+
+static void *poolMain(void *argument) {
+  PoolWorker *worker = (PoolWorker *)argument;
+  insideParallel = true;
+
+  pthread_mutex_lock(&pool.lock);
+  for (;;) {
+    while (pool.generation == worker->generation && !pool.stopping)
+      pthread_cond_wait(&pool.start, &pool.lock);
+    if (pool.stopping)
+      break;
+
+    worker->generation = pool.generation;
+    ParallelBody body = pool.body;
+    void *context = pool.context;
+    uint32_t count = pool.count;
+    uint32_t chunks = pool.chunks;
+    uint32_t stride = pool.workerCount + 1;
+    pthread_mutex_unlock(&pool.lock);
+
+    for (uint32_t c = worker->index; c < chunks; c += stride)
+      runChunk(body, context, count, chunks, c);
+
+    pthread_mutex_lock(&pool.lock);
+    if (--pool.pending == 0)
+      pthread_cond_signal(&pool.done);
+  }
+  pthread_mutex_unlock(&pool.lock);
+  return NULL;
+}
+
+static void stopPool(void) {
+  pthread_mutex_lock(&pool.lock);
+  pool.stopping = true;
+  pthread_cond_broadcast(&pool.start);
+  pthread_mutex_unlock(&pool.lock);
+
+  for (uint32_t w = 0; w < pool.workerCount; w++)
+    pthread_join(pool.threads[w], NULL);
+
+  pool.workerCount = 0;
+  pool.stopping = false;
+}
+
+// Called with submitLock held, so no job is in flight
+static void resizePool(uint32_t workers) {
+  if (pool.workerCount == workers)
+    return;
+
+  stopPool();
+  for (uint32_t w = 0; w < workers; w++) {
+    pool.workers[w].index = w + 1;
+    pool.workers[w].generation = pool.generation;
+    if (pthread_create(&pool.threads[w], NULL, poolMain, &pool.workers[w]))
+      break;
+    pool.workerCount++;
+  }
+}
+
+static void runPool(uint32_t count, uint32_t chunks, ParallelBody body,
+                    void *context) {
+  resizePool(threadCount - 1);
+  if (pool.workerCount == 0) {
+    runSerial(count, chunks, body, context);
+    return;
+  }
+
+  pthread_mutex_lock(&pool.lock);
+  pool.body = body;
+  pool.context = context;
+  pool.count = count;
+  pool.chunks = chunks;
+  pool.pending = pool.workerCount;
+  pool.generation++;
+  pthread_cond_broadcast(&pool.start);
+  uint32_t stride = pool.workerCount + 1;
+  pthread_mutex_unlock(&pool.lock);
+
+  insideParallel = true;
+  for (uint32_t c = 0; c < chunks; c += stride)
+    runChunk(body, context, count, chunks, c);
+  insideParallel = false;
+
+  pthread_mutex_lock(&pool.lock);
+  while (pool.pending > 0)
+    pthread_cond_wait(&pool.done, &pool.lock);
+  pthread_mutex_unlock(&pool.lock);
+}
+
+void ParallelForChunks(uint32_t count, uint32_t chunks, ParallelBody body,
+                       void *context) {
+  if (!body || count == 0 || chunks == 0)
+    return;
+
+  pthread_once(&configured, configure);
+
+  if (chunks == 1 || threadCount <= 1 || insideParallel ||
+      backend == PARALLEL_SERIAL) {
+    runSerial(count, chunks, body, context);
+    return;
+  }
+
+#ifdef _OPENMP
+  if (backend == PARALLEL_OPENMP) {
+    if (omp_in_parallel()) {
+      runSerial(count, chunks, body, context);
+      return;
+    }
+
+    int threads = (int)(chunks < threadCount ? chunks : threadCount);
+#pragma omp parallel for schedule(static, 1) num_threads(threads)
+    for (uint32_t c = 0; c < chunks; c++)
+      runChunk(body, context, count, chunks, c);
+    return;
+  }
+#endif
+
+  if (pthread_mutex_trylock(&submitLock) != 0) {
+    runSerial(count, chunks, body, context);
+    return;
+  }
+  runPool(count, chunks, body, context);
+  pthread_mutex_unlock(&submitLock);
+}
+
+void ParallelFor(uint32_t count, uint32_t grain, ParallelBody body,
+                 void *context) {
+  pthread_once(&configured, configure);
+
+  uint32_t chunks = threadCount;
+  if (grain > 0 && count / grain < chunks)
+    chunks = count / grain > 0 ? count / grain : 1;
+
+  ParallelForChunks(count, chunks, body, context);
+}
+
+bool ParallelBackendAvailable(ParallelBackend backend) {
+#ifdef _OPENMP
+  return backend >= PARALLEL_SERIAL && backend < PARALLEL_BACKEND_COUNT;
+#else
+  return backend == PARALLEL_SERIAL || backend == PARALLEL_PTHREADS;
+#endif
+}
+
+bool ParallelSetBackend(ParallelBackend requested) {
+  pthread_once(&configured, configure);
+  if (!ParallelBackendAvailable(requested))
+    return false;
+
+  backend = requested;
+  return true;
+}
+
+ParallelBackend ParallelGetBackend(void) {
+  pthread_once(&configured, configure);
+  return backend;
+}
+
+const char *ParallelBackendName(ParallelBackend backend) {
+  if (backend < PARALLEL_SERIAL || backend >= PARALLEL_BACKEND_COUNT)
+    return "unknown";
+  return BACKEND_NAMES[backend];
+}
+
+void ParallelSetThreads(uint32_t threads) {
+  pthread_once(&configured, configure);
+  threadCount = clampThreads(threads);
+}
+
+uint32_t ParallelGetThreads(void) {
+  pthread_once(&configured, configure);
+  return threadCount;
+}
+
+void ParallelShutdown(void) {
+  pthread_mutex_lock(&submitLock);
+  stopPool();
+  pthread_mutex_unlock(&submitLock);
+}
@@ -0,0 +1,67 @@
+/**
+ * parallel.h
+ *
+ * Parallel-for used by the systems, the reorder, first-touch and ensembles.
+ * Loops are split into contiguous chunks and run on the selected backend:
+ *
+ *   PARALLEL_SERIAL   every chunk on the calling thread, in order
+ *   PARALLEL_PTHREADS a persistent pool; the caller runs chunk 0
+ *   PARALLEL_OPENMP   an OpenMP static schedule (needs -fopenmp)
+ *
+ * The build picks the default with PARALLEL=serial|pthreads|openmp. At run
+ * time the KURAGE_PARALLEL and KURAGE_THREADS environment variables, or
+ * ParallelSetBackend/ParallelSetThreads, override it. Chunk c is always
+ * [count * c / chunks, count * (c + 1) / chunks) and goes to the same worker
+ * every time, so every backend produces the same results. Pages first
+ * touched by a worker also stay with it.
+ *
+ * Calls made from inside a chunk, or while another thread is using the
+ * pool, run serially on the caller.
+ */
+#ifndef ECS_PARALLEL_H
+#define ECS_PARALLEL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define PARALLEL_MAX_THREADS 64
+
+typedef enum {
+  PARALLEL_SERIAL,
+  PARALLEL_PTHREADS,
+  PARALLEL_OPENMP,
+  PARALLEL_BACKEND_COUNT
+} ParallelBackend;
+
+/* Loop body for the chunk [begin, end); `chunk` is the chunk index */
+typedef void (*ParallelBody)(void *context, uint32_t begin, uint32_t end,
+                             uint32_t chunk);
+
+/**
+ * Runs `body` over [0, count) in one chunk per thread, but never in chunks
+ * smaller than `grain` (0 means no minimum).
+ */
+void ParallelFor(uint32_t count, uint32_t grain, ParallelBody body,
+                 void *context);
+
+/**
+ * Runs `body` over [0, count) in exactly `chunks` chunks. Every chunk is
+ * called, empty ones included, so per-chunk state is always initialised.
+ */
+void ParallelForChunks(uint32_t count, uint32_t chunks, ParallelBody body,
+                       void *context);
+
+/* @return false if the backend was not compiled in */
+bool ParallelSetBackend(ParallelBackend backend);
+ParallelBackend ParallelGetBackend(void);
+bool ParallelBackendAvailable(ParallelBackend backend);
+const char *ParallelBackendName(ParallelBackend backend);
+
+/* Threads per loop, the caller included; clamped to PARALLEL_MAX_THREADS */
+void ParallelSetThreads(uint32_t threads);
+uint32_t ParallelGetThreads(void);
+
+/* Joins the pool threads; the next parallel loop starts them again */
+void ParallelShutdown(void);
+
+#endif /* ECS_PARALLEL_H */
@@ -0,0 +1,193 @@
+#include "diagnostics.h"
+
+#include <float.h>
+#include <string.h>
+
+#include "diagnostics_internal.h"
+#include "obstacles.h"
+
+void UniverseSetDiagnostics(Universe *universe, bool enabled) {
+  if (!universe)
+    return;
+
+  universe->diagnostics.enabled = enabled;
+  universe->diagnostics.hasReference = false;
+}
+
+void UniverseResetDiagnostics(Universe *universe) {
+  if (universe)
+    universe->diagnostics.hasReference = false;
+}
+
+void UniverseSetDiagnosticsTolerances(Universe *universe, double energy,
+                                      double step, double momentum) {
+  if (!universe)
+    return;
+
+  universe->diagnostics.energyTolerance = energy;
+  universe->diagnostics.stepTolerance = step;
+  universe->diagnostics.momentumTolerance = momentum;
+}
+
+const UniverseDiagnostics *UniverseGetDiagnostics(const Universe *universe) {
+  return universe ? &universe->diagnostics : NULL;
+}
+
+bool DiagnosticsInObstaclePass(const Universe *universe) {
+  return universe->obstacles && universe->obstacles->count > 0;
+}
+
+static void resetPartial(DiagnosticsPartial *partial) {
+  memset(partial, 0, sizeof(*partial));
+  partial->boundsMin = (KVector2){DBL_MAX, DBL_MAX};
+  partial->boundsMax = (KVector2){-DBL_MAX, -DBL_MAX};
+}
+
+void DiagnosticsBegin(DiagnosticsPartials *partials) {
+  for (uint32_t c = 0; c < PARALLEL_MAX_THREADS; c++)
+    resetPartial(&partials->chunks[c]);
+}
+
+/* Kahan leaves sum - error as the corrected total */
+static void addCorrected(double *sum, double *error, double chunkSum,
+                         double chunkError) {
+  DiagnosticsCompensatedAdd(sum, error, chunkSum);
+  DiagnosticsCompensatedAdd(sum, error, -chunkError);
+}
+
+/* Folds the chunks in order, so the result is independent of the backend */
+static DiagnosticsSample combine(const DiagnosticsPartial *chunks,
+                                 uint32_t count) {
+  DiagnosticsPartial total;
+  resetPartial(&total);
+
+  for (uint32_t c = 0; c < count; c++) {
+    const DiagnosticsPartial *chunk = &chunks[c];
+    if (chunk->count == 0)
+      continue;
+
+    addCorrected(&total.energy, &total.energyError, chunk->energy,
+                 chunk->energyError);
+    addCorrected(&total.mass, &total.massError, chunk->mass, chunk->massError);
+    addCorrected(&total.momentum.x, &total.momentumError.x, chunk->momentum.x,
+                 chunk->momentumError.x);
+    addCorrected(&total.momentum.y, &total.momentumError.y, chunk->momentum.y,
+                 chunk->momentumError.y);
+
+    if (chunk->boundsMin.x < total.boundsMin.x)
+      total.boundsMin.x = chunk->boundsMin.x;
+    if (chunk->boundsMin.y < total.boundsMin.y)
+      total.boundsMin.y = chunk->boundsMin.y;
+    if (chunk->boundsMax.x > total.boundsMax.x)
+      total.boundsMax.x = chunk->boundsMax.x;
+    if (chunk->boundsMax.y > total.boundsMax.y)
+      total.boundsMax.y = chunk->boundsMax.y;
+    total.count += chunk->count;
+  }
+
+  DiagnosticsSample sample;
+  sample.kineticEnergy = total.energy - total.energyError;
+  sample.mass = total.mass - total.massError;
+  sample.momentum.x = total.momentum.x - total.momentumError.x;
+  sample.momentum.y = total.momentum.y - total.momentumError.y;
+  sample.count = total.count;
+  if (total.count) {
+    sample.boundsMin = total.boundsMin;
+    sample.boundsMax = total.boundsMax;
+  } else {
+    sample.boundsMin = sample.boundsMax = (KVector2){0.0, 0.0};
+  }
+  return sample;
+}
+
+// Relative change, or the absolute one when the reference is zero
+static double relative(double value, double reference) {
+  double scale = fabs(reference) > 0.0 ? fabs(reference) : 1.0;
+  return (value - reference) / scale;
+}
+
+static bool sampleFinite(const DiagnosticsSample *sample) {
+  return isfinite(sample->kineticEnergy) && isfinite(sample->momentum.x) &&
+         isfinite(sample->momentum.y) && isfinite(sample->boundsMin.x) &&
+         isfinite(sample->boundsMin.y) && isfinite(sample->boundsMax.x) &&
+         isfinite(sample->boundsMax.y);
+}
+
+void DiagnosticsCommit(Universe *universe, const DiagnosticsPartials *partials) {
+  UniverseDiagnostics *diagnostics = &universe->diagnostics;
+  DiagnosticsSample sample = combine(partials->chunks, PARALLEL_MAX_THREADS);
+
+  // Creation and destruction change the totals legitimately
+  if (!diagnostics->hasReference ||
+      sample.count != diagnostics->reference.count) {
+    diagnostics->reference = sample;
+    diagnostics->current = sample;
+    diagnostics->hasReference = true;
+    diagnostics->flaggedSteps = 0;
+  }
+
+  diagnostics->previous = diagnostics->current;
+  diagnostics->current = sample;
+
+  const DiagnosticsSample *reference = &diagnostics->reference;
+  diagnostics->energyDrift =
+      relative(sample.kineticEnergy, reference->kineticEnergy);
+  diagnostics->stepDrift =
+      relative(sample.kineticEnergy, diagnostics->previous.kineticEnergy);
+
+  double scale = sqrt(2.0 * reference->mass * reference->kineticEnergy);
+  double dx = sample.momentum.x - reference->momentum.x;
+  double dy = sample.momentum.y - reference->momentum.y;
+  diagnostics->momentumDrift =
+      sqrt(dx * dx + dy * dy) / (scale > 0.0 ? scale : 1.0);
+
+  uint32_t flags = 0;
+  if (!sampleFinite(&sample))
+    flags |= DIAGNOSTICS_NON_FINITE;
+  if (diagnostics->energyTolerance > 0.0 &&
+      diagnostics->energyDrift > diagnostics->energyTolerance)
+    flags |= DIAGNOSTICS_ENERGY_DRIFT;
+  if (diagnostics->stepTolerance > 0.0 &&
+      diagnostics->stepDrift > diagnostics->stepTolerance)
+    flags |= DIAGNOSTICS_STEP_DRIFT;
+
+  const UniverseBoundary boundary = universe->boundary;
+  if (boundary.enabled) {
+    if (sample.count && (sample.boundsMin.x < boundary.left ||
+                         sample.boundsMax.x > boundary.right ||
+                         sample.boundsMin.y < boundary.top ||
+                         sample.boundsMax.y > boundary.bottom))
+      flags |= DIAGNOSTICS_ESCAPED;
+  } else if (diagnostics->momentumTolerance > 0.0 &&
+             diagnostics->momentumDrift > diagnostics->momentumTolerance) {
+    flags |= DIAGNOSTICS_MOMENTUM_DRIFT;
+  }
+
+  diagnostics->flags = flags;
+  if (flags)
+    diagnostics->flaggedSteps++;
+}
+
+DiagnosticsSample PhysicsMeasure(const Universe *universe) {
+  DiagnosticsPartial partial;
+  DiagnosticsTerms terms = {0.0, 0.0, {0.0, 0.0}};
+  resetPartial(&partial);
+  if (!universe)
+    return combine(&partial, 1);
+
+  const ComponentMask required = COMPONENT_PARTICLE | COMPONENT_MECHANICS;
+  for (uint32_t w = 0; w < BITSET_WORDS(universe->maxEntities); w++) {
+    uint64_t bits = UniverseMatchWord(universe, w, required, COMPONENT_NONE);
+    while (bits) {
+      EntityID i = w * 64 + (EntityID)__builtin_ctzll(bits);
+      bits &= bits - 1;
+
+      DiagnosticsAccumulate(&partial, &terms,
+                            universe->kineticBodies[i].position,
+                            universe->mechanics[i].velocity,
+                            universe->kineticBodies[i].inverseMass);
+    }
+    DiagnosticsFold(&partial, &terms);
+  }
+  return combine(&partial, 1);
+}
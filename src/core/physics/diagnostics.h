@@ -0,0 +1,39 @@
+/**
+ * diagnostics.h
+ *
+ * Kinetic energy, momentum and bounding box of the moving entities, tracked
+ * per step to catch changes that break the physics. The reduction is fused
+ * into the last sweep of the step over position and velocity: the obstacle
+ * pass when there are obstacles, else the adaptive integrator, the boundary
+ * pass, or the position update when there are no walls. Entities are summed
+ * plainly within a 64-entity bitset word. The word sums then go into
+ * compensated (Kahan) sums, one set per parallel chunk in its own cache
+ * line, so the cost per entity stays a few adds. The chunks are combined in
+ * chunk order, so the totals do not depend on the backend or the thread
+ * count.
+ *
+ * Drift is relative to a reference sample, which is the first sample after
+ * enabling or resetting, or after the entity count changes. Walls with
+ * RESTITUTION < 1 only ever remove energy, so only energy gains are flagged.
+ * Walls also exchange momentum, so momentum is only checked without them.
+ */
+#ifndef PHYSICS_DIAGNOSTICS_H
+#define PHYSICS_DIAGNOSTICS_H
+
+#include <stdbool.h>
+
+#include "../universe.h"
+
+/* Turning diagnostics on takes a new reference at the next step */
+void UniverseSetDiagnostics(Universe *universe, bool enabled);
+/* Takes a new reference at the next step */
+void UniverseResetDiagnostics(Universe *universe);
+/* A tolerance <= 0 disables that check */
+void UniverseSetDiagnosticsTolerances(Universe *universe, double energy,
+                                      double step, double momentum);
+const UniverseDiagnostics *UniverseGetDiagnostics(const Universe *universe);
+
+/* Standalone serial measurement, independent of the fused sweeps */
+DiagnosticsSample PhysicsMeasure(const Universe *universe);
+
+#endif /* PHYSICS_DIAGNOSTICS_H */
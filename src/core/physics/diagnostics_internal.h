@@ -0,0 +1,92 @@
+/**
+ * diagnostics_internal.h
+ *
+ * The per-chunk sums the fused sweeps accumulate into (see diagnostics.h).
+ * Only the library's own passes take samples, so none of this is part of
+ * the public API or exported from libkurage.
+ */
+#ifndef PHYSICS_DIAGNOSTICS_INTERNAL_H
+#define PHYSICS_DIAGNOSTICS_INTERNAL_H
+
+#include "../parallel.h"
+#include "diagnostics.h"
+
+/* Obstacles resolve after the walls, so with any their pass samples */
+bool DiagnosticsInObstaclePass(const Universe *universe);
+
+/* Per-chunk partial sums; one cache line each so chunks never share one */
+typedef struct {
+  _Alignas(64) double energy;
+  double energyError;
+  double mass;
+  double massError;
+  KVector2 momentum;
+  KVector2 momentumError;
+  KVector2 boundsMin;
+  KVector2 boundsMax;
+  uint32_t count;
+} DiagnosticsPartial;
+
+typedef struct {
+  DiagnosticsPartial chunks[PARALLEL_MAX_THREADS];
+} DiagnosticsPartials;
+
+void DiagnosticsBegin(DiagnosticsPartials *partials);
+/* Combines the chunks and updates universe->diagnostics */
+void DiagnosticsCommit(Universe *universe, const DiagnosticsPartials *partials);
+
+/* Kahan: sum + value, with the rounding error carried in *error. Branch
+ * free, unlike Neumaier, which matters in the middle of a sweep. */
+static inline void DiagnosticsCompensatedAdd(double *sum, double *error,
+                                             double value) {
+  double y = value - *error;
+  double t = *sum + y;
+  *error = (t - *sum) - y;
+  *sum = t;
+}
+
+/* Plain sums over one bitset word, folded into the partial after it */
+typedef struct {
+  double energy;
+  double mass;
+  KVector2 momentum;
+} DiagnosticsTerms;
+
+static inline void DiagnosticsAccumulate(DiagnosticsPartial *partial,
+                                         DiagnosticsTerms *terms,
+                                         KVector2 position, KVector2 velocity,
+                                         double inverseMass) {
+  partial->boundsMin.x =
+      position.x < partial->boundsMin.x ? position.x : partial->boundsMin.x;
+  partial->boundsMin.y =
+      position.y < partial->boundsMin.y ? position.y : partial->boundsMin.y;
+  partial->boundsMax.x =
+      position.x > partial->boundsMax.x ? position.x : partial->boundsMax.x;
+  partial->boundsMax.y =
+      position.y > partial->boundsMax.y ? position.y : partial->boundsMax.y;
+  partial->count++;
+
+  if (inverseMass <= 0.0)
+    return;
+
+  double mass = 1.0 / inverseMass;
+  terms->energy +=
+      0.5 * mass * (velocity.x * velocity.x + velocity.y * velocity.y);
+  terms->mass += mass;
+  terms->momentum.x += mass * velocity.x;
+  terms->momentum.y += mass * velocity.y;
+}
+
+static inline void DiagnosticsFold(DiagnosticsPartial *partial,
+                                   DiagnosticsTerms *terms) {
+  DiagnosticsCompensatedAdd(&partial->energy, &partial->energyError,
+                            terms->energy);
+  DiagnosticsCompensatedAdd(&partial->mass, &partial->massError, terms->mass);
+  DiagnosticsCompensatedAdd(&partial->momentum.x, &partial->momentumError.x,
+                            terms->momentum.x);
+  DiagnosticsCompensatedAdd(&partial->momentum.y, &partial->momentumError.y,
+                            terms->momentum.y);
+  *terms = (DiagnosticsTerms){0.0, 0.0, {0.0, 0.0}};
+}
+
+#endif /* PHYSICS_DIAGNOSTICS_INTERNAL_H */
@@ -0,0 +1,126 @@
+#include "emitters.h"
+
+#include <math.h>
+
+static double nextRandom(uint32_t *state) {
+  uint32_t x = *state;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  *state = x;
+  return (double)x / (double)UINT32_MAX;
+}
+
+bool ParticleEmittersEnable(Universe *universe) {
+  if (!universe)
+    return false;
+
+  if (universe->lifetimeComponent == INVALID_COMPONENT)
+    universe->lifetimeComponent = UniverseRegisterComponent(
+        universe, sizeof(LifetimeComponent), _Alignof(LifetimeComponent));
+
+  if (universe->emitterComponent == INVALID_COMPONENT)
+    universe->emitterComponent = UniverseRegisterComponent(
+        universe, sizeof(EmitterComponent), _Alignof(EmitterComponent));
+
+  return universe->lifetimeComponent != INVALID_COMPONENT &&
+         universe->emitterComponent != INVALID_COMPONENT;
+}
+
+EntityID EmitterCreate(Universe *universe, KVector2 position,
+                       const EmitterComponent *settings) {
+  if (!settings || !ParticleEmittersEnable(universe))
+    return INVALID_ENTITY;
+
+  EntityID entity = UniverseCreateEntity(universe);
+  if (entity == INVALID_ENTITY)
+    return INVALID_ENTITY;
+
+  EmitterComponent emitter = *settings;
+  emitter.direction = KVector2Unit(emitter.direction);
+  emitter.accumulator = 0.0;
+  if (emitter.seed == 0)
+    emitter.seed = 0x9E3779B9u ^ entity;
+
+  // Infinite mass keeps the emitter out of the integration systems
+  if (!UniverseAddKineticBodyComponent(universe, entity, position, 0.0) ||
+      !UniverseAddComponent(universe, entity, universe->emitterComponent,
+                            &emitter)) {
+    UniverseDestroyEntity(universe, entity);
+    return INVALID_ENTITY;
+  }
+
+  return entity;
+}
+
+void ParticleLifetimeUpdate(Universe *universe, double deltaTime) {
+  if (!universe || universe->lifetimeComponent == INVALID_COMPONENT)
+    return;
+
+  const EntityQuery *query = UniverseQuery(
+      universe, COMPONENT_BIT(universe->lifetimeComponent), COMPONENT_NONE);
+  if (!query)
+    return;
+
+  LifetimeComponent *lifetimes =
+      UNIVERSE_COLUMN(universe, LifetimeComponent, universe->lifetimeComponent);
+
+  // Walk backwards: destroying swaps an already visited entity into slot k
+  for (uint32_t k = query->count; k-- > 0;) {
+    EntityID i = query->entities[k];
+
+    lifetimes[i].remaining -= deltaTime;
+    if (lifetimes[i].remaining <= 0.0)
+      UniverseDestroyEntity(universe, UniverseSlotEntity(universe, i));
+  }
+}
+
+void ParticleEmittersUpdate(Universe *universe, double deltaTime) {
+  if (!universe || universe->emitterComponent == INVALID_COMPONENT)
+    return;
+
+  const EntityQuery *query = UniverseQuery(
+      universe, COMPONENT_PARTICLE | COMPONENT_BIT(universe->emitterComponent),
+      COMPONENT_NONE);
+  if (!query)
+    return;
+
+  EmitterComponent *emitters =
+      UNIVERSE_COLUMN(universe, EmitterComponent, universe->emitterComponent);
+
+  // Spawning never touches the emitter query, so the list is stable here
+  for (uint32_t k = 0; k < query->count; k++) {
+    EntityID i = query->entities[k];
+    EmitterComponent *emitter = &emitters[i];
+    KVector2 origin = universe->kineticBodies[i].position;
+
+    emitter->accumulator += emitter->rate * deltaTime;
+    while (emitter->accumulator >= 1.0 && universe->freeCount > 0) {
+      emitter->accumulator -= 1.0;
+
+      double angle = (2.0 * nextRandom(&emitter->seed) - 1.0) * emitter->spread;
+      double speed = emitter->speedMin + nextRandom(&emitter->seed) *
+                                             (emitter->speedMax -
+                                              emitter->speedMin);
+      double c = cos(angle);
+      double s = sin(angle);
+      KVector2 velocity = {
+          (emitter->direction.x * c - emitter->direction.y * s) * speed,
+          (emitter->direction.x * s + emitter->direction.y * c) * speed};
+
+      EntityID particle =
+          ParticleCreate(universe, origin, velocity, emitter->mass);
+      if (particle == INVALID_ENTITY)
+        break;
+
+      LifetimeComponent lifetime = {emitter->lifetime,
+                                    UniverseSlotEntity(universe, i)};
+      UniverseAddComponent(universe, particle, universe->lifetimeComponent,
+                           &lifetime);
+    }
+
+    // Do not bank particles while the universe is full
+    if (emitter->accumulator > 1.0)
+      emitter->accumulator = 1.0;
+  }
+}
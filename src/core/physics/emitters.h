@@ -0,0 +1,42 @@
+#ifndef PHYSICS_EMITTERS_H
+#define PHYSICS_EMITTERS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "../universe.h"
+
+/**
+ * Remaining lifetime of an emitted particle. When it reaches zero the
+ * particle is destroyed and its ID returns to the universe free list, where
+ * the next spawn picks it up again without any allocation.
+ */
+typedef struct {
+  double remaining;
+  EntityID emitter;
+} LifetimeComponent;
+
+/**
+ * Continuous particle source. Particles leave the emitter position along
+ * `direction`, rotated by a uniform angle in [-spread, spread] radians, with
+ * a speed uniformly drawn from [speedMin, speedMax].
+ */
+typedef struct {
+  KVector2 direction;
+  double spread;
+  double rate;     /* particles per second */
+  double speedMin;
+  double speedMax;
+  double lifetime; /* seconds */
+  double mass;
+  double accumulator; /* fractional particles carried between steps */
+  uint32_t seed;      /* xorshift state, must be non-zero */
+} EmitterComponent;
+
+bool ParticleEmittersEnable(Universe *universe);
+EntityID EmitterCreate(Universe *universe, KVector2 position,
+                       const EmitterComponent *settings);
+void ParticleLifetimeUpdate(Universe *universe, double deltaTime);
+void ParticleEmittersUpdate(Universe *universe, double deltaTime);
+
+#endif /* PHYSICS_EMITTERS_H */
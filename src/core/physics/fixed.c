@@ -0,0 +1,214 @@
+#include "fixed.h"
+
+#include <math.h>
+#include <string.h>
+
+#include "../parallel.h"
+
+Fixed FixedFromDouble(double value) {
+  // Scaling by a power of two is exact, so only the rounding is left
+  double scaled = value * FIXED_ONE;
+  if (scaled != scaled)
+    return 0;
+  if (scaled >= (double)INT32_MAX)
+    return INT32_MAX;
+  if (scaled <= -(double)INT32_MAX)
+    return -INT32_MAX;
+  return (Fixed)floor(scaled + 0.5);
+}
+
+double FixedToDouble(Fixed value) { return (double)value / FIXED_ONE; }
+
+bool FixedPointEnable(Universe *universe) {
+  if (!universe)
+    return false;
+
+  if (universe->fixedComponent != INVALID_COMPONENT)
+    return true;
+
+  ComponentID component = UniverseRegisterComponent(
+      universe, sizeof(FixedBodyComponent), _Alignof(FixedBodyComponent));
+  if (component == INVALID_COMPONENT)
+    return false;
+
+  // The kernels read every lane of a word, so unused slots hold zeros
+  memset(UniverseGetColumn(universe, component), 0,
+         (size_t)universe->maxEntities * sizeof(FixedBodyComponent));
+  universe->fixedComponent = component;
+  return true;
+}
+
+EntityID FixedParticleCreate(Universe *universe, KVector2 position,
+                             KVector2 velocity, KVector2 acceleration,
+                             double mass, double radius) {
+  if (!universe || universe->fixedComponent == INVALID_COMPONENT)
+    return INVALID_ENTITY;
+
+  FixedBodyComponent body = {
+      {FixedFromDouble(position.x), FixedFromDouble(position.y)},
+      {FixedFromDouble(velocity.x), FixedFromDouble(velocity.y)},
+      {FixedFromDouble(acceleration.x), FixedFromDouble(acceleration.y)},
+      FixedFromDouble(radius),
+      FixedFromDouble(RESTITUTION)};
+  KVector2 rounded = {FixedToDouble(body.position.x),
+                      FixedToDouble(body.position.y)};
+
+  EntityID entity = UniverseCreateEntity(universe);
+  if (entity == INVALID_ENTITY)
+    return INVALID_ENTITY;
+  if (!UniverseAddKineticBodyComponent(universe, entity, rounded, mass) ||
+      !UniverseAddRadiusComponent(universe, entity,
+                                  FixedToDouble(body.radius)) ||
+      !UniverseAddComponent(universe, entity, universe->fixedComponent,
+                            &body)) {
+    UniverseDestroyEntity(universe, entity);
+    return INVALID_ENTITY;
+  }
+  return entity;
+}
+
+/* Arguments of the per-chunk kernel, converted once per step */
+typedef struct {
+  Universe *universe;
+  FixedBodyComponent *bodies;
+  Fixed deltaTime;
+  bool walls;
+  Fixed left;
+  Fixed right;
+  Fixed top;
+  Fixed bottom;
+} FixedJob;
+
+/* Widening product, floored back to Q16.16 */
+static inline int64_t fixedMul(Fixed a, Fixed b) {
+  return (int64_t)a * b >> FIXED_SHIFT;
+}
+
+/* Saturates symmetrically, so every value can be negated */
+static inline Fixed fixedNarrow(int64_t value) {
+  value = value < INT32_MAX ? value : INT32_MAX;
+  return (Fixed)(value > -INT32_MAX ? value : -INT32_MAX);
+}
+
+/* sweepAxis of systems.c in integers */
+static inline void fixedSweep(Fixed *position, Fixed *velocity, Fixed lo,
+                              Fixed hi, Fixed restitution) {
+  Fixed under = fixedNarrow((int64_t)lo - *position);
+  Fixed over = fixedNarrow((int64_t)*position - hi);
+  under = under > 0 ? under : 0;
+  over = over > 0 ? over : 0;
+  int64_t swept = *position + fixedMul(fixedNarrow((int64_t)under - over),
+                                       FIXED_ONE + restitution);
+  Fixed v = *velocity;
+  Fixed speed = fixedNarrow(fixedMul(v < 0 ? -v : v, restitution));
+
+  v = under > 0 ? speed : v;
+  v = over > 0 ? -speed : v;
+
+  swept = swept > lo ? swept : lo;
+  *position = fixedNarrow(swept < hi ? swept : hi);
+  *velocity = v;
+}
+
+static void fixedWords(void *context, uint32_t begin, uint32_t end,
+                       uint32_t chunk) {
+  (void)chunk;
+  const FixedJob *job = (const FixedJob *)context;
+  Universe *universe = job->universe;
+  const ComponentMask required =
+      COMPONENT_PARTICLE | COMPONENT_BIT(universe->fixedComponent);
+  const Fixed dt = job->deltaTime;
+  // Without walls the bounds span the whole range and radii drop out, so
+  // the sweep changes nothing; a branch would keep the loop scalar
+  const Fixed radiusMask = job->walls ? -1 : 0;
+  const Fixed left = job->left, right = job->right;
+  const Fixed top = job->top, bottom = job->bottom;
+
+  for (uint32_t w = begin; w < end; w++) {
+    const uint64_t bits =
+        UniverseMatchWord(universe, w, required, COMPONENT_NONE);
+    if (!bits)
+      continue;
+
+    // Every lane of the word runs; only fixed particles keep the result
+    const uint32_t base = w * 64;
+    const uint32_t lanes =
+        universe->maxEntities - base < 64 ? universe->maxEntities - base : 64;
+    FixedBodyComponent *restrict bodies = job->bodies + base;
+
+    // 32-bit halves: vector units shift 32-bit lanes by lane amounts
+    const uint32_t low = (uint32_t)bits, high = (uint32_t)(bits >> 32);
+
+#pragma omp simd
+    for (uint32_t l = 0; l < lanes; l++) {
+      const bool keep = ((l < 32 ? low : high) >> (l & 31)) & 1;
+      const FixedBodyComponent body = bodies[l];
+      Fixed vx = fixedNarrow(body.velocity.x +
+                             fixedMul(body.acceleration.x, dt));
+      Fixed vy = fixedNarrow(body.velocity.y +
+                             fixedMul(body.acceleration.y, dt));
+      Fixed px = fixedNarrow(body.position.x + fixedMul(vx, dt));
+      Fixed py = fixedNarrow(body.position.y + fixedMul(vy, dt));
+      const Fixed radius = body.radius & radiusMask;
+      fixedSweep(&px, &vx, fixedNarrow((int64_t)left + radius),
+                 fixedNarrow((int64_t)right - radius), body.restitution);
+      fixedSweep(&py, &vy, fixedNarrow((int64_t)top + radius),
+                 fixedNarrow((int64_t)bottom - radius), body.restitution);
+      bodies[l].position.x = keep ? px : body.position.x;
+      bodies[l].position.y = keep ? py : body.position.y;
+      bodies[l].velocity.x = keep ? vx : body.velocity.x;
+      bodies[l].velocity.y = keep ? vy : body.velocity.y;
+    }
+
+    // The doubles are exact copies of the integers
+    uint64_t mirror = bits;
+    while (mirror) {
+      uint32_t l = (uint32_t)__builtin_ctzll(mirror);
+      mirror &= mirror - 1;
+
+      KineticBodyComponent *particle = &universe->kineticBodies[base + l];
+      particle->previous = particle->position;
+      particle->position.x = FixedToDouble(bodies[l].position.x);
+      particle->position.y = FixedToDouble(bodies[l].position.y);
+    }
+  }
+}
+
+static void fixedJob(Universe *universe, double deltaTime, FixedJob *job) {
+  const UniverseBoundary *boundary = &universe->boundary;
+  *job = (FixedJob){universe,
+                    UNIVERSE_COLUMN(universe, FixedBodyComponent,
+                                    universe->fixedComponent),
+                    FixedFromDouble(deltaTime),
+                    boundary->enabled,
+                    -INT32_MAX,
+                    INT32_MAX,
+                    -INT32_MAX,
+                    INT32_MAX};
+  if (boundary->enabled) {
+    job->left = FixedFromDouble(boundary->left);
+    job->right = FixedFromDouble(boundary->right);
+    job->top = FixedFromDouble(boundary->top);
+    job->bottom = FixedFromDouble(boundary->bottom);
+  }
+}
+
+void PhysicsFixedUpdate(Universe *universe, double deltaTime) {
+  if (!universe || universe->fixedComponent == INVALID_COMPONENT)
+    return;
+
+  FixedJob job;
+  fixedJob(universe, deltaTime, &job);
+  ParallelFor(BITSET_WORDS(universe->maxEntities), PARALLEL_GRAIN_SLOTS / 64,
+              fixedWords, &job);
+}
+
+void PhysicsFixedWords(Universe *universe, double deltaTime, uint32_t begin,
+                       uint32_t end) {
+  if (universe->fixedComponent == INVALID_COMPONENT)
+    return;
+
+  FixedJob job;
+  fixedJob(universe, deltaTime, &job);
+  fixedWords(&job, begin, end, 0);
+}
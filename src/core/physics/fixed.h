@@ -0,0 +1,73 @@
+/**
+ * fixed.h
+ *
+ * Deterministic particles in Q16.16 fixed point. Double-precision results
+ * of the regular integration change with the optimisation level, FMA
+ * contraction and vector width. Integer arithmetic does not, so a fixed
+ * particle ends every step with the same bits in any build and on any
+ * number of threads.
+ *
+ * A fixed particle is a kinetic body plus a FixedBodyComponent and no
+ * MechanicsComponent, so the double systems never touch it. Each step,
+ * PhysicsFixedUpdate integrates it with semi-implicit Euler in integers,
+ * sweeps it against the walls and writes position and previous back to the
+ * kinetic body as exact doubles for rendering and queries. Changes other
+ * systems make to those doubles are overwritten. Fixed particles take no
+ * forces and ignore fluid, obstacles and rigid bodies.
+ *
+ * Values cover (-32768, 32768) in steps of 1/65536. deltaTime is rounded to
+ * that step too. Results saturate at the ends of the range, and products
+ * round towards negative infinity. The kernels run a whole bitset word of
+ * components as 64 SIMD lanes and keep the result of the lanes that hold a
+ * fixed particle.
+ */
+#ifndef PHYSICS_FIXED_H
+#define PHYSICS_FIXED_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "../universe.h"
+
+#define FIXED_SHIFT 16
+#define FIXED_ONE ((Fixed)1 << FIXED_SHIFT)
+
+typedef int32_t Fixed;
+
+typedef struct {
+  Fixed x;
+  Fixed y;
+} FixedVector2;
+
+typedef struct {
+  FixedVector2 position;
+  FixedVector2 velocity;
+  FixedVector2 acceleration;
+  Fixed radius;      /* wall radius, 0 for a point */
+  Fixed restitution; /* of the walls, in [0, 1] */
+} FixedBodyComponent;
+
+/* Nearest value, saturated at the ends of the range; NaN gives 0 */
+Fixed FixedFromDouble(double value);
+/* Exact */
+double FixedToDouble(Fixed value);
+
+/* Registers the fixed body component; calling it again does nothing */
+bool FixedPointEnable(Universe *universe);
+
+/**
+ * A particle of the given mass with a FixedBodyComponent. The values are
+ * rounded to Q16.16 and the kinetic body holds the rounded position.
+ * Restitution defaults to RESTITUTION.
+ */
+EntityID FixedParticleCreate(Universe *universe, KVector2 position,
+                             KVector2 velocity, KVector2 acceleration,
+                             double mass, double radius);
+
+/* Integrates the fixed particles and resolves them against the walls */
+void PhysicsFixedUpdate(Universe *universe, double deltaTime);
+/* The same over the bitset words [begin, end), for fused sweeps */
+void PhysicsFixedWords(Universe *universe, double deltaTime, uint32_t begin,
+                       uint32_t end);
+
+#endif /* PHYSICS_FIXED_H */
@@ -0,0 +1,453 @@
+#include "fluid.h"
+
+#include <float.h>
+#include <math.h>
+
+#include "../parallel.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+/* Sorted particles handed to one worker at a time */
+#define FLUID_GRAIN 1024
+
+FluidSettings FluidDefaultSettings(void) {
+  FluidSettings settings;
+  settings.smoothingRadius = FLUID_SMOOTHING_RADIUS;
+  settings.spacing = FLUID_SPACING;
+  settings.particleMass = FLUID_PARTICLE_MASS;
+  settings.restDensity = 0.0;
+  settings.stiffness = FLUID_STIFFNESS;
+  settings.viscosity = FLUID_VISCOSITY;
+  settings.gravity = (KVector2){FLUID_GRAVITY_X, FLUID_GRAVITY_Y};
+  return settings;
+}
+
+static double poly6(double h) { return 4.0 / (M_PI * pow(h, 8.0)); }
+
+/* Density of a square lattice at the rest spacing, as the solver sees it */
+static double latticeDensity(const FluidSettings *settings) {
+  const double h = settings->smoothingRadius;
+  const double s = settings->spacing;
+  const int n = (int)ceil(h / s);
+  double density = 0.0;
+
+  for (int i = -n; i <= n; i++) {
+    for (int j = -n; j <= n; j++) {
+      double d = h * h - (double)(i * i + j * j) * s * s;
+      if (d > 0.0)
+        density += d * d * d;
+    }
+  }
+  return settings->particleMass * poly6(h) * density;
+}
+
+static size_t alignUp(size_t bytes) {
+  return (bytes + COLUMN_ALIGNMENT - 1) & ~(size_t)(COLUMN_ALIGNMENT - 1);
+}
+
+/* Everything in one block, so UniverseDestroy releases it in one go */
+static FluidSolver *createSolver(Universe *universe) {
+  const uint32_t capacity = universe->maxEntities;
+  // Twice as many cells as particles before cells start to grow
+  const uint32_t cellCapacity = 2 * capacity + 64;
+
+  size_t header = alignUp(sizeof(FluidSolver));
+  size_t indices = alignUp((size_t)capacity * sizeof(uint32_t));
+  size_t starts = alignUp(((size_t)cellCapacity + 1) * sizeof(uint32_t));
+  size_t values = alignUp((size_t)capacity * sizeof(double));
+  size_t bytes = header + 3 * indices + starts + 7 * values;
+
+  unsigned char *block = (unsigned char *)UniverseAllocate(
+      universe, K_MEMORY_FLUID, bytes, COLUMN_ALIGNMENT);
+  if (!block)
+    return NULL;
+
+  FluidSolver *fluid = (FluidSolver *)block;
+  unsigned char *cursor = block + header;
+  fluid->capacity = capacity;
+  fluid->cellCapacity = cellCapacity;
+  fluid->count = 0;
+  fluid->slots = (uint32_t *)cursor;
+  fluid->gathered = (uint32_t *)(cursor += indices);
+  fluid->cellOf = (uint32_t *)(cursor += indices);
+  fluid->cellStart = (uint32_t *)(cursor += indices);
+  fluid->x = (double *)(cursor += starts);
+  fluid->y = (double *)(cursor += values);
+  fluid->vx = (double *)(cursor += values);
+  fluid->vy = (double *)(cursor += values);
+  fluid->mass = (double *)(cursor += values);
+  fluid->invDensity = (double *)(cursor += values);
+  fluid->pressure = (double *)(cursor += values);
+  return fluid;
+}
+
+bool FluidEnable(Universe *universe, const FluidSettings *settings) {
+  if (!universe)
+    return false;
+
+  FluidSettings chosen = settings ? *settings : FluidDefaultSettings();
+  if (!(chosen.smoothingRadius > 0.0) || !(chosen.spacing > 0.0) ||
+      !(chosen.particleMass > 0.0))
+    return false;
+
+  if (universe->fluidComponent == INVALID_COMPONENT)
+    universe->fluidComponent = UniverseRegisterComponent(
+        universe, sizeof(FluidComponent), _Alignof(FluidComponent));
+  if (universe->fluidComponent == INVALID_COMPONENT)
+    return false;
+
+  if (!universe->fluid)
+    universe->fluid = createSolver(universe);
+  if (!universe->fluid)
+    return false;
+
+  if (chosen.restDensity <= 0.0)
+    chosen.restDensity = latticeDensity(&chosen);
+  universe->fluid->settings = chosen;
+  return true;
+}
+
+EntityID FluidParticleCreate(Universe *universe, KVector2 position,
+                             KVector2 velocity) {
+  if (!universe || !universe->fluid)
+    return INVALID_ENTITY;
+
+  const FluidSettings *settings = &universe->fluid->settings;
+  EntityID entity =
+      ParticleCreate(universe, position, velocity, settings->particleMass);
+  if (entity == INVALID_ENTITY)
+    return INVALID_ENTITY;
+
+  FluidComponent fluid = {settings->restDensity, 0.0};
+  if (!UniverseAddComponent(universe, entity, universe->fluidComponent,
+                            &fluid)) {
+    UniverseDestroyEntity(universe, entity);
+    return INVALID_ENTITY;
+  }
+
+  uint32_t slot = UniverseEntitySlot(universe, entity);
+  universe->radii[slot].radius = 0.5 * settings->spacing;
+  return entity;
+}
+
+double FluidMaxTimestep(const Universe *universe) {
+  if (!universe || !universe->fluid)
+    return 0.0;
+
+  // Sound crossing a fraction of the kernel, and explicit diffusion
+  const FluidSettings *settings = &universe->fluid->settings;
+  const double h = settings->smoothingRadius;
+  double step = settings->stiffness > 0.0 ? 0.4 * h / sqrt(settings->stiffness)
+                                          : DBL_MAX;
+  if (settings->viscosity > 0.0 && 0.125 * h * h / settings->viscosity < step)
+    step = 0.125 * h * h / settings->viscosity;
+  return step;
+}
+
+/*
+ * Clamped cell coordinate. Clamping never moves two points more than one
+ * cell closer or apart, so particles outside the grid still find all their
+ * neighbours; they just share the edge cells.
+ */
+static uint32_t cellCoordinate(double value, double origin, double inverse,
+                               uint32_t cells) {
+  double c = (value - origin) * inverse;
+  if (!(c > 0.0))
+    return 0;
+  return c < (double)(cells - 1) ? (uint32_t)c : cells - 1;
+}
+
+/* Collects the fluid slots and sorts them into the cell list */
+static uint32_t buildCells(Universe *universe, FluidSolver *fluid) {
+  const ComponentMask required = COMPONENT_PARTICLE | COMPONENT_MECHANICS |
+                                 COMPONENT_BIT(universe->fluidComponent);
+  const KineticBodyComponent *bodies = universe->kineticBodies;
+  const MechanicsComponent *mechanics = universe->mechanics;
+
+  KVector2 lo = {DBL_MAX, DBL_MAX};
+  KVector2 hi = {-DBL_MAX, -DBL_MAX};
+  uint32_t count = 0;
+  for (uint32_t w = 0; w < BITSET_WORDS(universe->maxEntities); w++) {
+    uint64_t bits = UniverseMatchWord(universe, w, required, COMPONENT_NONE);
+    while (bits) {
+      uint32_t slot = w * 64 + (uint32_t)__builtin_ctzll(bits);
+      bits &= bits - 1;
+
+      KVector2 p = bodies[slot].position;
+      lo.x = p.x < lo.x ? p.x : lo.x;
+      lo.y = p.y < lo.y ? p.y : lo.y;
+      hi.x = p.x > hi.x ? p.x : hi.x;
+      hi.y = p.y > hi.y ? p.y : hi.y;
+      fluid->gathered[count++] = slot;
+    }
+  }
+  fluid->count = count;
+  if (count == 0)
+    return 0;
+
+  // Inside walls the grid covers them and strays share the edge cells
+  if (universe->boundary.enabled) {
+    lo = (KVector2){universe->boundary.left, universe->boundary.top};
+    hi = (KVector2){universe->boundary.right, universe->boundary.bottom};
+  }
+  double width = isfinite(hi.x - lo.x) ? hi.x - lo.x : 0.0;
+  double height = isfinite(hi.y - lo.y) ? hi.y - lo.y : 0.0;
+  if (!isfinite(lo.x) || !isfinite(lo.y))
+    lo = (KVector2){0.0, 0.0};
+
+  // Cells narrower than the kernel would miss neighbours; wider is only
+  // slower, so grow them until the grid fits the scratch
+  double cellSize = fluid->settings.smoothingRadius;
+  double cellsX = floor(width / cellSize) + 1.0;
+  double cellsY = floor(height / cellSize) + 1.0;
+  while (cellsX * cellsY > (double)fluid->cellCapacity) {
+    cellSize *= 1.25;
+    cellsX = floor(width / cellSize) + 1.0;
+    cellsY = floor(height / cellSize) + 1.0;
+  }
+  fluid->cellSize = cellSize;
+  fluid->cellsX = (uint32_t)cellsX;
+  fluid->cellsY = (uint32_t)cellsY;
+  fluid->origin = lo;
+
+  const uint32_t cells = fluid->cellsX * fluid->cellsY;
+  const double inverse = 1.0 / cellSize;
+  uint32_t *cellStart = fluid->cellStart;
+  for (uint32_t c = 0; c <= cells; c++)
+    cellStart[c] = 0;
+
+  for (uint32_t k = 0; k < count; k++) {
+    KVector2 p = bodies[fluid->gathered[k]].position;
+    uint32_t cx = cellCoordinate(p.x, lo.x, inverse, fluid->cellsX);
+    uint32_t cy = cellCoordinate(p.y, lo.y, inverse, fluid->cellsY);
+    uint32_t cell = cy * fluid->cellsX + cx;
+    fluid->cellOf[k] = cell;
+    cellStart[cell + 1]++;
+  }
+  for (uint32_t c = 0; c < cells; c++)
+    cellStart[c + 1] += cellStart[c];
+
+  // Scatter in bitset order, so cells keep a deterministic order; the starts
+  // advance to the ends and are shifted back afterwards
+  for (uint32_t k = 0; k < count; k++) {
+    uint32_t slot = fluid->gathered[k];
+    uint32_t i = cellStart[fluid->cellOf[k]]++;
+    double inverseMass = bodies[slot].inverseMass;
+
+    fluid->slots[i] = slot;
+    fluid->x[i] = bodies[slot].position.x;
+    fluid->y[i] = bodies[slot].position.y;
+    fluid->vx[i] = mechanics[slot].velocity.x;
+    fluid->vy[i] = mechanics[slot].velocity.y;
+    fluid->mass[i] = inverseMass > 0.0 ? 1.0 / inverseMass : 0.0;
+  }
+  for (uint32_t c = cells; c > 0; c--)
+    cellStart[c] = cellStart[c - 1];
+  cellStart[0] = 0;
+
+  return count;
+}
+
+/*
+ * Kernels run on blocks of up to FLUID_LANES consecutive sorted particles
+ * from one or two adjacent cells of a row. Each candidate neighbour is
+ * broadcast against every lane, so the lanes are the SIMD dimension and the
+ * vector stays full however few particles a cell holds. The shared
+ * candidate range is the three rows around the block, one cell wider than
+ * its cells. It holds at most a third more particles than a single
+ * particle's range, and lanes just add zeros for the extras. Unused lanes
+ * sit far outside every kernel.
+ */
+#define FLUID_LANES 8
+#define FLUID_FAR 1e30
+
+typedef struct {
+  uint32_t first; /* sorted index of lane 0 */
+  uint32_t count; /* occupied lanes */
+  uint32_t rowFirst;
+  uint32_t rowLast;
+  uint32_t from[3]; /* candidate range per row */
+  uint32_t to[3];
+  double x[FLUID_LANES];
+  double y[FLUID_LANES];
+} FluidBlock;
+
+static void nextBlock(const FluidSolver *fluid, uint32_t i, uint32_t end,
+                      FluidBlock *block) {
+  const double inverse = 1.0 / fluid->cellSize;
+  uint32_t cx = cellCoordinate(fluid->x[i], fluid->origin.x, inverse,
+                               fluid->cellsX);
+  uint32_t cy = cellCoordinate(fluid->y[i], fluid->origin.y, inverse,
+                               fluid->cellsY);
+  uint32_t cxLast = cx;
+
+  // Sorted order is row-major by cell, so a run of one row is contiguous
+  uint32_t count = 1;
+  while (count < FLUID_LANES && i + count < end) {
+    uint32_t nx = cellCoordinate(fluid->x[i + count], fluid->origin.x, inverse,
+                                 fluid->cellsX);
+    uint32_t ny = cellCoordinate(fluid->y[i + count], fluid->origin.y, inverse,
+                                 fluid->cellsY);
+    if (ny != cy || nx > cx + 1)
+      break;
+    cxLast = nx;
+    count++;
+  }
+
+  block->first = i;
+  block->count = count;
+  for (uint32_t l = 0; l < FLUID_LANES; l++) {
+    block->x[l] = l < count ? fluid->x[i + l] : FLUID_FAR;
+    block->y[l] = l < count ? fluid->y[i + l] : FLUID_FAR;
+  }
+
+  uint32_t first = cx > 0 ? cx - 1 : 0;
+  uint32_t last = cxLast + 1 < fluid->cellsX ? cxLast + 1 : fluid->cellsX - 1;
+  block->rowFirst = cy > 0 ? cy - 1 : 0;
+  block->rowLast = cy + 1 < fluid->cellsY ? cy + 1 : fluid->cellsY - 1;
+  for (uint32_t row = block->rowFirst; row <= block->rowLast; row++) {
+    uint32_t base = row * fluid->cellsX;
+    block->from[row - block->rowFirst] = fluid->cellStart[base + first];
+    block->to[row - block->rowFirst] = fluid->cellStart[base + last + 1];
+  }
+}
+
+typedef struct {
+  Universe *universe;
+  FluidSolver *fluid;
+} FluidJob;
+
+static void densityRange(void *context, uint32_t begin, uint32_t end,
+                         uint32_t chunk) {
+  (void)chunk;
+  Universe *universe = ((FluidJob *)context)->universe;
+  FluidSolver *fluid = ((FluidJob *)context)->fluid;
+  FluidComponent *components =
+      UNIVERSE_COLUMN(universe, FluidComponent, universe->fluidComponent);
+  const double *restrict x = fluid->x;
+  const double *restrict y = fluid->y;
+  const double *restrict mass = fluid->mass;
+  const FluidSettings settings = fluid->settings;
+  const double h2 = settings.smoothingRadius * settings.smoothingRadius;
+  const double scale = poly6(settings.smoothingRadius);
+
+  FluidBlock block;
+  for (uint32_t i = begin; i < end; i = block.first + block.count) {
+    nextBlock(fluid, i, end, &block);
+    double density[FLUID_LANES] = {0.0};
+
+    for (uint32_t r = 0; r <= block.rowLast - block.rowFirst; r++) {
+      for (uint32_t j = block.from[r]; j < block.to[r]; j++) {
+        const double xj = x[j], yj = y[j], mj = mass[j];
+
+#pragma omp simd
+        for (uint32_t l = 0; l < FLUID_LANES; l++) {
+          double dx = xj - block.x[l], dy = yj - block.y[l];
+          double d = h2 - (dx * dx + dy * dy);
+          d = d > 0.0 ? d : 0.0;
+          density[l] += mj * d * d * d;
+        }
+      }
+    }
+
+    for (uint32_t l = 0; l < block.count; l++) {
+      uint32_t k = block.first + l;
+      double rho = density[l] * scale;
+      double excess = rho - settings.restDensity;
+      double pressure = settings.stiffness * (excess > 0.0 ? excess : 0.0);
+      fluid->invDensity[k] = rho > 0.0 ? 1.0 / rho : 0.0;
+      fluid->pressure[k] = pressure;
+      components[fluid->slots[k]] = (FluidComponent){rho, pressure};
+    }
+  }
+}
+
+static void forceRange(void *context, uint32_t begin, uint32_t end,
+                       uint32_t chunk) {
+  (void)chunk;
+  const FluidSolver *fluid = ((FluidJob *)context)->fluid;
+  MechanicsComponent *mechanics = ((FluidJob *)context)->universe->mechanics;
+  const double *restrict x = fluid->x;
+  const double *restrict y = fluid->y;
+  const double *restrict vx = fluid->vx;
+  const double *restrict vy = fluid->vy;
+  const double *restrict mass = fluid->mass;
+  const double *restrict invDensity = fluid->invDensity;
+  const double *restrict pressure = fluid->pressure;
+  const FluidSettings settings = fluid->settings;
+  const double h = settings.smoothingRadius;
+  const double h2 = h * h;
+  // Spiky gradient and viscosity Laplacian, 2D normalisation
+  const double pressureScale = 30.0 / (M_PI * pow(h, 5.0));
+  const double viscosityScale = settings.viscosity * settings.restDensity *
+                                40.0 / (M_PI * pow(h, 5.0));
+
+  FluidBlock block;
+  for (uint32_t i = begin; i < end; i = block.first + block.count) {
+    nextBlock(fluid, i, end, &block);
+
+    double bvx[FLUID_LANES], bvy[FLUID_LANES], bp[FLUID_LANES];
+    for (uint32_t l = 0; l < FLUID_LANES; l++) {
+      bool used = l < block.count;
+      bvx[l] = used ? vx[block.first + l] : 0.0;
+      bvy[l] = used ? vy[block.first + l] : 0.0;
+      bp[l] = used ? pressure[block.first + l] : 0.0;
+    }
+
+    double px[FLUID_LANES] = {0.0}, py[FLUID_LANES] = {0.0};
+    double ux[FLUID_LANES] = {0.0}, uy[FLUID_LANES] = {0.0};
+    for (uint32_t r = 0; r <= block.rowLast - block.rowFirst; r++) {
+      for (uint32_t j = block.from[r]; j < block.to[r]; j++) {
+        const double xj = x[j], yj = y[j], vxj = vx[j], vyj = vy[j];
+        const double pj = pressure[j];
+        const double weight = mass[j] * invDensity[j];
+
+#pragma omp simd
+        for (uint32_t l = 0; l < FLUID_LANES; l++) {
+          double dx = block.x[l] - xj, dy = block.y[l] - yj;
+          double r2 = dx * dx + dy * dy;
+          double r = sqrt(r2);
+          // The particle itself and everything past the kernel drop out
+          double q = r2 < h2 && r2 > 0.0 ? h - r : 0.0;
+          double inverseR = r2 > 0.0 ? 1.0 / r : 0.0;
+
+          double push = weight * (bp[l] + pj) * q * q * inverseR;
+          px[l] += push * dx;
+          py[l] += push * dy;
+          ux[l] += weight * q * (vxj - bvx[l]);
+          uy[l] += weight * q * (vyj - bvy[l]);
+        }
+      }
+    }
+
+    // m_i * a_i; the symmetric forms make pair forces equal and opposite
+    for (uint32_t l = 0; l < block.count; l++) {
+      uint32_t k = block.first + l;
+      double pressureFactor = 0.5 * pressureScale * invDensity[k];
+      double viscosityFactor = viscosityScale * invDensity[k];
+      MechanicsComponent *target = &mechanics[fluid->slots[k]];
+      target->forceAccum.x +=
+          mass[k] * (pressureFactor * px[l] + viscosityFactor * ux[l] +
+                     settings.gravity.x);
+      target->forceAccum.y +=
+          mass[k] * (pressureFactor * py[l] + viscosityFactor * uy[l] +
+                     settings.gravity.y);
+    }
+  }
+}
+
+void PhysicsFluidUpdate(Universe *universe) {
+  if (!universe || !universe->fluid)
+    return;
+
+  FluidSolver *fluid = universe->fluid;
+  if (buildCells(universe, fluid) == 0)
+    return;
+
+  // Forces read every density, so the passes are two separate loops
+  FluidJob job = {universe, fluid};
+  ParallelFor(fluid->count, FLUID_GRAIN, densityRange, &job);
+  ParallelFor(fluid->count, FLUID_GRAIN, forceRange, &job);
+}
@@ -0,0 +1,95 @@
+/**
+ * fluid.h
+ *
+ * Smoothed-particle hydrodynamics on top of the particle ECS. Fluid
+ * particles are ordinary particles (KineticBodyComponent, MechanicsComponent
+ * and a radius for the walls) plus a compact FluidComponent. Each step,
+ * PhysicsFluidUpdate turns density, pressure and viscosity into forces in
+ * forceAccum. The regular integration and boundary pass then move the
+ * particles, so the fluid also works with adaptive substepping.
+ *
+ * Neighbours are found through a cell list with cells of at least the
+ * smoothing radius, rebuilt every step by a counting sort. The sort also
+ * packs position, velocity and mass into structure-of-arrays scratch in cell
+ * order, so the cells of a row around a particle are one contiguous range.
+ * The kernels take blocks of neighbouring sorted particles as SIMD lanes and
+ * stream the shared candidate ranges past them without branches. Density
+ * and forces are parallel over the sorted particles. Each particle only
+ * writes its own results, so every backend gives the same answer.
+ *
+ * Kernels are the 2D forms of Mueller et al. 2003: poly6 for density, the
+ * spiky gradient for pressure and the viscosity Laplacian. Pressure is
+ * stiffness * max(density - restDensity, 0). Pairwise terms are symmetric,
+ * so momentum is conserved apart from gravity and walls.
+ */
+#ifndef PHYSICS_FLUID_H
+#define PHYSICS_FLUID_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "../universe.h"
+
+typedef struct {
+  double density;
+  double pressure;
+} FluidComponent;
+
+typedef struct {
+  double smoothingRadius;
+  double spacing;      /* rest distance between particles */
+  double particleMass; /* mass of FluidParticleCreate particles */
+  double restDensity;  /* 0 derives it from spacing and particleMass */
+  double stiffness;    /* squared speed of sound */
+  double viscosity;    /* kinematic */
+  KVector2 gravity;
+} FluidSettings;
+
+/**
+ * Solver state and per-step scratch. It is carved from the universe
+ * allocator in one block when the fluid is enabled, so steps never allocate.
+ */
+typedef struct FluidSolver {
+  FluidSettings settings;
+  uint32_t capacity;     /* particles the scratch holds */
+  uint32_t cellCapacity; /* cells the scratch holds */
+  uint32_t count;        /* fluid particles in the last step */
+  uint32_t cellsX;
+  uint32_t cellsY;
+  double cellSize;
+  KVector2 origin;
+  uint32_t *slots;     /* sorted index -> storage slot */
+  uint32_t *gathered;  /* fluid slots in bitset order */
+  uint32_t *cellOf;    /* cell of each gathered particle */
+  uint32_t *cellStart; /* cellCapacity + 1 prefix offsets */
+  /* Sorted structure-of-arrays copies for the kernel loops */
+  double *x;
+  double *y;
+  double *vx;
+  double *vy;
+  double *mass;
+  double *invDensity;
+  double *pressure;
+} FluidSolver;
+
+FluidSettings FluidDefaultSettings(void);
+
+/**
+ * Registers the fluid component and carves the solver from the universe
+ * allocator. Calling it again replaces the settings.
+ *
+ * @param settings NULL selects FluidDefaultSettings
+ */
+bool FluidEnable(Universe *universe, const FluidSettings *settings);
+
+/* A particle of settings.particleMass with a wall radius of spacing / 2 */
+EntityID FluidParticleCreate(Universe *universe, KVector2 position,
+                             KVector2 velocity);
+
+/* Largest stable step for the current settings, ignoring flow speed */
+double FluidMaxTimestep(const Universe *universe);
+
+/* Density and pressure, then pressure, viscosity and gravity forces */
+void PhysicsFluidUpdate(Universe *universe);
+
+#endif /* PHYSICS_FLUID_H */
@@ -0,0 +1,542 @@
+#include "obstacles.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+#include "../parallel.h"
+#include "diagnostics_internal.h"
+
+static inline KVector2 add(KVector2 a, KVector2 b) {
+  return (KVector2){a.x + b.x, a.y + b.y};
+}
+static inline KVector2 sub(KVector2 a, KVector2 b) {
+  return (KVector2){a.x - b.x, a.y - b.y};
+}
+static inline KVector2 scale(double s, KVector2 v) {
+  return (KVector2){s * v.x, s * v.y};
+}
+static inline double dot(KVector2 a, KVector2 b) {
+  return a.x * b.x + a.y * b.y;
+}
+static inline double cross(KVector2 a, KVector2 b) {
+  return a.x * b.y - a.y * b.x;
+}
+static inline KVector2 lower(KVector2 a, KVector2 b) {
+  return (KVector2){a.x < b.x ? a.x : b.x, a.y < b.y ? a.y : b.y};
+}
+static inline KVector2 upper(KVector2 a, KVector2 b) {
+  return (KVector2){a.x > b.x ? a.x : b.x, a.y > b.y ? a.y : b.y};
+}
+// Non-short-circuit, so the four compares cost one branch at the caller
+static inline bool overlaps(KVector2 minA, KVector2 maxA, KVector2 minB,
+                            KVector2 maxB) {
+  return (minA.x <= maxB.x) & (maxA.x >= minB.x) & (minA.y <= maxB.y) &
+         (maxA.y >= minB.y);
+}
+
+static size_t alignUp(size_t bytes) {
+  return (bytes + COLUMN_ALIGNMENT - 1) & ~(size_t)(COLUMN_ALIGNMENT - 1);
+}
+
+static ObstacleSet *createSet(Universe *universe, uint32_t capacity,
+                              uint32_t vertexCapacity) {
+  size_t header = alignUp(sizeof(ObstacleSet));
+  size_t obstacles = alignUp((size_t)capacity * sizeof(Obstacle));
+  size_t vertices = alignUp((size_t)vertexCapacity * sizeof(KVector2));
+  // Nodes below the root hold more than a leaf each: fewer than n in all
+  size_t nodes = alignUp((size_t)capacity * sizeof(ObstacleNode));
+
+  unsigned char *block = (unsigned char *)UniverseAllocate(
+      universe, K_MEMORY_OBSTACLES, header + obstacles + 2 * vertices + nodes,
+      COLUMN_ALIGNMENT);
+  if (!block)
+    return NULL;
+
+  ObstacleSet *set = (ObstacleSet *)block;
+  unsigned char *cursor = block + header;
+  *set = (ObstacleSet){0};
+  set->capacity = capacity;
+  set->vertexCapacity = vertexCapacity;
+  set->obstacles = (Obstacle *)cursor;
+  set->vertices = (KVector2 *)(cursor += obstacles);
+  set->normals = (KVector2 *)(cursor += vertices);
+  set->nodes = (ObstacleNode *)(cursor += vertices);
+  return set;
+}
+
+bool ObstaclesEnable(Universe *universe, uint32_t maxObstacles,
+                     uint32_t maxVertices) {
+  if (!universe || maxObstacles == 0)
+    return false;
+
+  if (!universe->obstacles)
+    universe->obstacles = createSet(universe, maxObstacles, maxVertices);
+  return universe->obstacles != NULL;
+}
+
+static bool addObstacle(Universe *universe, Obstacle obstacle) {
+  ObstacleSet *set = universe ? universe->obstacles : NULL;
+  if (!set || set->count == set->capacity)
+    return false;
+
+  set->obstacles[set->count++] = obstacle;
+  set->dirty = true;
+  return true;
+}
+
+bool ObstacleAddSegment(Universe *universe, KVector2 a, KVector2 b) {
+  if (dot(sub(b, a), sub(b, a)) <= 0.0)
+    return false;
+
+  Obstacle segment = {0};
+  segment.type = OBSTACLE_SEGMENT;
+  segment.a = a;
+  segment.b = b;
+  segment.boundsMin = lower(a, b);
+  segment.boundsMax = upper(a, b);
+  return addObstacle(universe, segment);
+}
+
+bool ObstacleAddCircle(Universe *universe, KVector2 centre, double radius) {
+  if (!(radius > 0.0))
+    return false;
+
+  Obstacle circle = {0};
+  circle.type = OBSTACLE_CIRCLE;
+  circle.radius = radius;
+  circle.a = centre;
+  circle.boundsMin = (KVector2){centre.x - radius, centre.y - radius};
+  circle.boundsMax = (KVector2){centre.x + radius, centre.y + radius};
+  return addObstacle(universe, circle);
+}
+
+bool ObstacleAddPolygon(Universe *universe, const KVector2 *vertices,
+                        uint32_t count) {
+  ObstacleSet *set = universe ? universe->obstacles : NULL;
+  if (!set || !vertices || count < 3 || set->count == set->capacity ||
+      count > set->vertexCapacity - set->vertexCount)
+    return false;
+
+  double area = 0.0;
+  for (uint32_t i = 0; i < count; i++)
+    area += cross(vertices[i], vertices[(i + 1) % count]);
+  if (area == 0.0)
+    return false;
+
+  // Store counter-clockwise; every turn must then be strictly to the left
+  KVector2 *corners = &set->vertices[set->vertexCount];
+  for (uint32_t i = 0; i < count; i++)
+    corners[i] = vertices[area > 0.0 ? i : count - 1 - i];
+  for (uint32_t i = 0; i < count; i++) {
+    KVector2 edge = sub(corners[(i + 1) % count], corners[i]);
+    KVector2 next = sub(corners[(i + 2) % count], corners[(i + 1) % count]);
+    if (cross(edge, next) <= 0.0)
+      return false;
+  }
+
+  Obstacle polygon = {0};
+  polygon.type = OBSTACLE_POLYGON;
+  polygon.first = set->vertexCount;
+  polygon.count = count;
+  polygon.boundsMin = polygon.boundsMax = corners[0];
+  for (uint32_t i = 0; i < count; i++) {
+    KVector2 edge = sub(corners[(i + 1) % count], corners[i]);
+    double length = sqrt(dot(edge, edge));
+    set->normals[polygon.first + i] =
+        (KVector2){edge.y / length, -edge.x / length};
+    polygon.boundsMin = lower(polygon.boundsMin, corners[i]);
+    polygon.boundsMax = upper(polygon.boundsMax, corners[i]);
+  }
+
+  if (!addObstacle(universe, polygon))
+    return false;
+  set->vertexCount += count;
+  return true;
+}
+
+/* Centroid of the bounds, the key the build splits on */
+static double centre(const Obstacle *obstacle, int axis) {
+  return axis ? obstacle->boundsMin.y + obstacle->boundsMax.y
+              : obstacle->boundsMin.x + obstacle->boundsMax.x;
+}
+
+static int compareX(const void *a, const void *b) {
+  double u = centre((const Obstacle *)a, 0);
+  double v = centre((const Obstacle *)b, 0);
+  return (u > v) - (u < v);
+}
+
+static int compareY(const void *a, const void *b) {
+  double u = centre((const Obstacle *)a, 1);
+  double v = centre((const Obstacle *)b, 1);
+  return (u > v) - (u < v);
+}
+
+static void boundsOf(const Obstacle *obstacles, uint32_t begin, uint32_t end,
+                     KVector2 *boundsMin, KVector2 *boundsMax,
+                     KVector2 *centresMin, KVector2 *centresMax) {
+  *boundsMin = obstacles[begin].boundsMin;
+  *boundsMax = obstacles[begin].boundsMax;
+  *centresMin = *centresMax = (KVector2){centre(&obstacles[begin], 0),
+                                         centre(&obstacles[begin], 1)};
+  for (uint32_t i = begin + 1; i < end; i++) {
+    KVector2 c = {centre(&obstacles[i], 0), centre(&obstacles[i], 1)};
+    *boundsMin = lower(*boundsMin, obstacles[i].boundsMin);
+    *boundsMax = upper(*boundsMax, obstacles[i].boundsMax);
+    *centresMin = lower(*centresMin, c);
+    *centresMax = upper(*centresMax, c);
+  }
+}
+
+/* Sorts [begin, end) along the longer side of its centroid bounds and
+ * returns the median */
+static uint32_t split(Obstacle *obstacles, uint32_t begin, uint32_t end) {
+  KVector2 boundsMin, boundsMax, centresMin, centresMax;
+  boundsOf(obstacles, begin, end, &boundsMin, &boundsMax, &centresMin,
+           &centresMax);
+  bool splitY = centresMax.y - centresMin.y > centresMax.x - centresMin.x;
+  qsort(&obstacles[begin], end - begin, sizeof(Obstacle),
+        splitY ? compareY : compareX);
+  return begin + (end - begin) / 2;
+}
+
+/*
+ * Two levels of median splits give each node up to four children; ranges
+ * of at most OBSTACLE_LEAF_SIZE obstacles become leaf children. Nodes are
+ * numbered depth first. Median splits keep the depth at log4 of the leaf
+ * count, well inside OBSTACLE_STACK_DEPTH.
+ */
+static uint32_t buildNode(ObstacleSet *set, uint32_t begin, uint32_t end,
+                          uint32_t depth) {
+  const uint32_t index = set->nodeCount++;
+  ObstacleNode *node = &set->nodes[index];
+  Obstacle *obstacles = set->obstacles;
+  if (depth + 1 > set->depth)
+    set->depth = depth + 1;
+
+  uint32_t ranges[5] = {begin, end};
+  uint32_t count = 1;
+  if (end - begin > OBSTACLE_LEAF_SIZE) {
+    uint32_t middle = split(obstacles, begin, end);
+    count = 0;
+    ranges[count++] = begin;
+    if (middle - begin > OBSTACLE_LEAF_SIZE)
+      ranges[count++] = split(obstacles, begin, middle);
+    ranges[count++] = middle;
+    if (end - middle > OBSTACLE_LEAF_SIZE)
+      ranges[count++] = split(obstacles, middle, end);
+    ranges[count] = end;
+  }
+
+  for (uint32_t c = 0; c < OBSTACLE_NODE_WIDTH; c++) {
+    // Empty slots get inverted bounds, which no query overlaps
+    node->minX[c] = node->minY[c] = INFINITY;
+    node->maxX[c] = node->maxY[c] = -INFINITY;
+    node->child[c] = 0;
+    node->count[c] = 0;
+  }
+  for (uint32_t c = 0; c < count; c++) {
+    KVector2 boundsMin, boundsMax, centresMin, centresMax;
+    boundsOf(obstacles, ranges[c], ranges[c + 1], &boundsMin, &boundsMax,
+             &centresMin, &centresMax);
+    node->minX[c] = boundsMin.x;
+    node->minY[c] = boundsMin.y;
+    node->maxX[c] = boundsMax.x;
+    node->maxY[c] = boundsMax.y;
+    if (ranges[c + 1] - ranges[c] <= OBSTACLE_LEAF_SIZE) {
+      node->child[c] = ranges[c];
+      node->count[c] = ranges[c + 1] - ranges[c];
+    } else {
+      uint32_t child = buildNode(set, ranges[c], ranges[c + 1], depth + 1);
+      set->nodes[index].child[c] = child;
+    }
+  }
+  return index;
+}
+
+bool ObstaclesBuild(Universe *universe) {
+  ObstacleSet *set = universe ? universe->obstacles : NULL;
+  if (!set)
+    return false;
+
+  set->nodeCount = 0;
+  set->depth = 0;
+  if (set->count > 0)
+    buildNode(set, 0, set->count, 0);
+  set->dirty = false;
+  return true;
+}
+
+/**
+ * Contacts. Each takes the particle's position, velocity and radius, and
+ * where it started the step; it returns true after pushing the particle out.
+ */
+
+// Removes the velocity into the surface, less restitution
+static inline void bounce(KVector2 *velocity, KVector2 normal) {
+  double into = dot(*velocity, normal);
+  if (into < 0.0)
+    *velocity = sub(*velocity, scale((1.0 + RESTITUTION) * into, normal));
+}
+
+static bool collideSegment(const Obstacle *segment, KVector2 *position,
+                           KVector2 *velocity, KVector2 previous,
+                           double radius) {
+  const KVector2 a = segment->a;
+  const KVector2 edge = sub(segment->b, a);
+  const double length2 = dot(edge, edge);
+  const KVector2 normal =
+      scale(1.0 / sqrt(length2), (KVector2){-edge.y, edge.x});
+  const double before = dot(sub(previous, a), normal);
+  const double after = dot(sub(*position, a), normal);
+
+  // Crossed the line this step, within the segment: back to the start side
+  if (before * after < 0.0) {
+    KVector2 hit = add(previous, scale(before / (before - after),
+                                       sub(*position, previous)));
+    double along = dot(sub(hit, a), edge);
+    if (along >= 0.0 && along <= length2) {
+      KVector2 side = before > 0.0 ? normal : scale(-1.0, normal);
+      *position = add(*position, scale(radius - dot(sub(*position, a), side),
+                                       side));
+      bounce(velocity, side);
+      return true;
+    }
+  }
+
+  double t = dot(sub(*position, a), edge) / length2;
+  t = t < 0.0 ? 0.0 : (t > 1.0 ? 1.0 : t);
+  const KVector2 closest = add(a, scale(t, edge));
+  const KVector2 offset = sub(*position, closest);
+  const double distance2 = dot(offset, offset);
+  if (distance2 >= radius * radius)
+    return false;
+
+  double distance = sqrt(distance2);
+  KVector2 direction = distance > 0.0 ? scale(1.0 / distance, offset)
+                       : before < 0.0 ? scale(-1.0, normal)
+                                      : normal;
+  *position = add(closest, scale(radius, direction));
+  bounce(velocity, direction);
+  return true;
+}
+
+static bool collideCircle(const Obstacle *circle, KVector2 *position,
+                          KVector2 *velocity, KVector2 previous,
+                          double radius) {
+  const KVector2 offset = sub(*position, circle->a);
+  const double reach = circle->radius + radius;
+  const double distance2 = dot(offset, offset);
+  if (distance2 >= reach * reach)
+    return false;
+
+  // A particle right at the centre leaves the way it came in
+  KVector2 direction = {0.0, -1.0};
+  KVector2 back = sub(previous, circle->a);
+  if (distance2 > 0.0)
+    direction = scale(1.0 / sqrt(distance2), offset);
+  else if (dot(back, back) > 0.0)
+    direction = scale(1.0 / sqrt(dot(back, back)), back);
+  *position = add(circle->a, scale(reach, direction));
+  bounce(velocity, direction);
+  return true;
+}
+
+static bool collidePolygon(const ObstacleSet *set, const Obstacle *polygon,
+                           KVector2 *position, KVector2 *velocity,
+                           double radius) {
+  const KVector2 *corners = &set->vertices[polygon->first];
+  const KVector2 *normals = &set->normals[polygon->first];
+  const uint32_t count = polygon->count;
+
+  uint32_t face = 0;
+  double separation = -INFINITY;
+  for (uint32_t i = 0; i < count; i++) {
+    double s = dot(sub(*position, corners[i]), normals[i]);
+    if (s > separation) {
+      separation = s;
+      face = i;
+    }
+  }
+  if (separation >= radius)
+    return false;
+
+  // Centre inside: out through the nearest face
+  if (separation <= 0.0) {
+    *position = add(*position, scale(radius - separation, normals[face]));
+    bounce(velocity, normals[face]);
+    return true;
+  }
+
+  // Centre outside but within the radius: the nearest boundary point
+  KVector2 closest = corners[0];
+  double best = INFINITY;
+  for (uint32_t i = 0; i < count; i++) {
+    KVector2 edge = sub(corners[(i + 1) % count], corners[i]);
+    double t = dot(sub(*position, corners[i]), edge) / dot(edge, edge);
+    t = t < 0.0 ? 0.0 : (t > 1.0 ? 1.0 : t);
+    KVector2 point = add(corners[i], scale(t, edge));
+    KVector2 offset = sub(*position, point);
+    if (dot(offset, offset) < best) {
+      best = dot(offset, offset);
+      closest = point;
+    }
+  }
+  if (best >= radius * radius)
+    return false;
+
+  KVector2 direction = scale(1.0 / sqrt(best), sub(*position, closest));
+  *position = add(closest, scale(radius, direction));
+  bounce(velocity, direction);
+  return true;
+}
+
+static uint32_t collideLeaf(const ObstacleSet *set, uint32_t first,
+                            uint32_t count, KVector2 queryMin,
+                            KVector2 queryMax, KVector2 *position,
+                            KVector2 *velocity, KVector2 previous,
+                            double radius) {
+  uint32_t contacts = 0;
+  for (uint32_t o = first; o < first + count; o++) {
+    const Obstacle *obstacle = &set->obstacles[o];
+    if (!overlaps(queryMin, queryMax, obstacle->boundsMin,
+                  obstacle->boundsMax))
+      continue;
+
+    if (obstacle->type == OBSTACLE_SEGMENT)
+      contacts +=
+          collideSegment(obstacle, position, velocity, previous, radius);
+    else if (obstacle->type == OBSTACLE_CIRCLE)
+      contacts += collideCircle(obstacle, position, velocity, previous, radius);
+    else
+      contacts += collidePolygon(set, obstacle, position, velocity, radius);
+  }
+  return contacts;
+}
+
+/*
+ * One particle against the hierarchy. Each node tests its four child boxes
+ * at once into a bit mask, so a level costs one compare block rather than a
+ * branch per child.
+ */
+static uint32_t collideParticle(const ObstacleSet *set, KVector2 *position,
+                                KVector2 *velocity, KVector2 previous,
+                                double radius) {
+  const ObstacleNode *nodes = set->nodes;
+  // The box swept this step, so crossings are found as well as overlaps
+  const KVector2 pad = {radius, radius};
+  const KVector2 queryMin = sub(lower(previous, *position), pad);
+  const KVector2 queryMax = add(upper(previous, *position), pad);
+
+  uint32_t stack[OBSTACLE_STACK_DEPTH];
+  uint32_t top = 0, contacts = 0;
+  stack[top++] = 0;
+  while (top > 0) {
+    const ObstacleNode *node = &nodes[stack[--top]];
+    uint32_t hits = 0;
+    for (uint32_t c = 0; c < OBSTACLE_NODE_WIDTH; c++)
+      hits |= (uint32_t)((node->minX[c] <= queryMax.x) &
+                         (node->maxX[c] >= queryMin.x) &
+                         (node->minY[c] <= queryMax.y) &
+                         (node->maxY[c] >= queryMin.y))
+              << c;
+
+    while (hits) {
+      uint32_t c = (uint32_t)__builtin_ctz(hits);
+      hits &= hits - 1;
+      if (node->count[c] > 0)
+        contacts += collideLeaf(set, node->child[c], node->count[c], queryMin,
+                                queryMax, position, velocity, previous, radius);
+      else
+        stack[top++] = node->child[c];
+    }
+  }
+  return contacts;
+}
+
+typedef struct {
+  Universe *universe;
+  const ObstacleSet *set;
+  ComponentMask required;
+  ComponentMask excluded;
+  const RadiusComponent *radii;
+  DiagnosticsPartials *partials; /* non-NULL: this pass takes the sample */
+  uint64_t contacts[PARALLEL_MAX_THREADS];
+} ObstacleJob;
+
+static void obstacleWords(void *context, uint32_t begin, uint32_t end,
+                          uint32_t chunk) {
+  ObstacleJob *job = (ObstacleJob *)context;
+  Universe *universe = job->universe;
+  uint64_t contacts = 0;
+  DiagnosticsPartial sample;
+  DiagnosticsTerms terms = {0.0, 0.0, {0.0, 0.0}};
+  if (job->partials)
+    sample = job->partials->chunks[chunk];
+
+  for (uint32_t w = begin; w < end; w++) {
+    uint64_t bits =
+        UniverseMatchWord(universe, w, job->required, job->excluded);
+    while (bits) {
+      EntityID i = w * 64 + (EntityID)__builtin_ctzll(bits);
+      bits &= bits - 1;
+
+      KineticBodyComponent *particle = &universe->kineticBodies[i];
+      MechanicsComponent *mechanics = &universe->mechanics[i];
+      const double radius = job->radii ? job->radii[i].radius : 0.0;
+      KVector2 p = particle->position;
+      KVector2 v = mechanics->velocity;
+
+      uint32_t hits =
+          collideParticle(job->set, &p, &v, particle->previous, radius);
+      if (hits) {
+        particle->position = p;
+        mechanics->velocity = v;
+        contacts += hits;
+      }
+      if (job->partials)
+        DiagnosticsAccumulate(&sample, &terms, p, v, particle->inverseMass);
+    }
+    if (job->partials)
+      DiagnosticsFold(&sample, &terms);
+  }
+
+  job->contacts[chunk] += contacts;
+  if (job->partials)
+    job->partials->chunks[chunk] = sample;
+}
+
+void PhysicsResolveObstacleCollisions(Universe *universe) {
+  ObstacleSet *set = universe ? universe->obstacles : NULL;
+  if (!set)
+    return;
+  if (set->dirty)
+    ObstaclesBuild(universe);
+  set->contacts = 0;
+  if (set->nodeCount == 0)
+    return;
+
+  // Both passes split the words the same way, so they share the partials
+  DiagnosticsPartials partials;
+  DiagnosticsPartials *sample = NULL;
+  if (universe->diagnostics.enabled) {
+    DiagnosticsBegin(&partials);
+    sample = &partials;
+  }
+
+  // Entities without a radius collide as points, as at the walls
+  const ComponentMask required = COMPONENT_PARTICLE | COMPONENT_MECHANICS;
+  ObstacleJob job = {universe, set, required | COMPONENT_RADIUS,
+                     COMPONENT_NONE, universe->radii, sample, {0}};
+  const uint32_t words = BITSET_WORDS(universe->maxEntities);
+  ParallelFor(words, PARALLEL_GRAIN_SLOTS / 64, obstacleWords, &job);
+  job.required = required;
+  job.excluded = COMPONENT_RADIUS;
+  job.radii = NULL;
+  ParallelFor(words, PARALLEL_GRAIN_SLOTS / 64, obstacleWords, &job);
+
+  for (uint32_t c = 0; c < PARALLEL_MAX_THREADS; c++)
+    set->contacts += job.contacts[c];
+  if (sample)
+    DiagnosticsCommit(universe, sample);
+}
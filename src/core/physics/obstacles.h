@@ -0,0 +1,103 @@
+/**
+ * obstacles.h
+ *
+ * Static collision geometry for particles: line segments, circles and
+ * convex polygons that never move. They are registered on the universe and
+ * kept in a four-wide bounding volume hierarchy, flattened into one
+ * depth-first array of nodes. A node stores the boxes of its four children
+ * side by side, so one block of compares tests them all. Leaf children
+ * point at a contiguous run of obstacles, which are stored in leaf order.
+ *
+ * The hierarchy is built once, on the first collision pass after obstacles
+ * were added (or by an explicit ObstaclesBuild). Each step,
+ * PhysicsResolveObstacleCollisions runs one parallel pass over the
+ * particles. Every particle walks the tree with the box its motion swept
+ * this step, so a particle far from all geometry costs a single box test.
+ *
+ * Particles with a RadiusComponent collide as discs, the rest as points.
+ * Segments are two-sided and infinitely thin. A particle whose motion
+ * crossed a segment is put back on the side it came from, so fast particles
+ * do not tunnel. Circles and polygons are solid, and overlapping particles
+ * are pushed out through the nearest surface. The velocity towards the
+ * surface is reflected with RESTITUTION, as at the universe walls.
+ */
+#ifndef PHYSICS_OBSTACLES_H
+#define PHYSICS_OBSTACLES_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "../universe.h"
+
+typedef enum {
+  OBSTACLE_SEGMENT = 0,
+  OBSTACLE_CIRCLE,
+  OBSTACLE_POLYGON
+} ObstacleType;
+
+typedef struct {
+  uint32_t type;  /* ObstacleType */
+  uint32_t first; /* polygons: first vertex in the shared arrays */
+  uint32_t count; /* polygons: vertex count */
+  double radius;  /* circles */
+  KVector2 a;     /* segment start, circle centre */
+  KVector2 b;     /* segment end */
+  KVector2 boundsMin;
+  KVector2 boundsMax;
+} Obstacle;
+
+/* Up to OBSTACLE_NODE_WIDTH children, their boxes stored coordinate-wise */
+typedef struct {
+  double minX[OBSTACLE_NODE_WIDTH];
+  double minY[OBSTACLE_NODE_WIDTH];
+  double maxX[OBSTACLE_NODE_WIDTH];
+  double maxY[OBSTACLE_NODE_WIDTH];
+  uint32_t child[OBSTACLE_NODE_WIDTH]; /* node, or first obstacle of a leaf */
+  uint32_t count[OBSTACLE_NODE_WIDTH]; /* leaf obstacles; 0 for nodes */
+} ObstacleNode;
+
+/**
+ * Obstacles, their polygon vertices and the hierarchy, carved from the
+ * universe allocator in one block by ObstaclesEnable.
+ */
+typedef struct ObstacleSet {
+  uint32_t capacity;
+  uint32_t vertexCapacity;
+  uint32_t count;
+  uint32_t vertexCount;
+  uint32_t nodeCount; /* 0 until the hierarchy is built; the root is 0 */
+  uint32_t depth;     /* node levels in the hierarchy */
+  bool dirty;         /* obstacles added since the last build */
+  Obstacle *obstacles;
+  KVector2 *vertices; /* polygon corners, counter-clockwise */
+  KVector2 *normals;  /* outward normal of the edge starting at each corner */
+  ObstacleNode *nodes;
+  uint64_t contacts; /* particle-obstacle contacts resolved by the last pass */
+} ObstacleSet;
+
+/**
+ * Carves room for `maxObstacles` obstacles with `maxVertices` polygon
+ * corners between them. Calling it again keeps the existing set.
+ */
+bool ObstaclesEnable(Universe *universe, uint32_t maxObstacles,
+                     uint32_t maxVertices);
+
+/**
+ * Obstacle constructors. Polygons take their corners in either winding and
+ * must be convex. They fail on degenerate input or when the set is full.
+ */
+bool ObstacleAddSegment(Universe *universe, KVector2 a, KVector2 b);
+bool ObstacleAddCircle(Universe *universe, KVector2 centre, double radius);
+bool ObstacleAddPolygon(Universe *universe, const KVector2 *vertices,
+                        uint32_t count);
+
+/**
+ * Builds the hierarchy now instead of on the next collision pass. This
+ * reorders the obstacles into leaf order.
+ */
+bool ObstaclesBuild(Universe *universe);
+
+/* Pushes particles out of the obstacles; called by UniverseUpdate */
+void PhysicsResolveObstacleCollisions(Universe *universe);
+
+#endif /* PHYSICS_OBSTACLES_H */
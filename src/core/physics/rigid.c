@@ -0,0 +1,1050 @@
+#include "rigid.h"
+
+#include <float.h>
+#include <math.h>
+#include <stdlib.h>
+
+#include "../parallel.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+/* Bodies or pairs handed to one worker at a time */
+#define RIGID_GRAIN 256
+
+/* Wall keys sit above every EntityID, one per wall */
+#define RIGID_WALL_KEY 0xFFFFFFFCu
+enum { WALL_LEFT, WALL_RIGHT, WALL_TOP, WALL_BOTTOM, WALL_COUNT };
+
+RigidSettings RigidDefaultSettings(void) {
+  RigidSettings settings;
+  settings.maxBodies = RIGID_MAX_BODIES;
+  settings.iterations = RIGID_ITERATIONS;
+  settings.gravity = (KVector2){RIGID_GRAVITY_X, RIGID_GRAVITY_Y};
+  settings.baumgarte = RIGID_BAUMGARTE;
+  settings.slop = RIGID_SLOP;
+  return settings;
+}
+
+/* Inline vector helpers; the solver loops call them millions of times */
+static inline KVector2 add(KVector2 a, KVector2 b) {
+  return (KVector2){a.x + b.x, a.y + b.y};
+}
+static inline KVector2 sub(KVector2 a, KVector2 b) {
+  return (KVector2){a.x - b.x, a.y - b.y};
+}
+static inline KVector2 scale(double s, KVector2 v) {
+  return (KVector2){s * v.x, s * v.y};
+}
+static inline KVector2 negate(KVector2 v) { return (KVector2){-v.x, -v.y}; }
+static inline double dot(KVector2 a, KVector2 b) {
+  return a.x * b.x + a.y * b.y;
+}
+static inline double cross(KVector2 a, KVector2 b) {
+  return a.x * b.y - a.y * b.x;
+}
+/* w x r for an angular velocity w about z */
+static inline KVector2 crossScalar(double w, KVector2 r) {
+  return (KVector2){-w * r.y, w * r.x};
+}
+static inline KVector2 rotate(KVector2 rotation, KVector2 v) {
+  return (KVector2){rotation.x * v.x - rotation.y * v.y,
+                    rotation.y * v.x + rotation.x * v.y};
+}
+
+KQuaternion RigidOrientation(double angle) {
+  return KQuaternionFromAxisAngle((KVector3){0.0, 0.0, 1.0}, angle);
+}
+
+double RigidAngle(KQuaternion orientation) {
+  return 2.0 * atan2(orientation.z, orientation.w);
+}
+
+static size_t alignUp(size_t bytes) {
+  return (bytes + COLUMN_ALIGNMENT - 1) & ~(size_t)(COLUMN_ALIGNMENT - 1);
+}
+
+/* Everything in one block, so UniverseDestroy releases it in one go */
+static RigidSolver *createSolver(Universe *universe, uint32_t maxBodies) {
+  const uint32_t pairCapacity = maxBodies * RIGID_PAIRS_PER_BODY;
+
+  size_t header = alignUp(sizeof(RigidSolver));
+  size_t indices = alignUp((size_t)maxBodies * sizeof(uint32_t));
+  size_t velocities = alignUp(((size_t)maxBodies + 1) * sizeof(RigidVelocity));
+  size_t vectors = alignUp((size_t)maxBodies * sizeof(KVector2));
+  size_t corners =
+      alignUp((size_t)maxBodies * RIGID_MAX_VERTICES * sizeof(KVector2));
+  size_t sweep = alignUp((size_t)maxBodies * sizeof(RigidSweepKey));
+  size_t pairs = alignUp((size_t)pairCapacity * sizeof(RigidPair));
+  size_t manifolds = alignUp((size_t)pairCapacity * sizeof(RigidManifold));
+  size_t bytes = header + 2 * indices + velocities + 4 * vectors +
+                 2 * corners + sweep + pairs + 2 * manifolds;
+
+  unsigned char *block = (unsigned char *)UniverseAllocate(
+      universe, K_MEMORY_RIGID, bytes, COLUMN_ALIGNMENT);
+  if (!block)
+    return NULL;
+
+  RigidSolver *rigid = (RigidSolver *)block;
+  unsigned char *cursor = block + header;
+  *rigid = (RigidSolver){0};
+  rigid->pairCapacity = pairCapacity;
+  rigid->slots = (uint32_t *)cursor;
+  rigid->entities = (EntityID *)(cursor += indices);
+  rigid->velocities = (RigidVelocity *)(cursor += indices);
+  rigid->positions = (KVector2 *)(cursor += velocities);
+  rigid->rotations = (KVector2 *)(cursor += vectors);
+  rigid->boundsMin = (KVector2 *)(cursor += vectors);
+  rigid->boundsMax = (KVector2 *)(cursor += vectors);
+  rigid->worldVertices = (KVector2 *)(cursor += vectors);
+  rigid->worldNormals = (KVector2 *)(cursor += corners);
+  rigid->sweep = (RigidSweepKey *)(cursor += corners);
+  rigid->pairs = (RigidPair *)(cursor += sweep);
+  rigid->manifolds = (RigidManifold *)(cursor += pairs);
+  rigid->previous = (RigidManifold *)(cursor += manifolds);
+  return rigid;
+}
+
+bool RigidEnable(Universe *universe, const RigidSettings *settings) {
+  if (!universe)
+    return false;
+
+  RigidSettings chosen = settings ? *settings : RigidDefaultSettings();
+  if (chosen.maxBodies == 0 || !(chosen.slop >= 0.0) ||
+      !(chosen.baumgarte >= 0.0))
+    return false;
+
+  if (universe->rigidBodyComponent == INVALID_COMPONENT)
+    universe->rigidBodyComponent = UniverseRegisterComponent(
+        universe, sizeof(RigidBodyComponent), _Alignof(RigidBodyComponent));
+  if (universe->rigidShapeComponent == INVALID_COMPONENT)
+    universe->rigidShapeComponent = UniverseRegisterComponent(
+        universe, sizeof(RigidShapeComponent), _Alignof(RigidShapeComponent));
+  if (universe->rigidBodyComponent == INVALID_COMPONENT ||
+      universe->rigidShapeComponent == INVALID_COMPONENT)
+    return false;
+
+  if (!universe->rigid)
+    universe->rigid = createSolver(universe, chosen.maxBodies);
+  if (!universe->rigid)
+    return false;
+
+  chosen.maxBodies = universe->rigid->pairCapacity / RIGID_PAIRS_PER_BODY;
+  universe->rigid->settings = chosen;
+  return true;
+}
+
+static EntityID createBody(Universe *universe, KVector2 position,
+                           double angle, const RigidShapeComponent *shape,
+                           double mass, double inertia) {
+  EntityID entity = UniverseCreateEntity(universe);
+  if (entity == INVALID_ENTITY)
+    return INVALID_ENTITY;
+
+  RigidBodyComponent body;
+  body.position = position;
+  body.orientation = RigidOrientation(angle);
+  body.velocity = (KVector2){0.0, 0.0};
+  body.angularVelocity = 0.0;
+  body.inverseMass = mass > 0.0 ? 1.0 / mass : 0.0;
+  body.inverseInertia = inertia > 0.0 ? 1.0 / inertia : 0.0;
+
+  if (!UniverseAddComponent(universe, entity, universe->rigidBodyComponent,
+                            &body) ||
+      !UniverseAddComponent(universe, entity, universe->rigidShapeComponent,
+                            shape)) {
+    UniverseDestroyEntity(universe, entity);
+    return INVALID_ENTITY;
+  }
+  return entity;
+}
+
+EntityID RigidCircleCreate(Universe *universe, KVector2 position,
+                           double radius, double density) {
+  if (!universe || !universe->rigid || !(radius > 0.0) || !(density >= 0.0))
+    return INVALID_ENTITY;
+
+  RigidShapeComponent shape = {0};
+  shape.type = RIGID_CIRCLE;
+  shape.radius = radius;
+  shape.friction = RIGID_FRICTION;
+  shape.restitution = RIGID_RESTITUTION;
+
+  double mass = density * M_PI * radius * radius;
+  return createBody(universe, position, 0.0, &shape, mass,
+                    0.5 * mass * radius * radius);
+}
+
+EntityID RigidBoxCreate(Universe *universe, KVector2 position,
+                        KVector2 halfExtents, double angle, double density) {
+  const KVector2 corners[4] = {{-halfExtents.x, -halfExtents.y},
+                               {halfExtents.x, -halfExtents.y},
+                               {halfExtents.x, halfExtents.y},
+                               {-halfExtents.x, halfExtents.y}};
+  return RigidPolygonCreate(universe, position, corners, 4, angle, density);
+}
+
+static int compareVertices(const void *a, const void *b) {
+  const KVector2 *u = (const KVector2 *)a;
+  const KVector2 *v = (const KVector2 *)b;
+  if (u->x != v->x)
+    return u->x < v->x ? -1 : 1;
+  return (u->y > v->y) - (u->y < v->y);
+}
+
+/* Andrew's monotone chain; counter-clockwise, collinear points dropped */
+static uint32_t convexHull(const KVector2 *points, uint32_t count,
+                           KVector2 *hull) {
+  KVector2 sorted[RIGID_MAX_VERTICES];
+  KVector2 chain[2 * RIGID_MAX_VERTICES];
+  for (uint32_t i = 0; i < count; i++)
+    sorted[i] = points[i];
+  qsort(sorted, count, sizeof(KVector2), compareVertices);
+
+  uint32_t k = 0;
+  for (uint32_t i = 0; i < count; i++) {
+    while (k >= 2 && cross(sub(chain[k - 1], chain[k - 2]),
+                           sub(sorted[i], chain[k - 2])) <= 0.0)
+      k--;
+    chain[k++] = sorted[i];
+  }
+  for (uint32_t i = count - 1, lower = k + 1; i-- > 0;) {
+    while (k >= lower && cross(sub(chain[k - 1], chain[k - 2]),
+                               sub(sorted[i], chain[k - 2])) <= 0.0)
+      k--;
+    chain[k++] = sorted[i];
+  }
+
+  // The chain ends where it started
+  uint32_t size = k > 0 ? k - 1 : 0;
+  for (uint32_t i = 0; i < size; i++)
+    hull[i] = chain[i];
+  return size;
+}
+
+EntityID RigidPolygonCreate(Universe *universe, KVector2 position,
+                            const KVector2 *vertices, uint32_t count,
+                            double angle, double density) {
+  if (!universe || !universe->rigid || !vertices || count < 3 ||
+      count > RIGID_MAX_VERTICES || !(density >= 0.0))
+    return INVALID_ENTITY;
+
+  KVector2 hull[RIGID_MAX_VERTICES];
+  uint32_t size = convexHull(vertices, count, hull);
+  if (size < 3)
+    return INVALID_ENTITY;
+
+  // Triangle fan about the first vertex, which keeps the sums well scaled
+  const KVector2 origin = hull[0];
+  double area = 0.0, inertia = 0.0;
+  KVector2 centroid = {0.0, 0.0};
+  for (uint32_t i = 1; i + 1 < size; i++) {
+    KVector2 e1 = sub(hull[i], origin);
+    KVector2 e2 = sub(hull[i + 1], origin);
+    double twiceArea = cross(e1, e2);
+    area += 0.5 * twiceArea;
+    centroid.x += twiceArea * (e1.x + e2.x) / 6.0;
+    centroid.y += twiceArea * (e1.y + e2.y) / 6.0;
+    double xx = e1.x * e1.x + e1.x * e2.x + e2.x * e2.x;
+    double yy = e1.y * e1.y + e1.y * e2.y + e2.y * e2.y;
+    inertia += twiceArea * (xx + yy) / 12.0;
+  }
+  if (!(area > DBL_EPSILON))
+    return INVALID_ENTITY;
+  centroid = scale(1.0 / area, centroid);
+
+  RigidShapeComponent shape = {0};
+  shape.type = RIGID_POLYGON;
+  shape.count = size;
+  shape.friction = RIGID_FRICTION;
+  shape.restitution = RIGID_RESTITUTION;
+  for (uint32_t i = 0; i < size; i++)
+    shape.vertices[i] = sub(sub(hull[i], origin), centroid);
+  for (uint32_t i = 0; i < size; i++) {
+    KVector2 edge = sub(shape.vertices[(i + 1) % size], shape.vertices[i]);
+    shape.normals[i] = KVector2Unit((KVector2){edge.y, -edge.x});
+  }
+
+  // Parallel axis theorem moves the inertia from the fan origin to the centroid
+  double mass = density * area;
+  inertia = density * inertia - mass * dot(centroid, centroid);
+
+  KVector2 rotation = {cos(angle), sin(angle)};
+  KVector2 offset = rotate(rotation, add(origin, centroid));
+  return createBody(universe, add(position, offset), angle, &shape, mass,
+                    inertia);
+}
+
+RigidBodyComponent *RigidGetBody(Universe *universe, EntityID entity) {
+  if (!universe)
+    return NULL;
+  return (RigidBodyComponent *)UniverseGetComponent(
+      universe, entity, universe->rigidBodyComponent);
+}
+
+RigidShapeComponent *RigidGetShape(Universe *universe, EntityID entity) {
+  if (!universe)
+    return NULL;
+  return (RigidShapeComponent *)UniverseGetComponent(
+      universe, entity, universe->rigidShapeComponent);
+}
+
+typedef struct {
+  Universe *universe;
+  RigidSolver *rigid;
+  RigidBodyComponent *bodies;
+  const RigidShapeComponent *shapes;
+  double deltaTime;
+} RigidJob;
+
+/* Dense solver state in bitset order; the walls follow the bodies */
+static uint32_t gatherBodies(Universe *universe, RigidSolver *rigid,
+                             const RigidBodyComponent *bodies) {
+  const ComponentMask required = COMPONENT_BIT(universe->rigidBodyComponent) |
+                                 COMPONENT_BIT(universe->rigidShapeComponent);
+  const uint32_t capacity = rigid->settings.maxBodies;
+
+  uint32_t count = 0, dropped = 0;
+  for (uint32_t w = 0; w < BITSET_WORDS(universe->maxEntities); w++) {
+    uint64_t bits = UniverseMatchWord(universe, w, required, COMPONENT_NONE);
+    while (bits) {
+      uint32_t slot = w * 64 + (uint32_t)__builtin_ctzll(bits);
+      bits &= bits - 1;
+      if (count == capacity) {
+        dropped++;
+        continue;
+      }
+
+      const RigidBodyComponent *body = &bodies[slot];
+      rigid->slots[count] = slot;
+      rigid->entities[count] = UniverseSlotEntity(universe, slot);
+      rigid->velocities[count] =
+          (RigidVelocity){body->velocity, body->angularVelocity,
+                          body->inverseMass, body->inverseInertia};
+      count++;
+    }
+  }
+  rigid->velocities[count] = (RigidVelocity){{0.0, 0.0}, 0.0, 0.0, 0.0};
+  rigid->bodyCount = count;
+  rigid->droppedBodies = dropped;
+  return count;
+}
+
+/* World geometry and bounds per body, then gravity on the dynamic ones */
+static void prepareRange(void *context, uint32_t begin, uint32_t end,
+                         uint32_t chunk) {
+  (void)chunk;
+  const RigidJob *job = (const RigidJob *)context;
+  RigidSolver *rigid = job->rigid;
+  const double margin = rigid->settings.slop;
+  const KVector2 gravity = scale(job->deltaTime, rigid->settings.gravity);
+
+  for (uint32_t i = begin; i < end; i++) {
+    const RigidBodyComponent *body = &job->bodies[rigid->slots[i]];
+    const RigidShapeComponent *shape = &job->shapes[rigid->slots[i]];
+    Matrix3x3 matrix = KQuaternionToMatrix3(body->orientation);
+    KVector2 rotation = {matrix.m[0][0], matrix.m[1][0]};
+    KVector2 p = body->position;
+    rigid->positions[i] = p;
+    rigid->rotations[i] = rotation;
+
+    KVector2 lo = p, hi = p;
+    if (shape->type == RIGID_CIRCLE) {
+      lo = (KVector2){p.x - shape->radius, p.y - shape->radius};
+      hi = (KVector2){p.x + shape->radius, p.y + shape->radius};
+    } else {
+      KVector2 *vertices = &rigid->worldVertices[i * RIGID_MAX_VERTICES];
+      KVector2 *normals = &rigid->worldNormals[i * RIGID_MAX_VERTICES];
+      lo = (KVector2){DBL_MAX, DBL_MAX};
+      hi = (KVector2){-DBL_MAX, -DBL_MAX};
+      for (uint32_t k = 0; k < shape->count; k++) {
+        KVector2 v = add(p, rotate(rotation, shape->vertices[k]));
+        vertices[k] = v;
+        normals[k] = rotate(rotation, shape->normals[k]);
+        lo.x = v.x < lo.x ? v.x : lo.x;
+        lo.y = v.y < lo.y ? v.y : lo.y;
+        hi.x = v.x > hi.x ? v.x : hi.x;
+        hi.y = v.y > hi.y ? v.y : hi.y;
+      }
+    }
+    // Speculative margin, so contacts exist a little before they touch
+    rigid->boundsMin[i] = (KVector2){lo.x - margin, lo.y - margin};
+    rigid->boundsMax[i] = (KVector2){hi.x + margin, hi.y + margin};
+
+    RigidVelocity *velocity = &rigid->velocities[i];
+    if (velocity->inverseMass > 0.0)
+      velocity->velocity = add(velocity->velocity, gravity);
+  }
+}
+
+static int compareSweep(const void *a, const void *b) {
+  const RigidSweepKey *u = (const RigidSweepKey *)a;
+  const RigidSweepKey *v = (const RigidSweepKey *)b;
+  if (u->minX != v->minX)
+    return u->minX < v->minX ? -1 : 1;
+  return (u->body > v->body) - (u->body < v->body);
+}
+
+static int comparePairs(const void *a, const void *b) {
+  uint64_t u = ((const RigidPair *)a)->key;
+  uint64_t v = ((const RigidPair *)b)->key;
+  return (u > v) - (u < v);
+}
+
+static void addPair(RigidSolver *rigid, uint64_t key, uint32_t a, uint32_t b) {
+  if (rigid->pairCount == rigid->pairCapacity) {
+    rigid->droppedPairs++;
+    return;
+  }
+  rigid->pairs[rigid->pairCount++] = (RigidPair){key, a, b};
+}
+
+/*
+ * Bodies move little between steps, so last step's sweep order is almost
+ * sorted already and an insertion sort puts it right in close to linear time.
+ * A change in the body count starts over from a full sort.
+ */
+static void sortSweep(RigidSolver *rigid) {
+  const uint32_t count = rigid->bodyCount;
+  RigidSweepKey *sweep = rigid->sweep;
+
+  if (rigid->sweepCount != count) {
+    for (uint32_t i = 0; i < count; i++)
+      sweep[i].body = i;
+  }
+  for (uint32_t s = 0; s < count; s++) {
+    const uint32_t i = sweep[s].body;
+    sweep[s] = (RigidSweepKey){rigid->boundsMin[i].x, rigid->boundsMax[i].x,
+                               rigid->boundsMin[i].y, rigid->boundsMax[i].y, i};
+  }
+  if (rigid->sweepCount != count) {
+    KSort(sweep, count, sizeof(RigidSweepKey), compareSweep);
+    rigid->sweepCount = count;
+    return;
+  }
+
+  for (uint32_t s = 1; s < count; s++) {
+    const RigidSweepKey key = sweep[s];
+    uint32_t t = s;
+    for (; t > 0 && compareSweep(&sweep[t - 1], &key) > 0; t--)
+      sweep[t] = sweep[t - 1];
+    sweep[t] = key;
+  }
+}
+
+/* Sweep and prune along x, then the walls; sorted by key at the end */
+static void findPairs(Universe *universe, RigidSolver *rigid) {
+  const uint32_t count = rigid->bodyCount;
+  const RigidVelocity *velocities = rigid->velocities;
+  const RigidSweepKey *sweep = rigid->sweep;
+
+  rigid->pairCount = 0;
+  rigid->droppedPairs = 0;
+  sortSweep(rigid);
+
+  for (uint32_t s = 0; s < count; s++) {
+    const RigidSweepKey key = sweep[s];
+    const uint32_t i = key.body;
+    const bool fixed = velocities[i].inverseMass <= 0.0;
+
+    for (uint32_t t = s + 1; t < count && sweep[t].minX <= key.maxX; t++) {
+      if (sweep[t].minY > key.maxY || sweep[t].maxY < key.minY)
+        continue;
+      const uint32_t j = sweep[t].body;
+      if (fixed && velocities[j].inverseMass <= 0.0)
+        continue;
+
+      // The lower entity is body a, so keys do not depend on dense order
+      uint32_t a = rigid->entities[i] < rigid->entities[j] ? i : j;
+      uint32_t b = a == i ? j : i;
+      addPair(rigid,
+              (uint64_t)rigid->entities[a] << 32 | rigid->entities[b], a, b);
+    }
+  }
+
+  const UniverseBoundary walls = universe->boundary;
+  if (walls.enabled) {
+    for (uint32_t i = 0; i < count; i++) {
+      if (velocities[i].inverseMass <= 0.0)
+        continue;
+
+      const KVector2 lo = rigid->boundsMin[i], hi = rigid->boundsMax[i];
+      const bool touches[WALL_COUNT] = {lo.x < walls.left, hi.x > walls.right,
+                                        lo.y < walls.top, hi.y > walls.bottom};
+      for (uint32_t w = 0; w < WALL_COUNT; w++)
+        if (touches[w])
+          addPair(rigid,
+                  (uint64_t)rigid->entities[i] << 32 | (RIGID_WALL_KEY + w), i,
+                  count);
+    }
+  }
+
+  KSort(rigid->pairs, rigid->pairCount, sizeof(RigidPair), comparePairs);
+}
+
+static void addPoint(const RigidSolver *rigid, RigidManifold *manifold,
+                     KVector2 point, double separation, uint32_t feature) {
+  RigidContactPoint *contact = &manifold->points[manifold->count++];
+  contact->anchorA = sub(point, rigid->positions[manifold->a]);
+  contact->anchorB = manifold->b < rigid->bodyCount
+                         ? sub(point, rigid->positions[manifold->b])
+                         : (KVector2){0.0, 0.0};
+  contact->separation = separation;
+  contact->normalImpulse = 0.0;
+  contact->tangentImpulse = 0.0;
+  contact->feature = feature;
+}
+
+static void collideCircles(const RigidSolver *rigid, RigidManifold *manifold,
+                           double radiusA, double radiusB, double margin) {
+  KVector2 pa = rigid->positions[manifold->a];
+  KVector2 d = sub(rigid->positions[manifold->b], pa);
+  double distance = KVector2Norm(d);
+  double separation = distance - radiusA - radiusB;
+  if (separation > margin)
+    return;
+
+  manifold->normal = distance > DBL_EPSILON
+                         ? scale(1.0 / distance, d)
+                         : (KVector2){0.0, 1.0};
+  KVector2 point = add(pa, scale(radiusA + 0.5 * separation, manifold->normal));
+  addPoint(rigid, manifold, point, separation, 0);
+}
+
+/*
+ * Polygon `polygon` against a circle. The normal points from the polygon to
+ * the circle; `flip` turns it around when the circle is body a.
+ */
+static void collidePolygonCircle(const RigidSolver *rigid,
+                                 RigidManifold *manifold, uint32_t polygon,
+                                 uint32_t vertexCount, uint32_t circle,
+                                 double radius, double margin, bool flip) {
+  const KVector2 *vertices =
+      &rigid->worldVertices[polygon * RIGID_MAX_VERTICES];
+  const KVector2 *normals = &rigid->worldNormals[polygon * RIGID_MAX_VERTICES];
+  const KVector2 centre = rigid->positions[circle];
+
+  uint32_t face = 0;
+  double best = -DBL_MAX;
+  for (uint32_t i = 0; i < vertexCount; i++) {
+    double s = dot(normals[i], sub(centre, vertices[i]));
+    if (s > best) {
+      best = s;
+      face = i;
+    }
+  }
+  if (best > radius + margin)
+    return;
+
+  // Face region, or the Voronoi region of one of its vertices
+  KVector2 v1 = vertices[face], v2 = vertices[(face + 1) % vertexCount];
+  KVector2 normal = normals[face], surface;
+  double separation = best - radius;
+  uint32_t feature = face;
+  if (best > 0.0 && dot(sub(centre, v1), sub(v2, v1)) < 0.0) {
+    surface = v1;
+  } else if (best > 0.0 && dot(sub(centre, v2), sub(v1, v2)) < 0.0) {
+    surface = v2;
+    feature = (face + 1) % vertexCount;
+  } else {
+    surface = sub(centre, scale(best, normal));
+    feature |= 0x80u;
+  }
+  if (!(feature & 0x80u)) {
+    KVector2 d = sub(centre, surface);
+    double distance = KVector2Norm(d);
+    separation = distance - radius;
+    if (separation > margin || !(distance > DBL_EPSILON))
+      return;
+    normal = scale(1.0 / distance, d);
+  }
+
+  KVector2 rim = sub(centre, scale(radius, normal));
+  KVector2 point = scale(0.5, add(surface, rim));
+  manifold->normal = flip ? negate(normal) : normal;
+  addPoint(rigid, manifold, point, separation, feature);
+}
+
+/* Largest separation along a face normal of `a`, and that face */
+static double maxSeparation(const RigidSolver *rigid, uint32_t a,
+                            uint32_t countA, uint32_t b, uint32_t countB,
+                            uint32_t *face) {
+  const KVector2 *va = &rigid->worldVertices[a * RIGID_MAX_VERTICES];
+  const KVector2 *na = &rigid->worldNormals[a * RIGID_MAX_VERTICES];
+  const KVector2 *vb = &rigid->worldVertices[b * RIGID_MAX_VERTICES];
+
+  double best = -DBL_MAX;
+  for (uint32_t i = 0; i < countA; i++) {
+    double deepest = DBL_MAX;
+    for (uint32_t j = 0; j < countB; j++) {
+      double s = dot(na[i], sub(vb[j], va[i]));
+      deepest = s < deepest ? s : deepest;
+    }
+    if (deepest > best) {
+      best = deepest;
+      *face = i;
+    }
+  }
+  return best;
+}
+
+typedef struct {
+  KVector2 point;
+  uint32_t feature;
+} ClipVertex;
+
+/*
+ * Keeps the part of the segment with dot(normal, p) <= offset. A clipped end
+ * stays in its place, so point k always comes from end k of the incident
+ * edge and keeps its feature whether or not it was clipped this step.
+ */
+static bool clipSegment(const ClipVertex in[2], ClipVertex out[2],
+                        KVector2 normal, double offset) {
+  double d0 = dot(normal, in[0].point) - offset;
+  double d1 = dot(normal, in[1].point) - offset;
+  if (d0 > 0.0 && d1 > 0.0)
+    return false;
+
+  out[0] = in[0];
+  out[1] = in[1];
+  if (d0 * d1 < 0.0) {
+    double t = d0 / (d0 - d1);
+    KVector2 cut = add(in[0].point, scale(t, sub(in[1].point, in[0].point)));
+    out[d0 > 0.0 ? 0 : 1].point = cut;
+  }
+  return true;
+}
+
+/*
+ * Separating axis test, then the incident edge of one polygon clipped
+ * against the side planes of the reference face of the other. Features pack
+ * the reference face, the incident edge and which end of it the point came
+ * from, so a resting contact keeps its ids from step to step.
+ */
+static void collidePolygons(const RigidSolver *rigid, RigidManifold *manifold,
+                            uint32_t countA, uint32_t countB, double margin) {
+  const uint32_t a = manifold->a, b = manifold->b;
+  uint32_t faceA = 0, faceB = 0;
+  double separationA = maxSeparation(rigid, a, countA, b, countB, &faceA);
+  if (separationA > margin)
+    return;
+  double separationB = maxSeparation(rigid, b, countB, a, countA, &faceB);
+  if (separationB > margin)
+    return;
+
+  // Prefer a's face unless b's is clearly better, so the choice is stable
+  uint32_t reference = a, incident = b, face = faceA;
+  uint32_t referenceCount = countA, incidentCount = countB;
+  bool flip = false;
+  if (separationB > separationA + 0.1 * margin + DBL_EPSILON) {
+    reference = b;
+    incident = a;
+    face = faceB;
+    referenceCount = countB;
+    incidentCount = countA;
+    flip = true;
+  }
+
+  const KVector2 *rv = &rigid->worldVertices[reference * RIGID_MAX_VERTICES];
+  const KVector2 *iv = &rigid->worldVertices[incident * RIGID_MAX_VERTICES];
+  const KVector2 *in = &rigid->worldNormals[incident * RIGID_MAX_VERTICES];
+  const KVector2 normal =
+      rigid->worldNormals[reference * RIGID_MAX_VERTICES + face];
+
+  uint32_t edge = 0;
+  double most = DBL_MAX;
+  for (uint32_t i = 0; i < incidentCount; i++) {
+    double d = dot(normal, in[i]);
+    if (d < most) {
+      most = d;
+      edge = i;
+    }
+  }
+
+  const uint32_t next = (edge + 1) % incidentCount;
+  const uint32_t base = (flip ? 1u : 0u) << 16 | face << 8 | edge;
+  ClipVertex incidentEdge[2] = {{iv[edge], base << 1},
+                                {iv[next], base << 1 | 1u}};
+
+  const KVector2 v1 = rv[face], v2 = rv[(face + 1) % referenceCount];
+  const KVector2 tangent = KVector2Unit(sub(v2, v1));
+  ClipVertex clipped[2], points[2];
+  if (!clipSegment(incidentEdge, clipped, negate(tangent), -dot(tangent, v1)) ||
+      !clipSegment(clipped, points, tangent, dot(tangent, v2)))
+    return;
+
+  manifold->normal = flip ? negate(normal) : normal;
+  for (uint32_t k = 0; k < 2; k++) {
+    double separation = dot(normal, sub(points[k].point, v1));
+    if (separation > margin)
+      continue;
+    // Halfway between the incident point and the reference face
+    KVector2 point = sub(points[k].point, scale(0.5 * separation, normal));
+    addPoint(rigid, manifold, point, separation, points[k].feature);
+  }
+}
+
+/* The deepest one or two points past a wall; the normal points into it */
+static void collideWall(const RigidSolver *rigid, RigidManifold *manifold,
+                        const RigidShapeComponent *shape,
+                        const UniverseBoundary *walls, uint32_t wall,
+                        double margin) {
+  static const KVector2 normals[WALL_COUNT] = {
+      {-1.0, 0.0}, {1.0, 0.0}, {0.0, -1.0}, {0.0, 1.0}};
+  const KVector2 normal = normals[wall];
+  const double offset[WALL_COUNT] = {-walls->left, walls->right, -walls->top,
+                                     walls->bottom};
+  const uint32_t a = manifold->a;
+  manifold->normal = normal;
+
+  if (shape->type == RIGID_CIRCLE) {
+    KVector2 centre = rigid->positions[a];
+    double separation = offset[wall] - dot(normal, centre) - shape->radius;
+    if (separation <= margin)
+      addPoint(rigid, manifold,
+               add(centre, scale(shape->radius + 0.5 * separation, normal)),
+               separation, 0);
+    return;
+  }
+
+  const KVector2 *vertices = &rigid->worldVertices[a * RIGID_MAX_VERTICES];
+  uint32_t first = UINT32_MAX, second = UINT32_MAX;
+  double deepest = DBL_MAX, nextDeepest = DBL_MAX;
+  for (uint32_t k = 0; k < shape->count; k++) {
+    double s = offset[wall] - dot(normal, vertices[k]);
+    if (s < deepest) {
+      second = first;
+      nextDeepest = deepest;
+      first = k;
+      deepest = s;
+    } else if (s < nextDeepest) {
+      second = k;
+      nextDeepest = s;
+    }
+  }
+
+  // In vertex order, so the points keep their slots from step to step
+  uint32_t chosen[2] = {first < second ? first : second,
+                        first < second ? second : first};
+  double separations[2] = {first < second ? deepest : nextDeepest,
+                           first < second ? nextDeepest : deepest};
+  for (uint32_t k = 0; k < 2; k++) {
+    if (chosen[k] == UINT32_MAX || separations[k] > margin)
+      continue;
+    KVector2 point =
+        add(vertices[chosen[k]], scale(0.5 * separations[k], normal));
+    addPoint(rigid, manifold, point, separations[k], chosen[k]);
+  }
+}
+
+static void narrowRange(void *context, uint32_t begin, uint32_t end,
+                        uint32_t chunk) {
+  (void)chunk;
+  const RigidJob *job = (const RigidJob *)context;
+  const RigidSolver *rigid = job->rigid;
+  const double margin = rigid->settings.slop;
+
+  for (uint32_t p = begin; p < end; p++) {
+    const RigidPair *pair = &rigid->pairs[p];
+    RigidManifold *manifold = &rigid->manifolds[p];
+    const RigidShapeComponent *shapeA = &job->shapes[rigid->slots[pair->a]];
+    manifold->key = pair->key;
+    manifold->a = pair->a;
+    manifold->b = pair->b;
+    manifold->count = 0;
+
+    if (pair->b == rigid->bodyCount) {
+      manifold->friction = shapeA->friction;
+      manifold->restitution = shapeA->restitution;
+      collideWall(rigid, manifold, shapeA, &job->universe->boundary,
+                  (uint32_t)(pair->key & 0xFFFFFFFFu) - RIGID_WALL_KEY, margin);
+      continue;
+    }
+
+    const RigidShapeComponent *shapeB = &job->shapes[rigid->slots[pair->b]];
+    manifold->friction = sqrt(shapeA->friction * shapeB->friction);
+    manifold->restitution = shapeA->restitution > shapeB->restitution
+                                ? shapeA->restitution
+                                : shapeB->restitution;
+
+    if (shapeA->type == RIGID_POLYGON && shapeB->type == RIGID_POLYGON)
+      collidePolygons(rigid, manifold, shapeA->count, shapeB->count, margin);
+    else if (shapeA->type == RIGID_POLYGON)
+      collidePolygonCircle(rigid, manifold, pair->a, shapeA->count, pair->b,
+                           shapeB->radius, margin, false);
+    else if (shapeB->type == RIGID_POLYGON)
+      collidePolygonCircle(rigid, manifold, pair->b, shapeB->count, pair->a,
+                           shapeA->radius, margin, true);
+    else
+      collideCircles(rigid, manifold, shapeA->radius, shapeB->radius, margin);
+  }
+}
+
+/*
+ * Drops the pairs that do not touch and hands surviving points last step's
+ * impulses. Both lists are sorted by key, so one merge walk matches them.
+ */
+static void warmStart(RigidSolver *rigid) {
+  uint32_t count = 0, old = 0, matched = 0;
+  for (uint32_t p = 0; p < rigid->pairCount; p++) {
+    if (rigid->manifolds[p].count == 0)
+      continue;
+    if (count != p)
+      rigid->manifolds[count] = rigid->manifolds[p];
+    RigidManifold *manifold = &rigid->manifolds[count++];
+
+    while (old < rigid->previousCount &&
+           rigid->previous[old].key < manifold->key)
+      old++;
+    if (old == rigid->previousCount ||
+        rigid->previous[old].key != manifold->key)
+      continue;
+
+    const RigidManifold *last = &rigid->previous[old];
+    for (uint32_t k = 0; k < manifold->count; k++) {
+      for (uint32_t l = 0; l < last->count; l++) {
+        if (manifold->points[k].feature == last->points[l].feature) {
+          manifold->points[k].normalImpulse = last->points[l].normalImpulse;
+          manifold->points[k].tangentImpulse = last->points[l].tangentImpulse;
+          matched++;
+          break;
+        }
+      }
+    }
+  }
+  rigid->manifoldCount = count;
+  rigid->warmStarted = matched;
+}
+
+static inline void applyImpulse(RigidVelocity *a, RigidVelocity *b,
+                                const RigidContactPoint *point,
+                                KVector2 impulse) {
+  a->velocity = sub(a->velocity, scale(a->inverseMass, impulse));
+  a->angularVelocity -= a->inverseInertia * cross(point->anchorA, impulse);
+  b->velocity = add(b->velocity, scale(b->inverseMass, impulse));
+  b->angularVelocity += b->inverseInertia * cross(point->anchorB, impulse);
+}
+
+static inline KVector2 relativeVelocity(const RigidVelocity *a,
+                                        const RigidVelocity *b,
+                                        const RigidContactPoint *point) {
+  KVector2 vb =
+      add(b->velocity, crossScalar(b->angularVelocity, point->anchorB));
+  KVector2 va =
+      add(a->velocity, crossScalar(a->angularVelocity, point->anchorA));
+  return sub(vb, va);
+}
+
+/* Effective masses and bias, then the warm-start impulses */
+static void prepareContacts(RigidSolver *rigid, double deltaTime) {
+  const double inverseStep = 1.0 / deltaTime;
+  const double baumgarte = rigid->settings.baumgarte;
+  const double slop = rigid->settings.slop;
+
+  for (uint32_t m = 0; m < rigid->manifoldCount; m++) {
+    RigidManifold *manifold = &rigid->manifolds[m];
+    RigidVelocity *a = &rigid->velocities[manifold->a];
+    RigidVelocity *b = &rigid->velocities[manifold->b];
+    const KVector2 normal = manifold->normal;
+    const KVector2 tangent = {normal.y, -normal.x};
+
+    for (uint32_t k = 0; k < manifold->count; k++) {
+      RigidContactPoint *point = &manifold->points[k];
+      double rnA = cross(point->anchorA, normal);
+      double rnB = cross(point->anchorB, normal);
+      double rtA = cross(point->anchorA, tangent);
+      double rtB = cross(point->anchorB, tangent);
+      double mass = a->inverseMass + b->inverseMass;
+      point->normalMass = 1.0 / (mass + a->inverseInertia * rnA * rnA +
+                                 b->inverseInertia * rnB * rnB);
+      point->tangentMass = 1.0 / (mass + a->inverseInertia * rtA * rtA +
+                                  b->inverseInertia * rtB * rtB);
+
+      // A gap may close within the step; overlap past the slop is pushed out
+      double separation = point->separation;
+      point->bias = separation > 0.0
+                        ? -separation * inverseStep
+                        : -baumgarte * inverseStep *
+                              (separation + slop < 0.0 ? separation + slop
+                                                       : 0.0);
+      double approach = dot(relativeVelocity(a, b, point), normal);
+      if (manifold->restitution > 0.0 && approach < -RIGID_BOUNCE_THRESHOLD &&
+          -manifold->restitution * approach > point->bias)
+        point->bias = -manifold->restitution * approach;
+
+      KVector2 impulse = add(scale(point->normalImpulse, normal),
+                             scale(point->tangentImpulse, tangent));
+      applyImpulse(a, b, point, impulse);
+    }
+
+    // Two points share one block unless the matrix is close to singular
+    manifold->block = false;
+    if (manifold->count == 2) {
+      const RigidContactPoint *p1 = &manifold->points[0];
+      const RigidContactPoint *p2 = &manifold->points[1];
+      double rn1A = cross(p1->anchorA, normal);
+      double rn1B = cross(p1->anchorB, normal);
+      double rn2A = cross(p2->anchorA, normal);
+      double rn2B = cross(p2->anchorB, normal);
+      double mass = a->inverseMass + b->inverseMass;
+      double k11 = mass + a->inverseInertia * rn1A * rn1A +
+                   b->inverseInertia * rn1B * rn1B;
+      double k22 = mass + a->inverseInertia * rn2A * rn2A +
+                   b->inverseInertia * rn2B * rn2B;
+      double k12 = mass + a->inverseInertia * rn1A * rn2A +
+                   b->inverseInertia * rn1B * rn2B;
+      double determinant = k11 * k22 - k12 * k12;
+      if (k11 * k11 < RIGID_MAX_CONDITION * determinant) {
+        manifold->block = true;
+        manifold->blockK[0] = k11;
+        manifold->blockK[1] = k12;
+        manifold->blockK[2] = k22;
+        manifold->blockMass[0] = k22 / determinant;
+        manifold->blockMass[1] = -k12 / determinant;
+        manifold->blockMass[2] = k11 / determinant;
+      }
+    }
+  }
+}
+
+static void applyNormal(RigidVelocity *a, RigidVelocity *b,
+                        RigidContactPoint *point, KVector2 normal,
+                        double total) {
+  double delta = total - point->normalImpulse;
+  point->normalImpulse = total;
+  applyImpulse(a, b, point, scale(delta, normal));
+}
+
+/*
+ * Finds accumulated impulses x >= 0 with K x + b >= 0 and complementarity,
+ * by trying both points active, either one, then neither (Box2D's block
+ * solver). Every case that fits leaves both constraints satisfied exactly.
+ */
+static void solveBlock(RigidManifold *manifold, RigidVelocity *a,
+                       RigidVelocity *b) {
+  RigidContactPoint *p1 = &manifold->points[0];
+  RigidContactPoint *p2 = &manifold->points[1];
+  const KVector2 normal = manifold->normal;
+  const double *k = manifold->blockK;
+  const double *inverse = manifold->blockMass;
+  const double x1 = p1->normalImpulse, x2 = p2->normalImpulse;
+
+  // Velocity error with the current impulses taken out again
+  double b1 = dot(relativeVelocity(a, b, p1), normal) - p1->bias -
+              (k[0] * x1 + k[1] * x2);
+  double b2 = dot(relativeVelocity(a, b, p2), normal) - p2->bias -
+              (k[1] * x1 + k[2] * x2);
+
+  double y1 = -(inverse[0] * b1 + inverse[1] * b2);
+  double y2 = -(inverse[1] * b1 + inverse[2] * b2);
+  if (!(y1 >= 0.0 && y2 >= 0.0)) {
+    y1 = -p1->normalMass * b1;
+    y2 = 0.0;
+    if (!(y1 >= 0.0 && k[1] * y1 + b2 >= 0.0)) {
+      y1 = 0.0;
+      y2 = -p2->normalMass * b2;
+      if (!(y2 >= 0.0 && k[1] * y2 + b1 >= 0.0)) {
+        y2 = 0.0;
+        if (!(b1 >= 0.0 && b2 >= 0.0))
+          return; // No case fits, which only rounding can cause
+      }
+    }
+  }
+
+  // Both deltas from the same velocities, so apply them together
+  double d1 = y1 - x1, d2 = y2 - x2;
+  p1->normalImpulse = y1;
+  p2->normalImpulse = y2;
+  applyImpulse(a, b, p1, scale(d1, normal));
+  applyImpulse(a, b, p2, scale(d2, normal));
+}
+
+/* Friction first, so the normal impulses it is limited by are settled last */
+static void solveContacts(RigidSolver *rigid) {
+  for (uint32_t m = 0; m < rigid->manifoldCount; m++) {
+    RigidManifold *manifold = &rigid->manifolds[m];
+    RigidVelocity *a = &rigid->velocities[manifold->a];
+    RigidVelocity *b = &rigid->velocities[manifold->b];
+    const KVector2 normal = manifold->normal;
+    const KVector2 tangent = {normal.y, -normal.x};
+
+    // Accumulated impulses are clamped, not the increments
+    for (uint32_t k = 0; k < manifold->count; k++) {
+      RigidContactPoint *point = &manifold->points[k];
+      double limit = manifold->friction * point->normalImpulse;
+      double vt = dot(relativeVelocity(a, b, point), tangent);
+      double total = point->tangentImpulse - point->tangentMass * vt;
+      total = total < -limit ? -limit : (total > limit ? limit : total);
+      double delta = total - point->tangentImpulse;
+      point->tangentImpulse = total;
+      applyImpulse(a, b, point, scale(delta, tangent));
+    }
+
+    if (manifold->block) {
+      solveBlock(manifold, a, b);
+      continue;
+    }
+    for (uint32_t k = 0; k < manifold->count; k++) {
+      RigidContactPoint *point = &manifold->points[k];
+      double vn = dot(relativeVelocity(a, b, point), normal);
+      double total =
+          point->normalImpulse + point->normalMass * (point->bias - vn);
+      applyNormal(a, b, point, normal, total > 0.0 ? total : 0.0);
+    }
+  }
+}
+
+/* Velocities back into the components, then positions and orientations */
+static void integrateRange(void *context, uint32_t begin, uint32_t end,
+                           uint32_t chunk) {
+  (void)chunk;
+  const RigidJob *job = (const RigidJob *)context;
+  const RigidSolver *rigid = job->rigid;
+  const double dt = job->deltaTime;
+  const KVector3 axis = {0.0, 0.0, 1.0};
+
+  for (uint32_t i = begin; i < end; i++) {
+    RigidBodyComponent *body = &job->bodies[rigid->slots[i]];
+    const RigidVelocity *velocity = &rigid->velocities[i];
+    body->velocity = velocity->velocity;
+    body->angularVelocity = velocity->angularVelocity;
+    body->position = add(body->position, scale(dt, body->velocity));
+    if (body->angularVelocity != 0.0)
+      body->orientation = KQuaternionNormalize(KQuaternionMultiply(
+          KQuaternionFromAxisAngle(axis, body->angularVelocity * dt),
+          body->orientation));
+  }
+}
+
+void PhysicsRigidUpdate(Universe *universe, double deltaTime) {
+  if (!universe || !universe->rigid || !(deltaTime > 0.0))
+    return;
+
+  RigidSolver *rigid = universe->rigid;
+  RigidJob job;
+  job.universe = universe;
+  job.rigid = rigid;
+  job.bodies = UNIVERSE_COLUMN(universe, RigidBodyComponent,
+                               universe->rigidBodyComponent);
+  job.shapes = UNIVERSE_COLUMN(universe, RigidShapeComponent,
+                               universe->rigidShapeComponent);
+  job.deltaTime = deltaTime;
+
+  uint32_t count = gatherBodies(universe, rigid, job.bodies);
+  ParallelFor(count, RIGID_GRAIN, prepareRange, &job);
+  findPairs(universe, rigid);
+  ParallelFor(rigid->pairCount, RIGID_GRAIN, narrowRange, &job);
+  warmStart(rigid);
+
+  prepareContacts(rigid, deltaTime);
+  for (uint32_t i = 0; i < rigid->settings.iterations; i++)
+    solveContacts(rigid);
+  ParallelFor(count, RIGID_GRAIN, integrateRange, &job);
+
+  // This step's manifolds warm start the next one
+  RigidManifold *swap = rigid->previous;
+  rigid->previous = rigid->manifolds;
+  rigid->manifolds = swap;
+  rigid->previousCount = rigid->manifoldCount;
+}
@@ -0,0 +1,188 @@
+/**
+ * rigid.h
+ *
+ * 2D rigid bodies: circles and convex polygons with an orientation, angular
+ * velocity and rotational inertia. A body is an entity with two components,
+ * split by how often they are touched. RigidBodyComponent is the hot part:
+ * pose, velocities and inverse mass properties, read and written every step.
+ * RigidShapeComponent is the cold part: local geometry and material, read
+ * only by collision detection. Rigid bodies carry no particle components, so
+ * the particle systems never see them.
+ *
+ * Orientation is a KQuaternion about the z axis. Renderers can turn it into
+ * a matrix with KQuaternionToMatrix3 or KQuaternionToMatrix4 directly.
+ *
+ * PhysicsRigidUpdate is a sequential-impulse solver in the style of Box2D
+ * Lite. Each step it:
+ *  1. gathers the bodies into dense solver scratch, with world-space
+ *     vertices and bounding boxes;
+ *  2. finds candidate pairs by sweep and prune along x, plus bodies near
+ *     the universe walls;
+ *  3. builds manifolds of up to two contact points (SAT and edge clipping),
+ *     in parallel over the pairs;
+ *  4. warm starts every point with last step's impulses, matched by entity
+ *     pair and contact feature;
+ *  5. iterates friction and normal impulses with a Baumgarte position bias.
+ *     The two normal impulses of a manifold are solved together as a 2x2
+ *     linear complementarity problem, which is what keeps stacks upright;
+ *  6. integrates positions and orientations back into the components.
+ * The iterations only touch a compact array of velocities and inverse
+ * masses, so they stay in cache. The components are read once on the way in
+ * and written once on the way out. Pairs are solved in entity-pair order,
+ * so every backend gives the same answer.
+ */
+#ifndef PHYSICS_RIGID_H
+#define PHYSICS_RIGID_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "../universe.h"
+
+typedef enum { RIGID_CIRCLE = 0, RIGID_POLYGON } RigidShapeType;
+
+typedef struct {
+  KVector2 position;       /* centre of mass */
+  KQuaternion orientation; /* rotation about z */
+  KVector2 velocity;
+  double angularVelocity; /* radians per second */
+  double inverseMass;     /* 0 for static bodies */
+  double inverseInertia;
+} RigidBodyComponent;
+
+typedef struct {
+  uint32_t type;  /* RigidShapeType */
+  uint32_t count; /* polygon vertices */
+  double radius;  /* circles */
+  double friction;
+  double restitution;
+  /* Counter-clockwise about the centre of mass; normals[i] is the outward
+   * normal of the edge from vertices[i] to vertices[i + 1] */
+  KVector2 vertices[RIGID_MAX_VERTICES];
+  KVector2 normals[RIGID_MAX_VERTICES];
+} RigidShapeComponent;
+
+typedef struct {
+  uint32_t maxBodies; /* bodies the solver scratch holds */
+  uint32_t iterations;
+  KVector2 gravity;
+  double baumgarte; /* share of the overlap removed per step */
+  double slop;      /* overlap left alone, and the speculative margin */
+} RigidSettings;
+
+typedef struct {
+  KVector2 anchorA; /* contact point relative to each centre of mass */
+  KVector2 anchorB;
+  double separation; /* negative when overlapping */
+  double normalImpulse;
+  double tangentImpulse;
+  double normalMass;
+  double tangentMass;
+  double bias;
+  uint32_t feature; /* identifies the point across steps */
+} RigidContactPoint;
+
+typedef struct {
+  uint64_t key; /* entity pair, or entity and wall */
+  uint32_t a;   /* dense body indices; the walls are index bodyCount */
+  uint32_t b;
+  KVector2 normal; /* from a to b */
+  double friction;
+  double restitution;
+  uint32_t count;
+  bool block; /* both points solved together through blockMass */
+  double blockK[3];    /* 2x2 normal effective mass matrix: xx, xy, yy */
+  double blockMass[3]; /* its inverse */
+  RigidContactPoint points[2];
+} RigidManifold;
+
+/* Dense per-step body state, the only data the iterations touch */
+typedef struct {
+  KVector2 velocity;
+  double angularVelocity;
+  double inverseMass;
+  double inverseInertia;
+} RigidVelocity;
+
+/* A body's bounds, copied so the sweep reads one contiguous array */
+typedef struct {
+  double minX;
+  double maxX;
+  double minY;
+  double maxY;
+  uint32_t body;
+} RigidSweepKey;
+
+typedef struct {
+  uint64_t key;
+  uint32_t a;
+  uint32_t b;
+} RigidPair;
+
+/**
+ * Solver state and per-step scratch. It is carved from the universe
+ * allocator in one block when rigid bodies are enabled, so steps never
+ * allocate.
+ */
+typedef struct RigidSolver {
+  RigidSettings settings;
+  uint32_t pairCapacity;
+  uint32_t bodyCount;     /* bodies in the last step */
+  uint32_t pairCount;     /* candidate pairs in the last step */
+  uint32_t manifoldCount; /* touching pairs in the last step */
+  uint32_t warmStarted;   /* contact points that kept their impulses */
+  uint32_t droppedBodies; /* beyond maxBodies, left out of the last step */
+  uint32_t droppedPairs;  /* beyond pairCapacity, left out of the last step */
+  uint32_t *slots;        /* dense index -> storage slot */
+  EntityID *entities;     /* dense index -> entity */
+  RigidVelocity *velocities; /* bodyCount + 1; the last entry is the walls */
+  KVector2 *positions;
+  KVector2 *rotations;   /* (cos, sin) */
+  KVector2 *boundsMin;
+  KVector2 *boundsMax;
+  KVector2 *worldVertices; /* RIGID_MAX_VERTICES per body */
+  KVector2 *worldNormals;
+  RigidSweepKey *sweep; /* sorted by minX, kept in order between steps */
+  uint32_t sweepCount;
+  RigidPair *pairs;
+  RigidManifold *manifolds; /* this step's, sorted by key */
+  RigidManifold *previous;  /* last step's, for warm starting */
+  uint32_t previousCount;
+} RigidSolver;
+
+RigidSettings RigidDefaultSettings(void);
+
+/**
+ * Registers the rigid components and carves the solver from the universe
+ * allocator. Calling it again replaces the settings but keeps the scratch,
+ * so maxBodies only takes effect the first time.
+ *
+ * @param settings NULL selects RigidDefaultSettings
+ */
+bool RigidEnable(Universe *universe, const RigidSettings *settings);
+
+/* Rotation by `angle` radians about z */
+KQuaternion RigidOrientation(double angle);
+double RigidAngle(KQuaternion orientation);
+
+/**
+ * Body constructors. A density of 0 makes the body static. Polygons take
+ * up to RIGID_MAX_VERTICES points relative to `position`, in any order; the
+ * body is their convex hull, and its position becomes the hull's centroid.
+ * They fail on degenerate input.
+ */
+EntityID RigidCircleCreate(Universe *universe, KVector2 position,
+                           double radius, double density);
+EntityID RigidBoxCreate(Universe *universe, KVector2 position,
+                        KVector2 halfExtents, double angle, double density);
+EntityID RigidPolygonCreate(Universe *universe, KVector2 position,
+                            const KVector2 *vertices, uint32_t count,
+                            double angle, double density);
+
+RigidBodyComponent *RigidGetBody(Universe *universe, EntityID entity);
+RigidShapeComponent *RigidGetShape(Universe *universe, EntityID entity);
+
+/* Contacts, impulses and integration of one step */
+void PhysicsRigidUpdate(Universe *universe, double deltaTime);
+
+#endif /* PHYSICS_RIGID_H */
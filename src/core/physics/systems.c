@@ -1,38 +1,108 @@
 #include "systems.h"
 
+#include <math.h>
+
+#include "../parallel.h"
+#include "diagnostics_internal.h"
+
 static const KVector2 GRAVITY_VECTOR = {GRAVITY_X, GRAVITY_Y};
 
 bool PhysicsApplyForce(Universe *universe, EntityID entity, KVector2 force) {
   if (!universe || entity >= universe->maxEntities ||
-      !universe->activeEntities[entity])
+      !UniverseIsEntityActive(universe, entity))
     return false;
 
+  uint32_t slot = UniverseEntitySlot(universe, entity);
   ComponentMask required = COMPONENT_PARTICLE | COMPONENT_MECHANICS;
-  if ((universe->entityMasks[entity] & required) != required)
+  if ((universe->entityMasks[slot] & required) != required)
     return false;
 
-  universe->mechanics[entity].forceAccum.x += force.x;
-  universe->mechanics[entity].forceAccum.y += force.y;
+  universe->mechanics[slot].forceAccum.x += force.x;
+  universe->mechanics[slot].forceAccum.y += force.y;
   return true;
 }
 
+/* Shared arguments of the per-chunk system bodies */
+typedef struct {
+  Universe *universe;
+  double deltaTime;
+  ComponentMask required;
+  ComponentMask excluded;
+  const RadiusComponent *radii;
+  DiagnosticsPartials *partials; /* non-NULL: this sweep takes the sample */
+} SystemJob;
+
+// Systems split the bitset words into chunks of at least PARALLEL_GRAIN_SLOTS
+static void runSystem(Universe *universe, ParallelBody body, SystemJob *job) {
+  ParallelFor(BITSET_WORDS(universe->maxEntities), PARALLEL_GRAIN_SLOTS / 64,
+              body, job);
+}
+
+static void forcesWords(void *context, uint32_t begin, uint32_t end,
+                        uint32_t chunk) {
+  (void)chunk;
+  Universe *universe = ((SystemJob *)context)->universe;
+  const ComponentMask required = COMPONENT_PARTICLE | COMPONENT_MECHANICS;
+
+  for (uint32_t w = begin; w < end; w++) {
+    uint64_t bits = UniverseMatchWord(universe, w, required, COMPONENT_NONE);
+    while (bits) {
+      EntityID i = w * 64 + (EntityID)__builtin_ctzll(bits);
+      bits &= bits - 1;
+
+      double inverseMass = universe->kineticBodies[i].inverseMass;
+      if (inverseMass <= 0.0)
+        continue;
+
+      // double mass = 1.0 / inverseMass;
+      // universe->mechanics[i].forceAccum.x += mass * GRAVITY_VECTOR.x;
+      // universe->mechanics[i].forceAccum.y += mass * GRAVITY_VECTOR.y;
+    }
+  }
+}
+
 void PhysicsForcesUpdate(Universe *universe) {
   if (!universe)
     return;
 
-  for (uint32_t i = 0; i < universe->maxEntities; i++) {
-    ComponentMask required = COMPONENT_PARTICLE | COMPONENT_MECHANICS;
-    if (!universe->activeEntities[i] ||
-        (universe->entityMasks[i] & required) != required)
-      continue;
+  SystemJob job = {universe, 0.0, COMPONENT_NONE, COMPONENT_NONE, NULL};
+  runSystem(universe, forcesWords, &job);
+}
+
+void PhysicsForcesWords(Universe *universe, double deltaTime, uint32_t begin,
+                        uint32_t end) {
+  SystemJob job = {universe, deltaTime, COMPONENT_NONE, COMPONENT_NONE, NULL};
+  forcesWords(&job, begin, end, 0);
+}
+
+static void mechanicsWords(void *context, uint32_t begin, uint32_t end,
+                           uint32_t chunk) {
+  (void)chunk;
+  Universe *universe = ((SystemJob *)context)->universe;
+  const double deltaTime = ((SystemJob *)context)->deltaTime;
+  const ComponentMask required = COMPONENT_PARTICLE | COMPONENT_MECHANICS;
+
+  for (uint32_t w = begin; w < end; w++) {
+    uint64_t bits = UniverseMatchWord(universe, w, required, COMPONENT_NONE);
+    while (bits) {
+      EntityID i = w * 64 + (EntityID)__builtin_ctzll(bits);
+      bits &= bits - 1;
 
-    double inverseMass = universe->kineticBodies[i].inverseMass;
-    if (inverseMass <= 0.0)
-      continue;
+      if (universe->kineticBodies[i].inverseMass <= 0)
+        continue;
 
-    // double mass = 1.0 / inverseMass;
-    // universe->mechanics[i].forceAccum.x += mass * GRAVITY_VECTOR.x;
-    // universe->mechanics[i].forceAccum.y += mass * GRAVITY_VECTOR.y;
+      KineticBodyComponent *particle = &universe->kineticBodies[i];
+      MechanicsComponent *mechanics = &universe->mechanics[i];
+
+      KVector2 acceleration;
+      acceleration.x = mechanics->forceAccum.x * particle->inverseMass;
+      acceleration.y = mechanics->forceAccum.y * particle->inverseMass;
+      acceleration.x += mechanics->acceleration.x;
+      acceleration.y += mechanics->acceleration.y;
+
+      mechanics->velocity.x += acceleration.x * deltaTime;
+      mechanics->velocity.y += acceleration.y * deltaTime;
+    }
   }
 }
 
@@ -40,45 +110,91 @@ void PhysicsMechanicsUpdate(Universe *universe, double deltaTime) {
   if (!universe)
     return;
 
-  for (uint32_t i = 0; i < universe->maxEntities; i++) {
-    ComponentMask required = COMPONENT_PARTICLE | COMPONENT_MECHANICS;
-    if (!universe->activeEntities[i] ||
-        (universe->entityMasks[i] & required) != required)
-      continue;
+  SystemJob job = {universe, deltaTime, COMPONENT_NONE, COMPONENT_NONE, NULL};
+  runSystem(universe, mechanicsWords, &job);
+}
+
+void PhysicsMechanicsWords(Universe *universe, double deltaTime,
+                           uint32_t begin, uint32_t end) {
+  SystemJob job = {universe, deltaTime, COMPONENT_NONE, COMPONENT_NONE, NULL};
+  mechanicsWords(&job, begin, end, 0);
+}
+
+static void positionWords(void *context, uint32_t begin, uint32_t end,
+                          uint32_t chunk) {
+  Universe *universe = ((SystemJob *)context)->universe;
+  const double deltaTime = ((SystemJob *)context)->deltaTime;
+  DiagnosticsPartials *partials = ((SystemJob *)context)->partials;
+  const ComponentMask required = COMPONENT_PARTICLE | COMPONENT_MECHANICS;
+  // A local copy stays in registers; the column stores could alias it
+  DiagnosticsPartial sample;
+  DiagnosticsTerms terms = {0.0, 0.0, {0.0, 0.0}};
+  if (partials)
+    sample = partials->chunks[chunk];
 
-    if (universe->kineticBodies[i].inverseMass <= 0)
-      continue;
+  for (uint32_t w = begin; w < end; w++) {
+    uint64_t bits = UniverseMatchWord(universe, w, required, COMPONENT_NONE);
+    while (bits) {
+      EntityID i = w * 64 + (EntityID)__builtin_ctzll(bits);
+      bits &= bits - 1;
 
-    KineticBodyComponent *particle = &universe->kineticBodies[i];
-    MechanicsComponent *mechanics = &universe->mechanics[i];
+      KineticBodyComponent *particle = &universe->kineticBodies[i];
+      MechanicsComponent *mechanics = &universe->mechanics[i];
 
-    KVector2 acceleration;
-    acceleration.x = mechanics->forceAccum.x * particle->inverseMass;
-    acceleration.y = mechanics->forceAccum.y * particle->inverseMass;
-    acceleration.x += mechanics->acceleration.x;
-    acceleration.y += mechanics->acceleration.y;
+      particle->previous = particle->position;
+      particle->position.x += mechanics->velocity.x * deltaTime;
+      particle->position.y += mechanics->velocity.y * deltaTime;
 
-    mechanics->velocity.x += acceleration.x * deltaTime;
-    mechanics->velocity.y += acceleration.y * deltaTime;
+      if (partials)
+        DiagnosticsAccumulate(&sample, &terms, particle->position,
+                              mechanics->velocity, particle->inverseMass);
+    }
+    if (partials)
+      DiagnosticsFold(&sample, &terms);
   }
+
+  if (partials)
+    partials->chunks[chunk] = sample;
 }
 
 void PhysicsPositionUpdate(Universe *universe, double deltaTime) {
   if (!universe)
     return;
 
-  for (uint32_t i = 0; i < universe->maxEntities; i++) {
-    ComponentMask required = COMPONENT_PARTICLE | COMPONENT_MECHANICS;
-    if (!universe->activeEntities[i] ||
-        (universe->entityMasks[i] & required) != required)
-      continue;
+  // With walls or obstacles a later pass has the final positions instead
+  DiagnosticsPartials partials;
+  SystemJob job = {universe, deltaTime, COMPONENT_NONE, COMPONENT_NONE, NULL};
+  if (universe->diagnostics.enabled && !universe->boundary.enabled &&
+      !DiagnosticsInObstaclePass(universe)) {
+    DiagnosticsBegin(&partials);
+    job.partials = &partials;
+  }
+  runSystem(universe, positionWords, &job);
+  if (job.partials)
+    DiagnosticsCommit(universe, &partials);
+}
 
-    KineticBodyComponent *particle = &universe->kineticBodies[i];
-    MechanicsComponent *mechanics = &universe->mechanics[i];
+void PhysicsPositionWords(Universe *universe, double deltaTime,
+                          uint32_t begin, uint32_t end) {
+  SystemJob job = {universe, deltaTime, COMPONENT_NONE, COMPONENT_NONE, NULL};
+  positionWords(&job, begin, end, 0);
+}
+
+static void clearForcesWords(void *context, uint32_t begin, uint32_t end,
+                             uint32_t chunk) {
+  (void)chunk;
+  Universe *universe = ((SystemJob *)context)->universe;
+
+  for (uint32_t w = begin; w < end; w++) {
+    uint64_t bits =
+        UniverseMatchWord(universe, w, COMPONENT_MECHANICS, COMPONENT_NONE);
+    while (bits) {
+      EntityID i = w * 64 + (EntityID)__builtin_ctzll(bits);
+      bits &= bits - 1;
 
-    particle->previous = particle->position;
-    particle->position.x += mechanics->velocity.x * deltaTime;
-    particle->position.y += mechanics->velocity.y * deltaTime;
+      universe->mechanics[i].forceAccum.x = 0.0;
+      universe->mechanics[i].forceAccum.y = 0.0;
+    }
   }
 }
 
@@ -86,43 +202,291 @@ void PhysicsClearForces(Universe *universe) {
   if (!universe)
     return;
 
-  for (uint32_t i = 0; i < universe->maxEntities; i++) {
-    if (!universe->activeEntities[i] ||
-        !(universe->entityMasks[i] & COMPONENT_MECHANICS))
-      continue;
+  SystemJob job = {universe, 0.0, COMPONENT_NONE, COMPONENT_NONE, NULL};
+  runSystem(universe, clearForcesWords, &job);
+}
+
+void PhysicsClearForcesWords(Universe *universe, double deltaTime,
+                             uint32_t begin, uint32_t end) {
+  SystemJob job = {universe, deltaTime, COMPONENT_NONE, COMPONENT_NONE, NULL};
+  clearForcesWords(&job, begin, end, 0);
+}
+
+/*
+ * Swept response along one axis. The part of the step left after the time of
+ * impact, (1 - toi) * (position - previous), is exactly the penetration past
+ * the wall, so mirroring it (scaled by restitution) continues the motion after
+ * the bounce instead of sticking to the wall. Selects compile to blends, which
+ * keeps the loop free of branches.
+ */
+static inline void sweepAxis(double *position, double *velocity, double lo,
+                             double hi) {
+  // Plain selects rather than fmin/fmax: without -ffast-math those stay libm
+  // calls, which cost far more than the sweep itself in vectorised builds
+  double under = lo - *position;
+  double over = *position - hi;
+  under = under > 0.0 ? under : 0.0;
+  over = over > 0.0 ? over : 0.0;
+  double swept = *position + (under - over) * (1.0 + RESTITUTION);
+  double v = *velocity;
+
+  v = under > 0.0 ? fabs(v) * RESTITUTION : v;
+  v = over > 0.0 ? -fabs(v) * RESTITUTION : v;
+
+  swept = swept > lo ? swept : lo;
+  *position = swept < hi ? swept : hi;
+  *velocity = v;
+}
 
-    universe->mechanics[i].forceAccum.x = 0.0;
-    universe->mechanics[i].forceAccum.y = 0.0;
+static void boundaryWords(void *context, uint32_t begin, uint32_t end,
+                          uint32_t chunk) {
+  const SystemJob *job = (const SystemJob *)context;
+  Universe *universe = job->universe;
+  const RadiusComponent *radii = job->radii;
+  const UniverseBoundary boundary = universe->boundary;
+  DiagnosticsPartial sample;
+  DiagnosticsTerms terms = {0.0, 0.0, {0.0, 0.0}};
+  if (job->partials)
+    sample = job->partials->chunks[chunk];
+
+  for (uint32_t w = begin; w < end; w++) {
+    uint64_t bits = UniverseMatchWord(universe, w, job->required, job->excluded);
+    while (bits) {
+      EntityID i = w * 64 + (EntityID)__builtin_ctzll(bits);
+      bits &= bits - 1;
+
+      double radius = radii ? radii[i].radius : 0.0;
+      KineticBodyComponent *particle = &universe->kineticBodies[i];
+      MechanicsComponent *mechanics = &universe->mechanics[i];
+
+      sweepAxis(&particle->position.x, &mechanics->velocity.x,
+                boundary.left + radius, boundary.right - radius);
+      sweepAxis(&particle->position.y, &mechanics->velocity.y,
+                boundary.top + radius, boundary.bottom - radius);
+
+      if (job->partials)
+        DiagnosticsAccumulate(&sample, &terms, particle->position,
+                              mechanics->velocity, particle->inverseMass);
+    }
+    if (job->partials)
+      DiagnosticsFold(&sample, &terms);
   }
+
+  if (job->partials)
+    job->partials->chunks[chunk] = sample;
 }
 
 void PhysicsResolveBoundaryCollisions(Universe *universe) {
   if (!universe || !universe->boundary.enabled)
     return;
 
-  for (uint32_t i = 0; i < universe->maxEntities; i++) {
-    ComponentMask required = COMPONENT_PARTICLE | COMPONENT_MECHANICS;
-    if (!universe->activeEntities[i] ||
-        (universe->entityMasks[i] & required) != required)
-      continue;
-
-    KineticBodyComponent *particle = &universe->kineticBodies[i];
-    MechanicsComponent *mechanics = &universe->mechanics[i];
-
-    if (particle->position.x < universe->boundary.left) {
-      particle->position.x = universe->boundary.left;
-      mechanics->velocity.x = -mechanics->velocity.x * RESTITUTION;
-    } else if (particle->position.x > universe->boundary.right) {
-      particle->position.x = universe->boundary.right;
-      mechanics->velocity.x = -mechanics->velocity.x * RESTITUTION;
+  // Entities without a radius collide as points
+  // Both passes split the words the same way, so they share the partials
+  DiagnosticsPartials partials;
+  DiagnosticsPartials *sample = NULL;
+  if (universe->diagnostics.enabled && !DiagnosticsInObstaclePass(universe)) {
+    DiagnosticsBegin(&partials);
+    sample = &partials;
+  }
+
+  const ComponentMask required = COMPONENT_PARTICLE | COMPONENT_MECHANICS;
+  SystemJob withRadius = {universe, 0.0, required | COMPONENT_RADIUS,
+                          COMPONENT_NONE, universe->radii, sample};
+  SystemJob points = {universe, 0.0, required, COMPONENT_RADIUS, NULL, sample};
+  runSystem(universe, boundaryWords, &withRadius);
+  runSystem(universe, boundaryWords, &points);
+  if (sample)
+    DiagnosticsCommit(universe, sample);
+}
+
+bool UniverseSetAdaptiveTimestep(Universe *universe, double maxDisplacement) {
+  if (!universe)
+    return false;
+
+  if (maxDisplacement > 0.0 && !universe->timestep.classBits) {
+    size_t bytes = (size_t)TIMESTEP_CLASSES *
+                   BITSET_WORDS(universe->maxEntities) * sizeof(uint64_t);
+    universe->timestep.classBits = (uint64_t *)UniverseAllocate(
+        universe, K_MEMORY_TIMESTEP, bytes, COLUMN_ALIGNMENT);
+    if (!universe->timestep.classBits)
+      return false;
+  }
+
+  universe->timestep.maxDisplacement = maxDisplacement > 0.0 ? maxDisplacement
+                                                             : 0.0;
+  return true;
+}
+
+static KVector2 stepAcceleration(const KineticBodyComponent *particle,
+                                 const MechanicsComponent *mechanics) {
+  // Immovable bodies keep their velocity, as in PhysicsMechanicsUpdate
+  if (particle->inverseMass <= 0)
+    return (KVector2){0.0, 0.0};
+
+  return (KVector2){
+      mechanics->forceAccum.x * particle->inverseMass +
+          mechanics->acceleration.x,
+      mechanics->forceAccum.y * particle->inverseMass +
+          mechanics->acceleration.y};
+}
+
+static uint32_t timestepClass(double travel, double limit) {
+  uint32_t k = 0;
+  while (k + 1 < TIMESTEP_CLASSES && travel > limit * (double)(1u << k))
+    k++;
+  return k;
+}
+
+/* Chunks only write their own words of the class bitsets */
+static void classifyWords(void *context, uint32_t begin, uint32_t end,
+                          uint32_t chunk) {
+  (void)chunk;
+  Universe *universe = ((SystemJob *)context)->universe;
+  const double deltaTime = ((SystemJob *)context)->deltaTime;
+  UniverseTimestep *timestep = &universe->timestep;
+  const UniverseBoundary boundary = universe->boundary;
+  const uint32_t words = BITSET_WORDS(universe->maxEntities);
+  const ComponentMask required = COMPONENT_PARTICLE | COMPONENT_MECHANICS;
+
+  for (uint32_t w = begin; w < end; w++) {
+    for (uint32_t k = 0; k < TIMESTEP_CLASSES; k++)
+      timestep->classBits[k * words + w] = 0;
+
+    uint64_t bits = UniverseMatchWord(universe, w, required, COMPONENT_NONE);
+    uint64_t withRadius =
+        UniverseMatchWord(universe, w, COMPONENT_RADIUS, COMPONENT_NONE);
+    while (bits) {
+      EntityID i = w * 64 + (EntityID)__builtin_ctzll(bits);
+      bits &= bits - 1;
+
+      const KineticBodyComponent *particle = &universe->kineticBodies[i];
+      const MechanicsComponent *mechanics = &universe->mechanics[i];
+      KVector2 a = stepAcceleration(particle, mechanics);
+
+      // Bound the speed over the whole step by its value at either end
+      double vx = mechanics->velocity.x, vy = mechanics->velocity.y;
+      double ex = vx + a.x * deltaTime, ey = vy + a.y * deltaTime;
+      double v0 = vx * vx + vy * vy, v1 = ex * ex + ey * ey;
+      double travel = sqrt(v0 > v1 ? v0 : v1) * deltaTime;
+
+      double limit = timestep->maxDisplacement;
+      if (boundary.enabled && travel > 0.0) {
+        double radius =
+            withRadius & (1ull << (i % 64)) ? universe->radii[i].radius : 0.0;
+        KVector2 p = particle->position;
+        double gaps[4] = {p.x - boundary.left, boundary.right - p.x,
+                          p.y - boundary.top, boundary.bottom - p.y};
+        // Closing speed on each wall, the larger of either end of the step
+        double closing[4] = {-(vx < ex ? vx : ex), vx > ex ? vx : ex,
+                             -(vy < ey ? vy : ey), vy > ey ? vy : ey};
+        // Only walls being approached count, by the path to reach them
+        for (int g = 0; g < 4; g++) {
+          if (closing[g] <= 0.0)
+            continue;
+          double gap = gaps[g] - radius > 0.0 ? gaps[g] - radius : 0.0;
+          double path = gap * travel / (closing[g] * deltaTime);
+          limit = path < limit ? path : limit;
+        }
+        double floor = timestep->maxDisplacement * TIMESTEP_WALL_FLOOR;
+        limit = limit > floor ? limit : floor;
+      }
+
+      uint32_t k = timestepClass(travel, limit);
+      timestep->classBits[k * words + w] |= 1ull << (i % 64);
     }
+  }
+}
+
+static void integrateWords(void *context, uint32_t begin, uint32_t end,
+                           uint32_t chunk) {
+  Universe *universe = ((SystemJob *)context)->universe;
+  const double deltaTime = ((SystemJob *)context)->deltaTime;
+  DiagnosticsPartials *partials = ((SystemJob *)context)->partials;
+  const UniverseBoundary boundary = universe->boundary;
+  const uint32_t words = BITSET_WORDS(universe->maxEntities);
+  DiagnosticsPartial sample;
+  DiagnosticsTerms terms = {0.0, 0.0, {0.0, 0.0}};
+  if (partials)
+    sample = partials->chunks[chunk];
+
+  for (uint32_t k = 0; k < TIMESTEP_CLASSES; k++) {
+    const uint32_t substeps = 1u << k;
+    const double h = deltaTime / (double)substeps;
+    const uint64_t *classBits = &universe->timestep.classBits[k * words];
+
+    for (uint32_t w = begin; w < end; w++) {
+      uint64_t bits = classBits[w];
+      uint64_t withRadius =
+          UniverseMatchWord(universe, w, COMPONENT_RADIUS, COMPONENT_NONE);
+      while (bits) {
+        EntityID i = w * 64 + (EntityID)__builtin_ctzll(bits);
+        bits &= bits - 1;
+
+        KineticBodyComponent *particle = &universe->kineticBodies[i];
+        MechanicsComponent *mechanics = &universe->mechanics[i];
+        KVector2 a = stepAcceleration(particle, mechanics);
+        double radius =
+            withRadius & (1ull << (i % 64)) ? universe->radii[i].radius : 0.0;
+
+        // The whole class interval runs in registers; entities are independent
+        KVector2 p = particle->position;
+        KVector2 v = mechanics->velocity;
+        particle->previous = p;
+
+        for (uint32_t s = 0; s < substeps; s++) {
+          v.x += a.x * h;
+          v.y += a.y * h;
+          p.x += v.x * h;
+          p.y += v.y * h;
+
+          if (boundary.enabled) {
+            sweepAxis(&p.x, &v.x, boundary.left + radius,
+                      boundary.right - radius);
+            sweepAxis(&p.y, &v.y, boundary.top + radius,
+                      boundary.bottom - radius);
+          }
+        }
 
-    if (particle->position.y < universe->boundary.top) {
-      particle->position.y = universe->boundary.top;
-      mechanics->velocity.y = -mechanics->velocity.y * RESTITUTION;
-    } else if (particle->position.y > universe->boundary.bottom) {
-      particle->position.y = universe->boundary.bottom;
-      mechanics->velocity.y = -mechanics->velocity.y * RESTITUTION;
+        particle->position = p;
+        mechanics->velocity = v;
+
+        if (partials)
+          DiagnosticsAccumulate(&sample, &terms, p, v, particle->inverseMass);
+      }
+      if (partials)
+        DiagnosticsFold(&sample, &terms);
     }
   }
-}
\ No newline at end of file
+
+  if (partials)
+    partials->chunks[chunk] = sample;
+}
+
+void PhysicsAdaptiveIntegrate(Universe *universe, double deltaTime) {
+  if (!universe || !universe->timestep.classBits)
+    return;
+
+  SystemJob job = {universe, deltaTime, COMPONENT_NONE, COMPONENT_NONE, NULL};
+  runSystem(universe, classifyWords, &job);
+
+  // Per-class statistics from the finished bitsets
+  UniverseTimestep *timestep = &universe->timestep;
+  const uint32_t words = BITSET_WORDS(universe->maxEntities);
+  timestep->substeps = 0;
+  for (uint32_t k = 0; k < TIMESTEP_CLASSES; k++) {
+    uint32_t count = 0;
+    for (uint32_t w = 0; w < words; w++)
+      count += (uint32_t)__builtin_popcountll(timestep->classBits[k * words + w]);
+    timestep->classCounts[k] = count;
+    timestep->substeps += (uint64_t)count << k;
+  }
+
+  DiagnosticsPartials partials;
+  if (universe->diagnostics.enabled && !DiagnosticsInObstaclePass(universe)) {
+    DiagnosticsBegin(&partials);
+    job.partials = &partials;
+  }
+  runSystem(universe, integrateWords, &job);
+  if (job.partials)
+    DiagnosticsCommit(universe, &partials);
+}
@@ -12,4 +12,38 @@ void PhysicsPositionUpdate(Universe *universe, double deltaTime);
 void PhysicsClearForces(Universe *universe);
 void PhysicsResolveBoundaryCollisions(Universe *universe);
 
+/*
+ * The same systems over the bitset words [begin, end) only, for fused sweeps
+ * (see scheduler.h). The position kernel takes no diagnostics sample.
+ */
+void PhysicsForcesWords(Universe *universe, double deltaTime, uint32_t begin,
+                        uint32_t end);
+void PhysicsMechanicsWords(Universe *universe, double deltaTime,
+                           uint32_t begin, uint32_t end);
+void PhysicsPositionWords(Universe *universe, double deltaTime,
+                          uint32_t begin, uint32_t end);
+void PhysicsClearForcesWords(Universe *universe, double deltaTime,
+                             uint32_t begin, uint32_t end);
+
+/**
+ * Multi-rate integration. Every moving entity is put in the smallest
+ * power-of-two class k such that a substep of deltaTime / 2^k moves it no
+ * further than maxDisplacement. Near a wall it is closing on, the path it
+ * has left to that wall along its velocity is the limit if smaller, though
+ * never below TIMESTEP_WALL_FLOOR of maxDisplacement: particles resting on
+ * or leaving a wall keep a coarse class. Class k then takes 2^k substeps of
+ * velocity, position and boundary updates, so every class ends in sync at
+ * the global step. Slow entities in the interior cost one substep, and only
+ * fast or wall-bound ones pay for the fine rate.
+ */
+void PhysicsAdaptiveIntegrate(Universe *universe, double deltaTime);
+
+/**
+ * Enables adaptive substepping in UniverseUpdate; 0 returns to uniform
+ * steps.
+ *
+ * @return false if the class bitsets could not be allocated
+ */
+bool UniverseSetAdaptiveTimestep(Universe *universe, double maxDisplacement);
+
 #endif /* PHYSICS_SYSTEMS_H */
@@ -0,0 +1,243 @@
+#include "publish.h"
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* Frames, arrays and the header all start on their own cache line */
+#define PUBLISH_ALIGNMENT 64
+
+static size_t roundUp(size_t value) {
+  return (value + PUBLISH_ALIGNMENT - 1) & ~(size_t)(PUBLISH_ALIGNMENT - 1);
+}
+
+static bool validName(const char *name) {
+  return name && name[0] == '/' && strlen(name) < PUBLISH_NAME_MAX;
+}
+
+static Publisher *mapSegment(const char *name, int fd, size_t bytes,
+                             bool owner) {
+  int protection = owner ? PROT_READ | PROT_WRITE : PROT_READ;
+  void *memory = mmap(NULL, bytes, protection, MAP_SHARED, fd, 0);
+  if (memory == MAP_FAILED)
+    return NULL;
+
+  Publisher *publisher = (Publisher *)calloc(1, sizeof(Publisher));
+  if (!publisher) {
+    munmap(memory, bytes);
+    return NULL;
+  }
+  KAccountAllocation(K_MEMORY_PUBLISH, sizeof(Publisher) + bytes);
+  publisher->header = (PublishHeader *)memory;
+  publisher->bytes = bytes;
+  publisher->owner = owner;
+  strcpy(publisher->name, name);
+  return publisher;
+}
+
+Publisher *PublisherCreate(const char *name, uint32_t maxEntities,
+                           uint32_t frames) {
+  if (!validName(name) || frames < 2)
+    return NULL;
+
+  size_t offsets[PUBLISH_FIELD_COUNT];
+  size_t frameBytes = roundUp(sizeof(PublishFrame));
+  for (uint32_t f = 0; f < PUBLISH_FIELD_COUNT; f++) {
+    size_t element = f == PUBLISH_ENTITY ? sizeof(EntityID) : sizeof(double);
+    offsets[f] = frameBytes;
+    frameBytes += roundUp((size_t)maxEntities * element);
+  }
+  const size_t headerBytes = roundUp(sizeof(PublishHeader));
+  const size_t bytes = headerBytes + (size_t)frames * frameBytes;
+
+  // A fresh segment, so readers of an old one keep their mapping intact
+  shm_unlink(name);
+  int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0644);
+  if (fd < 0)
+    return NULL;
+  Publisher *publisher = NULL;
+  if (ftruncate(fd, (off_t)bytes) == 0)
+    publisher = mapSegment(name, fd, bytes, true);
+  close(fd);
+  if (!publisher) {
+    shm_unlink(name);
+    return NULL;
+  }
+
+  // ftruncate zero-fills, so every frame starts at sequence 0
+  PublishHeader *header = publisher->header;
+  header->version = PUBLISH_VERSION;
+  header->headerBytes = (uint32_t)headerBytes;
+  header->frameCount = frames;
+  header->maxEntities = maxEntities;
+  header->frameBytes = frameBytes;
+  for (uint32_t f = 0; f < PUBLISH_FIELD_COUNT; f++)
+    header->fieldOffsets[f] = offsets[f];
+  atomic_store_explicit(&header->published, 0, memory_order_relaxed);
+  // Readers check the magic first: it goes in last
+  atomic_thread_fence(memory_order_release);
+  header->magic = PUBLISH_MAGIC;
+  return publisher;
+}
+
+static unsigned char *frameAt(const PublishHeader *header, uint64_t frame) {
+  return (unsigned char *)header + header->headerBytes +
+         (size_t)(frame % header->frameCount) * header->frameBytes;
+}
+
+bool PublisherPublish(Publisher *publisher, const Universe *universe) {
+  if (!publisher || !publisher->owner || !universe)
+    return false;
+
+  PublishHeader *header = publisher->header;
+  const uint64_t number =
+      atomic_load_explicit(&header->published, memory_order_relaxed) + 1;
+  unsigned char *base = frameAt(header, number);
+  PublishFrame *frame = (PublishFrame *)base;
+
+  const uint64_t sequence =
+      atomic_load_explicit(&frame->sequence, memory_order_relaxed);
+  atomic_store_explicit(&frame->sequence, sequence + 1, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+
+  EntityID *entities = (EntityID *)(base + header->fieldOffsets[0]);
+  double *x = (double *)(base + header->fieldOffsets[PUBLISH_POSITION_X]);
+  double *y = (double *)(base + header->fieldOffsets[PUBLISH_POSITION_Y]);
+  double *vx = (double *)(base + header->fieldOffsets[PUBLISH_VELOCITY_X]);
+  double *vy = (double *)(base + header->fieldOffsets[PUBLISH_VELOCITY_Y]);
+  double *inverseMass =
+      (double *)(base + header->fieldOffsets[PUBLISH_INVERSE_MASS]);
+  double *radius = (double *)(base + header->fieldOffsets[PUBLISH_RADIUS]);
+
+  const uint64_t *moving = universe->componentBits[COMPONENT_ID_MECHANICS];
+  const uint64_t *round = universe->componentBits[COMPONENT_ID_RADIUS];
+  const uint32_t capacity = header->maxEntities;
+  uint32_t count = 0, dropped = 0;
+  for (uint32_t w = 0; w < BITSET_WORDS(universe->maxEntities); w++) {
+    uint64_t bits =
+        UniverseMatchWord(universe, w, COMPONENT_PARTICLE, COMPONENT_NONE);
+    while (bits) {
+      uint32_t bit = (uint32_t)__builtin_ctzll(bits);
+      uint32_t slot = w * 64 + bit;
+      bits &= bits - 1;
+      if (count == capacity) {
+        dropped++;
+        continue;
+      }
+
+      const KineticBodyComponent *body = &universe->kineticBodies[slot];
+      KVector2 velocity = {0.0, 0.0};
+      if (moving[w] >> bit & 1)
+        velocity = universe->mechanics[slot].velocity;
+      entities[count] = UniverseSlotEntity(universe, slot);
+      x[count] = body->position.x;
+      y[count] = body->position.y;
+      vx[count] = velocity.x;
+      vy[count] = velocity.y;
+      inverseMass[count] = body->inverseMass;
+      radius[count] = round[w] >> bit & 1 ? universe->radii[slot].radius : 0.0;
+      count++;
+    }
+  }
+  frame->frame = number;
+  frame->step = universe->stepCount;
+  frame->count = count;
+  frame->dropped = dropped;
+
+  atomic_store_explicit(&frame->sequence, sequence + 2, memory_order_release);
+  atomic_store_explicit(&header->published, number, memory_order_release);
+  return dropped == 0;
+}
+
+Publisher *PublisherOpen(const char *name) {
+  if (!validName(name))
+    return NULL;
+
+  int fd = shm_open(name, O_RDONLY, 0);
+  if (fd < 0)
+    return NULL;
+  struct stat info;
+  Publisher *reader = NULL;
+  if (fstat(fd, &info) == 0 && (size_t)info.st_size >= sizeof(PublishHeader))
+    reader = mapSegment(name, fd, (size_t)info.st_size, false);
+  close(fd);
+  if (!reader)
+    return NULL;
+
+  // A writer still setting up, another version or a truncated segment
+  const PublishHeader *header = reader->header;
+  bool valid = header->magic == PUBLISH_MAGIC;
+  atomic_thread_fence(memory_order_acquire);
+  valid = valid && header->version == PUBLISH_VERSION &&
+          header->frameCount >= 2 &&
+          header->headerBytes + (size_t)header->frameCount *
+                                    header->frameBytes <= reader->bytes;
+  if (!valid) {
+    PublisherClose(reader);
+    return NULL;
+  }
+  return reader;
+}
+
+void PublisherClose(Publisher *publisher) {
+  if (!publisher)
+    return;
+
+  KAccountRelease(K_MEMORY_PUBLISH, sizeof(Publisher) + publisher->bytes);
+  munmap(publisher->header, publisher->bytes);
+  if (publisher->owner)
+    shm_unlink(publisher->name);
+  free(publisher);
+}
+
+bool PublisherReadLatest(const Publisher *reader, PublishSnapshot *snapshot) {
+  if (!reader || !snapshot)
+    return false;
+
+  PublishHeader *header = reader->header;
+  for (;;) {
+    uint64_t number =
+        atomic_load_explicit(&header->published, memory_order_acquire);
+    if (number == 0)
+      return false;
+
+    const unsigned char *base = frameAt(header, number);
+    const PublishFrame *frame = (const PublishFrame *)base;
+    uint64_t sequence = atomic_load_explicit(
+        (_Atomic uint64_t *)&frame->sequence, memory_order_acquire);
+    // The writer lapped the ring onto this frame; take the newer one
+    if (sequence & 1)
+      continue;
+
+    const uint64_t *offsets = header->fieldOffsets;
+    snapshot->frame = frame;
+    snapshot->sequence = sequence;
+    snapshot->step = frame->step;
+    snapshot->count = frame->count;
+    snapshot->entities = (const EntityID *)(base + offsets[PUBLISH_ENTITY]);
+    snapshot->x = (const double *)(base + offsets[PUBLISH_POSITION_X]);
+    snapshot->y = (const double *)(base + offsets[PUBLISH_POSITION_Y]);
+    snapshot->vx = (const double *)(base + offsets[PUBLISH_VELOCITY_X]);
+    snapshot->vy = (const double *)(base + offsets[PUBLISH_VELOCITY_Y]);
+    snapshot->inverseMass =
+        (const double *)(base + offsets[PUBLISH_INVERSE_MASS]);
+    snapshot->radius = (const double *)(base + offsets[PUBLISH_RADIUS]);
+    if (snapshot->count > header->maxEntities)
+      continue; // torn read of the count itself
+    return true;
+  }
+}
+
+bool PublisherReadValid(const Publisher *reader,
+                        const PublishSnapshot *snapshot) {
+  if (!reader || !snapshot || !snapshot->frame)
+    return false;
+
+  // Everything read from the frame happens before the second sequence load
+  atomic_thread_fence(memory_order_acquire);
+  return atomic_load_explicit((_Atomic uint64_t *)&snapshot->frame->sequence,
+                              memory_order_relaxed) == snapshot->sequence;
+}
@@ -0,0 +1,117 @@
+/**
+ * publish.h
+ *
+ * Particle state published into a POSIX shared-memory segment, for analysis
+ * and visualisation processes that map it read-only. The segment starts with
+ * a PublishHeader describing the layout, followed by a ring of frames. Each
+ * frame holds a PublishFrame and one packed array per PublishField, at the
+ * offsets the header lists. Readers use the arrays in place.
+ *
+ * Every frame is guarded by a seqlock. The writer makes the frame's sequence
+ * odd, fills the arrays, makes it even again and then advances `published`.
+ * It never waits for readers, so publishing costs one pass over the
+ * particles whatever the readers do. A reader takes the latest frame, reads
+ * what it needs, and then checks the sequence is unchanged. If it changed,
+ * the writer came round the ring and the reader retries. A ring of N frames
+ * gives readers N - 1 publishes to finish.
+ *
+ *   PublishSnapshot snapshot;
+ *   while (PublisherReadLatest(reader, &snapshot)) {
+ *     ... use snapshot.x[0..snapshot.count) ...
+ *     if (PublisherReadValid(reader, &snapshot))
+ *       break;
+ *   }
+ */
+#ifndef ECS_PUBLISH_H
+#define ECS_PUBLISH_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "universe.h"
+
+#define PUBLISH_MAGIC 0x4b55524147455348ull /* "KURAGESH" */
+#define PUBLISH_VERSION 1u
+#define PUBLISH_NAME_MAX 64
+
+/* Packed per-particle arrays in each frame */
+typedef enum {
+  PUBLISH_ENTITY = 0, /* EntityID (uint32_t) */
+  PUBLISH_POSITION_X, /* double from here on */
+  PUBLISH_POSITION_Y,
+  PUBLISH_VELOCITY_X, /* 0 without a MechanicsComponent */
+  PUBLISH_VELOCITY_Y,
+  PUBLISH_INVERSE_MASS,
+  PUBLISH_RADIUS, /* 0 without a RadiusComponent */
+  PUBLISH_FIELD_COUNT
+} PublishField;
+
+/* Start of the segment; fixed once the publisher is created */
+typedef struct {
+  uint64_t magic;
+  uint32_t version;
+  uint32_t headerBytes; /* the first frame starts here */
+  uint32_t frameCount;
+  uint32_t maxEntities; /* particles a frame holds */
+  uint64_t frameBytes;  /* stride between frames */
+  uint64_t fieldOffsets[PUBLISH_FIELD_COUNT]; /* from the frame start */
+  _Atomic uint64_t published; /* frames published so far */
+} PublishHeader;
+
+typedef struct {
+  _Atomic uint64_t sequence; /* odd while the writer fills the frame */
+  uint64_t frame;            /* number of this publish, from 1 */
+  uint64_t step;             /* universe->stepCount when published */
+  uint32_t count;            /* particles in the arrays */
+  uint32_t dropped;          /* particles beyond maxEntities */
+} PublishFrame;
+
+/* The writer's or a reader's mapping of one segment */
+typedef struct {
+  PublishHeader *header;
+  size_t bytes;
+  bool owner; /* created the segment; unlinks it on close */
+  char name[PUBLISH_NAME_MAX];
+} Publisher;
+
+/* One frame as a reader sees it, pointing into the mapping */
+typedef struct {
+  const PublishFrame *frame;
+  uint64_t sequence;
+  uint64_t step;
+  uint32_t count;
+  const EntityID *entities;
+  const double *x;
+  const double *y;
+  const double *vx;
+  const double *vy;
+  const double *inverseMass;
+  const double *radius;
+} PublishSnapshot;
+
+/**
+ * Creates (or replaces) the segment `name`, e.g. "/kurage", sized for
+ * `maxEntities` particles in each of `frames` frames (at least 2).
+ */
+Publisher *PublisherCreate(const char *name, uint32_t maxEntities,
+                           uint32_t frames);
+
+/* Writes the particles of `universe` into the next frame of the ring */
+bool PublisherPublish(Publisher *publisher, const Universe *universe);
+
+/* Maps an existing segment read-only; NULL if absent or incompatible */
+Publisher *PublisherOpen(const char *name);
+
+/* Unmaps the segment, and removes its name if this is the writer */
+void PublisherClose(Publisher *publisher);
+
+/* The latest complete frame; false if none has been published yet */
+bool PublisherReadLatest(const Publisher *reader, PublishSnapshot *snapshot);
+
+/* True if the frame was not rewritten since PublisherReadLatest */
+bool PublisherReadValid(const Publisher *reader,
+                        const PublishSnapshot *snapshot);
+
+#endif /* ECS_PUBLISH_H */
@@ -0,0 +1,276 @@
+#include "reorder.h"
+
+#include <math.h>
+#include <string.h>
+
+#include "parallel.h"
+#include "spatial.h"
+
+#define RADIX_BITS 8
+#define RADIX_BUCKETS (1u << RADIX_BITS)
+/* Below this many slots thread start-up costs more than it saves */
+#define PARALLEL_SORT_THRESHOLD (1u << 16)
+
+typedef struct {
+  Universe *universe;
+  uint32_t threads;
+  uint32_t count;
+  uint32_t *keys;
+  uint32_t *keysOut;
+  uint32_t *order;
+  uint32_t *orderOut;
+  uint32_t *histograms; /* threads * RADIX_BUCKETS */
+  uint32_t shift;
+  /* Gather state */
+  const unsigned char *source;
+  unsigned char *destination;
+  size_t stride;
+} SortJob;
+
+static uint32_t spreadBits(uint32_t v) {
+  v &= 0x0000FFFFu;
+  v = (v | (v << 8)) & 0x00FF00FFu;
+  v = (v | (v << 4)) & 0x0F0F0F0Fu;
+  v = (v | (v << 2)) & 0x33333333u;
+  v = (v | (v << 1)) & 0x55555555u;
+  return v;
+}
+
+uint32_t MortonEncode2D(uint16_t x, uint16_t y) {
+  return spreadBits(x) | (spreadBits(y) << 1);
+}
+
+/* Grid cell of an offset already scaled to [0, 65535]; NaN lands in 0 */
+static uint16_t quantise(double scaled) {
+  if (!(scaled > 0.0))
+    return 0;
+  return scaled < 65535.0 ? (uint16_t)scaled : 65535;
+}
+
+static void histogramChunk(void *context, uint32_t begin, uint32_t end,
+                           uint32_t thread) {
+  SortJob *job = (SortJob *)context;
+  uint32_t *histogram = &job->histograms[thread * RADIX_BUCKETS];
+
+  memset(histogram, 0, RADIX_BUCKETS * sizeof(uint32_t));
+  for (uint32_t i = begin; i < end; i++)
+    histogram[(job->keys[i] >> job->shift) & (RADIX_BUCKETS - 1)]++;
+}
+
+static void scatterChunk(void *context, uint32_t begin, uint32_t end,
+                         uint32_t thread) {
+  SortJob *job = (SortJob *)context;
+  uint32_t *offsets = &job->histograms[thread * RADIX_BUCKETS];
+
+  for (uint32_t i = begin; i < end; i++) {
+    uint32_t digit = (job->keys[i] >> job->shift) & (RADIX_BUCKETS - 1);
+    uint32_t target = offsets[digit]++;
+    job->keysOut[target] = job->keys[i];
+    job->orderOut[target] = job->order[i];
+  }
+}
+
+static void gatherChunk(void *context, uint32_t begin, uint32_t end,
+                        uint32_t thread) {
+  SortJob *job = (SortJob *)context;
+  (void)thread;
+  for (uint32_t i = begin; i < end; i++)
+    memcpy(job->destination + (size_t)i * job->stride,
+           job->source + (size_t)job->order[i] * job->stride, job->stride);
+}
+
+// Stable LSD radix sort of (keys, order); results end up in keys/order
+static void radixSort(SortJob *job) {
+  for (job->shift = 0; job->shift < 32; job->shift += RADIX_BITS) {
+    ParallelForChunks(job->count, job->threads, histogramChunk, job);
+
+    // Exclusive prefix over (digit, thread) so equal digits keep chunk order
+    uint32_t total = 0;
+    bool uniform = false;
+    for (uint32_t digit = 0; digit < RADIX_BUCKETS; digit++) {
+      uint32_t digitTotal = 0;
+      for (uint32_t t = 0; t < job->threads; t++) {
+        uint32_t *bucket = &job->histograms[t * RADIX_BUCKETS + digit];
+        uint32_t count = *bucket;
+        *bucket = total;
+        total += count;
+        digitTotal += count;
+      }
+      uniform |= digitTotal == job->count;
+    }
+
+    // Every key shares this digit: the pass would be the identity
+    if (uniform)
+      continue;
+
+    ParallelForChunks(job->count, job->threads, scatterChunk, job);
+
+    uint32_t *swap = job->keys;
+    job->keys = job->keysOut;
+    job->keysOut = swap;
+    swap = job->order;
+    job->order = job->orderOut;
+    job->orderOut = swap;
+  }
+}
+
+static void gatherColumn(SortJob *job, void *data, size_t stride,
+                         unsigned char *scratch) {
+  job->source = (const unsigned char *)data;
+  job->destination = scratch;
+  job->stride = stride;
+  ParallelForChunks(job->count, job->threads, gatherChunk, job);
+  memcpy(data, scratch, (size_t)job->count * stride);
+}
+
+static bool ensureScratch(Universe *universe, size_t bytes) {
+  if (universe->reorderScratchBytes >= bytes)
+    return true;
+
+  UniverseRelease(universe, K_MEMORY_REORDER, universe->reorderScratch,
+                  universe->reorderScratchBytes);
+  universe->reorderScratch =
+      UniverseAllocate(universe, K_MEMORY_REORDER, bytes, COLUMN_ALIGNMENT);
+  universe->reorderScratchBytes = universe->reorderScratch ? bytes : 0;
+  return universe->reorderScratch != NULL;
+}
+
+bool UniverseReorderByMorton(Universe *universe) {
+  if (!universe || universe->maxEntities == 0)
+    return false;
+
+  const uint32_t n = universe->maxEntities;
+  const uint32_t words = BITSET_WORDS(n);
+
+  // Bounding box of positioned entities sets the quantisation grid
+  double minX = 0.0, minY = 0.0, maxX = 0.0, maxY = 0.0;
+  bool any = false;
+  for (uint32_t w = 0; w < words; w++) {
+    uint64_t bits =
+        UniverseMatchWord(universe, w, COMPONENT_PARTICLE, COMPONENT_NONE);
+    while (bits) {
+      uint32_t i = w * 64 + (uint32_t)__builtin_ctzll(bits);
+      bits &= bits - 1;
+
+      KVector2 p = universe->kineticBodies[i].position;
+      if (!isfinite(p.x) || !isfinite(p.y))
+        continue;
+      if (!any) {
+        minX = maxX = p.x;
+        minY = maxY = p.y;
+        any = true;
+      }
+      minX = p.x < minX ? p.x : minX;
+      maxX = p.x > maxX ? p.x : maxX;
+      minY = p.y < minY ? p.y : minY;
+      maxY = p.y > maxY ? p.y : maxY;
+    }
+  }
+
+  if (!any)
+    return true;
+
+  size_t widest = n * sizeof(ComponentMask);
+  for (uint32_t c = 0; c < universe->componentCount; c++) {
+    size_t bytes = (size_t)n * universe->columns[c].stride;
+    widest = bytes > widest ? bytes : widest;
+  }
+
+  // The same chunks as the systems, so a worker sorts the slots it steps
+  uint32_t threads = ParallelGetThreads();
+  if (n < PARALLEL_SORT_THRESHOLD)
+    threads = 1;
+
+  size_t arrays = 4 * (size_t)n * sizeof(uint32_t);
+  size_t histograms = (size_t)threads * RADIX_BUCKETS * sizeof(uint32_t);
+  size_t pad = COLUMN_ALIGNMENT;
+  if (!ensureScratch(universe, arrays + histograms + widest + 2 * pad))
+    return false;
+
+  unsigned char *scratch = (unsigned char *)universe->reorderScratch;
+  SortJob job = {0};
+  job.universe = universe;
+  job.threads = threads;
+  job.count = n;
+  job.keys = (uint32_t *)scratch;
+  job.keysOut = job.keys + n;
+  job.order = job.keysOut + n;
+  job.orderOut = job.order + n;
+  job.histograms = job.orderOut + n;
+  unsigned char *columnScratch =
+      scratch + ((arrays + histograms + pad - 1) & ~(pad - 1));
+
+  // A span too wide for a double gives a zero scale, not a NaN
+  double scaleX = maxX > minX ? 65535.0 / (maxX - minX) : 0.0;
+  double scaleY = maxY > minY ? 65535.0 / (maxY - minY) : 0.0;
+
+  for (uint32_t i = 0; i < n; i++) {
+    job.order[i] = i;
+    job.keys[i] = UINT32_MAX;
+    if (UniverseIsSlotActive(universe, i) &&
+        (universe->entityMasks[i] & COMPONENT_PARTICLE)) {
+      // Non-finite positions go last, with the slots that have none
+      KVector2 p = universe->kineticBodies[i].position;
+      if (isfinite(p.x) && isfinite(p.y))
+        job.keys[i] = MortonEncode2D(quantise((p.x - minX) * scaleX),
+                                     quantise((p.y - minY) * scaleY));
+    }
+  }
+
+  radixSort(&job);
+
+  // job.order[newSlot] = oldSlot from here on; keysOut is free scratch
+  uint32_t *wasActive = job.keysOut;
+  for (uint32_t i = 0; i < n; i++)
+    wasActive[i] = UniverseIsSlotActive(universe, job.order[i]);
+
+  for (uint32_t c = 0; c < universe->componentCount; c++)
+    gatherColumn(&job, universe->columns[c].data, universe->columns[c].stride,
+                 columnScratch);
+  gatherColumn(&job, universe->entityMasks, sizeof(ComponentMask),
+               columnScratch);
+  gatherColumn(&job, universe->slotEntities, sizeof(EntityID), columnScratch);
+
+  memset(universe->activeBits, 0, words * sizeof(uint64_t));
+  for (uint32_t c = 0; c < universe->componentCount; c++)
+    memset(universe->componentBits[c], 0, words * sizeof(uint64_t));
+
+  for (uint32_t i = 0; i < n; i++) {
+    uint64_t bit = (uint64_t)1 << (i & 63);
+
+    universe->entitySlots[universe->slotEntities[i]] = i;
+    if (wasActive[i])
+      universe->activeBits[i >> 6] |= bit;
+    for (ComponentMask mask = universe->entityMasks[i]; mask; mask &= mask - 1)
+      universe->componentBits[__builtin_ctzll(mask)][i >> 6] |= bit;
+  }
+
+  // Cached query lists hold slots: translate through the inverse permutation
+  uint32_t *newSlot = job.orderOut;
+  for (uint32_t i = 0; i < n; i++)
+    newSlot[job.order[i]] = i;
+
+  for (uint32_t q = 0; q < universe->queryCount; q++) {
+    EntityQuery *query = &universe->queries[q];
+
+    for (uint32_t i = 0; i < n; i++)
+      query->positions[i] = UINT32_MAX;
+    for (uint32_t k = 0; k < query->count; k++) {
+      query->entities[k] = newSlot[query->entities[k]];
+      query->positions[query->entities[k]] = k;
+    }
+  }
+
+  // The spatial index threads its lists through slots: relink on next use
+  if (universe->spatial)
+    universe->spatial->stale = true;
+
+  return true;
+}
+
+void UniverseSetReorderInterval(Universe *universe, uint32_t steps) {
+  if (!universe)
+    return;
+
+  universe->reorderInterval = steps;
+}
@@ -0,0 +1,37 @@
+/**
+ * reorder.h
+ *
+ * Spatial reordering of universe storage. After many steps, entities that are
+ * neighbours in space end up scattered across the component columns. Sorting
+ * the slots by the Morton (Z-curve) code of their position puts spatial
+ * neighbours next to each other in memory again, which keeps neighbour
+ * searches and tiled rendering in cache.
+ *
+ * EntityIDs are unaffected: only the slot behind each ID moves. Pointers
+ * obtained from UniverseGet*Component and slots read from query lists are
+ * invalidated by a reorder.
+ */
+#ifndef ECS_REORDER_H
+#define ECS_REORDER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "universe.h"
+
+uint32_t MortonEncode2D(uint16_t x, uint16_t y);
+
+/**
+ * Sorts every column by the Morton code of the kinetic body position with an
+ * LSD radix sort, split across the universe's worker threads. Slots without a
+ * position, or with a NaN or infinite one, keep their relative order after
+ * all positioned ones and do not count towards the quantisation grid.
+ *
+ * @return false if scratch memory could not be allocated
+ */
+bool UniverseReorderByMorton(Universe *universe);
+
+/* Reorder automatically every `steps` calls to UniverseUpdate; 0 disables */
+void UniverseSetReorderInterval(Universe *universe, uint32_t steps);
+
+#endif /* ECS_REORDER_H */
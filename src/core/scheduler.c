@@ -0,0 +1,462 @@
+#include "scheduler.h"
+
+#include <string.h>
+#include <time.h>
+
+#include "engine.h"
+#include "physics/diagnostics_internal.h"
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* Built-in systems: adapters from the engine's entry points */
+
+static bool adaptive(const Universe *universe) {
+  return universe->timestep.maxDisplacement > 0.0;
+}
+
+static void lifetimeRun(Universe *universe, double deltaTime) {
+  ParticleLifetimeUpdate(universe, deltaTime);
+}
+
+static void emittersRun(Universe *universe, double deltaTime) {
+  ParticleEmittersUpdate(universe, deltaTime);
+}
+
+static void forcesRun(Universe *universe, double deltaTime) {
+  (void)deltaTime;
+  PhysicsForcesUpdate(universe);
+}
+
+static SystemKernel forcesFuse(const Universe *universe) {
+  (void)universe;
+  return PhysicsForcesWords;
+}
+
+static void fluidRun(Universe *universe, double deltaTime) {
+  (void)deltaTime;
+  PhysicsFluidUpdate(universe);
+}
+
+static void fluidAccess(const Universe *universe, ComponentMask *reads,
+                        ComponentMask *writes) {
+  if (universe->fluidComponent == INVALID_COMPONENT)
+    return;
+  *reads |= COMPONENT_BIT(universe->fluidComponent);
+  *writes |= COMPONENT_BIT(universe->fluidComponent);
+}
+
+static void adaptiveRun(Universe *universe, double deltaTime) {
+  // Substeps resolve the boundary themselves
+  if (adaptive(universe))
+    PhysicsAdaptiveIntegrate(universe, deltaTime);
+}
+
+static void mechanicsRun(Universe *universe, double deltaTime) {
+  if (!adaptive(universe))
+    PhysicsMechanicsUpdate(universe, deltaTime);
+}
+
+static SystemKernel mechanicsFuse(const Universe *universe) {
+  return adaptive(universe) ? NULL : PhysicsMechanicsWords;
+}
+
+static void positionRun(Universe *universe, double deltaTime) {
+  if (!adaptive(universe))
+    PhysicsPositionUpdate(universe, deltaTime);
+}
+
+static SystemKernel positionFuse(const Universe *universe) {
+  // Without walls or obstacles the position pass takes the diagnostics sample
+  if (adaptive(universe) ||
+      (universe->diagnostics.enabled && !universe->boundary.enabled &&
+       !DiagnosticsInObstaclePass(universe)))
+    return NULL;
+  return PhysicsPositionWords;
+}
+
+static void fixedRun(Universe *universe, double deltaTime) {
+  PhysicsFixedUpdate(universe, deltaTime);
+}
+
+static SystemKernel fixedFuse(const Universe *universe) {
+  // Offered even when unused, so the kernels around it stay in one sweep
+  (void)universe;
+  return PhysicsFixedWords;
+}
+
+static void fixedAccess(const Universe *universe, ComponentMask *reads,
+                        ComponentMask *writes) {
+  if (universe->fixedComponent == INVALID_COMPONENT)
+    return;
+  *reads |= COMPONENT_BIT(universe->fixedComponent);
+  *writes |= COMPONENT_BIT(universe->fixedComponent);
+}
+
+static void boundaryRun(Universe *universe, double deltaTime) {
+  (void)deltaTime;
+  if (universe->boundary.enabled && !adaptive(universe))
+    PhysicsResolveBoundaryCollisions(universe);
+}
+
+static void obstaclesRun(Universe *universe, double deltaTime) {
+  (void)deltaTime;
+  PhysicsResolveObstacleCollisions(universe);
+}
+
+static void clearForcesRun(Universe *universe, double deltaTime) {
+  (void)deltaTime;
+  PhysicsClearForces(universe);
+}
+
+static SystemKernel clearForcesFuse(const Universe *universe) {
+  (void)universe;
+  return PhysicsClearForcesWords;
+}
+
+static void rigidRun(Universe *universe, double deltaTime) {
+  PhysicsRigidUpdate(universe, deltaTime);
+}
+
+static void rigidAccess(const Universe *universe, ComponentMask *reads,
+                        ComponentMask *writes) {
+  if (universe->rigidBodyComponent == INVALID_COMPONENT)
+    return;
+  ComponentMask rigid = COMPONENT_BIT(universe->rigidBodyComponent) |
+                        COMPONENT_BIT(universe->rigidShapeComponent);
+  *reads |= rigid;
+  *writes |= rigid;
+}
+
+static void commandsRun(Universe *universe, double deltaTime) {
+  (void)deltaTime;
+  // Sync point: structural changes recorded during the step land here
+  UniverseFlushCommands(universe);
+}
+
+static void chunksRun(Universe *universe, double deltaTime) {
+  (void)deltaTime;
+  UniverseChunksUpdate(universe);
+}
+
+static void reorderRun(Universe *universe, double deltaTime) {
+  (void)deltaTime;
+  // UniverseUpdate counts the step once every system has run
+  if (universe->reorderInterval &&
+      (universe->stepCount + 1) % universe->reorderInterval == 0)
+    UniverseReorderByMorton(universe);
+}
+
+static void spatialRun(Universe *universe, double deltaTime) {
+  (void)deltaTime;
+  UniverseSpatialIndexUpdate(universe);
+}
+
+static const UniverseSystem builtinSystems[] = {
+#define X(name, run, fuse, access, reads, writes, flags)                       \
+  {#name, run, fuse, access, reads, writes, flags},
+    KURAGE_SYSTEM_LIST
+#undef X
+};
+
+#define BUILTIN_SYSTEMS (sizeof(builtinSystems) / sizeof(builtinSystems[0]))
+
+static bool insertSystem(SystemSchedule *systems, const UniverseSystem *system,
+                         int32_t at, int16_t builtin);
+
+/* The schedule, carved and filled with the built-in systems on first use */
+static SystemSchedule *schedule(Universe *universe) {
+  if (universe->schedule)
+    return universe->schedule;
+
+  SystemSchedule *created = (SystemSchedule *)UniverseAllocate(
+      universe, K_MEMORY_SCHEDULER, sizeof(SystemSchedule), COLUMN_ALIGNMENT);
+  if (!created)
+    return NULL;
+  memset(created, 0, sizeof(SystemSchedule));
+  universe->schedule = created;
+
+  for (uint32_t s = 0; s < BUILTIN_SYSTEMS && s < MAX_SYSTEMS; s++)
+    insertSystem(created, &builtinSystems[s], (int32_t)s, (int16_t)s);
+  return created;
+}
+
+static int32_t findSystem(const SystemSchedule *schedule, const char *name) {
+  for (uint32_t s = 0; name && s < schedule->count; s++) {
+    if (strcmp(schedule->names[s], name) == 0)
+      return (int32_t)s;
+  }
+  return -1;
+}
+
+/* Entries from `first` on moved; their names moved with them */
+static void renameFrom(SystemSchedule *schedule, uint32_t first) {
+  for (uint32_t s = first; s < schedule->count; s++)
+    schedule->systems[s].name = schedule->names[s];
+}
+
+/* Adds `system` at `at`; `builtin` is its index in builtinSystems or -1 */
+static bool insertSystem(SystemSchedule *systems, const UniverseSystem *system,
+                         int32_t at, int16_t builtin) {
+  uint32_t tail = systems->count - (uint32_t)at;
+  memmove(&systems->systems[at + 1], &systems->systems[at],
+          tail * sizeof(UniverseSystem));
+  memmove(&systems->names[at + 1], &systems->names[at],
+          tail * sizeof(systems->names[0]));
+  memmove(&systems->builtin[at + 1], &systems->builtin[at],
+          tail * sizeof(systems->builtin[0]));
+  memmove(&systems->timings[at + 1], &systems->timings[at],
+          tail * sizeof(SystemTiming));
+  systems->systems[at] = *system;
+  strcpy(systems->names[at], system->name);
+  systems->builtin[at] = builtin;
+  memset(&systems->timings[at], 0, sizeof(SystemTiming));
+  systems->count++;
+  renameFrom(systems, (uint32_t)at);
+  return true;
+}
+
+bool UniverseRegisterSystem(Universe *universe, const UniverseSystem *system,
+                            const char *before) {
+  SystemSchedule *systems = universe ? schedule(universe) : NULL;
+  if (!systems || !system || !system->name || !system->run ||
+      strlen(system->name) >= SYSTEM_NAME_MAX ||
+      systems->count == MAX_SYSTEMS || findSystem(systems, system->name) >= 0)
+    return false;
+
+  int32_t at = before ? findSystem(systems, before) : (int32_t)systems->count;
+  if (at < 0)
+    return false;
+  return insertSystem(systems, system, at, -1);
+}
+
+bool UniverseRemoveSystem(Universe *universe, const char *name) {
+  SystemSchedule *systems = universe ? schedule(universe) : NULL;
+  int32_t at = systems ? findSystem(systems, name) : -1;
+  if (at < 0)
+    return false;
+
+  uint32_t tail = systems->count - (uint32_t)at - 1;
+  memmove(&systems->systems[at], &systems->systems[at + 1],
+          tail * sizeof(UniverseSystem));
+  memmove(&systems->names[at], &systems->names[at + 1],
+          tail * sizeof(systems->names[0]));
+  memmove(&systems->builtin[at], &systems->builtin[at + 1],
+          tail * sizeof(systems->builtin[0]));
+  memmove(&systems->timings[at], &systems->timings[at + 1],
+          tail * sizeof(SystemTiming));
+  systems->count--;
+  renameFrom(systems, (uint32_t)at);
+  return true;
+}
+
+void UniverseRebindSystems(Universe *universe) {
+  SystemSchedule *systems = universe ? universe->schedule : NULL;
+  if (!systems)
+    return;
+
+  // Names stay in the schedule; only code pointers are taken afresh
+  for (uint32_t s = 0; s < systems->count; s++) {
+    const int16_t builtin = systems->builtin[s];
+    if (builtin < 0 || (uint32_t)builtin >= BUILTIN_SYSTEMS)
+      continue;
+    systems->systems[s] = builtinSystems[builtin];
+    systems->systems[s].name = systems->names[s];
+  }
+  memset(systems->kernels, 0, sizeof(systems->kernels));
+}
+
+const SystemTiming *UniverseSystemTiming(Universe *universe,
+                                         const char *name) {
+  SystemSchedule *systems = universe ? schedule(universe) : NULL;
+  int32_t at = systems ? findSystem(systems, name) : -1;
+  return at < 0 ? NULL : &systems->timings[at];
+}
+
+/* Entities holding each component, counted once per step when needed */
+typedef struct {
+  ComponentMask counted;
+  uint32_t members[MAX_COMPONENTS];
+} MemberCounts;
+
+static uint64_t streamedBytes(const Universe *universe, MemberCounts *counts,
+                              ComponentMask reads, ComponentMask writes) {
+  uint64_t bytes = 0;
+  for (ComponentMask touched = reads | writes; touched;
+       touched &= touched - 1) {
+    const uint32_t c = (uint32_t)__builtin_ctzll(touched);
+    if (c >= universe->componentCount)
+      break;
+    if (!(counts->counted & COMPONENT_BIT(c))) {
+      uint32_t members = 0;
+      for (uint32_t w = 0; w < BITSET_WORDS(universe->maxEntities); w++)
+        members += (uint32_t)__builtin_popcountll(
+            universe->activeBits[w] & universe->componentBits[c][w]);
+      counts->members[c] = members;
+      counts->counted |= COMPONENT_BIT(c);
+    }
+    const uint64_t column =
+        (uint64_t)counts->members[c] * universe->columns[c].stride;
+    bytes += writes & COMPONENT_BIT(c) ? 2 * column : column;
+  }
+  return bytes;
+}
+
+/*
+ * Groups adjacent kernels into runs, then puts each run one stage after the
+ * last earlier run it conflicts with. Runs end up sorted by stage, in
+ * program order within a stage.
+ */
+static void plan(SystemSchedule *systems, const Universe *universe,
+                 ComponentMask *reads, ComponentMask *writes,
+                 uint32_t *flags) {
+  MemberCounts counts = {COMPONENT_NONE, {0}};
+  uint32_t runs = 0;
+  for (uint32_t s = 0; s < systems->count; s++) {
+    const UniverseSystem *system = &systems->systems[s];
+    systems->kernels[s] = system->fuse ? system->fuse(universe) : NULL;
+
+    ComponentMask r = system->reads, w = system->writes;
+    if (system->access)
+      system->access(universe, &r, &w);
+    systems->timings[s].bytesStreamed =
+        streamedBytes(universe, &counts, r, w);
+    bool extend = s > 0 && systems->kernels[s] && systems->kernels[s - 1];
+    if (!extend) {
+      systems->runFirst[runs] = s;
+      systems->runLength[runs] = 0;
+      reads[runs] = writes[runs] = COMPONENT_NONE;
+      flags[runs] = 0;
+      runs++;
+    }
+    systems->runLength[runs - 1]++;
+    reads[runs - 1] |= r;
+    writes[runs - 1] |= w;
+    flags[runs - 1] |= system->flags;
+  }
+
+  uint32_t stages = 0;
+  for (uint32_t j = 0; j < runs; j++) {
+    uint32_t stage = 0;
+    for (uint32_t i = 0; i < j; i++) {
+      bool conflict = ((flags[i] | flags[j]) & SYSTEM_STRUCTURAL) ||
+                      (writes[i] & (reads[j] | writes[j])) ||
+                      (writes[j] & reads[i]);
+      if (conflict && systems->runStage[i] + 1 > stage)
+        stage = systems->runStage[i] + 1;
+    }
+    systems->runStage[j] = stage;
+    stages = stage + 1 > stages ? stage + 1 : stages;
+  }
+
+  // Stable insertion sort by stage; there are never many runs
+  for (uint32_t j = 1; j < runs; j++) {
+    uint32_t first = systems->runFirst[j], length = systems->runLength[j];
+    uint32_t stage = systems->runStage[j], flag = flags[j];
+    uint32_t i = j;
+    for (; i > 0 && systems->runStage[i - 1] > stage; i--) {
+      systems->runFirst[i] = systems->runFirst[i - 1];
+      systems->runLength[i] = systems->runLength[i - 1];
+      systems->runStage[i] = systems->runStage[i - 1];
+      flags[i] = flags[i - 1];
+    }
+    systems->runFirst[i] = first;
+    systems->runLength[i] = length;
+    systems->runStage[i] = stage;
+    flags[i] = flag;
+  }
+  systems->runCount = runs;
+  systems->stageCount = stages;
+}
+
+static void record(SystemSchedule *systems, uint32_t first, uint32_t length,
+                   uint32_t stage, double seconds) {
+  for (uint32_t s = first; s < first + length; s++) {
+    SystemTiming *timing = &systems->timings[s];
+    timing->lastSeconds = seconds;
+    timing->totalSeconds += seconds;
+    timing->runs++;
+    timing->stage = stage;
+    timing->fused = length > 1;
+  }
+}
+
+typedef struct {
+  Universe *universe;
+  SystemSchedule *systems;
+  double deltaTime;
+  uint32_t first;       /* fused sweep: first kernel */
+  uint32_t length;      /* fused sweep: kernel count */
+  const uint32_t *runs; /* side-by-side stage: run indices */
+} ScheduleJob;
+
+static void fusedWords(void *context, uint32_t begin, uint32_t end,
+                       uint32_t chunk) {
+  (void)chunk;
+  const ScheduleJob *job = (const ScheduleJob *)context;
+  const SystemKernel *kernels = &job->systems->kernels[job->first];
+
+  for (uint32_t block = begin; block < end; block += SCHEDULER_FUSE_WORDS) {
+    uint32_t last = block + SCHEDULER_FUSE_WORDS < end
+                        ? block + SCHEDULER_FUSE_WORDS
+                        : end;
+    for (uint32_t k = 0; k < job->length; k++)
+      kernels[k](job->universe, job->deltaTime, block, last);
+  }
+}
+
+static void runOne(Universe *universe, SystemSchedule *systems, uint32_t run,
+                   double deltaTime) {
+  const uint32_t first = systems->runFirst[run];
+  const uint32_t length = systems->runLength[run];
+  double start = now();
+
+  if (length == 1) {
+    systems->systems[first].run(universe, deltaTime);
+  } else {
+    ScheduleJob job = {universe, systems, deltaTime, first, length, NULL};
+    ParallelFor(BITSET_WORDS(universe->maxEntities), PARALLEL_GRAIN_SLOTS / 64,
+                fusedWords, &job);
+  }
+  record(systems, first, length, systems->runStage[run], now() - start);
+}
+
+static void sideBySide(void *context, uint32_t begin, uint32_t end,
+                       uint32_t chunk) {
+  (void)chunk;
+  const ScheduleJob *job = (const ScheduleJob *)context;
+  for (uint32_t r = begin; r < end; r++)
+    runOne(job->universe, job->systems, job->runs[r], job->deltaTime);
+}
+
+void UniverseRunSystems(Universe *universe, double deltaTime) {
+  SystemSchedule *systems = universe ? schedule(universe) : NULL;
+  if (!systems)
+    return;
+
+  ComponentMask reads[MAX_SYSTEMS], writes[MAX_SYSTEMS];
+  uint32_t flags[MAX_SYSTEMS];
+  plan(systems, universe, reads, writes, flags);
+
+  uint32_t narrow[MAX_SYSTEMS];
+  for (uint32_t r = 0; r < systems->runCount;) {
+    const uint32_t stage = systems->runStage[r];
+    uint32_t count = 0;
+    // Wide and fused runs take the pool in turn, in program order
+    for (; r < systems->runCount && systems->runStage[r] == stage; r++) {
+      if ((flags[r] & SYSTEM_WIDE) || systems->runLength[r] > 1)
+        runOne(universe, systems, r, deltaTime);
+      else
+        narrow[count++] = r;
+    }
+    if (count == 1) {
+      runOne(universe, systems, narrow[0], deltaTime);
+    } else if (count > 1) {
+      ScheduleJob job = {universe, systems, deltaTime, 0, 0, narrow};
+      ParallelForChunks(count, count, sideBySide, &job);
+    }
+  }
+}
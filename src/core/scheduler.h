@@ -0,0 +1,161 @@
+/**
+ * scheduler.h
+ *
+ * UniverseUpdate runs a list of systems rather than a fixed sequence. Each
+ * system declares the components it reads and writes. Every step the
+ * scheduler turns the list into a dependency graph and runs it in stages:
+ *
+ *  - Program order is kept between systems that conflict. Two systems
+ *    conflict when one writes a component the other reads or writes, or
+ *    when either is SYSTEM_STRUCTURAL (it creates, destroys or moves
+ *    entities). A system goes one stage after the last system before it
+ *    that it conflicts with.
+ *  - Within a stage nothing conflicts. Systems flagged SYSTEM_WIDE split
+ *    their own work over the worker pool, so they run one after another.
+ *    The other systems of the stage run side by side, one per worker.
+ *  - Adjacent systems that offer a word kernel this step are fused. They
+ *    touch nothing but the components of the entities in the words they
+ *    are given, so one parallel sweep runs every kernel over a block of
+ *    SCHEDULER_FUSE_WORDS words before moving on, while the block is in
+ *    cache.
+ *
+ * The built-in systems are KURAGE_SYSTEM_LIST, in program order. Others are
+ * added with UniverseRegisterSystem, before any named system, without
+ * touching the engine. Wall-clock time is kept per system. Fused systems
+ * share the time of their sweep. An estimate of the memory traffic of each
+ * system is kept next to its time.
+ */
+#ifndef ECS_SCHEDULER_H
+#define ECS_SCHEDULER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "universe.h"
+
+/* Creates, destroys or moves entities: a barrier for every other system */
+#define SYSTEM_STRUCTURAL (1u << 0)
+/* Spreads its own work over the worker pool */
+#define SYSTEM_WIDE (1u << 1)
+
+#define SYSTEM_NAME_MAX 32
+
+typedef void (*SystemRun)(Universe *universe, double deltaTime);
+/* One word range [begin, end) of an entity-local system */
+typedef void (*SystemKernel)(Universe *universe, double deltaTime,
+                             uint32_t begin, uint32_t end);
+/* The kernel to fuse this step, or NULL to call run instead */
+typedef SystemKernel (*SystemFuse)(const Universe *universe);
+/* Adds components only known at run time, such as registered ones */
+typedef void (*SystemAccess)(const Universe *universe, ComponentMask *reads,
+                             ComponentMask *writes);
+
+typedef struct {
+  const char *name;
+  SystemRun run;
+  SystemFuse fuse;     /* NULL: never fused */
+  SystemAccess access; /* NULL: reads and writes are complete */
+  ComponentMask reads;
+  ComponentMask writes;
+  uint32_t flags; /* SYSTEM_* */
+} UniverseSystem;
+
+typedef struct {
+  double lastSeconds;
+  double totalSeconds;
+  uint64_t runs;
+  uint32_t stage; /* stage of the last step */
+  bool fused;     /* the last step ran it in a fused sweep */
+  /* Column bytes the last step streamed: every entity holding a component
+   * the system reads or writes, written ones counted twice */
+  uint64_t bytesStreamed;
+} SystemTiming;
+
+/*
+ * X(name, run, fuse, access, reads, writes, flags) for every built-in system,
+ * in the order UniverseUpdate has always run them.
+ */
+#define SYSTEM_PARTICLE_STATE (COMPONENT_PARTICLE | COMPONENT_MECHANICS)
+#define KURAGE_SYSTEM_LIST                                                     \
+  X(lifetime, lifetimeRun, NULL, NULL, COMPONENT_NONE, COMPONENT_NONE,         \
+    SYSTEM_STRUCTURAL)                                                         \
+  X(emitters, emittersRun, NULL, NULL, COMPONENT_NONE, COMPONENT_NONE,         \
+    SYSTEM_STRUCTURAL)                                                         \
+  X(forces, forcesRun, forcesFuse, NULL, SYSTEM_PARTICLE_STATE,                \
+    COMPONENT_MECHANICS, SYSTEM_WIDE)                                          \
+  X(fluid, fluidRun, NULL, fluidAccess, SYSTEM_PARTICLE_STATE,                 \
+    COMPONENT_MECHANICS, SYSTEM_WIDE)                                          \
+  X(adaptive, adaptiveRun, NULL, NULL,                                         \
+    SYSTEM_PARTICLE_STATE | COMPONENT_RADIUS, SYSTEM_PARTICLE_STATE,           \
+    SYSTEM_WIDE)                                                               \
+  X(mechanics, mechanicsRun, mechanicsFuse, NULL, SYSTEM_PARTICLE_STATE,       \
+    COMPONENT_MECHANICS, SYSTEM_WIDE)                                          \
+  X(position, positionRun, positionFuse, NULL, SYSTEM_PARTICLE_STATE,          \
+    COMPONENT_PARTICLE, SYSTEM_WIDE)                                           \
+  X(fixed, fixedRun, fixedFuse, fixedAccess, COMPONENT_PARTICLE,               \
+    COMPONENT_PARTICLE, SYSTEM_WIDE)                                           \
+  X(boundary, boundaryRun, NULL, NULL,                                         \
+    SYSTEM_PARTICLE_STATE | COMPONENT_RADIUS, SYSTEM_PARTICLE_STATE,           \
+    SYSTEM_WIDE)                                                               \
+  X(obstacles, obstaclesRun, NULL, NULL,                                       \
+    SYSTEM_PARTICLE_STATE | COMPONENT_RADIUS, SYSTEM_PARTICLE_STATE,           \
+    SYSTEM_WIDE)                                                               \
+  X(clearForces, clearForcesRun, clearForcesFuse, NULL, COMPONENT_NONE,        \
+    COMPONENT_MECHANICS, SYSTEM_WIDE)                                          \
+  X(rigid, rigidRun, NULL, rigidAccess, COMPONENT_NONE, COMPONENT_NONE,        \
+    SYSTEM_WIDE)                                                               \
+  X(commands, commandsRun, NULL, NULL, COMPONENT_NONE, COMPONENT_NONE,         \
+    SYSTEM_STRUCTURAL)                                                         \
+  X(chunks, chunksRun, NULL, NULL, COMPONENT_NONE, COMPONENT_NONE,             \
+    SYSTEM_STRUCTURAL)                                                         \
+  X(reorder, reorderRun, NULL, NULL, COMPONENT_NONE, COMPONENT_NONE,           \
+    SYSTEM_STRUCTURAL)                                                         \
+  X(spatial, spatialRun, NULL, NULL, COMPONENT_PARTICLE, COMPONENT_NONE, 0)
+
+/**
+ * Systems in program order and the plan of the last step. Carved from the
+ * universe allocator with the built-in systems on first use.
+ */
+typedef struct SystemSchedule {
+  uint32_t count;
+  uint32_t stageCount; /* stages of the last step */
+  UniverseSystem systems[MAX_SYSTEMS];
+  char names[MAX_SYSTEMS][SYSTEM_NAME_MAX];
+  /* Index in KURAGE_SYSTEM_LIST, or -1 for a registered system */
+  int16_t builtin[MAX_SYSTEMS];
+  SystemTiming timings[MAX_SYSTEMS];
+  /* Plan of the last step: runs of systems, sorted by stage */
+  SystemKernel kernels[MAX_SYSTEMS]; /* offered for this step, or NULL */
+  uint32_t runFirst[MAX_SYSTEMS];    /* first system of each run */
+  uint32_t runLength[MAX_SYSTEMS];   /* above 1 for a fused run */
+  uint32_t runStage[MAX_SYSTEMS];
+  uint32_t runCount;
+} SystemSchedule;
+
+/**
+ * Adds `system` before the system named `before`, or last if `before` is
+ * NULL. The name is copied. Fails on a duplicate or unknown name, or when
+ * MAX_SYSTEMS are registered.
+ */
+bool UniverseRegisterSystem(Universe *universe, const UniverseSystem *system,
+                            const char *before);
+
+/* Takes a system, built-in or not, out of the schedule */
+bool UniverseRemoveSystem(Universe *universe, const char *name);
+
+/* Timing of the named system, or NULL */
+const SystemTiming *UniverseSystemTiming(Universe *universe, const char *name);
+
+/**
+ * Points the built-in systems at this copy of the library, by their index
+ * in KURAGE_SYSTEM_LIST, and drops the plan of the last step. Called by
+ * UniverseRebind after a hot reload. Registered systems are left as they
+ * are: ones whose code lives in the reloaded library must be removed and
+ * registered again.
+ */
+void UniverseRebindSystems(Universe *universe);
+
+/* Plans and runs every system once; called by UniverseUpdate */
+void UniverseRunSystems(Universe *universe, double deltaTime);
+
+#endif /* ECS_SCHEDULER_H */
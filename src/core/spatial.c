@@ -0,0 +1,422 @@
+#include "spatial.h"
+
+#include <math.h>
+#include <string.h>
+
+#include "parallel.h"
+
+/* Queries handed to one worker at a time by the batched calls */
+#define SPATIAL_GRAIN 64
+
+/* Cell coordinates stay well inside int32 so neighbours never wrap */
+#define SPATIAL_CELL_LIMIT 1073741824.0
+
+#define SPATIAL_NONE UINT32_MAX
+
+static size_t alignUp(size_t bytes) {
+  return (bytes + COLUMN_ALIGNMENT - 1) & ~(size_t)(COLUMN_ALIGNMENT - 1);
+}
+
+static int32_t cellCoordinate(double value, double inverseCellSize) {
+  double c = floor(value * inverseCellSize);
+  if (c < -SPATIAL_CELL_LIMIT)
+    return (int32_t)-SPATIAL_CELL_LIMIT;
+  return c > SPATIAL_CELL_LIMIT ? (int32_t)SPATIAL_CELL_LIMIT : (int32_t)c;
+}
+
+static inline uint64_t packCell(int32_t cx, int32_t cy) {
+  return (uint64_t)(uint32_t)cx << 32 | (uint32_t)cy;
+}
+
+static inline uint32_t bucketOf(const SpatialIndex *index, int32_t cx,
+                                int32_t cy) {
+  uint32_t h = (uint32_t)cx * 0x9E3779B1u ^ (uint32_t)cy * 0x85EBCA77u;
+  return (h ^ h >> 16) & (index->bucketCount - 1);
+}
+
+static SpatialIndex *createIndex(Universe *universe, double cellSize) {
+  const uint32_t n = universe->maxEntities;
+  uint32_t buckets = 64;
+  while (buckets < n)
+    buckets <<= 1;
+
+  size_t header = alignUp(sizeof(SpatialIndex));
+  size_t heads = alignUp((size_t)buckets * sizeof(uint32_t));
+  size_t links = alignUp((size_t)n * sizeof(uint32_t));
+  size_t cells = alignUp((size_t)n * sizeof(uint64_t));
+  size_t members = alignUp((size_t)BITSET_WORDS(n) * sizeof(uint64_t));
+
+  unsigned char *block = (unsigned char *)UniverseAllocate(
+      universe, K_MEMORY_SPATIAL, header + heads + 2 * links + cells + members,
+      COLUMN_ALIGNMENT);
+  if (!block)
+    return NULL;
+
+  SpatialIndex *index = (SpatialIndex *)block;
+  unsigned char *cursor = block + header;
+  *index = (SpatialIndex){0};
+  index->cellSize = cellSize;
+  index->inverseCellSize = 1.0 / cellSize;
+  index->bucketCount = buckets;
+  index->stale = true; // the first update links everything
+  index->heads = (uint32_t *)cursor;
+  index->next = (uint32_t *)(cursor += heads);
+  index->prev = (uint32_t *)(cursor += links);
+  index->cells = (uint64_t *)(cursor += links);
+  index->members = (uint64_t *)(cursor += cells);
+  return index;
+}
+
+bool UniverseSpatialIndexEnable(Universe *universe, double cellSize) {
+  if (!universe)
+    return false;
+  if (universe->spatial)
+    return true;
+  if (!(cellSize > 0.0) || !isfinite(cellSize))
+    return false;
+
+  universe->spatial = createIndex(universe, cellSize);
+  if (!universe->spatial)
+    return false;
+  UniverseSpatialIndexUpdate(universe);
+  return true;
+}
+
+static void unlinkSlot(SpatialIndex *index, uint32_t slot) {
+  uint64_t cell = index->cells[slot];
+  uint32_t next = index->next[slot], prev = index->prev[slot];
+  if (prev != SPATIAL_NONE)
+    index->next[prev] = next;
+  else
+    index->heads[bucketOf(index, (int32_t)(cell >> 32), (int32_t)cell)] =
+        next;
+  if (next != SPATIAL_NONE)
+    index->prev[next] = prev;
+  index->members[slot >> 6] &= ~((uint64_t)1 << (slot & 63));
+  index->count--;
+}
+
+static void linkSlot(SpatialIndex *index, uint32_t slot, int32_t cx,
+                     int32_t cy) {
+  uint32_t *head = &index->heads[bucketOf(index, cx, cy)];
+  index->cells[slot] = packCell(cx, cy);
+  index->prev[slot] = SPATIAL_NONE;
+  index->next[slot] = *head;
+  if (*head != SPATIAL_NONE)
+    index->prev[*head] = slot;
+  *head = slot;
+  index->members[slot >> 6] |= (uint64_t)1 << (slot & 63);
+  index->count++;
+}
+
+void UniverseSpatialIndexUpdate(Universe *universe) {
+  SpatialIndex *index = universe ? universe->spatial : NULL;
+  if (!index)
+    return;
+
+  const uint32_t n = universe->maxEntities;
+  const uint32_t words = BITSET_WORDS(n);
+  if (index->stale) {
+    // A reorder moved the slots under the lists; start over
+    memset(index->heads, 0xff, index->bucketCount * sizeof(uint32_t));
+    memset(index->members, 0, words * sizeof(uint64_t));
+    for (uint32_t i = 0; i < n; i++)
+      index->cells[i] = SPATIAL_NO_CELL;
+    index->count = 0;
+    index->stale = false;
+  }
+
+  KVector2 lo = {INFINITY, INFINITY};
+  KVector2 hi = {-INFINITY, -INFINITY};
+  uint64_t relinked = 0;
+  for (uint32_t w = 0; w < words; w++) {
+    uint64_t matched =
+        UniverseMatchWord(universe, w, COMPONENT_PARTICLE, COMPONENT_NONE);
+    // Indexed slots that no longer match are visited to be unlinked
+    uint64_t bits = matched | index->members[w];
+    while (bits) {
+      uint32_t bit = (uint32_t)__builtin_ctzll(bits);
+      uint32_t slot = w * 64 + bit;
+      bits &= bits - 1;
+
+      uint64_t cell = SPATIAL_NO_CELL;
+      int32_t cx = 0, cy = 0;
+      KVector2 p = universe->kineticBodies[slot].position;
+      if ((matched >> bit & 1) && isfinite(p.x) && isfinite(p.y)) {
+        cx = cellCoordinate(p.x, index->inverseCellSize);
+        cy = cellCoordinate(p.y, index->inverseCellSize);
+        cell = packCell(cx, cy);
+        lo.x = p.x < lo.x ? p.x : lo.x;
+        lo.y = p.y < lo.y ? p.y : lo.y;
+        hi.x = p.x > hi.x ? p.x : hi.x;
+        hi.y = p.y > hi.y ? p.y : hi.y;
+      }
+      if (cell == index->cells[slot])
+        continue;
+
+      if (index->cells[slot] != SPATIAL_NO_CELL)
+        unlinkSlot(index, slot);
+      index->cells[slot] = cell;
+      if (cell != SPATIAL_NO_CELL)
+        linkSlot(index, slot, cx, cy);
+      relinked++;
+    }
+  }
+
+  index->boundsMin = lo;
+  index->boundsMax = hi;
+  index->relinked = relinked;
+}
+
+/* The index, relinked first if a reorder left it stale */
+static const SpatialIndex *prepare(Universe *universe) {
+  SpatialIndex *index = universe ? universe->spatial : NULL;
+  if (index && index->stale)
+    UniverseSpatialIndexUpdate(universe);
+  return index;
+}
+
+/*
+ * Region queries. A region covering more cells than there are buckets walks
+ * every bucket once instead, so no slot is seen twice.
+ */
+typedef struct {
+  KVector2 min; /* box, or the bounding box of the circle */
+  KVector2 max;
+  KVector2 centre;
+  double radiusSquared; /* negative for box queries */
+} SpatialRegion;
+
+static inline bool regionContains(const SpatialRegion *region, KVector2 p) {
+  if (region->radiusSquared < 0.0)
+    return (p.x >= region->min.x) & (p.x <= region->max.x) &
+           (p.y >= region->min.y) & (p.y <= region->max.y);
+  double dx = p.x - region->centre.x, dy = p.y - region->centre.y;
+  return dx * dx + dy * dy <= region->radiusSquared;
+}
+
+static uint32_t collectList(const Universe *universe,
+                            const SpatialIndex *index, uint32_t slot,
+                            uint64_t cell, const SpatialRegion *region,
+                            EntityID *out, uint32_t capacity,
+                            uint32_t found) {
+  for (; slot != SPATIAL_NONE; slot = index->next[slot]) {
+    // Buckets are shared by cells that hash alike
+    if (cell != SPATIAL_NO_CELL && index->cells[slot] != cell)
+      continue;
+    if (!UniverseIsSlotActive(universe, slot) ||
+        !regionContains(region, universe->kineticBodies[slot].position))
+      continue;
+    if (found < capacity)
+      out[found] = UniverseSlotEntity(universe, slot);
+    found++;
+  }
+  return found;
+}
+
+static uint32_t collectRegion(const Universe *universe,
+                              const SpatialIndex *index,
+                              const SpatialRegion *region, EntityID *out,
+                              uint32_t capacity) {
+  if (!(region->min.x <= region->max.x) || !(region->min.y <= region->max.y))
+    return 0;
+
+  const int32_t x0 = cellCoordinate(region->min.x, index->inverseCellSize);
+  const int32_t x1 = cellCoordinate(region->max.x, index->inverseCellSize);
+  const int32_t y0 = cellCoordinate(region->min.y, index->inverseCellSize);
+  const int32_t y1 = cellCoordinate(region->max.y, index->inverseCellSize);
+  uint32_t found = 0;
+
+  double cells = ((double)x1 - x0 + 1.0) * ((double)y1 - y0 + 1.0);
+  if (cells > index->bucketCount) {
+    for (uint32_t b = 0; b < index->bucketCount; b++)
+      found = collectList(universe, index, index->heads[b], SPATIAL_NO_CELL,
+                          region, out, capacity, found);
+    return found;
+  }
+
+  for (int32_t cy = y0; cy <= y1; cy++) {
+    for (int32_t cx = x0; cx <= x1; cx++)
+      found = collectList(universe, index,
+                          index->heads[bucketOf(index, cx, cy)],
+                          packCell(cx, cy), region, out, capacity, found);
+  }
+  return found;
+}
+
+static uint32_t queryRadius(const Universe *universe,
+                            const SpatialIndex *index, KVector2 centre,
+                            double radius, EntityID *out, uint32_t capacity) {
+  if (!(radius >= 0.0))
+    return 0;
+  SpatialRegion region = {{centre.x - radius, centre.y - radius},
+                          {centre.x + radius, centre.y + radius},
+                          centre,
+                          radius * radius};
+  return collectRegion(universe, index, &region, out, capacity);
+}
+
+uint32_t UniverseQueryRadius(Universe *universe, KVector2 centre,
+                             double radius, EntityID *out, uint32_t capacity) {
+  const SpatialIndex *index = prepare(universe);
+  if (!index)
+    return 0;
+  return queryRadius(universe, index, centre, radius, out, capacity);
+}
+
+uint32_t UniverseQueryAABB(Universe *universe, KVector2 min, KVector2 max,
+                           EntityID *out, uint32_t capacity) {
+  const SpatialIndex *index = prepare(universe);
+  if (!index)
+    return 0;
+  SpatialRegion region = {min, max, {0.0, 0.0}, -1.0};
+  return collectRegion(universe, index, &region, out, capacity);
+}
+
+/* Closest slot of one list to `point`, improving on *best */
+static uint32_t nearestInList(const Universe *universe,
+                              const SpatialIndex *index, uint32_t slot,
+                              uint64_t cell, KVector2 point, double *best,
+                              uint32_t bestSlot) {
+  for (; slot != SPATIAL_NONE; slot = index->next[slot]) {
+    if (cell != SPATIAL_NO_CELL && index->cells[slot] != cell)
+      continue;
+    if (!UniverseIsSlotActive(universe, slot))
+      continue;
+    KVector2 p = universe->kineticBodies[slot].position;
+    double dx = p.x - point.x, dy = p.y - point.y;
+    double d = dx * dx + dy * dy;
+    if (d <= *best) {
+      *best = d;
+      bestSlot = slot;
+    }
+  }
+  return bestSlot;
+}
+
+static inline int32_t largest(int32_t a, int32_t b) { return a > b ? a : b; }
+
+/*
+ * Rings of cells around the point's cell, outwards. Once ring r is done,
+ * anything not yet seen is more than r cells away, so the search stops as
+ * soon as the best distance is within that. Rings stop at the bounds of the
+ * indexed positions and at maxDistance.
+ */
+static EntityID queryNearest(const Universe *universe,
+                             const SpatialIndex *index, KVector2 point,
+                             double maxDistance) {
+  if (index->count == 0 || !(maxDistance >= 0.0) || !isfinite(point.x) ||
+      !isfinite(point.y))
+    return INVALID_ENTITY;
+
+  const double inverse = index->inverseCellSize;
+  const int32_t cx = cellCoordinate(point.x, inverse);
+  const int32_t cy = cellCoordinate(point.y, inverse);
+  int32_t rings = largest(
+      largest(cx - cellCoordinate(index->boundsMin.x, inverse),
+              cellCoordinate(index->boundsMax.x, inverse) - cx),
+      largest(cy - cellCoordinate(index->boundsMin.y, inverse),
+              cellCoordinate(index->boundsMax.y, inverse) - cy));
+  if (maxDistance * inverse + 1.0 < rings)
+    rings = (int32_t)(maxDistance * inverse) + 1;
+
+  double best = maxDistance * maxDistance;
+  uint32_t bestSlot = SPATIAL_NONE;
+  for (int32_t r = 0; r <= rings; r++) {
+    if ((2.0 * r + 1.0) * (2.0 * r + 1.0) > index->bucketCount) {
+      // Wider than the table: every bucket once is cheaper
+      for (uint32_t b = 0; b < index->bucketCount; b++)
+        bestSlot = nearestInList(universe, index, index->heads[b],
+                                 SPATIAL_NO_CELL, point, &best, bestSlot);
+      break;
+    }
+
+    for (int32_t dy = -r; dy <= r; dy++) {
+      // Whole rows at the top and bottom of the ring, the ends in between
+      int32_t step = (dy == -r || dy == r) ? 1 : 2 * r;
+      for (int32_t dx = -r; dx <= r; dx += step) {
+        int32_t x = cx + dx, y = cy + dy;
+        bestSlot = nearestInList(universe, index,
+                                 index->heads[bucketOf(index, x, y)],
+                                 packCell(x, y), point, &best, bestSlot);
+      }
+    }
+
+    double reach = r * index->cellSize;
+    if (bestSlot != SPATIAL_NONE && best <= reach * reach)
+      break;
+  }
+
+  return bestSlot == SPATIAL_NONE ? INVALID_ENTITY
+                                  : UniverseSlotEntity(universe, bestSlot);
+}
+
+EntityID UniverseQueryNearest(Universe *universe, KVector2 point,
+                              double maxDistance) {
+  const SpatialIndex *index = prepare(universe);
+  if (!index)
+    return INVALID_ENTITY;
+  return queryNearest(universe, index, point, maxDistance);
+}
+
+typedef struct {
+  const Universe *universe;
+  const SpatialIndex *index;
+  const KVector2 *points;
+  const double *radii;
+  double maxDistance;
+  EntityID *out;
+  uint32_t perQuery;
+  uint32_t *counts;
+} SpatialBatch;
+
+static void radiusChunk(void *context, uint32_t begin, uint32_t end,
+                        uint32_t chunk) {
+  (void)chunk;
+  const SpatialBatch *batch = (const SpatialBatch *)context;
+  for (uint32_t q = begin; q < end; q++)
+    batch->counts[q] =
+        queryRadius(batch->universe, batch->index, batch->points[q],
+                    batch->radii[q], batch->out + (size_t)q * batch->perQuery,
+                    batch->perQuery);
+}
+
+static void nearestChunk(void *context, uint32_t begin, uint32_t end,
+                         uint32_t chunk) {
+  (void)chunk;
+  const SpatialBatch *batch = (const SpatialBatch *)context;
+  for (uint32_t q = begin; q < end; q++)
+    batch->out[q] = queryNearest(batch->universe, batch->index,
+                                 batch->points[q], batch->maxDistance);
+}
+
+void UniverseQueryRadiusBatch(Universe *universe, const KVector2 *centres,
+                              const double *radii, uint32_t count,
+                              EntityID *out, uint32_t perQuery,
+                              uint32_t *counts) {
+  const SpatialIndex *index = prepare(universe);
+  if (!index) {
+    for (uint32_t q = 0; q < count; q++)
+      counts[q] = 0;
+    return;
+  }
+
+  SpatialBatch batch = {universe, index, centres, radii,
+                        0.0,      out,   perQuery, counts};
+  ParallelFor(count, SPATIAL_GRAIN, radiusChunk, &batch);
+}
+
+void UniverseQueryNearestBatch(Universe *universe, const KVector2 *points,
+                               uint32_t count, double maxDistance,
+                               EntityID *out) {
+  const SpatialIndex *index = prepare(universe);
+  if (!index) {
+    for (uint32_t q = 0; q < count; q++)
+      out[q] = INVALID_ENTITY;
+    return;
+  }
+
+  SpatialBatch batch = {universe, index, points, NULL,
+                        maxDistance, out, 0, NULL};
+  ParallelFor(count, SPATIAL_GRAIN, nearestChunk, &batch);
+}
@@ -0,0 +1,92 @@
+/**
+ * spatial.h
+ *
+ * Spatial queries over particle positions: everything within a radius or a
+ * box, and the nearest particle to a point. They are answered from a hashed
+ * uniform grid kept on the universe. Each storage slot is threaded into a
+ * doubly linked list for the bucket of its cell. The index is maintained
+ * incrementally: an update re-reads the positions and only relinks slots
+ * whose cell changed, or that were created or destroyed since.
+ *
+ * UniverseUpdate refreshes the index at the end of every step. Positions or
+ * entities changed outside a step show up after the next step or an explicit
+ * UniverseSpatialIndexUpdate. Query tests use the current positions, so a
+ * particle that moved since the refresh is only missed if it also left its
+ * cell's neighbourhood of the query.
+ *
+ * Queries never allocate. Results are EntityIDs written into caller buffers.
+ * The return value is the number of matches, which may exceed the capacity
+ * of the buffer, as with snprintf. Batched variants spread many queries over
+ * the worker threads (see parallel.h).
+ */
+#ifndef ECS_SPATIAL_H
+#define ECS_SPATIAL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "universe.h"
+
+/**
+ * Index state, carved from the universe allocator in one block by
+ * UniverseSpatialIndexEnable. Slot arrays are indexed by storage slot.
+ */
+typedef struct SpatialIndex {
+  double cellSize;
+  double inverseCellSize;
+  uint32_t bucketCount; /* power of two */
+  uint32_t count;       /* slots in the index */
+  bool stale;           /* slots were moved by a reorder; relink all */
+  KVector2 boundsMin;   /* of the indexed positions at the last update */
+  KVector2 boundsMax;
+  uint32_t *heads; /* bucketCount list heads, UINT32_MAX when empty */
+  uint32_t *next;
+  uint32_t *prev;
+  uint64_t *cells;   /* packed cell coordinates, SPATIAL_NO_CELL if absent */
+  uint64_t *members; /* bitset of indexed slots */
+  uint64_t relinked; /* slots relinked by the last update */
+} SpatialIndex;
+
+/* Packed cell of no slot; real cells stay within +-2^30 */
+#define SPATIAL_NO_CELL 0x8000000080000000ull
+
+/**
+ * Carves the index and links every particle. Cells should be about the size
+ * of a typical query radius. Calling it again keeps the index and its cell
+ * size.
+ */
+bool UniverseSpatialIndexEnable(Universe *universe, double cellSize);
+
+/* Relinks the particles that changed cell; called by UniverseUpdate */
+void UniverseSpatialIndexUpdate(Universe *universe);
+
+/* Particles whose position lies within `radius` of `centre` */
+uint32_t UniverseQueryRadius(Universe *universe, KVector2 centre,
+                             double radius, EntityID *out, uint32_t capacity);
+
+/* Particles whose position lies inside [min, max], bounds included */
+uint32_t UniverseQueryAABB(Universe *universe, KVector2 min, KVector2 max,
+                           EntityID *out, uint32_t capacity);
+
+/**
+ * The particle closest to `point` within `maxDistance` (INFINITY for no
+ * limit), or INVALID_ENTITY.
+ */
+EntityID UniverseQueryNearest(Universe *universe, KVector2 point,
+                              double maxDistance);
+
+/**
+ * `count` radius queries at once. Query q writes up to `perQuery` results
+ * to out[q * perQuery ...] and its match count to counts[q].
+ */
+void UniverseQueryRadiusBatch(Universe *universe, const KVector2 *centres,
+                              const double *radii, uint32_t count,
+                              EntityID *out, uint32_t perQuery,
+                              uint32_t *counts);
+
+/* `count` nearest queries at once; out[q] is the answer for points[q] */
+void UniverseQueryNearestBatch(Universe *universe, const KVector2 *points,
+                               uint32_t count, double maxDistance,
+                               EntityID *out);
+
+#endif /* ECS_SPATIAL_H */
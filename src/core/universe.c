@@ -2,29 +2,224 @@
 
 #include <math.h>
 #include <stdlib.h>
+#include <string.h>
+
+#include "chunks.h"
+#include "scheduler.h"
+
+static void setBit(uint64_t *bits, uint32_t slot) {
+  bits[slot >> 6] |= (uint64_t)1 << (slot & 63);
+}
+
+static void clearBit(uint64_t *bits, uint32_t slot) {
+  bits[slot >> 6] &= ~((uint64_t)1 << (slot & 63));
+}
+
+static bool queryMatches(const EntityQuery *query, ComponentMask mask) {
+  return (mask & query->required) == query->required &&
+         !(mask & query->excluded);
+}
+
+static void queryInsert(EntityQuery *query, uint32_t slot) {
+  query->positions[slot] = query->count;
+  query->entities[query->count++] = slot;
+}
+
+static void queryRemove(EntityQuery *query, uint32_t slot) {
+  uint32_t position = query->positions[slot];
+  uint32_t last = query->entities[--query->count];
+
+  query->entities[position] = last;
+  query->positions[last] = position;
+  query->positions[slot] = UINT32_MAX;
+}
+
+// Called after every structural change to keep the cached lists in sync.
+static void updateQueries(Universe *universe, uint32_t slot) {
+  ComponentMask mask = universe->entityMasks[slot];
+
+  for (uint32_t q = 0; q < universe->queryCount; q++) {
+    EntityQuery *query = &universe->queries[q];
+    bool listed = query->positions[slot] != UINT32_MAX;
+    bool matches = queryMatches(query, mask);
+
+    if (matches && !listed)
+      queryInsert(query, slot);
+    else if (!matches && listed)
+      queryRemove(query, slot);
+  }
+}
+
+/* Queries the built-in systems create; sized into the arena up front */
+#define ARENA_RESERVED_QUERIES 4
+
+size_t UniverseEstimateBytes(uint32_t maxEntities,
+                             const UniverseOptions *options) {
+  UniverseOptions defaults = {0};
+  if (!options)
+    options = &defaults;
+
+  size_t perEntity = sizeof(ComponentMask) + 3 * sizeof(EntityID) +
+                     sizeof(KineticBodyComponent) +
+                     sizeof(MechanicsComponent) + sizeof(RadiusComponent) +
+                     ARENA_RESERVED_QUERIES *
+                         (sizeof(EntityID) + sizeof(uint32_t)) +
+                     options->reserveBytesPerEntity;
+
+  size_t bitsets = BITSET_WORDS(maxEntities) * sizeof(uint64_t) *
+                   (1 + COMPONENT_BUILTIN_COUNT);
+
+  // One alignment pad per possible allocation
+  return sizeof(Universe) + (size_t)maxEntities * perEntity + bitsets +
+         (MAX_COMPONENTS + 2 * MAX_QUERIES + 4) * COLUMN_ALIGNMENT;
+}
+
+void *UniverseAllocate(Universe *universe, KMemoryOwner owner, size_t bytes,
+                       size_t alignment) {
+  void *data = universe->allocator.allocate(universe->allocator.context,
+                                            bytes, alignment);
+  if (data && (unsigned)owner < K_MEMORY_OWNERS) {
+    universe->memoryBytes[owner] += bytes;
+    KAccountAllocation(owner, bytes);
+  }
+  return data;
+}
+
+void UniverseRelease(Universe *universe, KMemoryOwner owner, void *data,
+                     size_t bytes) {
+  if (!data)
+    return;
+
+  universe->allocator.release(universe->allocator.context, data);
+  if ((unsigned)owner < K_MEMORY_OWNERS) {
+    universe->memoryBytes[owner] -= bytes;
+    KAccountRelease(owner, bytes);
+  }
+}
+
+static void *universeAllocate(Universe *universe, KMemoryOwner owner,
+                              size_t bytes) {
+  void *data = UniverseAllocate(universe, owner, bytes, COLUMN_ALIGNMENT);
+
+  // Fresh arena pages are untouched; let the workers fault them in
+  if (data && universe->arena && universe->touchThreads > 1)
+    KFirstTouch(data, bytes, universe->touchThreads);
+
+  return data;
+}
+
+static void universeRelease(Universe *universe, void *data) {
+  if (data)
+    universe->allocator.release(universe->allocator.context, data);
+}
 
 Universe *UniverseCreate(uint32_t maxEntities) {
-  Universe *universe = (Universe *)malloc(sizeof(Universe));
-  if (!universe)
+  return UniverseCreateWithOptions(maxEntities, NULL);
+}
+
+Universe *UniverseCreateWithOptions(uint32_t maxEntities,
+                                    const UniverseOptions *options) {
+  UniverseOptions defaults = {0};
+  if (!options)
+    options = &defaults;
+
+  KArena *arena = NULL;
+  KAllocator allocator;
+
+  if (options->allocator) {
+    allocator = *options->allocator;
+  } else {
+    arena = KArenaCreate(UniverseEstimateBytes(maxEntities, options),
+                         options->hugePages);
+    if (!arena)
+      return NULL;
+    allocator = KArenaAllocator(arena);
+  }
+
+  Universe *universe = (Universe *)allocator.allocate(
+      allocator.context, sizeof(Universe), COLUMN_ALIGNMENT);
+  if (!universe) {
+    KArenaDestroy(arena);
     return NULL;
+  }
+
+  universe->allocator = allocator;
+  universe->arena = arena;
+  memset(universe->memoryBytes, 0, sizeof(universe->memoryBytes));
+  universe->memoryBytes[K_MEMORY_UNIVERSE] = sizeof(Universe);
+  KAccountAllocation(K_MEMORY_UNIVERSE, sizeof(Universe));
+  universe->touchThreads = options->touchThreads;
+  universe->reorderInterval = 0;
+  universe->stepCount = 0;
+  universe->reorderScratch = NULL;
+  universe->reorderScratchBytes = 0;
+  memset(&universe->timestep, 0, sizeof(universe->timestep));
+  memset(&universe->diagnostics, 0, sizeof(universe->diagnostics));
+  universe->diagnostics.energyTolerance = DIAGNOSTICS_ENERGY_TOLERANCE;
+  universe->diagnostics.stepTolerance = DIAGNOSTICS_STEP_TOLERANCE;
+  universe->diagnostics.momentumTolerance = DIAGNOSTICS_MOMENTUM_TOLERANCE;
 
   universe->entityCount = 0;
   universe->maxEntities = maxEntities;
-
-  universe->entityMasks =
-      (ComponentMask *)calloc(maxEntities, sizeof(ComponentMask));
-  universe->activeEntities = (bool *)calloc(maxEntities, sizeof(bool));
-  universe->kineticBodies =
-      (KineticBodyComponent *)calloc(maxEntities, sizeof(KineticBodyComponent));
-  universe->mechanics =
-      (MechanicsComponent *)calloc(maxEntities, sizeof(MechanicsComponent));
-
-  if (!universe->entityMasks || !universe->activeEntities ||
-      !universe->kineticBodies || !universe->mechanics) {
+  universe->componentCount = 0;
+  universe->queryCount = 0;
+  universe->lifetimeComponent = INVALID_COMPONENT;
+  universe->emitterComponent = INVALID_COMPONENT;
+  universe->fluidComponent = INVALID_COMPONENT;
+  universe->fixedComponent = INVALID_COMPONENT;
+  universe->fluid = NULL;
+  universe->rigidBodyComponent = INVALID_COMPONENT;
+  universe->rigidShapeComponent = INVALID_COMPONENT;
+  universe->rigid = NULL;
+  universe->obstacles = NULL;
+  universe->spatial = NULL;
+  universe->chunks = NULL;
+  universe->schedule = NULL;
+  memset(universe->commandBuffers, 0, sizeof(universe->commandBuffers));
+
+  const KMemoryOwner owner = K_MEMORY_UNIVERSE;
+  universe->entityMasks = (ComponentMask *)universeAllocate(
+      universe, owner, maxEntities * sizeof(ComponentMask));
+  universe->activeBits = (uint64_t *)universeAllocate(
+      universe, owner, BITSET_WORDS(maxEntities) * sizeof(uint64_t));
+  universe->freeEntities = (EntityID *)universeAllocate(
+      universe, owner, maxEntities * sizeof(EntityID));
+  universe->entitySlots = (uint32_t *)universeAllocate(
+      universe, owner, maxEntities * sizeof(uint32_t));
+  universe->slotEntities = (EntityID *)universeAllocate(
+      universe, owner, maxEntities * sizeof(EntityID));
+
+  if (!universe->entityMasks || !universe->activeBits ||
+      !universe->freeEntities || !universe->entitySlots ||
+      !universe->slotEntities ||
+      UniverseRegisterComponent(universe, sizeof(KineticBodyComponent),
+                                _Alignof(KineticBodyComponent)) !=
+          COMPONENT_ID_KINETIC_BODY ||
+      UniverseRegisterComponent(universe, sizeof(MechanicsComponent),
+                                _Alignof(MechanicsComponent)) !=
+          COMPONENT_ID_MECHANICS ||
+      UniverseRegisterComponent(universe, sizeof(RadiusComponent),
+                                _Alignof(RadiusComponent)) !=
+          COMPONENT_ID_RADIUS) {
     UniverseDestroy(universe);
     return NULL;
   }
 
+  // Pushed in reverse so the lowest IDs are handed out first
+  universe->freeCount = maxEntities;
+  for (uint32_t i = 0; i < maxEntities; i++) {
+    universe->freeEntities[i] = maxEntities - 1 - i;
+    universe->entitySlots[i] = i;
+    universe->slotEntities[i] = i;
+  }
+
+  universe->kineticBodies =
+      UNIVERSE_COLUMN(universe, KineticBodyComponent, COMPONENT_ID_KINETIC_BODY);
+  universe->mechanics =
+      UNIVERSE_COLUMN(universe, MechanicsComponent, COMPONENT_ID_MECHANICS);
+  universe->radii =
+      UNIVERSE_COLUMN(universe, RadiusComponent, COMPONENT_ID_RADIUS);
+
   universe->boundary.left = BOUNDARY_PADDING;
   universe->boundary.top = BOUNDARY_PADDING;
   universe->boundary.right = WINDOW_DEFAULT_WIDTH - BOUNDARY_PADDING;
@@ -34,66 +229,210 @@ Universe *UniverseCreate(uint32_t maxEntities) {
   return universe;
 }
 
+void UniverseRebind(Universe *universe) {
+  if (!universe)
+    return;
+
+  universe->allocator = KAllocatorRebind(universe->allocator);
+  UniverseRebindSystems(universe);
+}
+
 void UniverseDestroy(Universe *universe) {
   if (!universe)
     return;
 
-  free(universe->entityMasks);
-  free(universe->activeEntities);
-  free(universe->kineticBodies);
-  free(universe->mechanics);
+  universeRelease(universe, universe->entityMasks);
+  universeRelease(universe, universe->activeBits);
+  universeRelease(universe, universe->freeEntities);
+  universeRelease(universe, universe->entitySlots);
+  universeRelease(universe, universe->slotEntities);
+  universeRelease(universe, universe->reorderScratch);
+  universeRelease(universe, universe->timestep.classBits);
+  universeRelease(universe, universe->fluid);
+  universeRelease(universe, universe->rigid);
+  universeRelease(universe, universe->obstacles);
+  universeRelease(universe, universe->spatial);
+  UniverseChunksDisable(universe);
+  universeRelease(universe, universe->schedule);
+
+  for (uint32_t c = 0; c < universe->componentCount; c++) {
+    universeRelease(universe, universe->columns[c].data);
+    universeRelease(universe, universe->componentBits[c]);
+  }
 
-  free(universe);
+  for (uint32_t q = 0; q < universe->queryCount; q++) {
+    universeRelease(universe, universe->queries[q].entities);
+    universeRelease(universe, universe->queries[q].positions);
+  }
+
+  for (uint32_t b = 0; b < MAX_COMMAND_BUFFERS; b++)
+    CommandBufferFree(&universe->commandBuffers[b]);
+
+  for (uint32_t o = 0; o < K_MEMORY_OWNERS; o++)
+    KAccountRelease((KMemoryOwner)o, universe->memoryBytes[o]);
+
+  // With the built-in arena everything above was a no-op; this unmaps it all
+  KArena *arena = universe->arena;
+  universeRelease(universe, universe);
+  KArenaDestroy(arena);
 }
 
 EntityID UniverseCreateEntity(Universe *universe) {
   if (!universe)
     return INVALID_ENTITY;
 
-  if (universe->entityCount >= universe->maxEntities)
+  if (universe->freeCount == 0)
     return INVALID_ENTITY;
 
-  for (uint32_t i = 0; i < universe->maxEntities; i++) {
-    if (!universe->activeEntities[i]) {
-      universe->activeEntities[i] = true;
-      universe->entityMasks[i] = COMPONENT_NONE;
-      universe->entityCount++;
-      return i;
-    }
-  }
-
-  return INVALID_ENTITY;
+  EntityID entity = universe->freeEntities[--universe->freeCount];
+  uint32_t slot = universe->entitySlots[entity];
+  setBit(universe->activeBits, slot);
+  universe->entityMasks[slot] = COMPONENT_NONE;
+  universe->entityCount++;
+  return entity;
 }
 
 bool UniverseDestroyEntity(Universe *universe, EntityID entity) {
   if (!universe || entity >= universe->maxEntities)
     return false;
 
-  if (!universe->activeEntities[entity])
+  if (!UniverseIsEntityActive(universe, entity))
     return false;
 
-  universe->activeEntities[entity] = false;
-  universe->entityMasks[entity] = COMPONENT_NONE;
+  uint32_t slot = universe->entitySlots[entity];
+  for (ComponentMask mask = universe->entityMasks[slot]; mask;
+       mask &= mask - 1)
+    clearBit(universe->componentBits[__builtin_ctzll(mask)], slot);
+
+  clearBit(universe->activeBits, slot);
+  universe->entityMasks[slot] = COMPONENT_NONE;
   universe->entityCount--;
+  universe->freeEntities[universe->freeCount++] = entity;
+  updateQueries(universe, slot);
+  return true;
+}
+
+ComponentID UniverseRegisterComponent(Universe *universe, size_t size,
+                                      size_t alignment) {
+  if (!universe || size == 0 || universe->componentCount >= MAX_COMPONENTS)
+    return INVALID_COMPONENT;
+
+  // Alignment must be a power of two
+  if (alignment == 0 || (alignment & (alignment - 1)) != 0)
+    return INVALID_COMPONENT;
+
+  size_t stride = (size + alignment - 1) & ~(alignment - 1);
+  size_t columnAlignment =
+      alignment > COLUMN_ALIGNMENT ? alignment : COLUMN_ALIGNMENT;
+  size_t bytes = stride * universe->maxEntities;
+  bytes = (bytes + columnAlignment - 1) & ~(columnAlignment - 1);
+  if (bytes == 0)
+    bytes = columnAlignment;
+
+  const size_t bitBytes =
+      BITSET_WORDS(universe->maxEntities) * sizeof(uint64_t);
+  void *data =
+      UniverseAllocate(universe, K_MEMORY_COLUMNS, bytes, columnAlignment);
+  uint64_t *bits =
+      (uint64_t *)universeAllocate(universe, K_MEMORY_COLUMNS, bitBytes);
+  if (!data || !bits) {
+    UniverseRelease(universe, K_MEMORY_COLUMNS, data, bytes);
+    UniverseRelease(universe, K_MEMORY_COLUMNS, bits, bitBytes);
+    return INVALID_COMPONENT;
+  }
+
+  if (universe->arena && universe->touchThreads > 1)
+    KFirstTouch(data, bytes, universe->touchThreads);
+
+  ComponentID component = universe->componentCount++;
+  universe->columns[component].data = data;
+  universe->columns[component].size = size;
+  universe->columns[component].alignment = alignment;
+  universe->columns[component].stride = stride;
+  universe->componentBits[component] = bits;
+  return component;
+}
+
+bool UniverseAddComponent(Universe *universe, EntityID entity,
+                          ComponentID component, const void *data) {
+  if (!universe || entity >= universe->maxEntities ||
+      !UniverseIsEntityActive(universe, entity) ||
+      component >= universe->componentCount)
+    return false;
+
+  uint32_t slot = universe->entitySlots[entity];
+  ComponentColumn *column = &universe->columns[component];
+  char *element = (char *)column->data + (size_t)slot * column->stride;
+
+  if (data)
+    memcpy(element, data, column->size);
+  else
+    memset(element, 0, column->size);
+
+  universe->entityMasks[slot] |= COMPONENT_BIT(component);
+  setBit(universe->componentBits[component], slot);
+  updateQueries(universe, slot);
+  return true;
+}
+
+bool UniverseRemoveComponent(Universe *universe, EntityID entity,
+                             ComponentID component) {
+  if (!universe || entity >= universe->maxEntities ||
+      !UniverseIsEntityActive(universe, entity) ||
+      component >= universe->componentCount)
+    return false;
+
+  uint32_t slot = universe->entitySlots[entity];
+  if (!(universe->entityMasks[slot] & COMPONENT_BIT(component)))
+    return false;
+
+  universe->entityMasks[slot] &= ~COMPONENT_BIT(component);
+  clearBit(universe->componentBits[component], slot);
+  updateQueries(universe, slot);
   return true;
 }
 
+void *UniverseGetComponent(Universe *universe, EntityID entity,
+                           ComponentID component) {
+  if (!universe || entity >= universe->maxEntities ||
+      !UniverseIsEntityActive(universe, entity) ||
+      component >= universe->componentCount)
+    return NULL;
+
+  uint32_t slot = universe->entitySlots[entity];
+  if (!(universe->entityMasks[slot] & COMPONENT_BIT(component)))
+    return NULL;
+
+  ComponentColumn *column = &universe->columns[component];
+  return (char *)column->data + (size_t)slot * column->stride;
+}
+
+void *UniverseGetColumn(Universe *universe, ComponentID component) {
+  if (!universe || component >= universe->componentCount)
+    return NULL;
+
+  return universe->columns[component].data;
+}
+
 bool UniverseAddKineticBodyComponent(Universe *universe, EntityID entity,
                                      KVector2 position, double mass) {
   if (!universe || entity >= universe->maxEntities ||
-      !universe->activeEntities[entity])
+      !UniverseIsEntityActive(universe, entity))
     return false;
 
-  universe->kineticBodies[entity].position = position;
-  universe->kineticBodies[entity].previous = position;
+  uint32_t slot = universe->entitySlots[entity];
+  universe->kineticBodies[slot].position = position;
+  universe->kineticBodies[slot].previous = position;
 
   if (mass <= 0 || isinf(mass)) {
-    universe->kineticBodies[entity].inverseMass = 0.0;
+    universe->kineticBodies[slot].inverseMass = 0.0;
   } else {
-    universe->kineticBodies[entity].inverseMass = 1.0 / mass;
+    universe->kineticBodies[slot].inverseMass = 1.0 / mass;
   }
 
-  universe->entityMasks[entity] |= COMPONENT_PARTICLE;
+  universe->entityMasks[slot] |= COMPONENT_PARTICLE;
+  setBit(universe->componentBits[COMPONENT_ID_KINETIC_BODY], slot);
+  updateQueries(universe, slot);
   return true;
 }
 
@@ -101,40 +440,55 @@ bool UniverseAddMechanicsComponent(Universe *universe, EntityID entity,
                                    KVector2 velocity,
                                    KVector2 acceleration) {
   if (!universe || entity >= universe->maxEntities ||
-      !universe->activeEntities[entity])
+      !UniverseIsEntityActive(universe, entity))
     return false;
 
-  universe->mechanics[entity].velocity = velocity;
-  universe->mechanics[entity].acceleration = acceleration;
-  universe->mechanics[entity].forceAccum.x = 0.0;
-  universe->mechanics[entity].forceAccum.y = 0.0;
+  uint32_t slot = universe->entitySlots[entity];
+  universe->mechanics[slot].velocity = velocity;
+  universe->mechanics[slot].acceleration = acceleration;
+  universe->mechanics[slot].forceAccum.x = 0.0;
+  universe->mechanics[slot].forceAccum.y = 0.0;
 
-  universe->entityMasks[entity] |= COMPONENT_MECHANICS;
+  universe->entityMasks[slot] |= COMPONENT_MECHANICS;
+  setBit(universe->componentBits[COMPONENT_ID_MECHANICS], slot);
+  updateQueries(universe, slot);
   return true;
 }
 
+bool UniverseAddRadiusComponent(Universe *universe, EntityID entity,
+                                double radius) {
+  if (radius < 0.0)
+    return false;
+
+  RadiusComponent component = {radius};
+  return UniverseAddComponent(universe, entity, COMPONENT_ID_RADIUS,
+                              &component);
+}
+
 KineticBodyComponent *UniverseGetKineticBodyComponent(Universe *universe,
                                                       EntityID entity) {
   if (!universe || entity >= universe->maxEntities ||
-      !universe->activeEntities[entity])
+      !UniverseIsEntityActive(universe, entity))
     return NULL;
 
-  if (!(universe->entityMasks[entity] & COMPONENT_PARTICLE))
+  uint32_t slot = universe->entitySlots[entity];
+  if (!(universe->entityMasks[slot] & COMPONENT_PARTICLE))
     return NULL;
 
-  return &universe->kineticBodies[entity];
+  return &universe->kineticBodies[slot];
 }
 
 MechanicsComponent *UniverseGetMechanicsComponent(Universe *universe,
                                                   EntityID entity) {
   if (!universe || entity >= universe->maxEntities ||
-      !universe->activeEntities[entity])
+      !UniverseIsEntityActive(universe, entity))
     return NULL;
 
-  if (!(universe->entityMasks[entity] & COMPONENT_MECHANICS))
+  uint32_t slot = universe->entitySlots[entity];
+  if (!(universe->entityMasks[slot] & COMPONENT_MECHANICS))
     return NULL;
 
-  return &universe->mechanics[entity];
+  return &universe->mechanics[slot];
 }
 
 void UniverseSetBoundaries(Universe *universe, int windowWidth,
@@ -149,6 +503,90 @@ void UniverseSetBoundaries(Universe *universe, int windowWidth,
   universe->boundary.enabled = enabled;
 }
 
+uint32_t UniverseCountActive(const Universe *universe) {
+  if (!universe)
+    return 0;
+
+  uint32_t count = 0;
+  for (uint32_t w = 0; w < BITSET_WORDS(universe->maxEntities); w++)
+    count += (uint32_t)__builtin_popcountll(universe->activeBits[w]);
+  return count;
+}
+
+bool UniverseValidate(const Universe *universe) {
+  if (!universe)
+    return false;
+
+  uint32_t active = UniverseCountActive(universe);
+  if (active != universe->entityCount ||
+      active + universe->freeCount != universe->maxEntities)
+    return false;
+
+  // Component bits must agree with the per-entity masks
+  for (uint32_t i = 0; i < universe->maxEntities; i++) {
+    ComponentMask mask = COMPONENT_NONE;
+    for (uint32_t c = 0; c < universe->componentCount; c++) {
+      if ((universe->componentBits[c][i >> 6] >> (i & 63)) & 1u)
+        mask |= COMPONENT_BIT(c);
+    }
+
+    if (mask != universe->entityMasks[i] ||
+        (mask && !UniverseIsSlotActive(universe, i)))
+      return false;
+
+    // Entity <-> slot tables must stay a bijection across reorders
+    if (universe->slotEntities[universe->entitySlots[i]] != i)
+      return false;
+  }
+
+  return true;
+}
+
+const EntityQuery *UniverseQuery(Universe *universe, ComponentMask required,
+                                 ComponentMask excluded) {
+  if (!universe || required == COMPONENT_NONE)
+    return NULL;
+
+  for (uint32_t q = 0; q < universe->queryCount; q++) {
+    EntityQuery *query = &universe->queries[q];
+    if (query->required == required && query->excluded == excluded)
+      return query;
+  }
+
+  if (universe->queryCount >= MAX_QUERIES)
+    return NULL;
+
+  EntityQuery *query = &universe->queries[universe->queryCount];
+  query->required = required;
+  query->excluded = excluded;
+  query->count = 0;
+  const size_t bytes = universe->maxEntities * sizeof(uint32_t);
+  query->entities =
+      (EntityID *)universeAllocate(universe, K_MEMORY_QUERIES, bytes);
+  query->positions =
+      (uint32_t *)universeAllocate(universe, K_MEMORY_QUERIES, bytes);
+
+  if (!query->entities || !query->positions) {
+    UniverseRelease(universe, K_MEMORY_QUERIES, query->entities, bytes);
+    UniverseRelease(universe, K_MEMORY_QUERIES, query->positions, bytes);
+    return NULL;
+  }
+
+  for (uint32_t i = 0; i < universe->maxEntities; i++)
+    query->positions[i] = UINT32_MAX;
+
+  for (uint32_t w = 0; w < BITSET_WORDS(universe->maxEntities); w++) {
+    uint64_t bits = UniverseMatchWord(universe, w, required, excluded);
+    while (bits) {
+      queryInsert(query, w * 64 + (EntityID)__builtin_ctzll(bits));
+      bits &= bits - 1;
+    }
+  }
+
+  universe->queryCount++;
+  return query;
+}
+
 EntityID ParticleCreate(Universe *universe, KVector2 position,
                         KVector2 velocity, double mass) {
   EntityID entity = UniverseCreateEntity(universe);
@@ -161,12 +599,11 @@ EntityID ParticleCreate(Universe *universe, KVector2 position,
   }
 
   if (!UniverseAddMechanicsComponent(universe, entity, velocity,
-                                     (KVector2){0, 0})) {
+                                     (KVector2){0, 0}) ||
+      !UniverseAddRadiusComponent(universe, entity, OBJECT_RADIUS)) {
     UniverseDestroyEntity(universe, entity);
     return INVALID_ENTITY;
   }
 
-  universe->kineticBodies[entity].previous = position;
-
   return entity;
 }
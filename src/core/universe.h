@@ -2,14 +2,19 @@
 #define ECS_UNIVERSE_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 #include "../config/config.h"
+#include "allocator.h"
+#include "commands.h"
 #include "components.h"
 
 typedef uint32_t EntityID;
 #define INVALID_ENTITY UINT32_MAX
 
+#define BITSET_WORDS(count) (((count) + 63u) / 64u)
+
 typedef struct {
   double left;
   double right;
@@ -18,31 +23,258 @@ typedef struct {
   bool enabled;
 } UniverseBoundary;
 
+/**
+ * Adaptive substepping state (see PhysicsAdaptiveIntegrate). Disabled while
+ * maxDisplacement is 0. The class bitsets are rebuilt every step, so they
+ * need no upkeep when entities are created, destroyed or reordered.
+ */
+typedef struct {
+  double maxDisplacement; /* largest move allowed in one substep */
+  uint64_t *classBits;    /* TIMESTEP_CLASSES bitsets, one per class */
+  uint32_t classCounts[TIMESTEP_CLASSES];
+  uint64_t substeps; /* entity-substeps integrated by the last step */
+} UniverseTimestep;
+
+/* Totals over the moving entities; bodies with inverseMass <= 0 only count
+ * towards the bounds */
+typedef struct {
+  double kineticEnergy;
+  KVector2 momentum;
+  double mass;
+  KVector2 boundsMin;
+  KVector2 boundsMax;
+  uint32_t count;
+} DiagnosticsSample;
+
+/* Reasons a step is flagged as unstable */
+#define DIAGNOSTICS_NON_FINITE (1u << 0)
+#define DIAGNOSTICS_ENERGY_DRIFT (1u << 1)
+#define DIAGNOSTICS_STEP_DRIFT (1u << 2)
+#define DIAGNOSTICS_MOMENTUM_DRIFT (1u << 3)
+#define DIAGNOSTICS_ESCAPED (1u << 4)
+
+/**
+ * Conservation diagnostics (see physics/diagnostics.h). While enabled, the
+ * last integration sweep of each step also reduces the sample, so keeping
+ * them on costs no extra pass over the columns.
+ */
+typedef struct {
+  bool enabled;
+  bool hasReference;
+  DiagnosticsSample reference; /* drift is measured against this sample */
+  DiagnosticsSample previous;
+  DiagnosticsSample current;
+  double energyDrift;   /* (E - E_ref) / E_ref */
+  double stepDrift;     /* (E - E_prev) / E_prev */
+  double momentumDrift; /* |P - P_ref| / sqrt(2 M_ref E_ref) */
+  double energyTolerance;
+  double stepTolerance;
+  double momentumTolerance;
+  uint32_t flags;        /* DIAGNOSTICS_* bits of the last step */
+  uint64_t flaggedSteps; /* steps with any flag since the reference */
+} UniverseDiagnostics;
+
+/**
+ * Storage for one registered component: `maxEntities` elements of `stride`
+ * bytes each, indexed by EntityID.
+ */
+typedef struct {
+  void *data;
+  size_t size;
+  size_t alignment;
+  size_t stride;
+} ComponentColumn;
+
+/**
+ * Cached list of entities whose mask contains every bit of `required` and
+ * none of `excluded`. The list is kept up to date as components are added and
+ * entities destroyed, so systems iterate `entities[0..count)` directly.
+ * Entries are storage slots, ready to index component columns; they equal the
+ * EntityID until the universe is reordered (see UniverseSlotEntity).
+ */
+typedef struct {
+  ComponentMask required;
+  ComponentMask excluded;
+  uint32_t count;
+  uint32_t *entities;
+  uint32_t *positions; /* slot -> index in `entities`, UINT32_MAX if absent */
+} EntityQuery;
+
+/**
+ * Creation options. Zero-initialised options select the built-in arena with
+ * regular pages, touched by the calling thread.
+ */
+typedef struct {
+  const KAllocator *allocator; /* NULL selects the single-block arena */
+  bool hugePages;              /* MAP_HUGETLB, else MADV_HUGEPAGE */
+  uint32_t touchThreads;       /* threads that first-touch arena columns */
+  size_t reserveBytesPerEntity; /* arena headroom for registered columns */
+} UniverseOptions;
+
+/**
+ * Entities are addressed by a stable EntityID, while masks, bitsets and
+ * component columns are indexed by storage slot. The two are a bijection over
+ * [0, maxEntities) kept in entitySlots/slotEntities, which lets reorder passes
+ * move storage around without invalidating IDs held by callers.
+ */
 typedef struct {
   uint32_t entityCount;
   uint32_t maxEntities;
+  uint32_t *entitySlots;  /* EntityID -> slot */
+  EntityID *slotEntities; /* slot -> EntityID */
   ComponentMask *entityMasks;
-  bool *activeEntities;
+  /* One bit per entity, 64 entities per word (see BITSET_WORDS) */
+  uint64_t *activeBits;
+  uint64_t *componentBits[MAX_COMPONENTS];
+  /* Stack of inactive entity IDs; creation pops, destruction pushes */
+  EntityID *freeEntities;
+  uint32_t freeCount;
+  ComponentColumn columns[MAX_COMPONENTS];
+  uint32_t componentCount;
+  /* Typed views of the built-in columns */
   KineticBodyComponent *kineticBodies;
   MechanicsComponent *mechanics;
+  RadiusComponent *radii;
+  /* Registered by ParticleEmittersEnable, INVALID_COMPONENT until then */
+  ComponentID lifetimeComponent;
+  ComponentID emitterComponent;
+  /* Set by FluidEnable (see physics/fluid.h); invalid and NULL until then */
+  ComponentID fluidComponent;
+  struct FluidSolver *fluid;
+  /* Set by FixedPointEnable (see physics/fixed.h); invalid until then */
+  ComponentID fixedComponent;
+  /* Set by RigidEnable (see physics/rigid.h); invalid and NULL until then */
+  ComponentID rigidBodyComponent;
+  ComponentID rigidShapeComponent;
+  struct RigidSolver *rigid;
+  /* Set by ObstaclesEnable (see physics/obstacles.h); NULL until then */
+  struct ObstacleSet *obstacles;
+  /* Set by UniverseSpatialIndexEnable (see spatial.h); NULL until then */
+  struct SpatialIndex *spatial;
+  /* Set by UniverseChunksEnable (see chunks.h); NULL until then */
+  struct ChunkWorld *chunks;
+  /* Systems run by UniverseUpdate (see scheduler.h); NULL until first used */
+  struct SystemSchedule *schedule;
   UniverseBoundary boundary;
+  UniverseTimestep timestep;
+  UniverseDiagnostics diagnostics;
+  EntityQuery queries[MAX_QUERIES];
+  uint32_t queryCount;
+  CommandBuffer commandBuffers[MAX_COMMAND_BUFFERS];
+  KAllocator allocator;
+  KArena *arena; /* owned arena, NULL with a caller-supplied allocator */
+  /* Bytes carved per owner, given back to the accounts on destruction */
+  size_t memoryBytes[K_MEMORY_OWNERS];
+  uint32_t touchThreads;
+  /* Spatial reorder (see reorder.h); interval 0 disables it */
+  uint32_t reorderInterval;
+  uint64_t stepCount;
+  void *reorderScratch;
+  size_t reorderScratchBytes;
 } Universe;
 
 Universe *UniverseCreate(uint32_t maxEntities);
+Universe *UniverseCreateWithOptions(uint32_t maxEntities,
+                                    const UniverseOptions *options);
 void UniverseDestroy(Universe *universe);
+/**
+ * Points the callbacks a universe holds, its allocator's and its built-in
+ * systems', at this copy of the library. After a hot reload the new copy
+ * calls it before the old one is closed.
+ */
+void UniverseRebind(Universe *universe);
+/**
+ * Carves `bytes` from the universe allocator and accounts them to `owner`
+ * (see KAllocationSnapshot). Subsystems take their storage through this.
+ */
+void *UniverseAllocate(Universe *universe, KMemoryOwner owner, size_t bytes,
+                       size_t alignment);
+/* Gives storage back before UniverseDestroy, which releases the rest */
+void UniverseRelease(Universe *universe, KMemoryOwner owner, void *data,
+                     size_t bytes);
+/* Storage a universe carves from its allocator at creation, padding included */
+size_t UniverseEstimateBytes(uint32_t maxEntities,
+                             const UniverseOptions *options);
 EntityID UniverseCreateEntity(Universe *universe);
 bool UniverseDestroyEntity(Universe *universe, EntityID entity);
+ComponentID UniverseRegisterComponent(Universe *universe, size_t size,
+                                      size_t alignment);
+bool UniverseAddComponent(Universe *universe, EntityID entity,
+                          ComponentID component, const void *data);
+bool UniverseRemoveComponent(Universe *universe, EntityID entity,
+                             ComponentID component);
+void *UniverseGetComponent(Universe *universe, EntityID entity,
+                           ComponentID component);
+void *UniverseGetColumn(Universe *universe, ComponentID component);
 bool UniverseAddKineticBodyComponent(Universe *universe, EntityID entity,
                                      KVector2 position, double mass);
 bool UniverseAddMechanicsComponent(Universe *universe, EntityID entity,
                                    KVector2 velocity, KVector2 acceleration);
+bool UniverseAddRadiusComponent(Universe *universe, EntityID entity,
+                                double radius);
 KineticBodyComponent *UniverseGetKineticBodyComponent(Universe *universe,
                                                       EntityID entity);
 MechanicsComponent *UniverseGetMechanicsComponent(Universe *universe,
                                                   EntityID entity);
 void UniverseSetBoundaries(Universe *universe, int windowWidth,
                            int windowHeight, float padding, bool enabled);
+const EntityQuery *UniverseQuery(Universe *universe, ComponentMask required,
+                                 ComponentMask excluded);
 EntityID ParticleCreate(Universe *universe, KVector2 position,
                         KVector2 velocity, double mass);
+CommandBuffer *UniverseGetCommandBuffer(Universe *universe, uint32_t thread);
+void UniverseFlushCommands(Universe *universe);
+
+uint32_t UniverseCountActive(const Universe *universe);
+bool UniverseValidate(const Universe *universe);
+
+static inline bool UniverseIsSlotActive(const Universe *universe,
+                                        uint32_t slot) {
+  return (universe->activeBits[slot >> 6] >> (slot & 63)) & 1u;
+}
+
+static inline bool UniverseIsEntityActive(const Universe *universe,
+                                          EntityID entity) {
+  return UniverseIsSlotActive(universe, universe->entitySlots[entity]);
+}
+
+static inline uint32_t UniverseEntitySlot(const Universe *universe,
+                                          EntityID entity) {
+  return universe->entitySlots[entity];
+}
+
+static inline EntityID UniverseSlotEntity(const Universe *universe,
+                                          uint32_t slot) {
+  return universe->slotEntities[slot];
+}
+
+/**
+ * Slots of word `word` (slots word*64 .. word*64+63) that are active, have
+ * every component in `required` and none in `excluded`. Systems walk the set
+ * bits with __builtin_ctzll, skipping 64 empty slots per zero word:
+ *
+ *   uint64_t bits = UniverseMatchWord(universe, w, required, COMPONENT_NONE);
+ *   while (bits) {
+ *     EntityID i = w * 64 + (EntityID)__builtin_ctzll(bits);
+ *     bits &= bits - 1;
+ *     ...
+ *   }
+ */
+static inline uint64_t UniverseMatchWord(const Universe *universe,
+                                         uint32_t word, ComponentMask required,
+                                         ComponentMask excluded) {
+  uint64_t bits = universe->activeBits[word];
+
+  for (; required && bits; required &= required - 1)
+    bits &= universe->componentBits[__builtin_ctzll(required)][word];
+  for (; excluded && bits; excluded &= excluded - 1)
+    bits &= ~universe->componentBits[__builtin_ctzll(excluded)][word];
+
+  return bits;
+}
+
+/* Typed access to a component column, e.g. UNIVERSE_COLUMN(u, Foo, fooId) */
+#define UNIVERSE_COLUMN(universe, type, component)                             \
+  ((type *)UniverseGetColumn((universe), (component)))
 
 #endif /* ECS_UNIVERSE_H */
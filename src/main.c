@@ -1,50 +1,11 @@
-#include <assert.h>
-#include <dlfcn.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include <string.h>
 
 #include "../lib/raylib/src/raylib.h"
 #include "plugin/plugin.h"
-
-// Define function pointer types
-#define X(name, ret, ...) typedef ret (*name##_t)(__VA_ARGS__);
-KURAGE_FUNC_LIST
-#undef X
-
-// Declare function pointers
-#define X(name, ...) name##_t name = NULL;
-KURAGE_FUNC_LIST
-#undef X
+#include "reload/reload.h"
 
 const char *engine_lib_name = "build/plugin.so";
-void *engine_lib = NULL;
-
-int lib_reload(void) {
-  if (engine_lib != NULL)
-    dlclose(engine_lib);
-
-  engine_lib = dlopen(engine_lib_name, RTLD_NOW);
-
-  if (engine_lib == NULL) {
-    fprintf(stderr, "ERROR: could not load %s: %s\n", engine_lib_name,
-            dlerror());
-    return -1;
-  }
-
-// Load all function pointers using the macro
-#define X(name, ...)                                                           \
-  name = (name##_t)dlsym(engine_lib, #name);                                   \
-  if (name == NULL) {                                                          \
-    fprintf(stderr, "ERROR: could not find %s symbol in %s: %s\n", #name,      \
-            engine_lib_name, dlerror());                                       \
-    return -1;                                                                 \
-  }
-  KURAGE_FUNC_LIST
-#undef X
-
-  return 1;
-}
 
 int main(void) {
   size_t factor = 100;
@@ -52,37 +13,39 @@ int main(void) {
   InitWindow(factor * 16, factor * 9, "Kurage Physics Engine");
   SetTargetFPS(60);
 
-  // Load the engine library
-  if (lib_reload() == -1) {
+  // Load the engine library; rebuilds are picked up in the background
+  KurageReloader reloader;
+  if (ReloaderStart(&reloader, engine_lib_name) == -1) {
     CloseWindow();
     return 1;
   }
 
   // Initialize the engine
-  kurage_init();
+  reloader.active->kurage_init();
 
   while (!WindowShouldClose()) {
     // Check for reloading library
     if (IsKeyPressed(KEY_ESCAPE))
       break;
-    if (IsKeyPressed(KEY_R)) {
-      void *state = kurage_pre_reload();
-      if (lib_reload() == -1)
-        return 1;
-      kurage_post_reload(state);
-    }
+    if (IsKeyPressed(KEY_R))
+      ReloaderRequest(&reloader);
+
+    // Install a freshly built library between frames
+    ReloaderSwap(&reloader);
+    const KurageApi *api = reloader.active;
 
     // Update and render
-    kurage_logic();
-    kurage_update();
+    api->kurage_logic();
+    api->kurage_update();
 
     BeginDrawing();
     ClearBackground(BLACK);
     DrawFPS(0, 0);
-    kurage_render();
+    api->kurage_render();
     EndDrawing();
   }
 
+  ReloaderStop(&reloader);
   CloseWindow();
   return 0;
-}
\ No newline at end of file
+}
@@ -5,6 +5,7 @@
  *
  */
 
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <time.h>
@@ -24,11 +25,12 @@ void kurage_init(void) {
   printf("Initializing Kurage Physics Engine\n");
 
   // Create our state structure
-  state = (KurageState *)malloc(sizeof(KurageState));
+  state = (KurageState *)calloc(1, sizeof(KurageState));
   if (!state) {
     fprintf(stderr, "ERROR: Failed to allocate state memory\n");
     return;
   }
+  state->layout = kurage_state_layout();
 
   // Initialize universe
   init_universe();
@@ -36,36 +38,86 @@ void kurage_init(void) {
 
 KurageState *kurage_pre_reload(void) {
   printf("Preparing for hot reload...\n");
+  // This copy is closed after the swap; its pool threads must not outlive it
+  ParallelShutdown();
   return state;
 }
 
 void kurage_post_reload(KurageState *preserved_state) {
   printf("Restoring state after hot reload...\n");
+  if (preserved_state && preserved_state->layout != kurage_state_layout()) {
+    // The host checks this before swapping; never run on a foreign layout
+    fprintf(stderr, "ERROR: Preserved state has an incompatible layout\n");
+    abort();
+  }
   state = preserved_state;
+  // The old copy of the library is closed next; nothing may point into it
+  if (state)
+    UniverseRebind(state->universe);
+}
+
+/*
+ * Fingerprint of everything the preserved state reaches into. Offsets are
+ * included so that reordering fields is caught as well as resizing them.
+ */
+uint64_t kurage_state_layout(void) {
+  const uint64_t fields[] = {
+      KURAGE_STATE_VERSION,
+      sizeof(KurageState),
+      offsetof(KurageState, lastWidth),
+      sizeof(RenderView),
+      sizeof(Universe),
+      offsetof(Universe, entitySlots),
+      offsetof(Universe, columns),
+      offsetof(Universe, kineticBodies),
+      offsetof(Universe, boundary),
+      offsetof(Universe, diagnostics),
+      offsetof(Universe, queries),
+      offsetof(Universe, commandBuffers),
+      offsetof(Universe, allocator),
+      sizeof(KAllocator),
+      offsetof(Universe, reorderInterval),
+      sizeof(EntityQuery),
+      sizeof(CommandBuffer),
+      sizeof(SystemSchedule),
+      sizeof(KineticBodyComponent),
+      sizeof(MechanicsComponent),
+      sizeof(RadiusComponent),
+      MAX_COMPONENTS,
+  };
+
+  // FNV-1a
+  uint64_t hash = 14695981039346656037ull;
+  const unsigned char *bytes = (const unsigned char *)fields;
+  for (size_t i = 0; i < sizeof(fields); i++) {
+    hash ^= bytes[i];
+    hash *= 1099511628211ull;
+  }
+  return hash;
 }
 
 void kurage_logic(void) {
   // Handle any physics engine logic here
   // For example, detecting user input for physics objects
+  if (state)
+    RenderViewHandleInput(&state->view);
 }
 
 void kurage_update(void) {
   // Update physics simulation
   if (state && state->universe) {
-    // Check if window has been resized and update boundaries
-    static int lastWidth = 0;
-    static int lastHeight = 0;
+    // The world no longer follows the window; a resize only moves the view.
+    // The cached size lives in the state so a reload is not a resize.
     int currentWidth = GetScreenWidth();
     int currentHeight = GetScreenHeight();
 
-    if (currentWidth != lastWidth || currentHeight != lastHeight) {
-      // Window resized, update boundaries
-      UniverseSetBoundaries(state->universe, currentWidth, currentHeight,
-                            BOUNDARY_PADDING, true);
+    if (currentWidth != state->lastWidth ||
+        currentHeight != state->lastHeight) {
+      RenderViewResize(&state->view, currentWidth, currentHeight);
 
       // Update cached dimensions
-      lastWidth = currentWidth;
-      lastHeight = currentHeight;
+      state->lastWidth = currentWidth;
+      state->lastHeight = currentHeight;
     }
 
     float deltaTime = 8 * GetFrameTime();
@@ -78,7 +130,8 @@ void kurage_render(void) {
   if (!state || !state->universe)
     return;
 
-  RenderUniverse(state->universe);
+  RenderUniverse(state->universe, &state->view);
+  RenderDiagnostics(state->universe, 10, 30);
 }
 
 // Initialize the physics universe
@@ -90,11 +143,16 @@ static void init_universe(void) {
       return;
     }
 
-    // Set universe boundaries based on window size with padding
+    // The world has a fixed size; the camera starts out framing it
     int windowWidth = GetScreenWidth();
     int windowHeight = GetScreenHeight();
-    UniverseSetBoundaries(state->universe, windowWidth, windowHeight,
+    UniverseSetBoundaries(state->universe, WORLD_WIDTH, WORLD_HEIGHT,
                           BOUNDARY_PADDING, true);
+    UniverseSetDiagnostics(state->universe, true);
+    RenderViewInit(&state->view, windowWidth, windowHeight,
+                   state->universe->boundary);
+    state->lastWidth = windowWidth;
+    state->lastHeight = windowHeight;
 
     srand(time(NULL));
     const double left = state->universe->boundary.left;
@@ -2,14 +2,27 @@
 #define KURAGE_H
 
 #include "../core/engine.h"
+#include "../render/draw.h"
+
+/**
+ * Bump whenever KurageState changes meaning without changing its size, so a
+ * running host refuses to hand its state to the new build
+ */
+#define KURAGE_STATE_VERSION 2
 
 /**
  * State structure to hold the engine's state for hot reloading
  * This allows preserving the simulation state between reloads
  */
-typedef struct {
+typedef struct KurageState {
   Universe *universe;
-  // Add any other state variables that need to be preserved
+  // Camera and render scratch; textures survive reloads with the GL context
+  RenderView view;
+  // Last window size the view was fitted to
+  int lastWidth;
+  int lastHeight;
+  // kurage_state_layout() of the build that created the state
+  uint64_t layout;
 } KurageState;
 
 /**
@@ -19,10 +32,16 @@ typedef struct {
  */
 #define KURAGE_FUNC_LIST                                                       \
   X(kurage_init, void, void)                                                   \
-  X(kurage_pre_reload, struct KurageState *, void)                                    \
-  X(kurage_post_reload, void, struct KurageState *)                                   \
+  X(kurage_pre_reload, struct KurageState *, void)                             \
+  X(kurage_post_reload, void, struct KurageState *)                            \
+  X(kurage_state_layout, uint64_t, void)                                       \
   X(kurage_logic, void, void)                                                  \
   X(kurage_update, void, void)                                                 \
   X(kurage_render, void, void)
 
+// Entry points exported by the plugin
+#define X(name, ret, ...) ret name(__VA_ARGS__);
+KURAGE_FUNC_LIST
+#undef X
+
 #endif // KURAGE_H
\ No newline at end of file
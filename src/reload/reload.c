@@ -0,0 +1,214 @@
+#include "reload.h"
+
+#include <dlfcn.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <libgen.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#define WATCH_POLL_MS 100
+
+static bool copyFile(const char *from, const char *to) {
+  int in = open(from, O_RDONLY);
+  if (in < 0)
+    return false;
+
+  int out = open(to, O_WRONLY | O_CREAT | O_TRUNC, 0755);
+  if (out < 0) {
+    close(in);
+    return false;
+  }
+
+  char buffer[1 << 16];
+  ssize_t bytes;
+  bool ok = true;
+  while ((bytes = read(in, buffer, sizeof(buffer))) > 0) {
+    if (write(out, buffer, (size_t)bytes) != bytes) {
+      ok = false;
+      break;
+    }
+  }
+
+  close(in);
+  close(out);
+  return ok && bytes == 0;
+}
+
+static void closeApi(KurageApi *api) {
+  if (!api)
+    return;
+
+  if (api->handle)
+    dlclose(api->handle);
+  free(api);
+}
+
+/*
+ * dlopen hands back the already loaded image for a path it has seen, so each
+ * generation is loaded from its own copy. The copy is unlinked right away;
+ * the mapping keeps it alive until dlclose.
+ */
+static KurageApi *loadApi(KurageReloader *reloader) {
+  char copyPath[PATH_MAX];
+  snprintf(copyPath, sizeof(copyPath), "%s.%u", reloader->libraryPath,
+           reloader->generation++);
+
+  if (!copyFile(reloader->libraryPath, copyPath)) {
+    fprintf(stderr, "ERROR: could not copy %s: %s\n", reloader->libraryPath,
+            strerror(errno));
+    return NULL;
+  }
+
+  KurageApi *api = (KurageApi *)calloc(1, sizeof(KurageApi));
+  if (!api) {
+    unlink(copyPath);
+    return NULL;
+  }
+
+  api->handle = dlopen(copyPath, RTLD_NOW | RTLD_LOCAL);
+  unlink(copyPath);
+  if (!api->handle) {
+    fprintf(stderr, "ERROR: could not load %s: %s\n", reloader->libraryPath,
+            dlerror());
+    free(api);
+    return NULL;
+  }
+
+#define X(name, ret, ...)                                                      \
+  *(void **)&api->name = dlsym(api->handle, #name);                            \
+  if (api->name == NULL) {                                                     \
+    fprintf(stderr, "ERROR: could not find %s symbol in %s: %s\n", #name,      \
+            reloader->libraryPath, dlerror());                                 \
+    closeApi(api);                                                             \
+    return NULL;                                                               \
+  }
+  KURAGE_FUNC_LIST
+#undef X
+
+  api->layout = api->kurage_state_layout();
+  return api;
+}
+
+static void stage(KurageReloader *reloader) {
+  KurageApi *api = loadApi(reloader);
+  if (!api)
+    return;
+
+  // Handing an incompatible build a live state would corrupt it
+  if (api->layout != atomic_load(&reloader->activeLayout)) {
+    fprintf(stderr,
+            "ERROR: %s changed the KurageState layout; restart to apply it\n",
+            reloader->libraryPath);
+    closeApi(api);
+    return;
+  }
+
+  // A newer build replaces one that was never swapped in
+  closeApi(atomic_exchange(&reloader->pending, api));
+}
+
+static bool libraryChanged(KurageReloader *reloader, const char *name) {
+  char buffer[4096]
+      __attribute__((aligned(__alignof__(struct inotify_event))));
+  bool changed = false;
+  ssize_t bytes;
+
+  while ((bytes = read(reloader->inotifyFd, buffer, sizeof(buffer))) > 0) {
+    for (char *cursor = buffer; cursor < buffer + bytes;) {
+      const struct inotify_event *event = (const struct inotify_event *)cursor;
+      if (event->len && strcmp(event->name, name) == 0)
+        changed = true;
+      cursor += sizeof(struct inotify_event) + event->len;
+    }
+  }
+
+  return changed;
+}
+
+static void *watch(void *argument) {
+  KurageReloader *reloader = (KurageReloader *)argument;
+  char pathCopy[PATH_MAX];
+  snprintf(pathCopy, sizeof(pathCopy), "%s", reloader->libraryPath);
+  const char *name = basename(pathCopy);
+
+  while (atomic_load(&reloader->running)) {
+    bool reload = atomic_exchange(&reloader->requested, false);
+
+    if (reloader->inotifyFd >= 0) {
+      struct pollfd fd = {reloader->inotifyFd, POLLIN, 0};
+      if (poll(&fd, 1, WATCH_POLL_MS) > 0 && libraryChanged(reloader, name))
+        reload = true;
+    } else {
+      usleep(WATCH_POLL_MS * 1000);
+    }
+
+    if (reload)
+      stage(reloader);
+  }
+
+  return NULL;
+}
+
+int ReloaderStart(KurageReloader *reloader, const char *libraryPath) {
+  memset(reloader, 0, sizeof(*reloader));
+  reloader->libraryPath = libraryPath;
+  reloader->inotifyFd = -1;
+
+  reloader->active = loadApi(reloader);
+  if (!reloader->active)
+    return -1;
+  atomic_store(&reloader->activeLayout, reloader->active->layout);
+
+  // Watch the directory: builds replace the file as often as rewrite it
+  char directory[PATH_MAX];
+  snprintf(directory, sizeof(directory), "%s", libraryPath);
+  reloader->inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (reloader->inotifyFd >= 0 &&
+      inotify_add_watch(reloader->inotifyFd, dirname(directory),
+                        IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+    close(reloader->inotifyFd);
+    reloader->inotifyFd = -1;
+  }
+  if (reloader->inotifyFd < 0)
+    fprintf(stderr, "WARNING: inotify unavailable, reload on request only\n");
+
+  atomic_store(&reloader->running, true);
+  reloader->threadStarted =
+      pthread_create(&reloader->thread, NULL, watch, reloader) == 0;
+  return 0;
+}
+
+void ReloaderRequest(KurageReloader *reloader) {
+  atomic_store(&reloader->requested, true);
+}
+
+bool ReloaderSwap(KurageReloader *reloader) {
+  KurageApi *next = atomic_exchange(&reloader->pending, NULL);
+  if (!next)
+    return false;
+
+  KurageState *state = reloader->active->kurage_pre_reload();
+  next->kurage_post_reload(state);
+
+  closeApi(reloader->active);
+  reloader->active = next;
+  return true;
+}
+
+void ReloaderStop(KurageReloader *reloader) {
+  atomic_store(&reloader->running, false);
+  if (reloader->threadStarted)
+    pthread_join(reloader->thread, NULL);
+
+  if (reloader->inotifyFd >= 0)
+    close(reloader->inotifyFd);
+
+  closeApi(atomic_exchange(&reloader->pending, NULL));
+  closeApi(reloader->active);
+  reloader->active = NULL;
+}
@@ -0,0 +1,65 @@
+/**
+ * reload.h
+ *
+ * Background hot-reload of the plugin library. A watcher thread waits for
+ * the compiler to finish writing the library (inotify), loads a private copy
+ * with dlopen, resolves every KURAGE_FUNC_LIST symbol and checks that the new
+ * build agrees with the running one on the KurageState layout. The frame loop
+ * then only has to swap one pointer between frames, so a reload never stalls
+ * rendering regardless of universe size.
+ */
+#ifndef KURAGE_RELOAD_H
+#define KURAGE_RELOAD_H
+
+#include <limits.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "../plugin/plugin.h"
+
+/* One loaded copy of the plugin with every hot-reloadable entry point */
+typedef struct {
+#define X(name, ret, ...) ret (*name)(__VA_ARGS__);
+  KURAGE_FUNC_LIST
+#undef X
+  void *handle;
+  uint64_t layout;
+} KurageApi;
+
+typedef struct {
+  const char *libraryPath;
+  KurageApi *active;          /* owned by the frame loop */
+  _Atomic(KurageApi *) pending; /* staged by the watcher, taken by the swap */
+  _Atomic uint64_t activeLayout;
+  atomic_bool requested;
+  atomic_bool running;
+  pthread_t thread;
+  bool threadStarted;
+  int inotifyFd;
+  uint32_t generation;
+} KurageReloader;
+
+/**
+ * Loads the library synchronously and starts the watcher thread. Reloading
+ * still works through ReloaderRequest if inotify is unavailable.
+ *
+ * @return 0 on success, -1 if the initial load failed
+ */
+int ReloaderStart(KurageReloader *reloader, const char *libraryPath);
+
+/* Asks the watcher to reload now, e.g. on a key press */
+void ReloaderRequest(KurageReloader *reloader);
+
+/**
+ * Installs a staged library, if any. Call between frames: the old copy's
+ * state is handed to the new copy and the old copy is unloaded.
+ *
+ * @return true if a new library was swapped in
+ */
+bool ReloaderSwap(KurageReloader *reloader);
+
+void ReloaderStop(KurageReloader *reloader);
+
+#endif /* KURAGE_RELOAD_H */
@@ -1,8 +1,9 @@
 #include "draw.h"
 
 #include <math.h>
+#include <stdlib.h>
+#include <string.h>
 
-#include "../../lib/raylib/src/raylib.h"
 #include "../config/config.h"
 
 static Color color_for_speed(double speed) {
@@ -17,35 +18,275 @@ static Color color_for_speed(double speed) {
 	return BLUE;
 }
 
-void RenderUniverse(const Universe *universe) {
-	if (!universe)
+// Dark blue through red to white on a log scale of the tile population
+static Color heatColor(uint32_t count, uint32_t maxCount) {
+	float t = maxCount > 1 ? log1pf((float)count) / log1pf((float)maxCount)
+												 : 1.0f;
+	Color color;
+	color.r = (unsigned char)(255.0f * fminf(1.0f, 2.0f * t));
+	color.g = (unsigned char)(255.0f * fmaxf(0.0f, 2.0f * t - 1.0f));
+	color.b = (unsigned char)(160.0f * (1.0f - t) + 95.0f * t * t);
+	color.a = (unsigned char)(96.0f + 159.0f * t);
+	return color;
+}
+
+void RenderViewInit(RenderView *view, int width, int height,
+										UniverseBoundary world) {
+	memset(view, 0, sizeof(*view));
+
+	double worldWidth = world.right - world.left;
+	double worldHeight = world.bottom - world.top;
+	float zoom = 1.0f;
+	if (worldWidth > 0.0 && worldHeight > 0.0)
+		zoom = (float)fmin(width / worldWidth, height / worldHeight);
+
+	view->camera.target =
+			(Vector2){(float)(world.left + worldWidth * 0.5),
+								(float)(world.top + worldHeight * 0.5)};
+	view->camera.rotation = 0.0f;
+	view->camera.zoom = zoom;
+	RenderViewResize(view, width, height);
+}
+
+void RenderViewResize(RenderView *view, int width, int height) {
+	view->width = width;
+	view->height = height;
+	view->camera.offset = (Vector2){width * 0.5f, height * 0.5f};
+}
+
+Vector2 RenderWorldToScreen(const RenderView *view, KVector2 position) {
+	const Camera2D *camera = &view->camera;
+	return (Vector2){
+			(float)((position.x - camera->target.x) * camera->zoom +
+							camera->offset.x),
+			(float)((position.y - camera->target.y) * camera->zoom +
+							camera->offset.y)};
+}
+
+KVector2 RenderScreenToWorld(const RenderView *view, Vector2 position) {
+	const Camera2D *camera = &view->camera;
+	return (KVector2){
+			(position.x - camera->offset.x) / camera->zoom + camera->target.x,
+			(position.y - camera->offset.y) / camera->zoom + camera->target.y};
+}
+
+void RenderViewHandleInput(RenderView *view) {
+	Camera2D *camera = &view->camera;
+
+	if (IsMouseButtonDown(MOUSE_BUTTON_RIGHT) ||
+			IsMouseButtonDown(MOUSE_BUTTON_MIDDLE)) {
+		Vector2 delta = GetMouseDelta();
+		camera->target.x -= delta.x / camera->zoom;
+		camera->target.y -= delta.y / camera->zoom;
+	}
+
+	float wheel = GetMouseWheelMove();
+	if (wheel != 0.0f) {
+		// Keep the world point under the cursor fixed while zooming
+		Vector2 mouse = GetMousePosition();
+		KVector2 anchor = RenderScreenToWorld(view, mouse);
+		float zoom = camera->zoom * powf(1.1f, wheel);
+		camera->zoom = fminf(fmaxf(zoom, RENDER_MIN_ZOOM), RENDER_MAX_ZOOM);
+		camera->target.x =
+				(float)(anchor.x - (mouse.x - camera->offset.x) / camera->zoom);
+		camera->target.y =
+				(float)(anchor.y - (mouse.y - camera->offset.y) / camera->zoom);
+	}
+}
+
+void RenderViewRelease(RenderView *view) {
+	if (view->hasTexture)
+		UnloadTexture(view->tileTexture);
+	free(view->tileCounts);
+	free(view->tileHeat);
+	free(view->tilePixels);
+	view->tileCounts = NULL;
+	view->tileHeat = NULL;
+	view->tilePixels = NULL;
+	view->hasTexture = false;
+	view->tilesX = view->tilesY = 0;
+}
+
+// (Re)builds the tile grid and its texture when the viewport size changed
+static bool ensureTiles(RenderView *view) {
+	int tilesX = (view->width + RENDER_TILE_PIXELS - 1) / RENDER_TILE_PIXELS;
+	int tilesY = (view->height + RENDER_TILE_PIXELS - 1) / RENDER_TILE_PIXELS;
+	if (tilesX == view->tilesX && tilesY == view->tilesY && view->tileCounts)
+		return true;
+
+	RenderViewRelease(view);
+	if (tilesX <= 0 || tilesY <= 0)
+		return false;
+
+	size_t tiles = (size_t)tilesX * tilesY;
+	view->tileCounts = (uint32_t *)calloc(tiles, sizeof(uint32_t));
+	view->tileHeat = (uint32_t *)calloc(tiles, sizeof(uint32_t));
+	view->tilePixels = (Color *)calloc(tiles, sizeof(Color));
+	if (!view->tileCounts || !view->tileHeat || !view->tilePixels) {
+		RenderViewRelease(view);
+		return false;
+	}
+
+	Image image = GenImageColor(tilesX, tilesY, BLANK);
+	view->tileTexture = LoadTextureFromImage(image);
+	UnloadImage(image);
+	view->hasTexture = true;
+	view->tilesX = tilesX;
+	view->tilesY = tilesY;
+	return true;
+}
+
+static float particleRadius(const Universe *universe, uint32_t slot) {
+	if (universe->entityMasks[slot] & COMPONENT_RADIUS)
+		return (float)universe->radii[slot].radius;
+	return OBJECT_RADIUS;
+}
+
+/*
+ * Screen tile of a particle, or -1 when it is culled. Particles whose centre
+ * is off screen but whose disc reaches into it land in the nearest edge tile.
+ */
+static int visibleTile(const RenderView *view, Vector2 screen,
+											 float screenRadius) {
+	if (screen.x + screenRadius < 0.0f || screen.y + screenRadius < 0.0f ||
+			screen.x - screenRadius >= (float)view->width ||
+			screen.y - screenRadius >= (float)view->height)
+		return -1;
+
+	int tx = (int)(screen.x / RENDER_TILE_PIXELS);
+	int ty = (int)(screen.y / RENDER_TILE_PIXELS);
+	tx = tx < 0 ? 0 : (tx >= view->tilesX ? view->tilesX - 1 : tx);
+	ty = ty < 0 ? 0 : (ty >= view->tilesY ? view->tilesY - 1 : ty);
+	return ty * view->tilesX + tx;
+}
+
+void RenderUniverse(const Universe *universe, RenderView *view) {
+	if (!universe || !view || !ensureTiles(view))
 		return;
 
+	const float zoom = view->camera.zoom;
+	const size_t tiles = (size_t)view->tilesX * view->tilesY;
+	const ComponentMask particles = COMPONENT_PARTICLE;
+
 	if (universe->boundary.enabled) {
 		Color boundaryColor = ColorAlpha(WHITE, 0.8f);
-		DrawRectangleLines(
-				(int)universe->boundary.left, (int)universe->boundary.top,
-				(int)(universe->boundary.right - universe->boundary.left),
-				(int)(universe->boundary.bottom - universe->boundary.top),
-				boundaryColor);
+		Vector2 topLeft = RenderWorldToScreen(
+				view, (KVector2){universe->boundary.left, universe->boundary.top});
+		Vector2 bottomRight = RenderWorldToScreen(
+				view,
+				(KVector2){universe->boundary.right, universe->boundary.bottom});
+		DrawRectangleLines((int)topLeft.x, (int)topLeft.y,
+											 (int)(bottomRight.x - topLeft.x),
+											 (int)(bottomRight.y - topLeft.y), boundaryColor);
 	}
 
-	for (uint32_t i = 0; i < universe->maxEntities; i++) {
-		if (!universe->activeEntities[i] ||
-				!(universe->entityMasks[i] & COMPONENT_PARTICLE))
-			continue;
-
-		const KineticBodyComponent *particle = &universe->kineticBodies[i];
-		Color particleColor = WHITE;
+	// Pass 1: cull and bin
+	memset(view->tileCounts, 0, tiles * sizeof(uint32_t));
+	for (uint32_t w = 0; w < BITSET_WORDS(universe->maxEntities); w++) {
+		uint64_t bits = UniverseMatchWord(universe, w, particles, COMPONENT_NONE);
+		while (bits) {
+			uint32_t i = w * 64 + (uint32_t)__builtin_ctzll(bits);
+			bits &= bits - 1;
 
-		if (universe->entityMasks[i] & COMPONENT_MECHANICS) {
-			const MechanicsComponent *mechanics = &universe->mechanics[i];
-			double speed = sqrt(mechanics->velocity.x * mechanics->velocity.x +
-													mechanics->velocity.y * mechanics->velocity.y);
-			particleColor = color_for_speed(speed);
+			Vector2 screen =
+					RenderWorldToScreen(view, universe->kineticBodies[i].position);
+			int tile = visibleTile(view, screen, particleRadius(universe, i) * zoom);
+			if (tile >= 0)
+				view->tileCounts[tile]++;
 		}
+	}
+
+	// Pass 2: sparse tiles draw their particles, the rest become density
+	memset(view->tileHeat, 0, tiles * sizeof(uint32_t));
+	view->drawn = 0;
+	view->aggregated = 0;
+	for (uint32_t w = 0; w < BITSET_WORDS(universe->maxEntities); w++) {
+		uint64_t bits = UniverseMatchWord(universe, w, particles, COMPONENT_NONE);
+		while (bits) {
+			uint32_t i = w * 64 + (uint32_t)__builtin_ctzll(bits);
+			bits &= bits - 1;
+
+			Vector2 screen =
+					RenderWorldToScreen(view, universe->kineticBodies[i].position);
+			float screenRadius = particleRadius(universe, i) * zoom;
+			int tile = visibleTile(view, screen, screenRadius);
+			if (tile < 0)
+				continue;
 
-		DrawCircle((int)particle->position.x, (int)particle->position.y,
-							 OBJECT_RADIUS, particleColor);
+			if (view->tileCounts[tile] > RENDER_TILE_DETAIL_LIMIT ||
+					screenRadius < RENDER_MIN_RADIUS_PIXELS) {
+				view->tileHeat[tile]++;
+				view->aggregated++;
+				continue;
+			}
+
+			Color particleColor = WHITE;
+			if (universe->entityMasks[i] & COMPONENT_MECHANICS) {
+				const MechanicsComponent *mechanics = &universe->mechanics[i];
+				double speed = sqrt(mechanics->velocity.x * mechanics->velocity.x +
+														mechanics->velocity.y * mechanics->velocity.y);
+				particleColor = color_for_speed(speed);
+			}
+
+			DrawCircleV(screen, screenRadius, particleColor);
+			view->drawn++;
+		}
 	}
+
+	if (view->aggregated == 0)
+		return;
+
+	uint32_t maxHeat = 0;
+	for (size_t t = 0; t < tiles; t++)
+		maxHeat = view->tileHeat[t] > maxHeat ? view->tileHeat[t] : maxHeat;
+
+	for (size_t t = 0; t < tiles; t++)
+		view->tilePixels[t] = view->tileHeat[t]
+															? heatColor(view->tileHeat[t], maxHeat)
+															: BLANK;
+
+	UpdateTexture(view->tileTexture, view->tilePixels);
+	Rectangle source = {0.0f, 0.0f, (float)view->tilesX, (float)view->tilesY};
+	Rectangle destination = {0.0f, 0.0f,
+													 (float)(view->tilesX * RENDER_TILE_PIXELS),
+													 (float)(view->tilesY * RENDER_TILE_PIXELS)};
+	DrawTexturePro(view->tileTexture, source, destination, (Vector2){0, 0},
+								 0.0f, WHITE);
+}
+
+void RenderDiagnostics(const Universe *universe, int x, int y) {
+	const UniverseDiagnostics *diagnostics = UniverseGetDiagnostics(universe);
+	if (!diagnostics || !diagnostics->enabled || !diagnostics->hasReference)
+		return;
+
+	const int fontSize = 10;
+	const int line = fontSize + 2;
+	const DiagnosticsSample *sample = &diagnostics->current;
+	Color color = LIGHTGRAY;
+	if (diagnostics->flaggedSteps)
+		color = diagnostics->flags ? RED : ORANGE;
+
+	DrawText(TextFormat("E %.4g  drift %+.2e  step %+.2e", sample->kineticEnergy,
+											diagnostics->energyDrift, diagnostics->stepDrift),
+					 x, y, fontSize, color);
+	DrawText(TextFormat("P (%.3g, %.3g)  drift %.2e", sample->momentum.x,
+											sample->momentum.y, diagnostics->momentumDrift),
+					 x, y + line, fontSize, color);
+	DrawText(TextFormat("bounds (%.0f, %.0f)-(%.0f, %.0f)  n %u",
+											sample->boundsMin.x, sample->boundsMin.y,
+											sample->boundsMax.x, sample->boundsMax.y, sample->count),
+					 x, y + 2 * line, fontSize, color);
+
+	if (!diagnostics->flaggedSteps)
+		return;
+
+	uint32_t flags = diagnostics->flags;
+	DrawText(TextFormat("unstable: %llu steps%s%s%s%s%s",
+											(unsigned long long)diagnostics->flaggedSteps,
+											flags & DIAGNOSTICS_NON_FINITE ? " nan" : "",
+											flags & DIAGNOSTICS_ENERGY_DRIFT ? " energy" : "",
+											flags & DIAGNOSTICS_STEP_DRIFT ? " step" : "",
+											flags & DIAGNOSTICS_MOMENTUM_DRIFT ? " momentum" : "",
+											flags & DIAGNOSTICS_ESCAPED ? " escaped" : ""),
+					 x, y + 3 * line, fontSize, color);
 }
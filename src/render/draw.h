@@ -1,10 +1,49 @@
 #ifndef RENDER_DRAW_H
 #define RENDER_DRAW_H
 
+#include <stdbool.h>
 #include <stdint.h>
 
+#include "../../lib/raylib/src/raylib.h"
 #include "../core/engine.h"
 
-void RenderUniverse(const Universe *universe);
+/**
+ * Camera onto the world plus the scratch of the tile pipeline. The screen is
+ * cut into RENDER_TILE_PIXELS tiles. Particles are culled against the
+ * viewport and binned into tiles. Sparse tiles draw their particles one by
+ * one. Dense tiles, and particles too small to see, become one texel of a
+ * density texture, so the draw batch is bounded by pixels, not particles.
+ */
+typedef struct {
+	Camera2D camera; /* offset = viewport centre, target = world point there */
+	int width;
+	int height;
+	int tilesX;
+	int tilesY;
+	uint32_t *tileCounts; /* visible particles per tile */
+	uint32_t *tileHeat;   /* of those, the ones folded into density */
+	Color *tilePixels;
+	Texture2D tileTexture;
+	bool hasTexture;
+	/* Last frame's split, for overlays */
+	uint32_t drawn;
+	uint32_t aggregated;
+} RenderView;
+
+/* Frames `world` in a width x height viewport */
+void RenderViewInit(RenderView *view, int width, int height,
+										UniverseBoundary world);
+/* Keeps the world point at the viewport centre where it was */
+void RenderViewResize(RenderView *view, int width, int height);
+/* Wheel zooms about the cursor, right or middle drag pans */
+void RenderViewHandleInput(RenderView *view);
+void RenderViewRelease(RenderView *view);
+
+Vector2 RenderWorldToScreen(const RenderView *view, KVector2 position);
+KVector2 RenderScreenToWorld(const RenderView *view, Vector2 position);
+
+void RenderUniverse(const Universe *universe, RenderView *view);
+/* Energy, momentum and drift of the last step; red once a step is flagged */
+void RenderDiagnostics(const Universe *universe, int x, int y);
 
 #endif /* RENDER_DRAW_H */
@@ -0,0 +1,147 @@
+#include <stdint.h>
+#include <stdio.h>
+#include "../src/core/engine.h"
+
+static int inside_block(const KArenaBlock *block, const void *pointer) {
+    uintptr_t begin = (uintptr_t)block;
+    return (uintptr_t)pointer >= begin && (uintptr_t)pointer < begin + block->size;
+}
+
+int test_single_block_layout() {
+    UniverseOptions options = {0};
+    options.touchThreads = 4;
+    Universe *universe = UniverseCreateWithOptions(10000, &options);
+    if (!universe) {
+        fprintf(stderr, "Failed to create universe\n");
+        return 1;
+    }
+
+    // Built-in systems run their queries on the first update
+    ParticleCreate(universe, (KVector2){50, 50}, (KVector2){1, 1}, 1.0);
+    UniverseUpdate(universe, 0.1);
+
+    const KArenaBlock *block = universe->arena->head;
+    int ok = block->next == NULL && inside_block(block, universe) &&
+             inside_block(block, universe->entityMasks) &&
+             inside_block(block, universe->freeEntities);
+    for (uint32_t c = 0; c < universe->componentCount; c++) {
+        ok &= inside_block(block, universe->columns[c].data);
+        ok &= (uintptr_t)universe->columns[c].data % COLUMN_ALIGNMENT == 0;
+    }
+    for (uint32_t q = 0; q < universe->queryCount; q++)
+        ok &= inside_block(block, universe->queries[q].entities);
+
+    if (!ok) {
+        fprintf(stderr, "Universe storage is not one aligned block\n");
+        UniverseDestroy(universe);
+        return 1;
+    }
+
+    UniverseDestroy(universe);
+    printf("Single block layout test: PASSED\n");
+    return 0;
+}
+
+int test_arena_overflow_and_huge_pages() {
+    UniverseOptions options = {0};
+    options.hugePages = true;
+    Universe *universe = UniverseCreateWithOptions(50000, &options);
+    if (!universe) {
+        fprintf(stderr, "Failed to create universe\n");
+        return 1;
+    }
+
+    // Far more column data than reserved must chain a second block
+    for (int c = 0; c < 8; c++) {
+        if (UniverseRegisterComponent(universe, 256, 64) == INVALID_COMPONENT) {
+            fprintf(stderr, "Registration failed after arena overflow\n");
+            UniverseDestroy(universe);
+            return 1;
+        }
+    }
+
+    if (universe->arena->head->next == NULL) {
+        fprintf(stderr, "Expected a chained arena block\n");
+        UniverseDestroy(universe);
+        return 1;
+    }
+
+    UniverseDestroy(universe);
+    printf("Arena overflow test: PASSED\n");
+    return 0;
+}
+
+int test_heap_allocator() {
+    KAllocator heap = KHeapAllocator();
+    UniverseOptions options = {0};
+    options.allocator = &heap;
+    Universe *universe = UniverseCreateWithOptions(100, &options);
+    if (!universe || universe->arena != NULL) {
+        fprintf(stderr, "Failed to create heap-backed universe\n");
+        UniverseDestroy(universe);
+        return 1;
+    }
+
+    EntityID particle = ParticleCreate(universe, (KVector2){50, 50}, (KVector2){10, 0}, 1.0);
+    UniverseUpdate(universe, 0.1);
+    if (UniverseGetKineticBodyComponent(universe, particle)->position.x != 51.0) {
+        fprintf(stderr, "Heap-backed universe did not simulate\n");
+        UniverseDestroy(universe);
+        return 1;
+    }
+
+    UniverseDestroy(universe);
+    printf("Heap allocator test: PASSED\n");
+    return 0;
+}
+
+// Overflow blocks follow the requests, not the size of the first block
+int test_overflow_growth() {
+    const size_t capacity = (size_t)64 << 20;
+    KArena *arena = KArenaCreate(capacity, false);
+    if (!arena || !KArenaAllocate(arena, capacity, 64)) {
+        fprintf(stderr, "Failed to fill the first arena block\n");
+        KArenaDestroy(arena);
+        return 1;
+    }
+
+    size_t requested = 0, overflow = 0, previous = 0;
+    int ok = 1;
+    for (int i = 0; i < 200; i++) {
+        size_t size = 1000 + 100 * (size_t)i;
+        ok &= KArenaAllocate(arena, size, 64) != NULL;
+        requested += size;
+    }
+    // Newest first; every block at least twice the one before it
+    for (const KArenaBlock *block = arena->head; block->next; block = block->next) {
+        overflow += block->size;
+        ok &= previous == 0 || block->size * 2 <= previous;
+        previous = block->size;
+    }
+    ok &= overflow < 4 * requested + ((size_t)64 << 10);
+
+    if (!ok)
+        fprintf(stderr, "Overflow blocks hold %zu bytes for %zu requested\n", overflow, requested);
+    KArenaDestroy(arena);
+    if (!ok)
+        return 1;
+    printf("Overflow growth test: PASSED\n");
+    return 0;
+}
+
+int main(void) {
+    int result = 0;
+
+    result |= test_single_block_layout();
+    result |= test_arena_overflow_and_huge_pages();
+    result |= test_heap_allocator();
+    result |= test_overflow_growth();
+
+    if (result == 0) {
+        printf("\nAll allocator tests passed!\n");
+    } else {
+        printf("\nSome tests failed!\n");
+    }
+
+    return result;
+}
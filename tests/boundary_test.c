@@ -0,0 +1,90 @@
+#include <stdio.h>
+#include <math.h>
+#include "../src/config/config.h"
+#include "../src/core/engine.h"
+
+#define EPSILON 0.000001
+#define DELTA_TIME 0.1
+
+int test_swept_bounce() {
+    Universe *universe = UniverseCreate(4);
+    if (!universe) {
+        fprintf(stderr, "Failed to create universe\n");
+        return 1;
+    }
+    UniverseSetBoundaries(universe, 200, 200, 0.0f, true);
+
+    // Radius 5 puts the left contact plane at x = 5; the step ends at x = 0,
+    // so 5 units of travel remain after impact and 5 * RESTITUTION survive
+    EntityID particle = ParticleCreate(universe, (KVector2){20.0, 100.0}, (KVector2){-200.0, 0.0}, 1.0);
+    UniverseUpdate(universe, DELTA_TIME);
+
+    KineticBodyComponent *body = UniverseGetKineticBodyComponent(universe, particle);
+    MechanicsComponent *mech = UniverseGetMechanicsComponent(universe, particle);
+    double expected_x = 5.0 + 5.0 * RESTITUTION;
+    double expected_vx = 200.0 * RESTITUTION;
+
+    printf("After bounce: x=%.3f vx=%.3f (expected %.3f, %.3f)\n",
+           body->position.x, mech->velocity.x, expected_x, expected_vx);
+
+    if (fabs(body->position.x - expected_x) > EPSILON ||
+        fabs(mech->velocity.x - expected_vx) > EPSILON) {
+        fprintf(stderr, "Swept bounce mismatch\n");
+        UniverseDestroy(universe);
+        return 1;
+    }
+
+    UniverseDestroy(universe);
+    printf("Swept bounce test: PASSED\n");
+    return 0;
+}
+
+int test_large_steps_stay_inside() {
+    Universe *universe = UniverseCreate(64);
+    if (!universe) {
+        fprintf(stderr, "Failed to create universe\n");
+        return 1;
+    }
+    UniverseSetBoundaries(universe, 300, 200, 10.0f, true);
+
+    for (int i = 0; i < 64; i++) {
+        EntityID e = ParticleCreate(universe, (KVector2){20.0 + 4.0 * i, 50.0 + i},
+                                    (KVector2){(i % 7 - 3) * 400.0, (i % 5 - 2) * 300.0}, 1.0);
+        UniverseAddRadiusComponent(universe, e, 1.0 + (i % 4));
+    }
+
+    for (int step = 0; step < 200; step++) {
+        UniverseUpdate(universe, 0.5);
+        for (EntityID i = 0; i < universe->maxEntities; i++) {
+            const KVector2 p = universe->kineticBodies[i].position;
+            const double r = universe->radii[i].radius;
+            if (p.x < universe->boundary.left + r - EPSILON ||
+                p.x > universe->boundary.right - r + EPSILON ||
+                p.y < universe->boundary.top + r - EPSILON ||
+                p.y > universe->boundary.bottom - r + EPSILON) {
+                fprintf(stderr, "Entity %u escaped at step %d\n", i, step);
+                UniverseDestroy(universe);
+                return 1;
+            }
+        }
+    }
+
+    UniverseDestroy(universe);
+    printf("Large step containment test: PASSED\n");
+    return 0;
+}
+
+int main(void) {
+    int result = 0;
+
+    result |= test_swept_bounce();
+    result |= test_large_steps_stay_inside();
+
+    if (result == 0) {
+        printf("\nAll boundary tests passed!\n");
+    } else {
+        printf("\nSome tests failed!\n");
+    }
+
+    return result;
+}
@@ -0,0 +1,187 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "../src/config/config.h"
+#include "../src/core/engine.h"
+
+#define DT (1.0 / 60.0)
+#define CHUNK 50.0
+#define GRID 20
+#define WORLD_PARTICLES 20000
+
+static ChunkSettings worldSettings(void) {
+    ChunkSettings settings = ChunkDefaultSettings();
+    settings.chunkSize = CHUNK;
+    settings.chunksX = GRID;
+    settings.chunksY = GRID;
+    settings.capacity = 256;
+    settings.halo = 0;
+    return settings;
+}
+
+// Resident particles inside [min, max], as sums of their coordinates
+static uint32_t residentIn(Universe *universe, KVector2 min, KVector2 max, double *sum) {
+    uint32_t count = 0;
+    *sum = 0.0;
+    for (uint32_t slot = 0; slot < universe->maxEntities; slot++) {
+        if (!UniverseIsSlotActive(universe, slot) || !(universe->entityMasks[slot] & COMPONENT_PARTICLE))
+            continue;
+        KVector2 p = universe->kineticBodies[slot].position;
+        if (p.x >= min.x && p.x < max.x && p.y >= min.y && p.y < max.y) {
+            count++;
+            *sum += p.x + 1000.0 * p.y;
+        }
+    }
+    return count;
+}
+
+// A world ten times larger than the universe: only the focus is resident,
+// and frozen particles come back exactly as they left
+int test_out_of_core() {
+    Universe *universe = UniverseCreate(2000);
+    UniverseSetBoundaries(universe, GRID * CHUNK, GRID * CHUNK, 0.0f, false);
+    ChunkSettings settings = worldSettings();
+    int failed = !UniverseChunksEnable(universe, &settings);
+
+    srand(50);
+    double originalSum = 0.0;
+    uint32_t originalCount = 0;
+    for (int i = 0; !failed && i < WORLD_PARTICLES; i++) {
+        KVector2 position = {rand() % 10000 / 10.0, rand() % 10000 / 10.0};
+        failed |= !ChunkParticleCreate(universe, position, (KVector2){0, 0}, 1.0);
+        if (position.x < 2 * CHUNK && position.y < 2 * CHUNK) {
+            originalCount++;
+            originalSum += position.x + 1000.0 * position.y;
+        }
+    }
+    failed |= UniverseCountActive(universe) != 0 || ChunkGetStats(universe)->frozenParticles != WORLD_PARTICLES;
+
+    // Walk a 2x2-chunk viewport across the world and back
+    uint32_t most = 0;
+    for (int leg = 0; !failed && leg < 20; leg++) {
+        double x = (leg < 10 ? leg : 19 - leg) * 2 * CHUNK;
+        double y = (leg < 10 ? leg : 19 - leg) * CHUNK;
+        ChunkSetFocus(universe, 0, (KVector2){x, y}, (KVector2){x + 2 * CHUNK - 1, y + 2 * CHUNK - 1});
+        for (int step = 0; step < 3; step++)
+            UniverseUpdate(universe, DT);
+
+        const ChunkStats *stats = ChunkGetStats(universe);
+        uint32_t resident = UniverseCountActive(universe);
+        most = resident > most ? resident : most;
+        failed |= stats->wantedChunks != 4 || resident + stats->frozenParticles != WORLD_PARTICLES ||
+                  stats->overflowed || stats->starved || !UniverseValidate(universe);
+    }
+
+    double sum = 0.0;
+    uint32_t count = residentIn(universe, (KVector2){0, 0}, (KVector2){2 * CHUNK, 2 * CHUNK}, &sum);
+    failed |= count != originalCount || count != UniverseCountActive(universe) ||
+              fabs(sum - originalSum) > 1e-6 * originalSum;
+    failed |= !ChunkIsWanted(universe, (KVector2){10, 10}) || ChunkIsWanted(universe, (KVector2){500, 500}) ||
+              ChunkIndex(universe, (KVector2){-5, 1e9}) != (GRID - 1) * GRID;
+    if (failed)
+        fprintf(stderr, "Resident %u of %u, at most %u\n", count, originalCount, most);
+
+    UniverseDestroy(universe);
+    if (!failed)
+        printf("Out-of-core test: PASSED\n");
+    return failed;
+}
+
+// Emitters keep their chunk simulated without a focus, and a fast particle
+// faults in the chunks it flies into
+int test_activity() {
+    Universe *universe = UniverseCreate(4000);
+    UniverseSetBoundaries(universe, GRID * CHUNK, GRID * CHUNK, 0.0f, false);
+    ChunkSettings settings = worldSettings();
+    settings.wakeSpeed = 200.0;
+    settings.halo = 1;
+    int failed = !UniverseChunksEnable(universe, &settings);
+    ChunkSetFocus(universe, 0, (KVector2){0, 0}, (KVector2){CHUNK - 1, CHUNK - 1});
+
+    EmitterComponent emitter = {{0, 1}, 0.2, 60.0, 1, 5, 2.0, 1.0, 0.0, 50};
+    EntityID source = EmitterCreate(universe, (KVector2){15 * CHUNK + 25, 15 * CHUNK + 25}, &emitter);
+    for (int i = 0; i < 20; i++)
+        ChunkParticleCreate(universe, (KVector2){8 * CHUNK + i, 25}, (KVector2){0, 0}, 1.0);
+    ChunkParticleCreate(universe, (KVector2){10, 25}, (KVector2){600, 0}, 1.0);
+
+    UniverseUpdate(universe, DT);
+    const ChunkStats *stats = ChunkGetStats(universe);
+    failed |= source == INVALID_ENTITY || !ChunkIsWanted(universe, (KVector2){15 * CHUNK + 25, 15 * CHUNK + 25}) ||
+              ChunkIsWanted(universe, (KVector2){8 * CHUNK, 25}) || stats->frozenParticles != 20;
+
+    // After about 0.7s the runner has crossed into chunk 8
+    for (int step = 0; step < 45; step++)
+        UniverseUpdate(universe, DT);
+    failed |= !ChunkIsWanted(universe, (KVector2){8 * CHUNK, 25}) || stats->frozenParticles != 0;
+
+    // The emitter has been busy the whole time, far from any focus
+    uint32_t lifetimes = 0;
+    for (uint32_t slot = 0; slot < universe->maxEntities; slot++)
+        lifetimes += UniverseIsSlotActive(universe, slot) &&
+                     (universe->entityMasks[slot] & COMPONENT_BIT(universe->lifetimeComponent));
+    failed |= lifetimes < 30;
+    if (failed)
+        fprintf(stderr, "Frozen %llu, emitted %u\n", (unsigned long long)stats->frozenParticles, lifetimes);
+
+    UniverseDestroy(universe);
+    if (!failed)
+        printf("Activity test: PASSED\n");
+    return failed;
+}
+
+// The page file is sparse, sized for every chunk, and a full chunk leaves
+// the rest resident
+int test_page_file() {
+    char path[] = "/tmp/kurage-chunk-test-XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0)
+        return 1;
+    close(fd);
+
+    Universe *universe = UniverseCreate(1000);
+    ChunkSettings settings = worldSettings();
+    settings.capacity = 100;
+    settings.path = path;
+    int failed = !UniverseChunksEnable(universe, &settings);
+    ChunkSetFocus(universe, 0, (KVector2){900, 900}, (KVector2){999, 999});
+    for (int i = 0; i < 150; i++)
+        ParticleCreate(universe, (KVector2){10 + i % 30, 10 + i / 30}, (KVector2){0, 0}, 1.0);
+    UniverseChunksStream(universe);
+
+    const ChunkStats *stats = ChunkGetStats(universe);
+    struct stat info;
+    failed |= stat(path, &info) != 0 || (size_t)info.st_size != universe->chunks->slotBytes * GRID * GRID ||
+              (size_t)info.st_blocks * 512 > 4 * universe->chunks->slotBytes;
+    failed |= stats->frozen != 100 || stats->overflowed != 50 || UniverseCountActive(universe) != 50;
+    failed |= ChunkSetFocus(universe, CHUNK_MAX_FOCI, (KVector2){0, 0}, (KVector2){1, 1});
+
+    // Moving the focus there thaws the chunk in full
+    ChunkSetFocus(universe, 0, (KVector2){0, 0}, (KVector2){1, 1});
+    UniverseChunksStream(universe);
+    failed |= stats->thawed != 100 || UniverseCountActive(universe) != 150 || stats->frozenParticles != 0;
+
+    UniverseDestroy(universe);
+    unlink(path);
+    if (!failed)
+        printf("Page file test: PASSED\n");
+    return failed;
+}
+
+int main(void) {
+    int result = 0;
+
+    result |= test_out_of_core();
+    result |= test_activity();
+    result |= test_page_file();
+
+    if (result == 0) {
+        printf("\nAll chunk tests passed!\n");
+    } else {
+        printf("\nSome chunk tests failed!\n");
+    }
+
+    return result;
+}
@@ -0,0 +1,119 @@
+#include <stdio.h>
+#include "../src/core/engine.h"
+
+int test_deferred_playback() {
+    Universe *universe = UniverseCreate(16);
+    if (!universe) {
+        fprintf(stderr, "Failed to create universe\n");
+        return 1;
+    }
+
+    EntityID victim = ParticleCreate(universe, (KVector2){0, 0}, (KVector2){0, 0}, 1.0);
+    EntityID pushed = ParticleCreate(universe, (KVector2){0, 0}, (KVector2){0, 0}, 2.0);
+
+    CommandBuffer *first = UniverseGetCommandBuffer(universe, 0);
+    CommandBuffer *second = UniverseGetCommandBuffer(universe, 1);
+
+    uint32_t spawned = CommandBufferCreateEntity(first);
+    KineticBodyComponent body = {{5.0, 6.0}, {5.0, 6.0}, 1.0};
+    CommandBufferAddComponent(first, spawned, COMPONENT_ID_KINETIC_BODY, &body, sizeof(body));
+    CommandBufferAddComponent(first, spawned, COMPONENT_ID_MECHANICS, NULL, 0);
+    CommandBufferDestroyEntity(first, victim);
+    CommandBufferDestroyEntity(second, victim);
+    CommandBufferApplyForce(second, pushed, (KVector2){4.0, 0.0});
+
+    if (universe->entityCount != 2 || !COMMAND_IS_PENDING(spawned)) {
+        fprintf(stderr, "Commands were applied before the flush\n");
+        UniverseDestroy(universe);
+        return 1;
+    }
+
+    UniverseFlushCommands(universe);
+
+    if (universe->entityCount != 2 || UniverseIsEntityActive(universe, victim)) {
+        fprintf(stderr, "Create/destroy playback mismatch\n");
+        UniverseDestroy(universe);
+        return 1;
+    }
+
+    const EntityQuery *particles = UniverseQuery(universe, COMPONENT_PARTICLE | COMPONENT_MECHANICS, COMPONENT_NONE);
+    EntityID created = INVALID_ENTITY;
+    for (uint32_t k = 0; k < particles->count; k++) {
+        if (particles->entities[k] != pushed)
+            created = particles->entities[k];
+    }
+
+    KineticBodyComponent *stored = UniverseGetKineticBodyComponent(universe, created);
+    MechanicsComponent *force = UniverseGetMechanicsComponent(universe, pushed);
+    if (!stored || stored->position.x != 5.0 || stored->position.y != 6.0 ||
+        !force || force->forceAccum.x != 4.0) {
+        fprintf(stderr, "Component/force playback mismatch\n");
+        UniverseDestroy(universe);
+        return 1;
+    }
+
+    if (first->count != 0 || second->count != 0) {
+        fprintf(stderr, "Buffers were not reset after the flush\n");
+        UniverseDestroy(universe);
+        return 1;
+    }
+
+    UniverseDestroy(universe);
+    printf("Deferred playback test: PASSED\n");
+    return 0;
+}
+
+// One buffer frees an ID that another buffer's creation would reuse; the
+// second buffer's own destroy of the old entity must not hit the new one
+int test_cross_buffer_reuse() {
+    Universe *universe = UniverseCreate(16);
+    if (!universe) {
+        fprintf(stderr, "Failed to create universe\n");
+        return 1;
+    }
+
+    EntityID victim = ParticleCreate(universe, (KVector2){0, 0}, (KVector2){0, 0}, 1.0);
+    CommandBuffer *first = UniverseGetCommandBuffer(universe, 0);
+    CommandBuffer *second = UniverseGetCommandBuffer(universe, 1);
+
+    CommandBufferDestroyEntity(first, victim);
+    uint32_t spawned = CommandBufferCreateEntity(second);
+    KineticBodyComponent body = {{1.0, 2.0}, {1.0, 2.0}, 1.0};
+    CommandBufferAddComponent(second, spawned, COMPONENT_ID_KINETIC_BODY, &body, sizeof(body));
+    CommandBufferDestroyEntity(second, victim);
+    UniverseFlushCommands(universe);
+
+    const EntityQuery *particles = UniverseQuery(universe, COMPONENT_PARTICLE, COMPONENT_NONE);
+    int failed = universe->entityCount != 1 || particles->count != 1 || UniverseIsEntityActive(universe, victim);
+
+    // A payload of the wrong size is dropped rather than over-read
+    EntityID target = particles->count ? particles->entities[0] : INVALID_ENTITY;
+    double radius = 9.0;
+    CommandBufferAddComponent(first, target, COMPONENT_ID_KINETIC_BODY, &radius, sizeof(radius));
+    UniverseFlushCommands(universe);
+    KineticBodyComponent *stored = UniverseGetKineticBodyComponent(universe, target);
+    failed |= !stored || stored->position.x != 1.0 || stored->position.y != 2.0 || !UniverseValidate(universe);
+
+    UniverseDestroy(universe);
+    if (failed) {
+        fprintf(stderr, "Cross-buffer playback mismatch\n");
+        return 1;
+    }
+    printf("Cross-buffer reuse test: PASSED\n");
+    return 0;
+}
+
+int main(void) {
+    int result = 0;
+
+    result |= test_deferred_playback();
+    result |= test_cross_buffer_reuse();
+
+    if (result == 0) {
+        printf("\nAll command buffer tests passed!\n");
+    } else {
+        printf("\nSome tests failed!\n");
+    }
+
+    return result;
+}
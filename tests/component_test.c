@@ -0,0 +1,104 @@
+#include <stdint.h>
+#include <stdio.h>
+#include "../src/core/engine.h"
+
+typedef struct {
+    double charge;
+    float radius;
+} ChargeComponent;
+
+typedef struct {
+    _Alignas(32) double lanes[4];
+} WideComponent;
+
+int test_register_and_store() {
+    Universe *universe = UniverseCreate(32);
+    if (!universe) {
+        fprintf(stderr, "Failed to create universe\n");
+        return 1;
+    }
+
+    ComponentID charge = UniverseRegisterComponent(universe, sizeof(ChargeComponent), _Alignof(ChargeComponent));
+    ComponentID wide = UniverseRegisterComponent(universe, sizeof(WideComponent), _Alignof(WideComponent));
+
+    if (charge != COMPONENT_BUILTIN_COUNT || wide != COMPONENT_BUILTIN_COUNT + 1) {
+        fprintf(stderr, "Unexpected component ids %u %u\n", charge, wide);
+        UniverseDestroy(universe);
+        return 1;
+    }
+
+    if ((uintptr_t)UniverseGetColumn(universe, wide) % COLUMN_ALIGNMENT != 0 ||
+        universe->columns[wide].stride % 32 != 0) {
+        fprintf(stderr, "Column is not aligned\n");
+        UniverseDestroy(universe);
+        return 1;
+    }
+
+    EntityID entity = ParticleCreate(universe, (KVector2){0, 0}, (KVector2){0, 0}, 1.0);
+    ChargeComponent value = {-1.5, 2.0f};
+    UniverseAddComponent(universe, entity, charge, &value);
+
+    ChargeComponent *stored = UniverseGetComponent(universe, entity, charge);
+    if (!stored || stored->charge != -1.5 || stored->radius != 2.0f ||
+        UniverseGetComponent(universe, entity, wide) != NULL) {
+        fprintf(stderr, "Component storage mismatch\n");
+        UniverseDestroy(universe);
+        return 1;
+    }
+
+    if (&UNIVERSE_COLUMN(universe, ChargeComponent, charge)[entity] != stored) {
+        fprintf(stderr, "Column view mismatch\n");
+        UniverseDestroy(universe);
+        return 1;
+    }
+
+    UniverseDestroy(universe);
+    printf("Component registration test: PASSED\n");
+    return 0;
+}
+
+int test_custom_component_queries() {
+    Universe *universe = UniverseCreate(32);
+    if (!universe) {
+        fprintf(stderr, "Failed to create universe\n");
+        return 1;
+    }
+
+    ComponentID charge = UniverseRegisterComponent(universe, sizeof(ChargeComponent), _Alignof(ChargeComponent));
+    const EntityQuery *charged = UniverseQuery(universe, COMPONENT_PARTICLE | COMPONENT_BIT(charge), COMPONENT_NONE);
+
+    EntityID entity = ParticleCreate(universe, (KVector2){0, 0}, (KVector2){0, 0}, 1.0);
+    UniverseAddComponent(universe, entity, charge, NULL);
+
+    if (!charged || charged->count != 1) {
+        fprintf(stderr, "Custom component not visible to queries\n");
+        UniverseDestroy(universe);
+        return 1;
+    }
+
+    UniverseRemoveComponent(universe, entity, charge);
+    if (charged->count != 0 || UniverseGetComponent(universe, entity, charge) != NULL) {
+        fprintf(stderr, "Component removal not reflected\n");
+        UniverseDestroy(universe);
+        return 1;
+    }
+
+    UniverseDestroy(universe);
+    printf("Custom component query test: PASSED\n");
+    return 0;
+}
+
+int main(void) {
+    int result = 0;
+
+    result |= test_register_and_store();
+    result |= test_custom_component_queries();
+
+    if (result == 0) {
+        printf("\nAll component tests passed!\n");
+    } else {
+        printf("\nSome tests failed!\n");
+    }
+
+    return result;
+}
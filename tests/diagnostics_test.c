@@ -0,0 +1,205 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "../src/core/engine.h"
+
+#define COUNT 40000
+
+static void populate(Universe *universe, int walls) {
+    UniverseSetBoundaries(universe, 1000, 1000, 10.0f, walls);
+    srand(11);
+    for (int i = 0; i < COUNT; i++) {
+        KVector2 p = {20 + rand() % 960, 20 + rand() % 960};
+        KVector2 v = {rand() % 200 - 100.0, rand() % 200 - 100.0};
+        ParticleCreate(universe, p, v, (rand() % 100 + 1) / 10.0);
+    }
+}
+
+static int close(double a, double b) {
+    return fabs(a - b) <= 1e-12 * (fabs(a) > fabs(b) ? fabs(a) : fabs(b)) + 1e-12;
+}
+
+static int sameSample(const DiagnosticsSample *a, const DiagnosticsSample *b) {
+    return a->count == b->count && close(a->kineticEnergy, b->kineticEnergy) &&
+           close(a->mass, b->mass) && close(a->momentum.x, b->momentum.x) &&
+           close(a->momentum.y, b->momentum.y) &&
+           a->boundsMin.x == b->boundsMin.x && a->boundsMin.y == b->boundsMin.y &&
+           a->boundsMax.x == b->boundsMax.x && a->boundsMax.y == b->boundsMax.y;
+}
+
+// Whichever sweep takes the sample, it must match a separate measurement
+int test_fused_matches_measure() {
+    const char *names[] = {"free", "walls", "adaptive", "obstacles", "adaptive obstacles"};
+    int failed = 0;
+
+    for (int mode = 0; mode < 5 && !failed; mode++) {
+        Universe *universe = UniverseCreate(COUNT);
+        populate(universe, mode > 0);
+        if (mode == 2 || mode == 4)
+            UniverseSetAdaptiveTimestep(universe, 2.0);
+        // Obstacles resolve after the walls, so their pass must sample
+        if (mode >= 3) {
+            ObstaclesEnable(universe, 4, 0);
+            ObstacleAddCircle(universe, (KVector2){500, 500}, 150.0);
+            ObstacleAddSegment(universe, (KVector2){100, 800}, (KVector2){900, 850});
+        }
+        UniverseSetDiagnostics(universe, true);
+
+        for (int s = 0; s < 20 && !failed; s++) {
+            UniverseUpdate(universe, 0.05);
+            DiagnosticsSample measured = PhysicsMeasure(universe);
+            if (!sameSample(&universe->diagnostics.current, &measured)) {
+                fprintf(stderr, "%s: fused sample differs at step %d (E %.17g vs %.17g)\n",
+                        names[mode], s, universe->diagnostics.current.kineticEnergy,
+                        measured.kineticEnergy);
+                failed = 1;
+            }
+        }
+        UniverseDestroy(universe);
+    }
+
+    if (!failed)
+        printf("Fused sample test: PASSED\n");
+    return failed;
+}
+
+// One huge body, then many small ones whose word sums are below its ulp: a
+// plain running sum drops them all. Bodiless entities fill the rest of the
+// huge body's word, so it is summed alone.
+int test_compensated_sum() {
+    Universe *universe = UniverseCreate(COUNT + 64);
+    ParticleCreate(universe, (KVector2){0, 0}, (KVector2){0x1p27, 0}, 2.0);
+    for (int i = 1; i < 64; i++)
+        UniverseCreateEntity(universe);
+    for (int i = 0; i < COUNT; i++)
+        ParticleCreate(universe, (KVector2){1, 1}, (KVector2){0, 0.125}, 2.0);
+
+    DiagnosticsSample sample = PhysicsMeasure(universe);
+    double expected = 0x1p54 + COUNT / 64.0;
+
+    int failed = 0;
+    if (sample.kineticEnergy != expected) {
+        fprintf(stderr, "Energy %.17g, expected %.17g\n", sample.kineticEnergy, expected);
+        failed = 1;
+    }
+
+    UniverseDestroy(universe);
+    if (!failed)
+        printf("Compensated sum test: PASSED\n");
+    return failed;
+}
+
+// Free flight conserves both; a kick and a NaN must be flagged
+int test_drift_flags() {
+    Universe *universe = UniverseCreate(COUNT);
+    populate(universe, 0);
+    UniverseSetDiagnostics(universe, true);
+
+    int failed = 0;
+    for (int s = 0; s < 50; s++)
+        UniverseUpdate(universe, 0.05);
+
+    const UniverseDiagnostics *diagnostics = UniverseGetDiagnostics(universe);
+    if (diagnostics->flaggedSteps || fabs(diagnostics->energyDrift) > 1e-12 ||
+        diagnostics->momentumDrift > 1e-12) {
+        fprintf(stderr, "Free flight drifted: energy %g momentum %g (%llu flagged)\n",
+                diagnostics->energyDrift, diagnostics->momentumDrift,
+                (unsigned long long)diagnostics->flaggedSteps);
+        failed = 1;
+    }
+
+    for (EntityID e = 0; e < COUNT; e++)
+        universe->mechanics[e].velocity.x += 50.0;
+    UniverseUpdate(universe, 0.05);
+    uint32_t kicked = DIAGNOSTICS_ENERGY_DRIFT | DIAGNOSTICS_STEP_DRIFT |
+                      DIAGNOSTICS_MOMENTUM_DRIFT;
+    if ((diagnostics->flags & kicked) != kicked) {
+        fprintf(stderr, "Kick not flagged (flags %#x)\n", diagnostics->flags);
+        failed = 1;
+    }
+
+    UniverseResetDiagnostics(universe);
+    UniverseUpdate(universe, 0.05);
+    if (diagnostics->flags || diagnostics->flaggedSteps) {
+        fprintf(stderr, "Reset kept flags %#x\n", diagnostics->flags);
+        failed = 1;
+    }
+
+    universe->mechanics[1].velocity.y = NAN;
+    UniverseUpdate(universe, 0.05);
+    if (!(diagnostics->flags & DIAGNOSTICS_NON_FINITE)) {
+        fprintf(stderr, "NaN not flagged (flags %#x)\n", diagnostics->flags);
+        failed = 1;
+    }
+
+    UniverseDestroy(universe);
+    if (!failed)
+        printf("Drift flags test: PASSED\n");
+    return failed;
+}
+
+// Inelastic walls only remove energy, which is not an instability
+int test_walls_dissipate_quietly() {
+    Universe *universe = UniverseCreate(COUNT);
+    populate(universe, 1);
+    UniverseSetDiagnostics(universe, true);
+
+    for (int s = 0; s < 200; s++)
+        UniverseUpdate(universe, 0.05);
+
+    const UniverseDiagnostics *diagnostics = UniverseGetDiagnostics(universe);
+    int failed = 0;
+    if (diagnostics->energyDrift >= 0.0 || diagnostics->flaggedSteps) {
+        fprintf(stderr, "Walls: drift %g, %llu flagged steps\n", diagnostics->energyDrift,
+                (unsigned long long)diagnostics->flaggedSteps);
+        failed = 1;
+    }
+
+    UniverseDestroy(universe);
+    if (!failed)
+        printf("Wall dissipation test: PASSED\n");
+    return failed;
+}
+
+// An obstacle that pushes a particle through a wall, after the wall pass,
+// shows up in that step's sample
+int test_escape_after_walls() {
+    Universe *universe = UniverseCreate(4);
+    UniverseSetBoundaries(universe, 1000, 1000, 10.0f, true);
+    const UniverseBoundary *b = &universe->boundary;
+    ObstaclesEnable(universe, 1, 0);
+    ObstacleAddCircle(universe, (KVector2){b->right - 20, 500}, 30.0);
+    ParticleCreate(universe, (KVector2){b->right - 2, 500}, (KVector2){0, 0}, 1.0);
+    UniverseSetDiagnostics(universe, true);
+
+    UniverseUpdate(universe, 0.01);
+    const UniverseDiagnostics *diagnostics = UniverseGetDiagnostics(universe);
+    int failed = !(diagnostics->flags & DIAGNOSTICS_ESCAPED) ||
+                 diagnostics->current.boundsMax.x <= b->right;
+    if (failed)
+        fprintf(stderr, "Escape missed: flags %u, max x %g\n", diagnostics->flags,
+                diagnostics->current.boundsMax.x);
+
+    UniverseDestroy(universe);
+    if (!failed)
+        printf("Escape after walls test: PASSED\n");
+    return failed;
+}
+
+int main(void) {
+    int result = 0;
+
+    result |= test_fused_matches_measure();
+    result |= test_compensated_sum();
+    result |= test_drift_flags();
+    result |= test_walls_dissipate_quietly();
+    result |= test_escape_after_walls();
+
+    if (result == 0) {
+        printf("\nAll diagnostics tests passed!\n");
+    } else {
+        printf("\nSome diagnostics tests failed!\n");
+    }
+
+    return result;
+}
@@ -0,0 +1,109 @@
+#include <stdio.h>
+#include "../src/core/engine.h"
+
+#define DELTA_TIME 0.1
+
+int test_emitter_steady_state() {
+    Universe *universe = UniverseCreate(64);
+    if (!universe) {
+        fprintf(stderr, "Failed to create universe\n");
+        return 1;
+    }
+    universe->boundary.enabled = false;
+
+    EmitterComponent settings = {0};
+    settings.direction = (KVector2){0.0, -1.0};
+    settings.spread = 0.3;
+    settings.rate = 20.0;
+    settings.speedMin = 5.0;
+    settings.speedMax = 10.0;
+    settings.lifetime = 1.0;
+    settings.mass = 1.0;
+
+    EntityID emitter = EmitterCreate(universe, (KVector2){0.0, 0.0}, &settings);
+    if (emitter == INVALID_ENTITY) {
+        fprintf(stderr, "Failed to create emitter\n");
+        UniverseDestroy(universe);
+        return 1;
+    }
+
+    // 20 particles/s living 1s: about 20 alive plus the emitter itself
+    EntityID highest = 0;
+    for (int step = 0; step < 100; step++) {
+        UniverseUpdate(universe, DELTA_TIME);
+        for (EntityID i = 0; i < universe->maxEntities; i++) {
+            if (UniverseIsEntityActive(universe, i) && i > highest)
+                highest = i;
+        }
+    }
+
+    printf("Alive entities: %u, highest id used: %u\n", universe->entityCount, highest);
+
+    if (!UniverseValidate(universe)) {
+        fprintf(stderr, "Universe bookkeeping is inconsistent\n");
+        UniverseDestroy(universe);
+        return 1;
+    }
+
+    if (universe->entityCount < 19 || universe->entityCount > 24) {
+        fprintf(stderr, "Emitter did not reach steady state\n");
+        UniverseDestroy(universe);
+        return 1;
+    }
+
+    // Recycling must keep reusing the same small block of IDs
+    if (highest > 26) {
+        fprintf(stderr, "Particle IDs were not recycled\n");
+        UniverseDestroy(universe);
+        return 1;
+    }
+
+    UniverseDestroy(universe);
+    printf("Emitter steady state test: PASSED\n");
+    return 0;
+}
+
+int test_emitter_full_universe() {
+    Universe *universe = UniverseCreate(8);
+    if (!universe) {
+        fprintf(stderr, "Failed to create universe\n");
+        return 1;
+    }
+
+    EmitterComponent settings = {0};
+    settings.direction = (KVector2){1.0, 0.0};
+    settings.rate = 1000.0;
+    settings.speedMin = 1.0;
+    settings.speedMax = 1.0;
+    settings.lifetime = 10.0;
+    settings.mass = 1.0;
+    EmitterCreate(universe, (KVector2){100.0, 100.0}, &settings);
+
+    for (int step = 0; step < 10; step++)
+        UniverseUpdate(universe, DELTA_TIME);
+
+    if (universe->entityCount != universe->maxEntities || universe->freeCount != 0) {
+        fprintf(stderr, "Emitter should fill but not overflow the universe\n");
+        UniverseDestroy(universe);
+        return 1;
+    }
+
+    UniverseDestroy(universe);
+    printf("Emitter full universe test: PASSED\n");
+    return 0;
+}
+
+int main(void) {
+    int result = 0;
+
+    result |= test_emitter_steady_state();
+    result |= test_emitter_full_universe();
+
+    if (result == 0) {
+        printf("\nAll emitter tests passed!\n");
+    } else {
+        printf("\nSome tests failed!\n");
+    }
+
+    return result;
+}
@@ -0,0 +1,119 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "../src/core/engine.h"
+
+#define WORLDS 96
+#define PER_WORLD 100
+#define STEPS 50
+
+static void populate(Universe *universe, uint32_t world) {
+    UniverseSetBoundaries(universe, 400 + world, 300, 10.0f, true);
+    srand(world + 1);
+    for (int i = 0; i < PER_WORLD; i++) {
+        KVector2 p = {20 + rand() % 300, 20 + rand() % 200};
+        KVector2 v = {(double)(rand() % 80) - 40 + world, (double)(rand() % 80) - 40};
+        ParticleCreate(universe, p, v, (rand() % 100 + 1) / 100.0);
+    }
+}
+
+// Every world must evolve exactly like the same universe stepped on its own
+int test_ensemble_matches_standalone(uint32_t threads) {
+    Ensemble *ensemble = EnsembleCreate(WORLDS, PER_WORLD, threads);
+    if (!ensemble) {
+        fprintf(stderr, "Failed to create ensemble\n");
+        return 1;
+    }
+
+    for (uint32_t w = 0; w < WORLDS; w++)
+        populate(EnsembleWorld(ensemble, w), w);
+    if (EnsembleCountActive(ensemble) != WORLDS * PER_WORLD) {
+        fprintf(stderr, "Ensemble holds %u entities\n", EnsembleCountActive(ensemble));
+        EnsembleDestroy(ensemble);
+        return 1;
+    }
+
+    for (int s = 0; s < STEPS; s++)
+        EnsembleUpdate(ensemble, 0.05);
+
+    int failed = 0;
+    for (uint32_t w = 0; w < WORLDS && !failed; w++) {
+        Universe *reference = UniverseCreate(PER_WORLD);
+        populate(reference, w);
+        for (int s = 0; s < STEPS; s++)
+            UniverseUpdate(reference, 0.05);
+
+        Universe *world = EnsembleWorld(ensemble, w);
+        for (EntityID e = 0; e < PER_WORLD; e++) {
+            KVector2 a = UniverseGetKineticBodyComponent(world, e)->position;
+            KVector2 b = UniverseGetKineticBodyComponent(reference, e)->position;
+            if (a.x != b.x || a.y != b.y) {
+                fprintf(stderr, "World %u entity %u diverged: (%f, %f) vs (%f, %f)\n",
+                        w, e, a.x, a.y, b.x, b.y);
+                failed = 1;
+                break;
+            }
+        }
+        UniverseDestroy(reference);
+    }
+
+    if (EnsembleWorld(ensemble, WORLDS) != NULL) {
+        fprintf(stderr, "Out-of-range world index accepted\n");
+        failed = 1;
+    }
+
+    EnsembleDestroy(ensemble);
+    if (!failed)
+        printf("Ensemble matches standalone test (%u threads): PASSED\n", threads);
+    return failed;
+}
+
+// Worlds keep working after creating components and queries mid-run
+int test_ensemble_emitters(void) {
+    Ensemble *ensemble = EnsembleCreate(8, 64, 4);
+    if (!ensemble) {
+        fprintf(stderr, "Failed to create ensemble\n");
+        return 1;
+    }
+
+    for (uint32_t w = 0; w < 8; w++) {
+        Universe *world = EnsembleWorld(ensemble, w);
+        UniverseSetBoundaries(world, 400, 300, 10.0f, true);
+        ParticleEmittersEnable(world);
+        EmitterComponent emitter = {{0, -1}, 0.5, 10.0 * (w + 1), 10, 20, 0.5, 1.0, 0.0, w + 1};
+        EmitterCreate(world, (KVector2){200, 150}, &emitter);
+    }
+
+    for (int s = 0; s < 40; s++)
+        EnsembleUpdate(ensemble, 0.05);
+
+    int failed = 0;
+    for (uint32_t w = 1; w < 8; w++) {
+        if (!UniverseValidate(EnsembleWorld(ensemble, w)) ||
+            UniverseCountActive(EnsembleWorld(ensemble, w)) <=
+                UniverseCountActive(EnsembleWorld(ensemble, w - 1))) {
+            fprintf(stderr, "World %u did not emit at its own rate\n", w);
+            failed = 1;
+        }
+    }
+
+    EnsembleDestroy(ensemble);
+    if (!failed)
+        printf("Ensemble emitters test: PASSED\n");
+    return failed;
+}
+
+int main(void) {
+    int result = 0;
+
+    result |= test_ensemble_matches_standalone(1);
+    result |= test_ensemble_matches_standalone(4);
+    result |= test_ensemble_emitters();
+
+    if (result == 0) {
+        printf("\nAll ensemble tests passed!\n");
+    } else {
+        printf("\nSome ensemble tests failed!\n");
+    }
+
+    return result;
+}
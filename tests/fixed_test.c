@@ -0,0 +1,177 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../src/config/config.h"
+#include "../src/core/engine.h"
+
+#define DT (1.0 / 60.0)
+#define PARTICLES 5000
+#define STEPS 600
+
+// Rounding, saturation and exact conversion back
+int test_conversions() {
+    int failed = FixedFromDouble(1.0) != FIXED_ONE || FixedFromDouble(-2.5) != -5 * FIXED_ONE / 2 ||
+                 FixedFromDouble(0.4 / FIXED_ONE) != 0 || FixedFromDouble(0.6 / FIXED_ONE) != 1 ||
+                 FixedFromDouble(-0.6 / FIXED_ONE) != -1 || FixedFromDouble(1e9) != INT32_MAX ||
+                 FixedFromDouble(-1e9) != -INT32_MAX || FixedFromDouble(NAN) != 0;
+    for (Fixed v = -100000; v < 100000; v += 77)
+        failed |= FixedFromDouble(FixedToDouble(v)) != v;
+    if (!failed)
+        printf("Conversion test: PASSED\n");
+    return failed;
+}
+
+// A thrown particle follows the double integration to within the rounding,
+// bounces off the floor and mirrors its integers into the kinetic body
+int test_ballistic() {
+    Universe *universe = UniverseCreate(64);
+    UniverseSetBoundaries(universe, 400, 300, 0.0f, true);
+    FixedPointEnable(universe);
+    EntityID e = FixedParticleCreate(universe, (KVector2){100, 50}, (KVector2){30, 0},
+                                     (KVector2){0, 98}, 1.0, 2.0);
+    EntityID doubled = ParticleCreate(universe, (KVector2){100, 50}, (KVector2){30, 0}, 1.0);
+    UniverseGetMechanicsComponent(universe, doubled)->acceleration = (KVector2){0, 98};
+    const FixedBodyComponent *body = UniverseGetComponent(universe, e, universe->fixedComponent);
+
+    int failed = e == INVALID_ENTITY || UniverseGetMechanicsComponent(universe, e) != NULL;
+    for (int step = 0; !failed && step < 30; step++) {
+        KVector2 before = UniverseGetKineticBodyComponent(universe, e)->position;
+        UniverseUpdate(universe, DT);
+        const KineticBodyComponent *kinetic = UniverseGetKineticBodyComponent(universe, e);
+        const KineticBodyComponent *reference = UniverseGetKineticBodyComponent(universe, doubled);
+        failed |= kinetic->position.x != FixedToDouble(body->position.x) ||
+                  kinetic->position.y != FixedToDouble(body->position.y) ||
+                  kinetic->previous.x != before.x || kinetic->previous.y != before.y;
+        failed |= fabs(kinetic->position.x - reference->position.x) > 0.01 ||
+                  fabs(kinetic->position.y - reference->position.y) > 0.01;
+    }
+
+    // It stays between the walls and comes back up off the floor
+    int bounced = 0;
+    for (int step = 0; !failed && step < 300; step++) {
+        UniverseUpdate(universe, DT);
+        const KineticBodyComponent *kinetic = UniverseGetKineticBodyComponent(universe, e);
+        failed |= kinetic->position.y > 298.0 || kinetic->position.x > 398.0;
+        bounced |= body->velocity.y < 0;
+    }
+    failed |= !bounced;
+
+    UniverseDestroy(universe);
+    if (!failed)
+        printf("Ballistic test: PASSED\n");
+    return failed;
+}
+
+static Universe *scenario(void) {
+    Universe *universe = UniverseCreate(PARTICLES + 1000);
+    UniverseSetBoundaries(universe, 800, 600, 0.0f, true);
+    UniverseSetReorderInterval(universe, 50);
+    FixedPointEnable(universe);
+    srand(48);
+    for (int i = 0; i < PARTICLES; i++) {
+        KVector2 position = {rand() % 8000 / 10.0, rand() % 6000 / 10.0};
+        KVector2 velocity = {rand() % 4001 / 10.0 - 200.0, rand() % 4001 / 10.0 - 200.0};
+        KVector2 acceleration = {rand() % 201 / 10.0 - 10.0, 98.0};
+        FixedParticleCreate(universe, position, velocity, acceleration, 1.0, i % 4);
+        // Double particles in between, to share words with the fixed ones
+        if (i % 5 == 0)
+            ParticleCreate(universe, position, velocity, 1.0);
+    }
+    return universe;
+}
+
+// FNV-1a over the fixed state and its mirror, in entity order
+static uint64_t digest(Universe *universe) {
+    uint64_t hash = 1469598103934665603ull;
+    for (EntityID e = 0; e < universe->maxEntities; e++) {
+        const FixedBodyComponent *body = UniverseGetComponent(universe, e, universe->fixedComponent);
+        if (!body)
+            continue;
+        const KineticBodyComponent *kinetic = UniverseGetKineticBodyComponent(universe, e);
+        unsigned char bytes[sizeof(FixedBodyComponent) + sizeof(KVector2)];
+        memcpy(bytes, body, sizeof(FixedBodyComponent));
+        memcpy(bytes + sizeof(FixedBodyComponent), &kinetic->position, sizeof(KVector2));
+        for (size_t b = 0; b < sizeof(bytes); b++)
+            hash = (hash ^ bytes[b]) * 1099511628211ull;
+    }
+    return hash;
+}
+
+static uint64_t run(ParallelBackend backend, uint32_t threads) {
+    ParallelSetBackend(backend);
+    ParallelSetThreads(threads);
+    Universe *universe = scenario();
+    for (int step = 0; step < STEPS; step++)
+        UniverseUpdate(universe, DT);
+    uint64_t hash = digest(universe);
+    UniverseDestroy(universe);
+    return hash;
+}
+
+// Same bits on one thread and on many, and without fusing the kernel
+int test_thread_counts() {
+    uint64_t serial = run(PARALLEL_SERIAL, 1);
+    uint64_t threaded = run(PARALLEL_PTHREADS, 4);
+
+    Universe *universe = scenario();
+    for (int step = 0; step < STEPS; step++) {
+        PhysicsFixedUpdate(universe, DT);
+        if ((step + 1) % 50 == 0)
+            UniverseReorderByMorton(universe);
+    }
+    uint64_t unfused = digest(universe);
+    UniverseDestroy(universe);
+
+    int failed = serial != threaded || serial != unfused;
+    if (failed)
+        fprintf(stderr, "Digests %016llx %016llx %016llx\n", (unsigned long long)serial,
+                (unsigned long long)threaded, (unsigned long long)unfused);
+    else
+        printf("Thread count test: PASSED\n");
+    return failed;
+}
+
+// `make test` runs this test from two builds with different optimisation,
+// vector width and FMA contraction. The first writes its digest, the second
+// compares against it.
+int test_cross_build(const char *path) {
+    uint64_t hash = run(PARALLEL_PTHREADS, 4);
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        file = fopen(path, "w");
+        if (!file)
+            return 1;
+        fprintf(file, "%016llx\n", (unsigned long long)hash);
+        fclose(file);
+        printf("Cross-build test: digest written to %s\n", path);
+        return 0;
+    }
+
+    unsigned long long expected = 0;
+    int failed = fscanf(file, "%llx", &expected) != 1 || expected != hash;
+    fclose(file);
+    if (failed)
+        fprintf(stderr, "Digest %016llx, other build %016llx\n", (unsigned long long)hash, expected);
+    else
+        printf("Cross-build test: PASSED\n");
+    return failed;
+}
+
+int main(int argc, char **argv) {
+    int result = 0;
+
+    result |= test_conversions();
+    result |= test_ballistic();
+    result |= test_thread_counts();
+    if (argc > 1)
+        result |= test_cross_build(argv[1]);
+
+    if (result == 0) {
+        printf("\nAll fixed-point tests passed!\n");
+    } else {
+        printf("\nSome fixed-point tests failed!\n");
+    }
+
+    return result;
+}
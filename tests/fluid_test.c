@@ -0,0 +1,183 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../src/core/engine.h"
+
+#define COUNT 1500
+
+static Universe *scatter(uint32_t count, int walls) {
+    Universe *universe = UniverseCreate(count);
+    UniverseSetBoundaries(universe, 220, 220, 10.0f, walls);
+    FluidSettings settings = FluidDefaultSettings();
+    settings.gravity = (KVector2){0.0, 0.0};
+    FluidEnable(universe, &settings);
+
+    srand(3);
+    for (uint32_t i = 0; i < count; i++) {
+        KVector2 p = {10 + 200.0 * rand() / RAND_MAX, 10 + 200.0 * rand() / RAND_MAX};
+        KVector2 v = {rand() % 40 - 20.0, rand() % 40 - 20.0};
+        FluidParticleCreate(universe, p, v);
+    }
+    return universe;
+}
+
+// The cell list must find exactly the pairs an all-pairs search finds
+int test_matches_all_pairs() {
+    Universe *universe = scatter(COUNT, 1);
+    PhysicsFluidUpdate(universe);
+
+    const FluidSolver *fluid = universe->fluid;
+    const FluidSettings *s = &fluid->settings;
+    const FluidComponent *components =
+        UNIVERSE_COLUMN(universe, FluidComponent, universe->fluidComponent);
+    const double h = s->smoothingRadius;
+    const double h2 = h * h;
+
+    double *density = calloc(COUNT, sizeof(double));
+    for (EntityID i = 0; i < COUNT; i++) {
+        KVector2 pi = universe->kineticBodies[i].position;
+        for (EntityID j = 0; j < COUNT; j++) {
+            KVector2 pj = universe->kineticBodies[j].position;
+            double d = h2 - ((pi.x - pj.x) * (pi.x - pj.x) + (pi.y - pj.y) * (pi.y - pj.y));
+            if (d > 0.0)
+                density[i] += s->particleMass * d * d * d;
+        }
+        density[i] *= 4.0 / (M_PI * pow(h, 8.0));
+    }
+
+    int failed = 0;
+    for (EntityID i = 0; i < COUNT && !failed; i++) {
+        double pressure = s->stiffness * fmax(density[i] - s->restDensity, 0.0);
+        if (fabs(components[i].density - density[i]) > 1e-12 * density[i] ||
+            fabs(components[i].pressure - pressure) > 1e-9 * (pressure + 1.0)) {
+            fprintf(stderr, "Particle %u: density %.17g, all pairs %.17g\n", i,
+                    components[i].density, density[i]);
+            failed = 1;
+        }
+    }
+
+    free(density);
+    UniverseDestroy(universe);
+    if (!failed)
+        printf("All-pairs density test: PASSED\n");
+    return failed;
+}
+
+// Without gravity the pair forces cancel, so the net force vanishes
+int test_forces_cancel() {
+    Universe *universe = scatter(COUNT, 0);
+    PhysicsFluidUpdate(universe);
+
+    double sumX = 0.0, sumY = 0.0, magnitude = 0.0;
+    for (EntityID i = 0; i < COUNT; i++) {
+        KVector2 f = universe->mechanics[i].forceAccum;
+        sumX += f.x;
+        sumY += f.y;
+        magnitude += sqrt(f.x * f.x + f.y * f.y);
+    }
+
+    int failed = 0;
+    if (magnitude == 0.0 || fabs(sumX) > 1e-9 * magnitude || fabs(sumY) > 1e-9 * magnitude) {
+        fprintf(stderr, "Net force (%g, %g) against total %g\n", sumX, sumY, magnitude);
+        failed = 1;
+    }
+
+    UniverseDestroy(universe);
+    if (!failed)
+        printf("Force balance test: PASSED\n");
+    return failed;
+}
+
+// An interior particle of the rest lattice sits at rest density
+int test_lattice_at_rest() {
+    Universe *universe = UniverseCreate(41 * 41);
+    UniverseSetBoundaries(universe, 400, 400, 0.0f, false);
+    FluidEnable(universe, NULL);
+    const FluidSettings *s = &universe->fluid->settings;
+
+    EntityID centre = INVALID_ENTITY;
+    for (int i = 0; i < 41; i++) {
+        for (int j = 0; j < 41; j++) {
+            EntityID e = FluidParticleCreate(universe, (KVector2){i * s->spacing, j * s->spacing},
+                                             (KVector2){0, 0});
+            if (i == 20 && j == 20)
+                centre = e;
+        }
+    }
+    PhysicsFluidUpdate(universe);
+
+    const FluidComponent *fluid = UniverseGetComponent(universe, centre, universe->fluidComponent);
+    const MechanicsComponent *mechanics = UniverseGetMechanicsComponent(universe, centre);
+    double mass = s->particleMass;
+
+    int failed = 0;
+    if (fabs(fluid->density - s->restDensity) > 1e-12 * s->restDensity ||
+        fabs(mechanics->forceAccum.x - mass * s->gravity.x) > 1e-9 ||
+        fabs(mechanics->forceAccum.y - mass * s->gravity.y) > 1e-9) {
+        fprintf(stderr, "Centre: density %g (rest %g), force (%g, %g)\n", fluid->density,
+                s->restDensity, mechanics->forceAccum.x, mechanics->forceAccum.y);
+        failed = 1;
+    }
+
+    UniverseDestroy(universe);
+    if (!failed)
+        printf("Rest lattice test: PASSED\n");
+    return failed;
+}
+
+// A pool settling on the floor stays finite, inside the walls and near rest
+// density
+int test_pool_stable() {
+    Universe *universe = UniverseCreate(2000);
+    UniverseSetBoundaries(universe, 400, 300, 10.0f, true);
+    FluidEnable(universe, NULL);
+    UniverseSetDiagnostics(universe, true);
+    const FluidSettings *s = &universe->fluid->settings;
+
+    for (int i = 0; i < 2000; i++) {
+        KVector2 p = {14 + (i % 94) * s->spacing, 286 - (i / 94) * s->spacing};
+        FluidParticleCreate(universe, p, (KVector2){0, 0});
+    }
+
+    double dt = FluidMaxTimestep(universe);
+    for (int step = 0; step < 600; step++)
+        UniverseUpdate(universe, dt);
+
+    const UniverseDiagnostics *diagnostics = UniverseGetDiagnostics(universe);
+    const FluidComponent *components =
+        UNIVERSE_COLUMN(universe, FluidComponent, universe->fluidComponent);
+    double densest = 0.0;
+    for (EntityID i = 0; i < 2000; i++)
+        densest = fmax(densest, components[i].density);
+
+    int failed = 0;
+    if (diagnostics->flags & (DIAGNOSTICS_NON_FINITE | DIAGNOSTICS_ESCAPED) ||
+        densest > 1.5 * s->restDensity) {
+        fprintf(stderr, "Pool: flags %#x, densest %g (rest %g)\n", diagnostics->flags,
+                densest, s->restDensity);
+        failed = 1;
+    }
+
+    UniverseDestroy(universe);
+    if (!failed)
+        printf("Pool test: PASSED\n");
+    return failed;
+}
+
+int main(void) {
+    int result = 0;
+
+    result |= test_matches_all_pairs();
+    result |= test_forces_cancel();
+    result |= test_lattice_at_rest();
+    result |= test_pool_stable();
+
+    if (result == 0) {
+        printf("\nAll fluid tests passed!\n");
+    } else {
+        printf("\nSome fluid tests failed!\n");
+    }
+
+    return result;
+}
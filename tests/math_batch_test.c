@@ -0,0 +1,161 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../src/core/engine.h"
+
+#define COUNT 1027 /* not a multiple of any vector width, to cover the tails */
+#define TOLERANCE 1e-12
+
+static double randomValue(void) {
+    return (double)rand() / RAND_MAX * 200.0 - 100.0;
+}
+
+static int near(double a, double b) {
+    return fabs(a - b) <= TOLERANCE * (1.0 + fabs(b));
+}
+
+static int nearVector3(KVector3 a, KVector3 b) {
+    return near(a.x, b.x) && near(a.y, b.y) && near(a.z, b.z);
+}
+
+// SoA and array-of-struct views agree with the scalar functions, including
+// the zero vector that KVector2Unit maps to zero
+int test_vector2_batches() {
+    static double x[COUNT], y[COUNT], ux[COUNT], uy[COUNT], dots[COUNT];
+    static KVector2 a[COUNT], b[COUNT], units[COUNT];
+    srand(1);
+    for (int i = 0; i < COUNT; i++) {
+        a[i] = (KVector2){randomValue(), randomValue()};
+        b[i] = (KVector2){randomValue(), randomValue()};
+        x[i] = a[i].x;
+        y[i] = a[i].y;
+    }
+    a[7] = (KVector2){0.0, 0.0};
+    x[7] = y[7] = 0.0;
+
+    KVector2UnitBatch(KVector2ArraySoA(x, y), KVector2ArraySoA(ux, uy), COUNT);
+    KVector2UnitBatch(KVector2ArrayOf(a), KVector2ArrayOf(units), COUNT);
+    KVector2DotProductBatch(KVector2ArrayOf(a), KVector2ArrayOf(b), dots, COUNT);
+
+    int failed = 0;
+    for (int i = 0; i < COUNT && !failed; i++) {
+        KVector2 unit = KVector2Unit(a[i]);
+        double dot = KVector2DotProduct(a[i], b[i]);
+        if (!near(ux[i], unit.x) || !near(uy[i], unit.y) || !near(units[i].x, unit.x) ||
+            !near(units[i].y, unit.y) || !near(dots[i], dot)) {
+            fprintf(stderr, "Vector2 %d: unit (%g, %g) vs (%g, %g), dot %g vs %g\n", i, ux[i],
+                    uy[i], unit.x, unit.y, dots[i], dot);
+            failed = 1;
+        }
+    }
+
+    if (!failed)
+        printf("Vector2 batch test: PASSED\n");
+    return failed;
+}
+
+// Unit, dot and cross over mixed layouts: SoA in, array-of-struct out
+int test_vector3_batches() {
+    static double x[COUNT], y[COUNT], z[COUNT], dots[COUNT];
+    static KVector3 a[COUNT], b[COUNT], units[COUNT], crosses[COUNT];
+    srand(2);
+    for (int i = 0; i < COUNT; i++) {
+        a[i] = (KVector3){randomValue(), randomValue(), randomValue()};
+        b[i] = (KVector3){randomValue(), randomValue(), randomValue()};
+        x[i] = a[i].x;
+        y[i] = a[i].y;
+        z[i] = a[i].z;
+    }
+    a[3] = (KVector3){1e-9, 0.0, 0.0};
+    x[3] = 1e-9;
+    y[3] = z[3] = 0.0;
+
+    KVector3Array soa = KVector3ArraySoA(x, y, z);
+    KVector3UnitBatch(soa, KVector3ArrayOf(units), COUNT);
+    KVector3DotProductBatch(soa, KVector3ArrayOf(b), dots, COUNT);
+    KVector3CrossProductBatch(KVector3ArrayOf(a), KVector3ArrayOf(b),
+                              KVector3ArrayOf(crosses), COUNT);
+
+    int failed = 0;
+    for (int i = 0; i < COUNT && !failed; i++) {
+        if (!nearVector3(units[i], KVector3Unit(a[i])) ||
+            !near(dots[i], KVector3DotProduct(a[i], b[i])) ||
+            !nearVector3(crosses[i], KVector3CrossProduct(a[i], b[i]))) {
+            fprintf(stderr, "Vector3 %d: unit, dot or cross differs from the scalar\n", i);
+            failed = 1;
+        }
+    }
+
+    if (!failed)
+        printf("Vector3 batch test: PASSED\n");
+    return failed;
+}
+
+// Rotation, products and matrices match the scalar quaternion functions
+int test_quaternion_batches() {
+    static KQuaternion q1[COUNT], q2[COUNT], products[COUNT];
+    static KVector3 points[COUNT], rotated[COUNT];
+    static Matrix3x3 m3[COUNT];
+    static Matrix4x4 m4[COUNT];
+    srand(3);
+    for (int i = 0; i < COUNT; i++) {
+        KVector3 axis = {randomValue(), randomValue(), randomValue()};
+        q1[i] = KQuaternionFromAxisAngle(axis, randomValue());
+        q2[i] = KQuaternionFromAxisAngle(axis, randomValue());
+        points[i] = (KVector3){randomValue(), randomValue(), randomValue()};
+    }
+
+    const KQuaternion q = q1[0];
+    KQuaternionRotateBatch(q, KVector3ArrayOf(points), KVector3ArrayOf(rotated), COUNT);
+    KQuaternionMultiplyBatch(q1, q2, products, COUNT);
+    KQuaternionToMatrix3Batch(q1, m3, COUNT);
+    KQuaternionToMatrix4Batch(q1, m4, COUNT);
+
+    int failed = 0;
+    for (int i = 0; i < COUNT && !failed; i++) {
+        KQuaternion p = KQuaternionMultiply(q1[i], q2[i]);
+        Matrix3x3 r3 = KQuaternionToMatrix3(q1[i]);
+        Matrix4x4 r4 = KQuaternionToMatrix4(q1[i]);
+        int same = nearVector3(rotated[i], KQuaternionRotate(q, points[i])) &&
+                   near(products[i].x, p.x) && near(products[i].y, p.y) &&
+                   near(products[i].z, p.z) && near(products[i].w, p.w);
+        for (int r = 0; r < 4; r++)
+            for (int c = 0; c < 4; c++)
+                same = same && near(m4[i].m[r][c], r4.m[r][c]) &&
+                       (r == 3 || c == 3 || near(m3[i].m[r][c], r3.m[r][c]));
+        if (!same) {
+            fprintf(stderr, "Quaternion %d: batch result differs from the scalar\n", i);
+            failed = 1;
+        }
+    }
+
+    // A quarter turn about z takes x to y
+    KVector3 unitX = {1.0, 0.0, 0.0};
+    KVector3 turned = KQuaternionRotate(
+        KQuaternionFromAxisAngle((KVector3){0.0, 0.0, 1.0}, M_PI / 2.0), unitX);
+    if (!nearVector3(turned, (KVector3){0.0, 1.0, 0.0})) {
+        fprintf(stderr, "Quarter turn gives (%g, %g, %g)\n", turned.x, turned.y, turned.z);
+        failed = 1;
+    }
+
+    if (!failed)
+        printf("Quaternion batch test: PASSED\n");
+    return failed;
+}
+
+int main(void) {
+    int result = 0;
+
+    result |= test_vector2_batches();
+    result |= test_vector3_batches();
+    result |= test_quaternion_batches();
+
+    if (result == 0) {
+        printf("\nAll math batch tests passed!\n");
+    } else {
+        printf("\nSome math batch tests failed!\n");
+    }
+
+    return result;
+}
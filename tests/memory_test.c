@@ -0,0 +1,228 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../src/config/config.h"
+#include "../src/core/engine.h"
+
+#define DT (1.0 / 60.0)
+#define WARMUP_STEPS 120
+#define STEPS 1000
+
+// Counts the C library's allocations too, except under the sanitizers,
+// which bring their own malloc
+#ifndef __SANITIZE_ADDRESS__
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t count, size_t size);
+extern void *__libc_realloc(void *data, size_t size);
+static int countHeap;
+static unsigned long heapCalls;
+
+void *malloc(size_t size) {
+    if (__atomic_load_n(&countHeap, __ATOMIC_RELAXED))
+        __atomic_fetch_add(&heapCalls, 1, __ATOMIC_RELAXED);
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size) {
+    if (__atomic_load_n(&countHeap, __ATOMIC_RELAXED))
+        __atomic_fetch_add(&heapCalls, 1, __ATOMIC_RELAXED);
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *data, size_t size) {
+    if (__atomic_load_n(&countHeap, __ATOMIC_RELAXED))
+        __atomic_fetch_add(&heapCalls, 1, __ATOMIC_RELAXED);
+    return __libc_realloc(data, size);
+}
+#define HEAP_COUNTING(on) __atomic_store_n(&countHeap, (on), __ATOMIC_RELAXED)
+#else
+static unsigned long heapCalls;
+#define HEAP_COUNTING(on) ((void)(on))
+#endif
+
+static unsigned long hookCalls;
+static KMemoryOwner lastOwner;
+
+static void countAllocation(void *context, KMemoryOwner owner, size_t bytes) {
+    (void)context;
+    (void)bytes;
+    __atomic_fetch_add(&hookCalls, 1, __ATOMIC_RELAXED);
+    lastOwner = owner;
+}
+
+// Every subsystem carves its storage under its own owner, and destroying
+// the universe gives all of it back
+int test_accounting() {
+    KAllocationStats before[K_MEMORY_OWNERS], during[K_MEMORY_OWNERS], after[K_MEMORY_OWNERS];
+    KAllocationSnapshot(before);
+
+    Universe *universe = UniverseCreate(4096);
+    FluidSettings fluid = FluidDefaultSettings();
+    int failed = !universe || !FluidEnable(universe, &fluid) ||
+                 !UniverseSpatialIndexEnable(universe, 8.0) || !ObstaclesEnable(universe, 4, 16);
+    ParticleCreate(universe, (KVector2){10, 10}, (KVector2){1, 0}, 1.0);
+    UniverseUpdate(universe, DT);
+    KAllocationSnapshot(during);
+
+    const KMemoryOwner owners[] = {K_MEMORY_ARENA, K_MEMORY_UNIVERSE, K_MEMORY_COLUMNS,
+                                   K_MEMORY_SCHEDULER, K_MEMORY_SPATIAL, K_MEMORY_FLUID,
+                                   K_MEMORY_OBSTACLES};
+    for (size_t i = 0; i < sizeof(owners) / sizeof(owners[0]); i++) {
+        const KMemoryOwner o = owners[i];
+        const uint64_t live = during[o].liveBytes - before[o].liveBytes;
+        if (during[o].allocations <= before[o].allocations || during[o].peakBytes < during[o].liveBytes ||
+            (o != K_MEMORY_ARENA && live != universe->memoryBytes[o])) {
+            fprintf(stderr, "Owner %s: %llu allocations, %llu live\n", KMemoryOwnerName(o),
+                    (unsigned long long)(during[o].allocations - before[o].allocations),
+                    (unsigned long long)live);
+            failed = 1;
+        }
+    }
+    // The arena maps one block at least as large as what was carved from it
+    uint64_t carved = 0;
+    for (uint32_t o = K_MEMORY_UNIVERSE; o < K_MEMORY_OWNERS; o++)
+        carved += universe->memoryBytes[o];
+    failed |= during[K_MEMORY_ARENA].liveBytes - before[K_MEMORY_ARENA].liveBytes < carved;
+    failed |= strcmp(KMemoryOwnerName(K_MEMORY_FLUID), "fluid") != 0 ||
+              strcmp(KMemoryOwnerName(K_MEMORY_OWNERS), "unknown") != 0;
+
+    UniverseDestroy(universe);
+    KAllocationSnapshot(after);
+    for (uint32_t o = 0; o < K_MEMORY_OWNERS; o++)
+        failed |= after[o].liveBytes != before[o].liveBytes;
+
+    // The heap allocator is accounted the same way, without an arena
+    KAllocator heap = KHeapAllocator();
+    UniverseOptions options = {0};
+    options.allocator = &heap;
+    universe = UniverseCreateWithOptions(1024, &options);
+    failed |= !universe || !UniverseSpatialIndexEnable(universe, 8.0);
+    KAllocationSnapshot(during);
+    failed |= during[K_MEMORY_ARENA].allocations != after[K_MEMORY_ARENA].allocations ||
+              during[K_MEMORY_SPATIAL].liveBytes - after[K_MEMORY_SPATIAL].liveBytes !=
+                  universe->memoryBytes[K_MEMORY_SPATIAL];
+    UniverseDestroy(universe);
+    KAllocationSnapshot(after);
+    for (uint32_t o = 0; o < K_MEMORY_OWNERS; o++)
+        failed |= after[o].liveBytes != before[o].liveBytes;
+
+    if (!failed)
+        printf("Accounting test: PASSED\n");
+    return failed;
+}
+
+static Universe *busyWorld(void) {
+    Universe *universe = UniverseCreate(6000);
+    UniverseSetBoundaries(universe, 400, 300, 0.0f, true);
+    UniverseSetReorderInterval(universe, 25);
+    UniverseSetDiagnostics(universe, true);
+    UniverseSpatialIndexEnable(universe, 8.0);
+    ObstaclesEnable(universe, 8, 32);
+    ObstacleAddCircle(universe, (KVector2){200, 150}, 30.0);
+    ObstacleAddSegment(universe, (KVector2){50, 250}, (KVector2){350, 220});
+    ParticleEmittersEnable(universe);
+    EmitterComponent emitter = {{0, -1}, 0.5, 600.0, 10, 40, 1.5, 1.0, 0.0, 49};
+    EmitterCreate(universe, (KVector2){200, 280}, &emitter);
+
+    RigidEnable(universe, NULL);
+    for (int i = 0; i < 40; i++) {
+        KVector2 position = {20.0 + (i % 10) * 36.0, 20.0 + (i / 10) * 20.0};
+        if (i % 2)
+            RigidBoxCreate(universe, position, (KVector2){6, 4}, 0.1 * i, 1.0);
+        else
+            RigidCircleCreate(universe, position, 5.0, 1.0);
+    }
+
+    srand(49);
+    for (int i = 0; i < 2000; i++)
+        ParticleCreate(universe, (KVector2){rand() % 400, rand() % 300},
+                       (KVector2){rand() % 200 - 100, rand() % 200 - 100}, 1.0);
+    return universe;
+}
+
+// Deferred work every step, so command buffers and the flush take part
+static void pushEverything(Universe *universe) {
+    CommandBuffer *buffer = UniverseGetCommandBuffer(universe, 0);
+    for (EntityID e = 0; e < 2000; e += 7)
+        CommandBufferApplyForce(buffer, e, (KVector2){5.0, -5.0});
+}
+
+// After warm-up, a step carves nothing and never calls malloc
+int test_steady_state() {
+    Universe *universe = busyWorld();
+    for (int step = 0; step < WARMUP_STEPS; step++) {
+        pushEverything(universe);
+        UniverseUpdate(universe, DT);
+    }
+
+    uint64_t carved = KAllocationCount();
+    KSetAllocationHook(countAllocation, NULL);
+    HEAP_COUNTING(1);
+    for (int step = 0; step < STEPS; step++) {
+        pushEverything(universe);
+        UniverseUpdate(universe, DT);
+    }
+    HEAP_COUNTING(0);
+    KSetAllocationHook(NULL, NULL);
+
+    int failed = hookCalls != 0 || KAllocationCount() != carved || heapCalls != 0;
+    if (failed)
+        fprintf(stderr, "%lu allocations (last by %s), %lu malloc calls in %d steps\n", hookCalls,
+                KMemoryOwnerName(lastOwner), heapCalls, STEPS);
+    // The world really was busy
+    failed |= UniverseCountActive(universe) < 2500 || universe->stepCount != WARMUP_STEPS + STEPS;
+
+    UniverseDestroy(universe);
+    if (!failed)
+        printf("Steady state test: PASSED\n");
+    return failed;
+}
+
+// The traffic estimate counts each column a system touches once per member,
+// and the columns it writes twice
+int test_traffic() {
+    Universe *universe = UniverseCreate(1000);
+    for (int i = 0; i < 300; i++)
+        ParticleCreate(universe, (KVector2){i, i}, (KVector2){1, 0}, 1.0);
+    // A body without mechanics or radius only adds to the kinetic column
+    EntityID bare = UniverseCreateEntity(universe);
+    UniverseAddKineticBodyComponent(universe, bare, (KVector2){0, 0}, 1.0);
+    UniverseUpdate(universe, DT);
+
+    const uint64_t kinetic = 301 * universe->columns[COMPONENT_ID_KINETIC_BODY].stride;
+    const uint64_t mechanics = 300 * universe->columns[COMPONENT_ID_MECHANICS].stride;
+    const uint64_t radius = 300 * universe->columns[COMPONENT_ID_RADIUS].stride;
+    const SystemTiming *position = UniverseSystemTiming(universe, "position");
+    const SystemTiming *mechanicsSystem = UniverseSystemTiming(universe, "mechanics");
+    const SystemTiming *boundary = UniverseSystemTiming(universe, "boundary");
+    int failed = !position || position->bytesStreamed != 2 * kinetic + mechanics ||
+                 mechanicsSystem->bytesStreamed != kinetic + 2 * mechanics ||
+                 boundary->bytesStreamed != 2 * kinetic + 2 * mechanics + radius;
+    if (failed)
+        fprintf(stderr, "Streamed position %llu mechanics %llu boundary %llu\n",
+                (unsigned long long)position->bytesStreamed,
+                (unsigned long long)mechanicsSystem->bytesStreamed,
+                (unsigned long long)boundary->bytesStreamed);
+
+    UniverseDestroy(universe);
+    if (!failed)
+        printf("Traffic test: PASSED\n");
+    return failed;
+}
+
+int main(void) {
+    int result = 0;
+
+    result |= test_accounting();
+    result |= test_steady_state();
+    result |= test_traffic();
+
+    if (result == 0) {
+        printf("\nAll memory tests passed!\n");
+    } else {
+        printf("\nSome memory tests failed!\n");
+    }
+
+    return result;
+}
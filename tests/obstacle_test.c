@@ -0,0 +1,231 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "../src/config/config.h"
+#include "../src/core/engine.h"
+
+#define EPSILON 0.000001
+#define DT (1.0 / 60.0)
+
+static Universe *world(uint32_t capacity, uint32_t obstacles) {
+    Universe *universe = UniverseCreate(capacity);
+    UniverseSetBoundaries(universe, 400, 300, 0.0f, false);
+    ObstaclesEnable(universe, obstacles, 8 * obstacles);
+    return universe;
+}
+
+static int contains(const ObstacleNode *node, uint32_t c, KVector2 lo, KVector2 hi) {
+    return node->minX[c] <= lo.x && node->minY[c] <= lo.y && node->maxX[c] >= hi.x &&
+           node->maxY[c] >= hi.y;
+}
+
+// Every obstacle sits in exactly one leaf, inside the box its parent keeps
+// for it and for every node on the way down; median splits keep the tree
+// shallow
+int test_hierarchy() {
+    enum { COUNT = 1000 };
+    Universe *universe = world(4, COUNT);
+    srand(4);
+    for (int i = 0; i < COUNT; i++) {
+        KVector2 c = {rand() % 4000 * 0.1, rand() % 3000 * 0.1};
+        if (i % 2)
+            ObstacleAddCircle(universe, c, 1.0 + i % 3);
+        else
+            ObstacleAddSegment(universe, c, (KVector2){c.x + 5.0, c.y + i % 7});
+    }
+    ObstaclesBuild(universe);
+
+    const ObstacleSet *set = universe->obstacles;
+    int seen[COUNT] = {0};
+    int failed = set->count != COUNT || set->dirty;
+    // Each stack entry carries the box its parent holds for it
+    struct { uint32_t node; KVector2 lo, hi; } stack[OBSTACLE_STACK_DEPTH];
+    uint32_t top = 0;
+    stack[top].node = 0;
+    stack[top].lo = (KVector2){-INFINITY, -INFINITY};
+    stack[top++].hi = (KVector2){INFINITY, INFINITY};
+    while (top > 0 && !failed) {
+        top--;
+        const ObstacleNode *node = &set->nodes[stack[top].node];
+        const KVector2 lo = stack[top].lo, hi = stack[top].hi;
+        for (uint32_t c = 0; c < OBSTACLE_NODE_WIDTH; c++) {
+            if (node->minX[c] > node->maxX[c])
+                continue;
+            KVector2 boxLo = {node->minX[c], node->minY[c]};
+            KVector2 boxHi = {node->maxX[c], node->maxY[c]};
+            failed |= boxLo.x < lo.x || boxLo.y < lo.y || boxHi.x > hi.x || boxHi.y > hi.y;
+            if (node->count[c] == 0) {
+                stack[top].node = node->child[c];
+                stack[top].lo = boxLo;
+                stack[top++].hi = boxHi;
+                continue;
+            }
+            for (uint32_t o = node->child[c]; o < node->child[c] + node->count[c]; o++)
+                failed |= seen[o]++ > 0 ||
+                          !contains(node, c, set->obstacles[o].boundsMin, set->obstacles[o].boundsMax);
+        }
+    }
+    for (int i = 0; i < COUNT; i++)
+        failed |= seen[i] != 1;
+    // 1000 obstacles in leaves of at most 4: 250+ leaves, 4 or 5 levels
+    if (failed || set->depth > 5 || set->nodeCount >= COUNT / OBSTACLE_LEAF_SIZE) {
+        fprintf(stderr, "Hierarchy: %u nodes, depth %u, invariant broken %d\n",
+                set->nodeCount, set->depth, failed);
+        failed = 1;
+    }
+
+    UniverseDestroy(universe);
+    if (!failed)
+        printf("Hierarchy test: PASSED\n");
+    return failed;
+}
+
+// A point moving far past a thin segment in one step is put back on the side
+// it came from, with its normal velocity reflected
+int test_segment_does_not_tunnel() {
+    Universe *universe = world(4, 4);
+    ObstacleAddSegment(universe, (KVector2){100, 200}, (KVector2){300, 200});
+    EntityID particle = ParticleCreate(universe, (KVector2){200, 150}, (KVector2){30, 6000}, 1.0);
+    UniverseUpdate(universe, DT);
+
+    const KineticBodyComponent *body = UniverseGetKineticBodyComponent(universe, particle);
+    const MechanicsComponent *mech = UniverseGetMechanicsComponent(universe, particle);
+    int failed = 0;
+    if (body->position.y > 200.0 + EPSILON || fabs(mech->velocity.y + 6000 * RESTITUTION) > EPSILON ||
+        fabs(mech->velocity.x - 30) > EPSILON || universe->obstacles->contacts != 1) {
+        fprintf(stderr, "Tunnel: y %g, velocity (%g, %g), %llu contacts\n", body->position.y,
+                mech->velocity.x, mech->velocity.y,
+                (unsigned long long)universe->obstacles->contacts);
+        failed = 1;
+    }
+
+    // Past the end of the segment the particle goes by
+    EntityID miss = ParticleCreate(universe, (KVector2){320, 150}, (KVector2){0, 6000}, 1.0);
+    UniverseUpdate(universe, DT);
+    if (UniverseGetKineticBodyComponent(universe, miss)->position.y < 200.0) {
+        fprintf(stderr, "A particle past the segment end was stopped\n");
+        failed = 1;
+    }
+
+    UniverseDestroy(universe);
+    if (!failed)
+        printf("Segment tunnel test: PASSED\n");
+    return failed;
+}
+
+// Discs overlapping a circle or a polygon end on its surface
+int test_solid_shapes() {
+    Universe *universe = world(4, 4);
+    ObstacleAddCircle(universe, (KVector2){100, 100}, 20.0);
+    // Clockwise on input; stored counter-clockwise
+    const KVector2 box[4] = {{200, 100}, {200, 140}, {260, 140}, {260, 100}};
+    ObstacleAddPolygon(universe, box, 4);
+    const KVector2 concave[4] = {{0, 0}, {10, 0}, {5, 2}, {5, 10}};
+
+    EntityID a = ParticleCreate(universe, (KVector2){110, 100}, (KVector2){-50, 0}, 1.0);
+    UniverseAddRadiusComponent(universe, a, 4.0);
+    // Inside the box, nearest the top face
+    EntityID b = ParticleCreate(universe, (KVector2){230, 103}, (KVector2){0, 50}, 1.0);
+    UniverseAddRadiusComponent(universe, b, 2.0);
+    // Outside, near a corner
+    EntityID c = ParticleCreate(universe, (KVector2){262, 142}, (KVector2){0, 0}, 1.0);
+    UniverseAddRadiusComponent(universe, c, 4.0);
+    UniverseUpdate(universe, 1e-9);
+
+    KVector2 pa = UniverseGetKineticBodyComponent(universe, a)->position;
+    KVector2 pb = UniverseGetKineticBodyComponent(universe, b)->position;
+    KVector2 pc = UniverseGetKineticBodyComponent(universe, c)->position;
+    double da = KVector2Norm(KVector2Subtraction(pa, (KVector2){100, 100}));
+    double dc = KVector2Norm(KVector2Subtraction(pc, (KVector2){260, 140}));
+    double vb = UniverseGetMechanicsComponent(universe, b)->velocity.y;
+    int failed = 0;
+    if (fabs(da - 24.0) > 1e-6 || fabs(pb.y - 98.0) > 1e-6 || fabs(pb.x - 230.0) > 1e-6 ||
+        fabs(vb + 50 * RESTITUTION) > 1e-6 || fabs(dc - 4.0) > 1e-6 ||
+        ObstacleAddPolygon(universe, concave, 4)) {
+        fprintf(stderr, "Circle distance %g, box particle (%g, %g) vy %g, corner distance %g\n",
+                da, pb.x, pb.y, vb, dc);
+        failed = 1;
+    }
+
+    UniverseDestroy(universe);
+    if (!failed)
+        printf("Solid shape test: PASSED\n");
+    return failed;
+}
+
+// True if the move from p0 to p1 passes through segment ab
+static int crosses(KVector2 p0, KVector2 p1, KVector2 a, KVector2 b) {
+    KVector2 e = KVector2Subtraction(b, a);
+    double s0 = e.x * (p0.y - a.y) - e.y * (p0.x - a.x);
+    double s1 = e.x * (p1.y - a.y) - e.y * (p1.x - a.x);
+    if (s0 * s1 >= 0.0)
+        return 0;
+    KVector2 hit = KVector2Addition(p0, KVector2ScalarProduct(s0 / (s0 - s1), KVector2Subtraction(p1, p0)));
+    double along = KVector2DotProduct(KVector2Subtraction(hit, a), e) / KVector2DotProduct(e, e);
+    return along > EPSILON && along < 1.0 - EPSILON;
+}
+
+// Particles poured into a funnel over a field of pegs never pass through the
+// funnel walls, however they bounce
+int test_funnel() {
+    enum { PARTICLES = 2000, PEGS = 300 };
+    Universe *universe = world(PARTICLES, PEGS + 8);
+    UniverseSetBoundaries(universe, 600, 600, 0.0f, true);
+    const KVector2 walls[2][2] = {{{50, 200}, {280, 400}}, {{550, 200}, {320, 400}}};
+    ObstacleAddSegment(universe, walls[0][0], walls[0][1]);
+    ObstacleAddSegment(universe, walls[1][0], walls[1][1]);
+    srand(5);
+    for (int i = 0; i < PEGS; i++)
+        ObstacleAddCircle(universe, (KVector2){20 + rand() % 560, 420 + rand() % 160}, 3.0);
+
+    static KVector2 last[PARTICLES];
+    for (int i = 0; i < PARTICLES; i++) {
+        last[i] = (KVector2){100 + (i % 100) * 4.0, 20 + (i / 100) * 4.0};
+        EntityID e = ParticleCreate(universe, last[i], (KVector2){(i % 13) - 6.0, 0}, 1.0);
+        UniverseAddRadiusComponent(universe, e, 1.0);
+        UniverseGetMechanicsComponent(universe, e)->acceleration = (KVector2){0, 400};
+    }
+
+    int failed = 0;
+    uint64_t contacts = 0;
+    for (int step = 0; step < 240 && !failed; step++) {
+        UniverseUpdate(universe, DT);
+        contacts += universe->obstacles->contacts;
+        for (EntityID i = 0; i < PARTICLES && !failed; i++) {
+            KVector2 p = universe->kineticBodies[i].position;
+            for (int w = 0; w < 2; w++) {
+                if (crosses(last[i], p, walls[w][0], walls[w][1])) {
+                    fprintf(stderr, "Particle %u went through wall %d at step %d\n", i, w, step);
+                    failed = 1;
+                }
+            }
+            last[i] = p;
+        }
+    }
+    if (!failed && contacts < PARTICLES) {
+        fprintf(stderr, "Only %llu contacts\n", (unsigned long long)contacts);
+        failed = 1;
+    }
+
+    UniverseDestroy(universe);
+    if (!failed)
+        printf("Funnel test: PASSED\n");
+    return failed;
+}
+
+int main(void) {
+    int result = 0;
+
+    result |= test_hierarchy();
+    result |= test_segment_does_not_tunnel();
+    result |= test_solid_shapes();
+    result |= test_funnel();
+
+    if (result == 0) {
+        printf("\nAll obstacle tests passed!\n");
+    } else {
+        printf("\nSome obstacle tests failed!\n");
+    }
+
+    return result;
+}
@@ -0,0 +1,139 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../src/core/engine.h"
+
+#define COUNT 100003
+#define CHUNKS 7
+
+typedef struct {
+    unsigned char *hits;
+    uint32_t begins[CHUNKS];
+    uint32_t ends[CHUNKS];
+    int nested;
+} CoverJob;
+
+static void nestedBody(void *context, uint32_t begin, uint32_t end, uint32_t chunk) {
+    (void)chunk;
+    int *sum = (int *)context;
+    for (uint32_t i = begin; i < end; i++)
+        (*sum)++;
+}
+
+static void coverBody(void *context, uint32_t begin, uint32_t end, uint32_t chunk) {
+    CoverJob *job = (CoverJob *)context;
+    job->begins[chunk] = begin;
+    job->ends[chunk] = end;
+    for (uint32_t i = begin; i < end; i++)
+        job->hits[i]++;
+
+    // A loop started inside a chunk must finish on this thread
+    if (chunk == CHUNKS - 1) {
+        int sum = 0;
+        ParallelFor(1000, 1, nestedBody, &sum);
+        job->nested = sum;
+    }
+}
+
+int test_chunks_cover_range(ParallelBackend backend) {
+    if (!ParallelSetBackend(backend)) {
+        printf("Chunk coverage test (%s): SKIPPED, not compiled in\n", ParallelBackendName(backend));
+        return 0;
+    }
+
+    CoverJob job = {0};
+    job.hits = calloc(COUNT, 1);
+    ParallelForChunks(COUNT, CHUNKS, coverBody, &job);
+
+    int failed = 0;
+    for (uint32_t i = 0; i < COUNT && !failed; i++) {
+        if (job.hits[i] != 1) {
+            fprintf(stderr, "Index %u visited %d times\n", i, job.hits[i]);
+            failed = 1;
+        }
+    }
+    for (uint32_t c = 0; c < CHUNKS && !failed; c++) {
+        if (job.begins[c] != (uint64_t)COUNT * c / CHUNKS ||
+            job.ends[c] != (uint64_t)COUNT * (c + 1) / CHUNKS) {
+            fprintf(stderr, "Chunk %u is [%u, %u)\n", c, job.begins[c], job.ends[c]);
+            failed = 1;
+        }
+    }
+    if (job.nested != 1000) {
+        fprintf(stderr, "Nested loop covered %d of 1000\n", job.nested);
+        failed = 1;
+    }
+
+    free(job.hits);
+    if (!failed)
+        printf("Chunk coverage test (%s): PASSED\n", ParallelBackendName(backend));
+    return failed;
+}
+
+static Universe *stepScenario(ParallelBackend backend) {
+    ParallelSetBackend(backend);
+    Universe *universe = UniverseCreate(3 * PARALLEL_GRAIN_SLOTS);
+    UniverseSetBoundaries(universe, 1000, 1000, 10.0f, true);
+    srand(5);
+    for (uint32_t i = 0; i < universe->maxEntities; i++) {
+        KVector2 p = {20 + rand() % 960, 20 + rand() % 960};
+        KVector2 v = {rand() % 400 - 200.0, rand() % 400 - 200.0};
+        EntityID e = ParticleCreate(universe, p, v, 1.0);
+        if (i % 3 == 0)
+            UniverseRemoveComponent(universe, e, COMPONENT_ID_RADIUS);
+    }
+    UniverseSetAdaptiveTimestep(universe, 4.0);
+    for (int s = 0; s < 10; s++)
+        UniverseUpdate(universe, 0.05);
+    UniverseSetAdaptiveTimestep(universe, 0.0);
+    for (int s = 0; s < 10; s++)
+        UniverseUpdate(universe, 0.05);
+    UniverseReorderByMorton(universe);
+    return universe;
+}
+
+// Every backend must reproduce the serial result bit for bit
+int test_backends_agree() {
+    ParallelSetThreads(4);
+    Universe *reference = stepScenario(PARALLEL_SERIAL);
+
+    int failed = 0;
+    for (int b = PARALLEL_SERIAL + 1; b < PARALLEL_BACKEND_COUNT && !failed; b++) {
+        if (!ParallelBackendAvailable((ParallelBackend)b))
+            continue;
+
+        Universe *universe = stepScenario((ParallelBackend)b);
+        if (memcmp(universe->kineticBodies, reference->kineticBodies,
+                   universe->maxEntities * sizeof(KineticBodyComponent)) != 0 ||
+            memcmp(universe->mechanics, reference->mechanics,
+                   universe->maxEntities * sizeof(MechanicsComponent)) != 0) {
+            fprintf(stderr, "Backend %s diverged from serial\n",
+                    ParallelBackendName((ParallelBackend)b));
+            failed = 1;
+        }
+        UniverseDestroy(universe);
+    }
+
+    UniverseDestroy(reference);
+    if (!failed)
+        printf("Backends agree test: PASSED\n");
+    return failed;
+}
+
+int main(void) {
+    int result = 0;
+
+    ParallelSetThreads(4);
+    for (int b = 0; b < PARALLEL_BACKEND_COUNT; b++)
+        result |= test_chunks_cover_range((ParallelBackend)b);
+    result |= test_backends_agree();
+    ParallelShutdown();
+
+    if (result == 0) {
+        printf("\nAll parallel tests passed!\n");
+    } else {
+        printf("\nSome parallel tests failed!\n");
+    }
+
+    return result;
+}
@@ -0,0 +1,152 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "../src/config/config.h"
+#include "../src/core/engine.h"
+
+#define DT (1.0 / 60.0)
+
+static void segmentName(char *name, const char *what) {
+    snprintf(name, PUBLISH_NAME_MAX, "/kurage_%s_%d", what, (int)getpid());
+}
+
+// A reader mapping of the segment sees every particle, field by field
+int test_snapshot() {
+    char name[PUBLISH_NAME_MAX];
+    segmentName(name, "snapshot");
+    Universe *universe = UniverseCreate(64);
+    for (int i = 0; i < 40; i++) {
+        EntityID e = ParticleCreate(universe, (KVector2){i, 2.0 * i}, (KVector2){-i, 1.0}, 1.0 + i);
+        if (i % 3 == 0)
+            UniverseAddRadiusComponent(universe, e, 0.5 * i);
+    }
+    UniverseDestroyEntity(universe, 7);
+    // A body with no mechanics publishes zero velocity
+    EntityID still = UniverseCreateEntity(universe);
+    UniverseAddKineticBodyComponent(universe, still, (KVector2){-5, -5}, 2.0);
+    UniverseUpdate(universe, DT);
+
+    Publisher *writer = PublisherCreate(name, 64, 3);
+    Publisher *reader = PublisherOpen(name);
+    PublishSnapshot snapshot;
+    int failed = !writer || !reader || PublisherReadLatest(reader, &snapshot);
+    failed |= failed || !PublisherPublish(writer, universe);
+    failed |= failed || !PublisherReadLatest(reader, &snapshot) ||
+              snapshot.count != UniverseCountActive(universe) || snapshot.step != 1;
+
+    for (uint32_t k = 0; !failed && k < snapshot.count; k++) {
+        EntityID e = snapshot.entities[k];
+        uint32_t slot = UniverseEntitySlot(universe, e);
+        const KineticBodyComponent *body = &universe->kineticBodies[slot];
+        KVector2 v = e == still ? (KVector2){0, 0} : universe->mechanics[slot].velocity;
+        double radius = universe->entityMasks[slot] & COMPONENT_RADIUS ? universe->radii[slot].radius : 0.0;
+        failed |= !UniverseIsEntityActive(universe, e) || snapshot.x[k] != body->position.x ||
+                  snapshot.y[k] != body->position.y || snapshot.vx[k] != v.x || snapshot.vy[k] != v.y ||
+                  snapshot.inverseMass[k] != body->inverseMass || snapshot.radius[k] != radius;
+        if (failed)
+            fprintf(stderr, "Published entity %u differs at %u\n", e, k);
+    }
+    failed |= !PublisherReadValid(reader, &snapshot);
+
+    // A full ring later the frame has been rewritten under the old snapshot
+    for (int i = 0; i < 3; i++)
+        PublisherPublish(writer, universe);
+    failed |= PublisherReadValid(reader, &snapshot);
+
+    // Frames hold the capacity given at creation; the rest are counted
+    Publisher *small = PublisherCreate(name, 16, 2);
+    Publisher *smallReader = PublisherOpen(name);
+    failed |= !small || PublisherPublish(small, universe) || !smallReader ||
+              !PublisherReadLatest(smallReader, &snapshot) || snapshot.count != 16 ||
+              snapshot.frame->dropped != UniverseCountActive(universe) - 16;
+
+    PublisherClose(smallReader);
+    PublisherClose(small);
+    PublisherClose(reader);
+    PublisherClose(writer);
+    failed |= PublisherOpen(name) != NULL;
+    UniverseDestroy(universe);
+    if (!failed)
+        printf("Snapshot test: PASSED\n");
+    return failed;
+}
+
+// Every frame a reader validates is consistent, while the writer publishes
+// as fast as it can into a ring of two frames from another process
+int test_cross_process() {
+    enum { PARTICLES = 4096, READS = 2000 };
+    char name[PUBLISH_NAME_MAX];
+    segmentName(name, "process");
+    Universe *universe = UniverseCreate(PARTICLES);
+    for (int i = 0; i < PARTICLES; i++)
+        ParticleCreate(universe, (KVector2){0, i}, (KVector2){0, 0}, 1.0);
+    Publisher *writer = PublisherCreate(name, PARTICLES, 2);
+    if (!writer) {
+        fprintf(stderr, "Could not create %s\n", name);
+        UniverseDestroy(universe);
+        return 1;
+    }
+    PublisherPublish(writer, universe);
+
+    pid_t child = fork();
+    if (child == 0) {
+        // Each published frame has x equal to its step in every particle
+        Publisher *reader = PublisherOpen(name);
+        PublishSnapshot snapshot;
+        int good = 0, torn = 0, retries = 0;
+        while (reader && good < READS) {
+            if (!PublisherReadLatest(reader, &snapshot))
+                _exit(2);
+            int consistent = snapshot.count == PARTICLES;
+            for (uint32_t k = 0; consistent && k < snapshot.count; k++)
+                consistent = snapshot.x[k] == (double)snapshot.step && snapshot.y[k] == k;
+            if (!PublisherReadValid(reader, &snapshot)) {
+                retries++;
+                continue;
+            }
+            torn += !consistent;
+            good++;
+        }
+        if (retries > 0)
+            fprintf(stderr, "  (reader retried %d times)\n", retries);
+        _exit(!reader ? 3 : torn ? 4 : 0);
+    }
+
+    int status = 0;
+    uint64_t published = 0;
+    while (waitpid(child, &status, WNOHANG) == 0) {
+        universe->stepCount++;
+        for (uint32_t i = 0; i < PARTICLES; i++)
+            universe->kineticBodies[i].position.x = (double)universe->stepCount;
+        PublisherPublish(writer, universe);
+        published++;
+    }
+
+    int failed = child < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0;
+    if (failed)
+        fprintf(stderr, "Reader exited with %d after %llu publishes\n",
+                WIFEXITED(status) ? WEXITSTATUS(status) : -1, (unsigned long long)published);
+
+    PublisherClose(writer);
+    UniverseDestroy(universe);
+    if (!failed)
+        printf("Cross-process test: PASSED\n");
+    return failed;
+}
+
+int main(void) {
+    int result = 0;
+
+    result |= test_snapshot();
+    result |= test_cross_process();
+
+    if (result == 0) {
+        printf("\nAll publish tests passed!\n");
+    } else {
+        printf("\nSome publish tests failed!\n");
+    }
+
+    return result;
+}
@@ -0,0 +1,96 @@
+#include <stdio.h>
+#include "../src/core/engine.h"
+
+static int contains(const EntityQuery *query, EntityID entity) {
+    for (uint32_t k = 0; k < query->count; k++) {
+        if (query->entities[k] == entity)
+            return 1;
+    }
+    return 0;
+}
+
+int test_query_matches_masks() {
+    Universe *universe = UniverseCreate(16);
+    if (!universe) {
+        fprintf(stderr, "Failed to create universe\n");
+        return 1;
+    }
+
+    EntityID particle = ParticleCreate(universe, (KVector2){0, 0}, (KVector2){0, 0}, 1.0);
+    EntityID bodyOnly = UniverseCreateEntity(universe);
+    UniverseAddKineticBodyComponent(universe, bodyOnly, (KVector2){1, 1}, 1.0);
+
+    const EntityQuery *both = UniverseQuery(universe, COMPONENT_PARTICLE | COMPONENT_MECHANICS, COMPONENT_NONE);
+    const EntityQuery *bodies = UniverseQuery(universe, COMPONENT_PARTICLE, COMPONENT_MECHANICS);
+
+    if (!both || !bodies || both->count != 1 || bodies->count != 1 ||
+        !contains(both, particle) || !contains(bodies, bodyOnly)) {
+        fprintf(stderr, "Initial query contents mismatch\n");
+        UniverseDestroy(universe);
+        return 1;
+    }
+
+    // Same masks must hand back the same cached query
+    if (UniverseQuery(universe, COMPONENT_PARTICLE | COMPONENT_MECHANICS, COMPONENT_NONE) != both) {
+        fprintf(stderr, "Query was not cached\n");
+        UniverseDestroy(universe);
+        return 1;
+    }
+
+    UniverseDestroy(universe);
+    printf("Query mask matching test: PASSED\n");
+    return 0;
+}
+
+int test_query_incremental_updates() {
+    Universe *universe = UniverseCreate(16);
+    if (!universe) {
+        fprintf(stderr, "Failed to create universe\n");
+        return 1;
+    }
+
+    const EntityQuery *both = UniverseQuery(universe, COMPONENT_PARTICLE | COMPONENT_MECHANICS, COMPONENT_NONE);
+    const EntityQuery *bodies = UniverseQuery(universe, COMPONENT_PARTICLE, COMPONENT_MECHANICS);
+
+    EntityID a = ParticleCreate(universe, (KVector2){0, 0}, (KVector2){0, 0}, 1.0);
+    EntityID b = ParticleCreate(universe, (KVector2){0, 0}, (KVector2){0, 0}, 1.0);
+    EntityID c = UniverseCreateEntity(universe);
+    UniverseAddKineticBodyComponent(universe, c, (KVector2){0, 0}, 1.0);
+
+    if (both->count != 2 || bodies->count != 1 || !contains(bodies, c)) {
+        fprintf(stderr, "Queries not updated on component add\n");
+        UniverseDestroy(universe);
+        return 1;
+    }
+
+    // Gaining the excluded component moves the entity between queries
+    UniverseAddMechanicsComponent(universe, c, (KVector2){0, 0}, (KVector2){0, 0});
+    UniverseDestroyEntity(universe, a);
+
+    if (both->count != 2 || bodies->count != 0 || contains(both, a) ||
+        !UniverseValidate(universe) ||
+        !contains(both, b) || !contains(both, c)) {
+        fprintf(stderr, "Queries not updated on add/destroy\n");
+        UniverseDestroy(universe);
+        return 1;
+    }
+
+    UniverseDestroy(universe);
+    printf("Query incremental update test: PASSED\n");
+    return 0;
+}
+
+int main(void) {
+    int result = 0;
+
+    result |= test_query_matches_masks();
+    result |= test_query_incremental_updates();
+
+    if (result == 0) {
+        printf("\nAll query tests passed!\n");
+    } else {
+        printf("\nSome tests failed!\n");
+    }
+
+    return result;
+}
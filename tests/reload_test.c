@@ -0,0 +1,171 @@
+#include <dirent.h>
+#include <dlfcn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "../src/config/config.h"
+#include "../src/core/engine.h"
+
+// Hot reload as the host does it: state made by one copy of the library
+// outlives that copy, and the next copy carries on with it. Each copy is
+// loaded from its own file so dlopen cannot hand back the same handle.
+
+#define DT (1.0 / 60.0)
+// Enough slots that the per-slot systems split across the workers
+#define SLOTS (1u << 16)
+
+typedef struct {
+    void *handle;
+    char path[64];
+    Universe *(*create)(uint32_t);
+    Universe *(*createWithOptions)(uint32_t, const UniverseOptions *);
+    KAllocator (*heapAllocator)(void);
+    EntityID (*particleCreate)(Universe *, KVector2, KVector2, double);
+    void (*update)(Universe *, double);
+    const EntityQuery *(*query)(Universe *, ComponentMask, ComponentMask);
+    void (*rebind)(Universe *);
+    void (*destroy)(Universe *);
+    bool (*setBackend)(ParallelBackend);
+    void (*setThreads)(uint32_t);
+    void (*shutdown)(void);
+} Library;
+
+static int copyFile(const char *from, int fd) {
+    FILE *in = fopen(from, "rb");
+    if (!in)
+        return 0;
+    char buffer[65536];
+    size_t n;
+    int ok = 1;
+    while ((n = fread(buffer, 1, sizeof(buffer), in)) > 0)
+        ok &= write(fd, buffer, n) == (ssize_t)n;
+    fclose(in);
+    return ok;
+}
+
+static int load(Library *library, const char *source) {
+    strcpy(library->path, "/tmp/kurage-reload-XXXXXX");
+    int fd = mkstemp(library->path);
+    if (fd < 0)
+        return 0;
+    int copied = copyFile(source, fd);
+    close(fd);
+    library->handle = copied ? dlopen(library->path, RTLD_NOW | RTLD_LOCAL) : NULL;
+    unlink(library->path);
+    if (!library->handle) {
+        fprintf(stderr, "Cannot load %s: %s\n", source, copied ? dlerror() : "copy failed");
+        return 0;
+    }
+
+    void *h = library->handle;
+    *(void **)&library->create = dlsym(h, "UniverseCreate");
+    *(void **)&library->createWithOptions = dlsym(h, "UniverseCreateWithOptions");
+    *(void **)&library->heapAllocator = dlsym(h, "KHeapAllocator");
+    *(void **)&library->particleCreate = dlsym(h, "ParticleCreate");
+    *(void **)&library->update = dlsym(h, "UniverseUpdate");
+    *(void **)&library->query = dlsym(h, "UniverseQuery");
+    *(void **)&library->rebind = dlsym(h, "UniverseRebind");
+    *(void **)&library->destroy = dlsym(h, "UniverseDestroy");
+    *(void **)&library->setBackend = dlsym(h, "ParallelSetBackend");
+    *(void **)&library->setThreads = dlsym(h, "ParallelSetThreads");
+    *(void **)&library->shutdown = dlsym(h, "ParallelShutdown");
+    if (!library->create || !library->createWithOptions || !library->heapAllocator ||
+        !library->particleCreate || !library->update || !library->query || !library->rebind ||
+        !library->destroy || !library->setBackend || !library->setThreads || !library->shutdown)
+        return 0;
+    // Every copy runs its own pool, even on a single core machine
+    library->setThreads(4);
+    return library->setBackend(PARALLEL_PTHREADS);
+}
+
+static int threadCount(void) {
+    DIR *tasks = opendir("/proc/self/task");
+    int count = 0;
+    for (struct dirent *entry; tasks && (entry = readdir(tasks));)
+        count += entry->d_name[0] != '.';
+    if (tasks)
+        closedir(tasks);
+    return count;
+}
+
+static void step(Library *library, Universe *arena, Universe *heaped) {
+    for (int i = 0; i < 10; i++) {
+        library->update(arena, DT);
+        library->update(heaped, DT);
+    }
+}
+
+// What the plugin does in kurage_pre_reload: the outgoing copy joins its
+// pool before it is closed, or its workers sleep in unmapped code
+static void swap(Library *from, Library *to, Universe *arena, Universe *heaped) {
+    to->rebind(arena);
+    to->rebind(heaped);
+    from->shutdown();
+    dlclose(from->handle);
+}
+
+static Universe *populate(Library *library, Universe *universe) {
+    for (int i = 0; universe && i < 50; i++)
+        library->particleCreate(universe, (KVector2){100 + i, 100}, (KVector2){10, -5}, 1.0);
+    return universe;
+}
+
+// Universes made and stepped by copy A keep allocating, keep stepping on
+// the schedule A built and are carried through copies B and C, each copy
+// stepping them on its own worker threads
+int test_reload(const char *source) {
+    Library a, b, c;
+    if (!load(&a, source))
+        return 1;
+
+    Universe *arena = populate(&a, a.create(SLOTS));
+    KAllocator heap = a.heapAllocator();
+    UniverseOptions options = {0};
+    options.allocator = &heap;
+    Universe *heaped = populate(&a, a.createWithOptions(SLOTS, &options));
+    if (!arena || !heaped)
+        return 1;
+    int threads = threadCount();
+    step(&a, arena, heaped);
+    // Stepping started A's pool
+    int failed = threadCount() <= threads;
+
+    if (!load(&b, source))
+        return 1;
+    swap(&a, &b, arena, heaped);
+    failed |= threadCount() != threads;
+
+    // A query the old copy never made is carved through the allocator
+    failed |= !b.query(arena, COMPONENT_RADIUS, COMPONENT_NONE) ||
+              !b.query(heaped, COMPONENT_RADIUS, COMPONENT_NONE);
+    step(&b, arena, heaped);
+
+    if (!load(&c, source))
+        return 1;
+    swap(&b, &c, arena, heaped);
+    step(&c, arena, heaped);
+    failed |= arena->stepCount != 30 || heaped->stepCount != 30;
+    c.destroy(arena);
+    c.destroy(heaped);
+    c.shutdown();
+    dlclose(c.handle);
+
+    if (!failed)
+        printf("Reload test: PASSED\n");
+    return failed;
+}
+
+int main(int argc, char **argv) {
+    int result = 0;
+
+    result |= test_reload(argc > 1 ? argv[1] : "build/libkurage.so");
+
+    if (result == 0) {
+        printf("\nAll reload tests passed!\n");
+    } else {
+        printf("\nSome reload tests failed!\n");
+    }
+
+    return result;
+}
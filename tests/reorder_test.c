@@ -0,0 +1,180 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "../src/core/engine.h"
+
+#define COUNT 1000
+
+static uint32_t slot_key(Universe *universe, uint32_t slot, KVector2 min, KVector2 max) {
+    KVector2 p = universe->kineticBodies[slot].position;
+    return MortonEncode2D((uint16_t)((p.x - min.x) * (65535.0 / (max.x - min.x))),
+                          (uint16_t)((p.y - min.y) * (65535.0 / (max.y - min.y))));
+}
+
+int test_reorder_keeps_ids(uint32_t maxEntities, uint32_t threads) {
+    ParallelSetThreads(threads);
+    UniverseOptions options = {0};
+    options.touchThreads = threads;
+    Universe *universe = UniverseCreateWithOptions(maxEntities, &options);
+    if (!universe) {
+        fprintf(stderr, "Failed to create universe\n");
+        return 1;
+    }
+
+    static EntityID ids[COUNT];
+    static KVector2 velocities[COUNT];
+    srand(42);
+    for (int i = 0; i < COUNT; i++) {
+        KVector2 p = {rand() % 1000, rand() % 1000};
+        velocities[i] = (KVector2){i, -i};
+        ids[i] = ParticleCreate(universe, p, velocities[i], 1.0);
+        UniverseAddRadiusComponent(universe, ids[i], 1.0 + i % 3);
+    }
+
+    // Holes and a query created before the reorder must survive it
+    for (int i = 0; i < COUNT; i += 10)
+        UniverseDestroyEntity(universe, ids[i]);
+    const EntityQuery *query = UniverseQuery(universe, COMPONENT_PARTICLE | COMPONENT_MECHANICS, COMPONENT_NONE);
+    uint32_t queried = query->count;
+
+    if (!UniverseReorderByMorton(universe) || !UniverseValidate(universe)) {
+        fprintf(stderr, "Reorder failed or broke bookkeeping\n");
+        UniverseDestroy(universe);
+        return 1;
+    }
+
+    for (int i = 0; i < COUNT; i++) {
+        MechanicsComponent *mech = UniverseGetMechanicsComponent(universe, ids[i]);
+        RadiusComponent *radius = UniverseGetComponent(universe, ids[i], COMPONENT_ID_RADIUS);
+        if (i % 10 == 0) {
+            if (mech) {
+                fprintf(stderr, "Destroyed entity came back\n");
+                UniverseDestroy(universe);
+                return 1;
+            }
+            continue;
+        }
+        if (!mech || mech->velocity.x != velocities[i].x || !radius || radius->radius != 1.0 + i % 3) {
+            fprintf(stderr, "Entity %u lost its data\n", ids[i]);
+            UniverseDestroy(universe);
+            return 1;
+        }
+    }
+
+    KVector2 min = universe->kineticBodies[0].position, max = min;
+    for (uint32_t slot = 0; slot < universe->entityCount; slot++) {
+        KVector2 p = universe->kineticBodies[slot].position;
+        min.x = p.x < min.x ? p.x : min.x;
+        min.y = p.y < min.y ? p.y : min.y;
+        max.x = p.x > max.x ? p.x : max.x;
+        max.y = p.y > max.y ? p.y : max.y;
+    }
+
+    // Positioned entities now occupy the first slots in Z-curve order
+    uint32_t previous = 0;
+    for (uint32_t slot = 0; slot < universe->entityCount; slot++) {
+        uint32_t key = slot_key(universe, slot, min, max);
+        if (!UniverseIsSlotActive(universe, slot) || key < previous) {
+            fprintf(stderr, "Slots are not in Morton order at %u\n", slot);
+            UniverseDestroy(universe);
+            return 1;
+        }
+        previous = key;
+    }
+
+    if (query->count != queried) {
+        fprintf(stderr, "Query lost entries\n");
+        UniverseDestroy(universe);
+        return 1;
+    }
+    for (uint32_t k = 0; k < query->count; k++) {
+        if (!UniverseIsSlotActive(universe, query->entities[k])) {
+            fprintf(stderr, "Query points at an empty slot\n");
+            UniverseDestroy(universe);
+            return 1;
+        }
+    }
+
+    UniverseDestroy(universe);
+    printf("Reorder keeps ids test (%u slots, %u threads): PASSED\n", maxEntities, threads);
+    return 0;
+}
+
+int test_periodic_reorder() {
+    Universe *universe = UniverseCreate(256);
+    if (!universe) {
+        fprintf(stderr, "Failed to create universe\n");
+        return 1;
+    }
+    universe->boundary.enabled = false;
+
+    EntityID far = ParticleCreate(universe, (KVector2){500, 500}, (KVector2){0, 0}, 1.0);
+    EntityID near = ParticleCreate(universe, (KVector2){0, 0}, (KVector2){0, 0}, 1.0);
+    UniverseSetReorderInterval(universe, 2);
+
+    UniverseUpdate(universe, 0.1);
+    if (UniverseEntitySlot(universe, far) != far) {
+        fprintf(stderr, "Reordered before the interval elapsed\n");
+        UniverseDestroy(universe);
+        return 1;
+    }
+
+    UniverseUpdate(universe, 0.1);
+    if (UniverseEntitySlot(universe, near) != 0 || UniverseEntitySlot(universe, far) != 1 ||
+        UniverseGetKineticBodyComponent(universe, far)->position.x != 500) {
+        fprintf(stderr, "Periodic reorder did not run\n");
+        UniverseDestroy(universe);
+        return 1;
+    }
+
+    UniverseDestroy(universe);
+    printf("Periodic reorder test: PASSED\n");
+    return 0;
+}
+
+// NaN and infinite positions neither stretch the grid nor get a key of
+// their own: the finite particles sort as if they were alone
+int test_non_finite_positions() {
+    Universe *universe = UniverseCreate(64);
+    if (!universe) {
+        fprintf(stderr, "Failed to create universe\n");
+        return 1;
+    }
+
+    EntityID nan = ParticleCreate(universe, (KVector2){NAN, 5}, (KVector2){0, 0}, 1.0);
+    EntityID far = ParticleCreate(universe, (KVector2){100, 40}, (KVector2){0, 0}, 1.0);
+    EntityID inf = ParticleCreate(universe, (KVector2){1, -INFINITY}, (KVector2){0, 0}, 1.0);
+    EntityID mid = ParticleCreate(universe, (KVector2){10, 100}, (KVector2){0, 0}, 1.0);
+    EntityID near = ParticleCreate(universe, (KVector2){0, 0}, (KVector2){0, 0}, 1.0);
+
+    int failed = !UniverseReorderByMorton(universe) || !UniverseValidate(universe);
+    failed |= UniverseEntitySlot(universe, near) != 0 || UniverseEntitySlot(universe, far) != 1 ||
+              UniverseEntitySlot(universe, mid) != 2;
+    // Stable: the non-finite ones keep their order, behind the rest
+    failed |= UniverseEntitySlot(universe, nan) != 3 || UniverseEntitySlot(universe, inf) != 4;
+
+    UniverseDestroy(universe);
+    if (failed) {
+        fprintf(stderr, "Non-finite positions disturbed the order\n");
+        return 1;
+    }
+    printf("Non-finite positions test: PASSED\n");
+    return 0;
+}
+
+int main(void) {
+    int result = 0;
+
+    result |= test_reorder_keeps_ids(COUNT + 24, 1);
+    result |= test_reorder_keeps_ids(1u << 17, 4);
+    result |= test_periodic_reorder();
+    result |= test_non_finite_positions();
+
+    if (result == 0) {
+        printf("\nAll reorder tests passed!\n");
+    } else {
+        printf("\nSome tests failed!\n");
+    }
+
+    return result;
+}
@@ -0,0 +1,258 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../src/core/engine.h"
+
+#define DT (1.0 / 60.0)
+
+static Universe *world(uint32_t capacity, int walls, KVector2 gravity) {
+    Universe *universe = UniverseCreate(capacity);
+    UniverseSetBoundaries(universe, 400, 300, 10.0f, walls);
+    RigidSettings settings = RigidDefaultSettings();
+    settings.gravity = gravity;
+    RigidEnable(universe, &settings);
+    return universe;
+}
+
+static double quaternionNorm(KQuaternion q) {
+    return sqrt(q.x * q.x + q.y * q.y + q.z * q.z + q.w * q.w);
+}
+
+// Mass, inertia and centroid of boxes and of hulls given in any order
+int test_mass_properties() {
+    Universe *universe = world(8, 0, (KVector2){0, 0});
+    EntityID box = RigidBoxCreate(universe, (KVector2){50, 50}, (KVector2){10, 5}, 0.0, 2.0);
+    // Clockwise, with a duplicate and an interior point
+    const KVector2 triangle[5] = {{0, 0}, {0, 30}, {30, 0}, {5, 5}, {0, 30}};
+    EntityID hull = RigidPolygonCreate(universe, (KVector2){100, 100}, triangle, 5, 0.0, 1.0);
+    const KVector2 line[3] = {{0, 0}, {10, 0}, {20, 0}};
+    EntityID degenerate = RigidPolygonCreate(universe, (KVector2){0, 0}, line, 3, 0.0, 1.0);
+
+    const RigidBodyComponent *b = RigidGetBody(universe, box);
+    const RigidBodyComponent *t = RigidGetBody(universe, hull);
+    const RigidShapeComponent *shape = RigidGetShape(universe, hull);
+
+    double boxMass = 2.0 * 20.0 * 10.0;
+    double boxInertia = boxMass * (20.0 * 20.0 + 10.0 * 10.0) / 12.0;
+    // Right triangle with legs a = 30: polar inertia about the centroid is m a^2 / 9
+    double triangleMass = 450.0;
+    double triangleInertia = triangleMass * 900.0 / 9.0;
+    double sumX = 0.0, sumY = 0.0;
+    for (uint32_t i = 0; i < shape->count; i++) {
+        sumX += shape->vertices[i].x;
+        sumY += shape->vertices[i].y;
+    }
+
+    int failed = 0;
+    if (fabs(1.0 / b->inverseMass - boxMass) > 1e-9 ||
+        fabs(1.0 / b->inverseInertia - boxInertia) > 1e-6 ||
+        fabs(1.0 / t->inverseMass - triangleMass) > 1e-9 ||
+        fabs(1.0 / t->inverseInertia - triangleInertia) > 1e-6 || shape->count != 3 ||
+        fabs(t->position.x - 110.0) > 1e-9 || fabs(t->position.y - 110.0) > 1e-9 ||
+        fabs(sumX) > 1e-9 || fabs(sumY) > 1e-9 || degenerate != INVALID_ENTITY) {
+        fprintf(stderr, "Box mass %g inertia %g; triangle mass %g inertia %g at (%g, %g), %u vertices\n",
+                1.0 / b->inverseMass, 1.0 / b->inverseInertia, 1.0 / t->inverseMass,
+                1.0 / t->inverseInertia, t->position.x, t->position.y, shape->count);
+        failed = 1;
+    }
+
+    // Counter-clockwise hull with unit outward normals
+    for (uint32_t i = 0; i < shape->count && !failed; i++) {
+        KVector2 v = shape->vertices[i];
+        KVector2 n = shape->normals[i];
+        if (fabs(KVector2Norm(n) - 1.0) > 1e-12 || KVector2DotProduct(n, v) <= 0.0) {
+            fprintf(stderr, "Normal %u (%g, %g) is not outward\n", i, n.x, n.y);
+            failed = 1;
+        }
+    }
+
+    UniverseDestroy(universe);
+    if (!failed)
+        printf("Mass properties test: PASSED\n");
+    return failed;
+}
+
+// A spinning body in free flight turns at a constant rate and keeps a unit
+// quaternion
+int test_free_rotation() {
+    Universe *universe = world(4, 0, (KVector2){0, 0});
+    EntityID box = RigidBoxCreate(universe, (KVector2){100, 100}, (KVector2){10, 10}, 0.0, 1.0);
+    RigidBodyComponent *body = RigidGetBody(universe, box);
+    body->angularVelocity = 2.0;
+    body->velocity = (KVector2){10.0, -5.0};
+
+    for (int step = 0; step < 100; step++)
+        UniverseUpdate(universe, 0.01);
+
+    double angle = RigidAngle(body->orientation);
+    int failed = 0;
+    if (fabs(angle - 2.0) > 1e-9 || fabs(quaternionNorm(body->orientation) - 1.0) > 1e-12 ||
+        fabs(body->position.x - 110.0) > 1e-9 || fabs(body->position.y - 95.0) > 1e-9 ||
+        body->angularVelocity != 2.0) {
+        fprintf(stderr, "Angle %.12f, |q| %.15f, position (%g, %g)\n", angle,
+                quaternionNorm(body->orientation), body->position.x, body->position.y);
+        failed = 1;
+    }
+
+    UniverseDestroy(universe);
+    if (!failed)
+        printf("Free rotation test: PASSED\n");
+    return failed;
+}
+
+// A box dropped on the floor comes to rest flat, within the slop
+int test_box_comes_to_rest() {
+    Universe *universe = world(4, 1, (KVector2){0, 400});
+    const double floor = universe->boundary.bottom;
+    EntityID box = RigidBoxCreate(universe, (KVector2){200, floor - 60}, (KVector2){15, 10}, 0.0, 1.0);
+    const RigidBodyComponent *body = RigidGetBody(universe, box);
+
+    for (int step = 0; step < 180; step++)
+        UniverseUpdate(universe, DT);
+
+    double overlap = body->position.y + 10.0 - floor;
+    double angle = RigidAngle(body->orientation);
+    int failed = 0;
+    if (overlap > universe->rigid->settings.slop + 0.05 || overlap < -0.05 ||
+        fabs(angle) > 1e-6 || KVector2Norm(body->velocity) > 0.1 ||
+        fabs(body->position.x - 200.0) > 1e-6) {
+        fprintf(stderr, "Resting box: overlap %g, angle %g, speed %g, x %g\n", overlap,
+                angle, KVector2Norm(body->velocity), body->position.x);
+        failed = 1;
+    }
+
+    UniverseDestroy(universe);
+    if (!failed)
+        printf("Box rest test: PASSED\n");
+    return failed;
+}
+
+// A staggered column of boxes stays standing; warm starting carries the
+// impulses that hold it up from step to step
+int test_stack_holds() {
+    enum { HEIGHT = 12 };
+    Universe *universe = world(HEIGHT + 1, 1, (KVector2){0, 400});
+    const double floor = universe->boundary.bottom;
+    EntityID boxes[HEIGHT];
+    for (int i = 0; i < HEIGHT; i++)
+        boxes[i] = RigidBoxCreate(universe, (KVector2){i % 2 ? 201.0 : 200.0, floor - 10.0 - 20.0 * i},
+                                  (KVector2){10, 10}, 0.0, 1.0);
+
+    for (int step = 0; step < 300; step++)
+        UniverseUpdate(universe, DT);
+
+    const RigidBodyComponent *top = RigidGetBody(universe, boxes[HEIGHT - 1]);
+    double drop = top->position.y - (floor - 10.0 - 20.0 * (HEIGHT - 1));
+    double speed = 0.0;
+    for (int i = 0; i < HEIGHT; i++)
+        speed = fmax(speed, KVector2Norm(RigidGetBody(universe, boxes[i])->velocity));
+
+    int failed = 0;
+    if (fabs(top->position.x - 201.0) > 2.0 || drop > HEIGHT * universe->rigid->settings.slop ||
+        fabs(RigidAngle(top->orientation)) > 0.02 || speed > 2.0 ||
+        universe->rigid->warmStarted < 2 * HEIGHT) {
+        fprintf(stderr, "Stack: top x %g, drop %g, angle %g, speed %g, warm started %u\n",
+                top->position.x, drop, RigidAngle(top->orientation), speed,
+                universe->rigid->warmStarted);
+        failed = 1;
+    }
+
+    UniverseDestroy(universe);
+    if (!failed)
+        printf("Stack test: PASSED\n");
+    return failed;
+}
+
+// Contact impulses are equal and opposite, so a collision conserves linear
+// and angular momentum
+int test_collision_conserves_momentum() {
+    Universe *universe = world(4, 0, (KVector2){0, 0});
+    EntityID a = RigidBoxCreate(universe, (KVector2){100, 100}, (KVector2){10, 10}, 0.3, 1.0);
+    EntityID b = RigidCircleCreate(universe, (KVector2){150, 104}, 8.0, 2.0);
+    RigidBodyComponent *ba = RigidGetBody(universe, a);
+    RigidBodyComponent *bb = RigidGetBody(universe, b);
+    ba->velocity = (KVector2){60.0, 0.0};
+    bb->velocity = (KVector2){-40.0, 0.0};
+
+    double momentum[2][3];
+    for (int phase = 0; phase < 2; phase++) {
+        double ma = 1.0 / ba->inverseMass, mb = 1.0 / bb->inverseMass;
+        double px = ma * ba->velocity.x + mb * bb->velocity.x;
+        double py = ma * ba->velocity.y + mb * bb->velocity.y;
+        // About the origin: spin plus r x p of each body
+        double l = ba->angularVelocity / ba->inverseInertia +
+                   bb->angularVelocity / bb->inverseInertia +
+                   ma * (ba->position.x * ba->velocity.y - ba->position.y * ba->velocity.x) +
+                   mb * (bb->position.x * bb->velocity.y - bb->position.y * bb->velocity.x);
+        momentum[phase][0] = px;
+        momentum[phase][1] = py;
+        momentum[phase][2] = l;
+        if (phase == 0) {
+            for (int step = 0; step < 60; step++)
+                UniverseUpdate(universe, DT);
+        }
+    }
+
+    int failed = 0;
+    double scale = fabs(momentum[0][0]) + 1.0;
+    if (fabs(momentum[1][0] - momentum[0][0]) > 1e-9 * scale ||
+        fabs(momentum[1][1] - momentum[0][1]) > 1e-9 * scale ||
+        fabs(momentum[1][2] - momentum[0][2]) > 1e-9 * fabs(momentum[0][2]) ||
+        ba->angularVelocity == 0.0 || bb->velocity.x <= -40.0) {
+        fprintf(stderr, "Momentum (%g, %g, %g) -> (%g, %g, %g)\n", momentum[0][0],
+                momentum[0][1], momentum[0][2], momentum[1][0], momentum[1][1], momentum[1][2]);
+        failed = 1;
+    }
+
+    UniverseDestroy(universe);
+    if (!failed)
+        printf("Momentum test: PASSED\n");
+    return failed;
+}
+
+// Circles settle on a static polygon and on each other
+int test_circles_on_ground() {
+    Universe *universe = world(4, 1, (KVector2){0, 400});
+    RigidBoxCreate(universe, (KVector2){200, 200}, (KVector2){100, 10}, 0.0, 0.0);
+    EntityID lower = RigidCircleCreate(universe, (KVector2){200, 150}, 10.0, 1.0);
+    EntityID upper = RigidCircleCreate(universe, (KVector2){200, 100}, 10.0, 1.0);
+
+    for (int step = 0; step < 240; step++)
+        UniverseUpdate(universe, DT);
+
+    const RigidBodyComponent *l = RigidGetBody(universe, lower);
+    const RigidBodyComponent *u = RigidGetBody(universe, upper);
+    const double slop = universe->rigid->settings.slop;
+    int failed = 0;
+    if (fabs(l->position.y - 180.0) > slop + 0.05 || fabs(u->position.y - 160.0) > 2 * slop + 0.1 ||
+        fabs(u->position.x - 200.0) > 1e-6 || KVector2Norm(u->velocity) > 0.1) {
+        fprintf(stderr, "Circles at y %g and %g (x %g)\n", l->position.y, u->position.y,
+                u->position.x);
+        failed = 1;
+    }
+
+    UniverseDestroy(universe);
+    if (!failed)
+        printf("Circle contact test: PASSED\n");
+    return failed;
+}
+
+int main(void) {
+    int result = 0;
+
+    result |= test_mass_properties();
+    result |= test_free_rotation();
+    result |= test_box_comes_to_rest();
+    result |= test_stack_holds();
+    result |= test_collision_conserves_momentum();
+    result |= test_circles_on_ground();
+
+    if (result == 0) {
+        printf("\nAll rigid body tests passed!\n");
+    } else {
+        printf("\nSome rigid body tests failed!\n");
+    }
+
+    return result;
+}
@@ -0,0 +1,181 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../src/config/config.h"
+#include "../src/core/engine.h"
+
+#define DT (1.0 / 60.0)
+#define PARTICLES 3000
+
+static Universe *world(void) {
+    Universe *universe = UniverseCreate(PARTICLES + 64);
+    UniverseSetBoundaries(universe, 400, 300, 0.0f, true);
+    ObstaclesEnable(universe, 8, 32);
+    ObstacleAddCircle(universe, (KVector2){200, 150}, 30.0);
+    ObstacleAddSegment(universe, (KVector2){50, 250}, (KVector2){350, 220});
+    srand(21);
+    for (int i = 0; i < PARTICLES; i++) {
+        EntityID e = ParticleCreate(universe, (KVector2){rand() % 400, rand() % 300},
+                                    (KVector2){rand() % 200 - 100, rand() % 200 - 100}, 1.0 + i % 3);
+        if (i % 2)
+            UniverseAddRadiusComponent(universe, e, 1.0 + i % 4);
+        PhysicsApplyForce(universe, e, (KVector2){10.0 * (i % 5), -20.0});
+        UniverseGetMechanicsComponent(universe, e)->acceleration = (KVector2){0, 98};
+    }
+    return universe;
+}
+
+// The systems UniverseUpdate used to call by hand, in their old order
+static void handWritten(Universe *universe, double deltaTime) {
+    ParticleLifetimeUpdate(universe, deltaTime);
+    ParticleEmittersUpdate(universe, deltaTime);
+    PhysicsForcesUpdate(universe);
+    PhysicsFluidUpdate(universe);
+    PhysicsMechanicsUpdate(universe, deltaTime);
+    PhysicsPositionUpdate(universe, deltaTime);
+    PhysicsResolveBoundaryCollisions(universe);
+    PhysicsResolveObstacleCollisions(universe);
+    PhysicsClearForces(universe);
+    PhysicsRigidUpdate(universe, deltaTime);
+    UniverseFlushCommands(universe);
+    universe->stepCount++;
+}
+
+// Fused and staged, the schedule gives the same bits as the fixed sequence
+int test_matches_fixed_order() {
+    Universe *scheduled = world();
+    Universe *fixed = world();
+    for (int step = 0; step < 60; step++) {
+        UniverseUpdate(scheduled, DT);
+        handWritten(fixed, DT);
+    }
+
+    int failed = memcmp(scheduled->kineticBodies, fixed->kineticBodies,
+                        PARTICLES * sizeof(KineticBodyComponent)) != 0 ||
+                 memcmp(scheduled->mechanics, fixed->mechanics,
+                        PARTICLES * sizeof(MechanicsComponent)) != 0;
+    const SystemTiming *mechanics = UniverseSystemTiming(scheduled, "mechanics");
+    const SystemTiming *position = UniverseSystemTiming(scheduled, "position");
+    failed |= !mechanics || !position || !mechanics->fused || !position->fused ||
+              mechanics->runs != 60 || position->stage != mechanics->stage;
+    if (failed)
+        fprintf(stderr, "Scheduled step differs from the fixed order\n");
+
+    UniverseDestroy(scheduled);
+    UniverseDestroy(fixed);
+    if (!failed)
+        printf("Fixed order test: PASSED\n");
+    return failed;
+}
+
+static ComponentID heatComponent;
+static ComponentID glowComponent;
+static int heatRuns, glowRuns;
+static uint32_t wordsSeen[BITSET_WORDS(PARTICLES + 64)];
+
+static void heatRun(Universe *universe, double deltaTime) {
+    (void)universe;
+    (void)deltaTime;
+    heatRuns++;
+}
+
+static void glowRun(Universe *universe, double deltaTime) {
+    (void)universe;
+    (void)deltaTime;
+    glowRuns++;
+}
+
+// Pushes everything right before the integration sees the forces
+static void windRun(Universe *universe, double deltaTime) {
+    (void)deltaTime;
+    for (EntityID e = 0; e < universe->maxEntities; e++)
+        PhysicsApplyForce(universe, e, (KVector2){600.0, 0.0});
+}
+
+static void countWords(Universe *universe, double deltaTime, uint32_t begin, uint32_t end) {
+    (void)universe;
+    (void)deltaTime;
+    for (uint32_t w = begin; w < end; w++)
+        wordsSeen[w]++;
+}
+
+static SystemKernel countFuse(const Universe *universe) {
+    (void)universe;
+    return countWords;
+}
+
+static void countRun(Universe *universe, double deltaTime) {
+    countWords(universe, deltaTime, 0, BITSET_WORDS(universe->maxEntities));
+}
+
+// Registered systems land where they are asked to, disjoint ones share a
+// stage, and a kernel next to the integration joins its sweep
+int test_registration() {
+    Universe *universe = world();
+    heatComponent = UniverseRegisterComponent(universe, sizeof(double), _Alignof(double));
+    glowComponent = UniverseRegisterComponent(universe, sizeof(double), _Alignof(double));
+
+    UniverseSystem heat = {"heat", heatRun, NULL, NULL, COMPONENT_PARTICLE,
+                           COMPONENT_BIT(heatComponent), 0};
+    UniverseSystem glow = {"glow", glowRun, NULL, NULL, COMPONENT_PARTICLE,
+                           COMPONENT_BIT(glowComponent), 0};
+    UniverseSystem wind = {"wind", windRun, NULL, NULL, COMPONENT_PARTICLE,
+                           COMPONENT_MECHANICS, 0};
+    UniverseSystem count = {"count", countRun, countFuse, NULL, COMPONENT_NONE,
+                            COMPONENT_NONE, SYSTEM_WIDE};
+    int failed = !UniverseRegisterSystem(universe, &heat, "spatial") ||
+                 !UniverseRegisterSystem(universe, &glow, "spatial") ||
+                 !UniverseRegisterSystem(universe, &wind, "mechanics") ||
+                 !UniverseRegisterSystem(universe, &count, "boundary");
+    failed |= UniverseRegisterSystem(universe, &heat, NULL) ||
+              UniverseRegisterSystem(universe, &(UniverseSystem){"x", heatRun}, "missing");
+
+    EntityID still = ParticleCreate(universe, (KVector2){100, 60}, (KVector2){0, 0}, 1.0);
+    UniverseUpdate(universe, DT);
+    double vx = UniverseGetMechanicsComponent(universe, still)->velocity.x;
+
+    const SystemTiming *h = UniverseSystemTiming(universe, "heat");
+    const SystemTiming *g = UniverseSystemTiming(universe, "glow");
+    const SystemTiming *s = UniverseSystemTiming(universe, "spatial");
+    const SystemTiming *c = UniverseSystemTiming(universe, "count");
+    const SystemTiming *p = UniverseSystemTiming(universe, "position");
+    failed |= heatRuns != 1 || glowRuns != 1;
+    // Disjoint writes, both after the last structural system
+    failed |= h->stage != g->stage || h->stage != s->stage;
+    failed |= !c->fused || c->stage != p->stage || c->lastSeconds != p->lastSeconds;
+    for (uint32_t w = 0; w < BITSET_WORDS(universe->maxEntities); w++)
+        failed |= wordsSeen[w] != 1;
+    // The wind got into this step's velocity
+    failed |= fabs(vx - 600.0 * DT) > 1e-9;
+    if (failed)
+        fprintf(stderr, "Stages heat %u glow %u spatial %u count %u position %u, fused %d, vx %g\n",
+                h->stage, g->stage, s->stage, c->stage, p->stage, c->fused, vx);
+
+    // Without it, the wind no longer blows
+    failed |= !UniverseRemoveSystem(universe, "wind") || UniverseSystemTiming(universe, "wind");
+    failed |= !UniverseRemoveSystem(universe, "heat") || UniverseRemoveSystem(universe, "heat");
+    UniverseUpdate(universe, DT);
+    failed |= UniverseGetMechanicsComponent(universe, still)->velocity.x != vx || heatRuns != 1 ||
+              glowRuns != 2;
+
+    UniverseDestroy(universe);
+    if (!failed)
+        printf("Registration test: PASSED\n");
+    return failed;
+}
+
+int main(void) {
+    int result = 0;
+
+    result |= test_matches_fixed_order();
+    result |= test_registration();
+
+    if (result == 0) {
+        printf("\nAll scheduler tests passed!\n");
+    } else {
+        printf("\nSome scheduler tests failed!\n");
+    }
+
+    return result;
+}
@@ -0,0 +1,105 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "../src/config/config.h"
+#include "../src/core/engine.h"
+
+// A long run with entities born and dying every step. `make test` runs a
+// short one; `make soak` runs SOAK_STEPS under a heap profiler such as
+// massif, whose graph should stay flat after the first steps.
+
+#define DT (1.0 / 60.0)
+#define DEFAULT_STEPS 1500
+#define WARMUP_STEPS 200
+#define CHECK_EVERY 250
+#define CHURN 16
+
+static Universe *soakWorld(void) {
+    Universe *universe = UniverseCreate(8000);
+    UniverseSetBoundaries(universe, 640, 480, 0.0f, true);
+    UniverseSetReorderInterval(universe, 30);
+    UniverseSpatialIndexEnable(universe, 10.0);
+    ObstaclesEnable(universe, 8, 32);
+    ObstacleAddCircle(universe, (KVector2){320, 240}, 40.0);
+    ObstacleAddSegment(universe, (KVector2){40, 400}, (KVector2){600, 380});
+    RigidEnable(universe, NULL);
+    for (int i = 0; i < 24; i++)
+        RigidCircleCreate(universe, (KVector2){30.0 + i * 24.0, 60.0}, 6.0, 1.0);
+
+    ParticleEmittersEnable(universe);
+    for (uint32_t e = 0; e < 4; e++) {
+        EmitterComponent emitter = {{0, -1}, 0.6, 400.0, 20, 60, 2.0, 1.0, 0.0, e + 1};
+        EmitterCreate(universe, (KVector2){80.0 + e * 160.0, 470}, &emitter);
+    }
+    return universe;
+}
+
+// Destroys the CHURN particles made CHURN steps ago and makes new ones, so
+// slots recycle through the free list on top of the emitters' churn
+static void churn(Universe *universe, EntityID *ring, uint32_t step) {
+    EntityID *slot = &ring[(step % CHURN) * CHURN];
+    for (uint32_t i = 0; i < CHURN; i++) {
+        if (slot[i] != INVALID_ENTITY)
+            UniverseDestroyEntity(universe, slot[i]);
+        slot[i] = ParticleCreate(universe, (KVector2){20.0 + i * 37.0, 20.0},
+                                 (KVector2){(double)i - CHURN / 2, 10.0}, 1.0);
+    }
+}
+
+int main(int argc, char **argv) {
+    const uint32_t steps = argc > 1 ? (uint32_t)strtoul(argv[1], NULL, 10) : DEFAULT_STEPS;
+    Universe *universe = soakWorld();
+    EntityID ring[CHURN * CHURN];
+    for (uint32_t i = 0; i < CHURN * CHURN; i++)
+        ring[i] = INVALID_ENTITY;
+
+    KAllocationStats settled[K_MEMORY_OWNERS], now[K_MEMORY_OWNERS];
+    uint64_t carved = 0;
+    uint32_t least = UINT32_MAX, most = 0;
+    int failed = !universe;
+    for (uint32_t step = 0; !failed && step < steps; step++) {
+        churn(universe, ring, step);
+        UniverseUpdate(universe, DT);
+
+        if (step + 1 == WARMUP_STEPS) {
+            KAllocationSnapshot(settled);
+            carved = KAllocationCount();
+        }
+        if (step >= WARMUP_STEPS) {
+            uint32_t active = UniverseCountActive(universe);
+            least = active < least ? active : least;
+            most = active > most ? active : most;
+        }
+        if (step >= WARMUP_STEPS && (step + 1) % CHECK_EVERY == 0) {
+            KAllocationSnapshot(now);
+            failed |= KAllocationCount() != carved || !UniverseValidate(universe);
+            for (uint32_t o = 0; o < K_MEMORY_OWNERS; o++)
+                if (now[o].liveBytes != settled[o].liveBytes) {
+                    fprintf(stderr, "Step %u: %s holds %llu bytes, %llu after warm-up\n", step + 1,
+                            KMemoryOwnerName((KMemoryOwner)o), (unsigned long long)now[o].liveBytes,
+                            (unsigned long long)settled[o].liveBytes);
+                    failed = 1;
+                }
+        }
+    }
+
+    // Particles came and went the whole time
+    failed |= steps > WARMUP_STEPS && (least == most || least == 0);
+    if (!failed) {
+        KAllocationSnapshot(now);
+        printf("%u steps, %u to %u entities alive\n", steps, least, most);
+        for (uint32_t o = 0; o < K_MEMORY_OWNERS; o++)
+            if (now[o].peakBytes)
+                printf("  %-10s %10llu bytes live, %10llu peak\n", KMemoryOwnerName((KMemoryOwner)o),
+                       (unsigned long long)now[o].liveBytes, (unsigned long long)now[o].peakBytes);
+        printf("Soak test: PASSED\n");
+    }
+
+    UniverseDestroy(universe);
+    if (failed == 0) {
+        printf("\nAll soak tests passed!\n");
+    } else {
+        printf("\nSome soak tests failed!\n");
+    }
+
+    return failed;
+}
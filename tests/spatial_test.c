@@ -0,0 +1,175 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../src/config/config.h"
+#include "../src/core/engine.h"
+
+#define DT (1.0 / 60.0)
+#define CAPACITY 4000
+
+static int compareIds(const void *a, const void *b) {
+    EntityID x = *(const EntityID *)a, y = *(const EntityID *)b;
+    return (x > y) - (x < y);
+}
+
+static double randomIn(double lo, double hi) {
+    return lo + (hi - lo) * rand() / (double)RAND_MAX;
+}
+
+// Particles over a region that straddles the origin, so negative cells count
+static Universe *scatter(uint32_t count) {
+    Universe *universe = UniverseCreate(CAPACITY);
+    for (uint32_t i = 0; i < count; i++)
+        ParticleCreate(universe, (KVector2){randomIn(-300, 500), randomIn(-200, 400)},
+                       (KVector2){randomIn(-90, 90), randomIn(-90, 90)}, 1.0);
+    return universe;
+}
+
+static int inRadius(KVector2 p, KVector2 centre, double radius) {
+    double dx = p.x - centre.x, dy = p.y - centre.y;
+    return dx * dx + dy * dy <= radius * radius;
+}
+
+static KVector2 positionOf(Universe *universe, EntityID e) {
+    return UniverseGetKineticBodyComponent(universe, e)->position;
+}
+
+// The radius, box and nearest answers of the index against a full scan
+static int matchesScan(Universe *universe, const char *when) {
+    static EntityID found[CAPACITY], expected[CAPACITY];
+    int failed = 0;
+
+    for (int q = 0; q < 40 && !failed; q++) {
+        KVector2 c = {randomIn(-350, 550), randomIn(-250, 450)};
+        double r = q == 0 ? 2000.0 : randomIn(0.0, 60.0);
+        uint32_t n = UniverseQueryRadius(universe, c, r, found, CAPACITY);
+        KVector2 lo = {c.x - r, c.y - 0.5 * r}, hi = {c.x + 0.5 * r, c.y + r};
+        uint32_t boxCount = 0, radiusCount = 0;
+        EntityID nearest = INVALID_ENTITY;
+        double best = INFINITY;
+        for (EntityID e = 0; e < CAPACITY; e++) {
+            if (!UniverseIsEntityActive(universe, e))
+                continue;
+            KVector2 p = positionOf(universe, e);
+            if (inRadius(p, c, r))
+                expected[radiusCount++] = e;
+            boxCount += p.x >= lo.x && p.x <= hi.x && p.y >= lo.y && p.y <= hi.y;
+            double d = (p.x - c.x) * (p.x - c.x) + (p.y - c.y) * (p.y - c.y);
+            if (d < best) {
+                best = d;
+                nearest = e;
+            }
+        }
+
+        qsort(found, n, sizeof(EntityID), compareIds);
+        failed |= n != radiusCount || memcmp(found, expected, n * sizeof(EntityID)) != 0;
+        uint32_t inBox = UniverseQueryAABB(universe, lo, hi, found, CAPACITY);
+        for (uint32_t k = 0; k < inBox && k < CAPACITY; k++) {
+            KVector2 p = positionOf(universe, found[k]);
+            failed |= p.x < lo.x || p.x > hi.x || p.y < lo.y || p.y > hi.y;
+        }
+        failed |= inBox != boxCount;
+        EntityID near = UniverseQueryNearest(universe, c, INFINITY);
+        // Ties may pick either entity; the distance must match
+        failed |= near == INVALID_ENTITY ||
+                  fabs(KVector2Norm(KVector2Subtraction(positionOf(universe, near), c)) - sqrt(best)) > 1e-9;
+        if (failed)
+            fprintf(stderr, "%s, query %d: radius %u/%u, box %u/%u, nearest %u/%u\n", when, q, n,
+                    radiusCount, inBox, boxCount, near, nearest);
+    }
+    return failed;
+}
+
+// Queries agree with a full scan as particles move, die, are born and are
+// reordered; a step only relinks the particles that changed cell
+int test_matches_scan() {
+    srand(11);
+    Universe *universe = scatter(3000);
+    int failed = !UniverseSpatialIndexEnable(universe, 16.0);
+    failed |= matchesScan(universe, "initial");
+
+    for (int step = 0; step < 20 && !failed; step++)
+        UniverseUpdate(universe, DT);
+    failed |= failed || matchesScan(universe, "moved");
+    uint64_t relinked = universe->spatial->relinked;
+    failed |= relinked == 0 || relinked >= universe->spatial->count;
+
+    for (EntityID e = 0; e < 3000; e += 3)
+        UniverseDestroyEntity(universe, e);
+    for (int i = 0; i < 500; i++)
+        ParticleCreate(universe, (KVector2){randomIn(-300, 500), randomIn(-200, 400)},
+                       (KVector2){0, 0}, 1.0);
+    UniverseSpatialIndexUpdate(universe);
+    failed |= failed || matchesScan(universe, "respawned");
+    failed |= universe->spatial->count != UniverseCountActive(universe);
+
+    UniverseReorderByMorton(universe);
+    failed |= failed || matchesScan(universe, "reordered");
+
+    // Far from everything, and limited by distance
+    failed |= UniverseQueryNearest(universe, (KVector2){1e6, -1e6}, INFINITY) == INVALID_ENTITY;
+    failed |= UniverseQueryNearest(universe, (KVector2){1e6, -1e6}, 100.0) != INVALID_ENTITY;
+
+    UniverseDestroy(universe);
+    if (!failed)
+        printf("Scan agreement test: PASSED\n");
+    return failed;
+}
+
+// Batched queries return what the single calls return; a full buffer still
+// reports the whole count
+int test_batch() {
+    enum { QUERIES = 500, PER_QUERY = 16 };
+    srand(12);
+    Universe *universe = scatter(3000);
+    UniverseSpatialIndexEnable(universe, 16.0);
+
+    static KVector2 centres[QUERIES];
+    static double radii[QUERIES];
+    static EntityID out[QUERIES * PER_QUERY], nearest[QUERIES];
+    static uint32_t counts[QUERIES];
+    for (int q = 0; q < QUERIES; q++) {
+        centres[q] = (KVector2){randomIn(-300, 500), randomIn(-200, 400)};
+        radii[q] = randomIn(0.0, 40.0);
+    }
+    UniverseQueryRadiusBatch(universe, centres, radii, QUERIES, out, PER_QUERY, counts);
+    UniverseQueryNearestBatch(universe, centres, QUERIES, INFINITY, nearest);
+
+    int failed = 0, truncated = 0;
+    EntityID single[CAPACITY];
+    for (int q = 0; q < QUERIES && !failed; q++) {
+        uint32_t n = UniverseQueryRadius(universe, centres[q], radii[q], single, CAPACITY);
+        uint32_t kept = n < PER_QUERY ? n : PER_QUERY;
+        truncated += n > PER_QUERY;
+        failed |= counts[q] != n ||
+                  memcmp(single, &out[q * PER_QUERY], kept * sizeof(EntityID)) != 0 ||
+                  nearest[q] != UniverseQueryNearest(universe, centres[q], INFINITY);
+        if (failed)
+            fprintf(stderr, "Batch query %d: %u results, single %u\n", q, counts[q], n);
+    }
+    if (!failed && truncated == 0) {
+        fprintf(stderr, "No query filled its buffer\n");
+        failed = 1;
+    }
+
+    UniverseDestroy(universe);
+    if (!failed)
+        printf("Batch query test: PASSED\n");
+    return failed;
+}
+
+int main(void) {
+    int result = 0;
+
+    result |= test_matches_scan();
+    result |= test_batch();
+
+    if (result == 0) {
+        printf("\nAll spatial tests passed!\n");
+    } else {
+        printf("\nSome spatial tests failed!\n");
+    }
+
+    return result;
+}
@@ -0,0 +1,161 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "../src/core/engine.h"
+
+#define SLOW 1000
+#define FAST 10
+
+static void populate(Universe *universe, int fast) {
+    UniverseSetBoundaries(universe, 800, 600, 10.0f, true);
+    srand(7);
+    for (int i = 0; i < SLOW; i++) {
+        KVector2 p = {100 + rand() % 600, 100 + rand() % 400};
+        KVector2 v = {rand() % 20 - 10.0, rand() % 20 - 10.0};
+        ParticleCreate(universe, p, v, 1.0);
+    }
+    for (int i = 0; i < fast; i++)
+        ParticleCreate(universe, (KVector2){400, 100 + 40 * i}, (KVector2){3000 - 100 * i, 1500}, 1.0);
+}
+
+// With every entity in class 0 the adaptive path is the uniform step
+int test_slow_matches_uniform() {
+    Universe *adaptive = UniverseCreate(SLOW);
+    Universe *uniform = UniverseCreate(SLOW);
+    populate(adaptive, 0);
+    populate(uniform, 0);
+    UniverseSetAdaptiveTimestep(adaptive, 50.0);
+
+    for (int s = 0; s < 100; s++) {
+        UniverseUpdate(adaptive, 0.05);
+        UniverseUpdate(uniform, 0.05);
+    }
+
+    int failed = 0;
+    if (adaptive->timestep.classCounts[0] != SLOW || adaptive->timestep.substeps != SLOW) {
+        fprintf(stderr, "Slow entities left class 0 (%u in class 0)\n",
+                adaptive->timestep.classCounts[0]);
+        failed = 1;
+    }
+    for (EntityID e = 0; e < SLOW && !failed; e++) {
+        KVector2 a = UniverseGetKineticBodyComponent(adaptive, e)->position;
+        KVector2 b = UniverseGetKineticBodyComponent(uniform, e)->position;
+        if (a.x != b.x || a.y != b.y) {
+            fprintf(stderr, "Entity %u diverged: (%f, %f) vs (%f, %f)\n", e, a.x, a.y, b.x, b.y);
+            failed = 1;
+        }
+    }
+
+    UniverseDestroy(adaptive);
+    UniverseDestroy(uniform);
+    if (!failed)
+        printf("Slow entities match uniform steps test: PASSED\n");
+    return failed;
+}
+
+// A fast entity must land where fine uniform steps put it, bounces included
+int test_fast_matches_fine_steps() {
+    Universe *adaptive = UniverseCreate(4);
+    Universe *fine = UniverseCreate(4);
+    EntityID a = ParticleCreate(adaptive, (KVector2){700, 300}, (KVector2){4000, -2500}, 1.0);
+    EntityID b = ParticleCreate(fine, (KVector2){700, 300}, (KVector2){4000, -2500}, 1.0);
+    UniverseSetBoundaries(adaptive, 800, 600, 10.0f, true);
+    UniverseSetBoundaries(fine, 800, 600, 10.0f, true);
+    UniverseSetAdaptiveTimestep(adaptive, 2.0);
+
+    for (int s = 0; s < 20; s++) {
+        UniverseUpdate(adaptive, 0.05);
+        for (int k = 0; k < 1 << (TIMESTEP_CLASSES - 1); k++)
+            UniverseUpdate(fine, 0.05 / (1 << (TIMESTEP_CLASSES - 1)));
+    }
+
+    KVector2 pa = UniverseGetKineticBodyComponent(adaptive, a)->position;
+    KVector2 pb = UniverseGetKineticBodyComponent(fine, b)->position;
+    KVector2 va = UniverseGetMechanicsComponent(adaptive, a)->velocity;
+    KVector2 vb = UniverseGetMechanicsComponent(fine, b)->velocity;
+    int failed = fabs(pa.x - pb.x) > 1e-6 || fabs(pa.y - pb.y) > 1e-6 ||
+                 fabs(va.x - vb.x) > 1e-6 || fabs(va.y - vb.y) > 1e-6;
+    if (failed)
+        fprintf(stderr, "Adaptive (%f, %f) v(%f, %f) vs fine (%f, %f) v(%f, %f)\n",
+                pa.x, pa.y, va.x, va.y, pb.x, pb.y, vb.x, vb.y);
+
+    UniverseDestroy(adaptive);
+    UniverseDestroy(fine);
+    if (!failed)
+        printf("Fast entity matches fine steps test: PASSED\n");
+    return failed;
+}
+
+// Only the fast few pay for the fine rate
+int test_work_drops() {
+    Universe *universe = UniverseCreate(SLOW + FAST);
+    populate(universe, FAST);
+    UniverseSetAdaptiveTimestep(universe, 5.0);
+
+    uint64_t adaptiveWork = 0, uniformWork = 0;
+    for (int s = 0; s < 50; s++) {
+        UniverseUpdate(universe, 0.05);
+        uint32_t finest = 0;
+        for (uint32_t k = 0; k < TIMESTEP_CLASSES; k++)
+            if (universe->timestep.classCounts[k])
+                finest = k;
+        adaptiveWork += universe->timestep.substeps;
+        uniformWork += (uint64_t)(SLOW + FAST) << finest;
+    }
+
+    int failed = !UniverseValidate(universe) || adaptiveWork * 10 > uniformWork;
+    if (failed)
+        fprintf(stderr, "Adaptive work %llu vs uniform %llu\n",
+                (unsigned long long)adaptiveWork, (unsigned long long)uniformWork);
+
+    UniverseDestroy(universe);
+    if (!failed)
+        printf("Integration work drops test (%.1fx less): PASSED\n",
+               (double)uniformWork / (double)adaptiveWork);
+    return failed;
+}
+
+// Particles touching a wall without racing into it stay coarse; one
+// flying into a wall takes a finer class than its speed alone needs
+int test_wall_contact() {
+    Universe *universe = UniverseCreate(64);
+    UniverseSetBoundaries(universe, 800, 600, 10.0f, true);
+    UniverseSetAdaptiveTimestep(universe, 5.0);
+    const UniverseBoundary *b = &universe->boundary;
+    for (int i = 0; i < 20; i++) {
+        // Resting on the floor, and sliding away from the left wall
+        ParticleCreate(universe, (KVector2){100 + 10 * i, b->bottom}, (KVector2){5, 0}, 1.0);
+        ParticleCreate(universe, (KVector2){b->left, 100 + 10 * i}, (KVector2){20, 0}, 1.0);
+    }
+    ParticleCreate(universe, (KVector2){b->right - 1.0, 300}, (KVector2){400, 0}, 1.0);
+
+    UniverseUpdate(universe, 0.05);
+    uint32_t coarse = universe->timestep.classCounts[0] + universe->timestep.classCounts[1];
+    // 20 units this step: class 2 in the open, class 4 at the wall floor
+    uint32_t fine = universe->timestep.classCounts[4];
+    int failed = coarse != 40 || fine != 1 || !UniverseValidate(universe);
+    if (failed)
+        fprintf(stderr, "%u coarse, %u in class 4\n", coarse, fine);
+
+    UniverseDestroy(universe);
+    if (!failed)
+        printf("Wall contact test: PASSED\n");
+    return failed;
+}
+
+int main(void) {
+    int result = 0;
+
+    result |= test_slow_matches_uniform();
+    result |= test_fast_matches_fine_steps();
+    result |= test_work_drops();
+    result |= test_wall_contact();
+
+    if (result == 0) {
+        printf("\nAll timestep tests passed!\n");
+    } else {
+        printf("\nSome timestep tests failed!\n");
+    }
+
+    return result;
+}